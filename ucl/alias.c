@@ -0,0 +1,527 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Alias analysis of the memory accesses of a function on the SSA form.
+
+	An access is described by its address, base + index + offset, see
+	struct memRef.   base is the object accessed, or the pointer the
+	address is computed from, index is a temporary added to it, offset is
+	the sum of the constants added:
+
+		t1 :&a;
+		t2 : i << 2;
+		t3 : t2 + 8;
+		t4 : t1 + t3;
+		t5 :*t4;			----- base a, index t2, offset 8
+
+	Two accesses may touch the same bytes, see MayAlias(), unless
+	(1)	they have the same base and index, and their bytes don't overlap;
+	(2)	they access two different objects;
+	(3)	one accesses a local variable whose address isn't taken, and the
+		other goes through a pointer, or is done by a callee;
+	(4)	their types can't access the same object, C89 3.3, which is
+		only used with strict aliasing, see -fno-strict-aliasing.   A char
+		may access any object, so may a record copied as a whole;
+	(5)	one goes through a pointer based on a restrict parameter p, and
+		the other through a pointer not based on p, or names an object,
+		C99 6.7.3.1.   A pointer computed from p, or from a phi function
+		with p as an argument, is based on p, see Origin().   The rule is
+		only used when no pointer based on a restrict parameter is
+		stored in memory or passed to a callee, otherwise a pointer read
+		from memory may be based on it.
+
+	The loads of the same location, and the loads of a location just
+	written, are found by GlobalValueNumbering(), see gvn.c.   A variable
+	which the stores in a loop can't change is read once before the loop
+	by HoistLoopInvariants(), see licm.c.
+ */
+
+// use the types of the accesses, see -fno-strict-aliasing
+int StrictAliasing = 1;
+
+// the instruction defining temporary t, Defs[AsVar(t)->no]
+static IRInst *Defs;
+static int NumDefs;
+// Visited[AsVar(t)->no] is Stamp when Origin() has visited t
+static int *Visited;
+static int Stamp;
+// the temporaries Origin() may still visit
+static int Budget;
+static FunctionSymbol CurFunc;
+static IRInst CurInst;
+// set when the restrict parameters are honored, see rule (5)
+static int RestrictSafe;
+// a pointer based on several restrict parameters, or one we know nothing about
+static struct symbol Mixed;
+// a temporary assigned twice has no single definition
+static struct irinst MultiDef;
+
+#define MAX_DECOMPOSE  8
+#define MAX_ORIGIN     64
+
+#define IsIntConstant(p) ((p)->kind == SK_Constant && IsIntegType((p)->ty))
+
+static IRInst DefOf(Symbol p)
+{
+	if (p == NULL || p->kind != SK_Temp || AsVar(p)->no == 0 || AsVar(p)->no > NumDefs)
+		return NULL;
+
+	return Defs[AsVar(p)->no] == &MultiDef ? NULL : Defs[AsVar(p)->no];
+}
+
+static int IsRestrictParam(Symbol p)
+{
+	Symbol q;
+
+	if (p->kind != SK_Variable || ! IsPtrType(p->ty) || ! (p->ty->qual & RESTRICT))
+		return 0;
+
+	// not a copy of the parameter of a function inlined
+	for (q = CurFunc->params; q != NULL; q = q->next)
+	{
+		if (q == p)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * The variable which p is part of, s for s.x and s[2]; *offset is the offset of p in it
+ */
+static Symbol Root(Symbol p, int *offset)
+{
+	while (p->kind == SK_Offset)
+	{
+		*offset += AsVar(p)->offset;
+		p = p->link;
+	}
+	return p;
+}
+
+static Symbol MergeOrigin(Symbol o1, Symbol o2)
+{
+	if (o1 == NULL || o1 == o2)
+		return o2;
+	if (o2 == NULL)
+		return o1;
+
+	return &Mixed;
+}
+
+/**
+	The restrict parameter the value of p is based on, NULL if it is based
+	on none.   The definitions of the operands are followed, a temporary
+	visited again adds nothing, so a phi function in a loop is based on
+	its arguments from outside the loop:
+		t1 = p;
+		t2 : phi(t1 BB0, t3 BB1);		----- based on p
+		t3 : t2 + 4;
+	A value loaded from memory or returned by a call is based on none,
+	when rule (5) is used.
+ */
+static Symbol Origin(Symbol p)
+{
+	IRInst inst;
+	Vector args;
+	Symbol o = NULL;
+	int i;
+
+	if (p == NULL || p->kind == SK_Constant || p->kind == SK_String || p->kind == SK_Function)
+		return NULL;
+	if (p->kind != SK_Temp)
+		return p->kind == SK_Variable && IsRestrictParam(p) ? p : NULL;
+	if ((inst = DefOf(p)) == NULL || --Budget < 0)
+		return &Mixed;
+	if (Visited[AsVar(p)->no] == Stamp)
+		return NULL;
+
+	Visited[AsVar(p)->no] = Stamp;
+	switch (inst->opcode)
+	{
+	case DEREF:
+	case CALL:
+	case ADDR:
+		return NULL;
+
+	case PHI:
+		args = (Vector)inst->opds[1];
+		for (i = 0; i < LEN(args); i++)
+		{
+			o = MergeOrigin(o, Origin(((PhiArg)GET_ITEM(args, i))->sym));
+		}
+		return o;
+
+	default:
+		o = Origin(inst->opds[1]);
+		return MergeOrigin(o, Origin(inst->opds[2]));
+	}
+}
+
+static Symbol FindOrigin(Symbol p)
+{
+	Stamp++;
+	Budget = MAX_ORIGIN;
+	return Origin(p);
+}
+
+/**
+ * Return 1 if a value based on a restrict parameter is stored by inst
+ */
+static int StoresRestrict(IRInst inst)
+{
+	Vector args;
+	int i;
+
+	if (inst->opcode == CALL)
+	{
+		args = (Vector)inst->opds[2];
+		for (i = 0; i < LEN(args); i++)
+		{
+			if (FindOrigin(((ILArg)GET_ITEM(args, i))->sym) != NULL)
+				return 1;
+		}
+		return 0;
+	}
+	if (inst->opcode == IMOV)
+		return FindOrigin(inst->opds[1]) != NULL;
+	if (inst->opcode <= SELZ || (inst->opcode >= EXTI1 && inst->opcode <= MOV))
+	{
+		return inst->opds[0]->kind != SK_Temp &&
+		       (FindOrigin(inst->opds[1]) != NULL || FindOrigin(inst->opds[2]) != NULL);
+	}
+	return 0;
+}
+
+static void RecordDef(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+	int no;
+
+	if (! def || p->kind != SK_Temp || (no = AsVar(p)->no) == 0 || no > NumDefs)
+		return;
+
+	Defs[no] = Defs[no] == NULL ? CurInst : &MultiDef;
+}
+
+/**
+	Prepare the alias queries on fsym, the temporaries of the SSA form
+	are numbered from 1 to n.   The temporaries created later have no
+	definition, they are treated as unknown pointers.
+ */
+void SetupAlias(FunctionSymbol fsym, int n)
+{
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int dummy = 0;
+
+	CurFunc = fsym;
+	NumDefs = n;
+	Defs = HeapAllocate(CurrentHeap, (n + 1) * sizeof(IRInst));
+	memset(Defs, 0, (n + 1) * sizeof(IRInst));
+	Visited = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	memset(Visited, 0, (n + 1) * sizeof(int));
+	Stamp = 0;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			CurInst = inst;
+			VisitOperands(inst, RecordDef);
+			// the address of a field or an element is the address of the variable
+			if (inst->opcode == ADDR)
+				Root(inst->opds[1], &dummy)->addressed = 1;
+		}
+	}
+
+	RestrictSafe = 0;
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (IsRestrictParam(p))
+		{
+			if (p->addressed)
+				return;
+			RestrictSafe = 1;
+		}
+	}
+	for (bb = fsym->entryBB; bb != NULL && RestrictSafe; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (StoresRestrict(inst))
+			{
+				RestrictSafe = 0;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * The access of size bytes at the beginning of object p, a variable or a field of it
+ */
+void ObjectRef(MemRef ref, Symbol p, int size)
+{
+	ref->offset = 0;
+	ref->base = Root(p, &ref->offset);
+	ref->index = NULL;
+	ref->size = size;
+	ref->ty = p->ty;
+	ref->object = 1;
+	ref->origin = NULL;
+}
+
+/**
+ * Return 1 if the address p is computed from the address of an object
+ */
+static int IsObjectAddress(Symbol p)
+{
+	IRInst inst;
+	int i;
+
+	for (i = 0; i < MAX_DECOMPOSE && (inst = DefOf(p)) != NULL; i++)
+	{
+		if (inst->opcode == ADDR)
+			return 1;
+		if (inst->opcode != MOV && ! ((inst->opcode == ADD || inst->opcode == SUB) && IsIntConstant(inst->opds[2])))
+			return 0;
+		p = inst->opds[1];
+	}
+	return 0;
+}
+
+/**
+ * Fold the constants added to the index p into the offset
+ */
+static Symbol DecomposeIndex(MemRef ref, Symbol p)
+{
+	IRInst inst;
+	int i;
+
+	for (i = 0; i < MAX_DECOMPOSE && (inst = DefOf(p)) != NULL; i++)
+	{
+		if (inst->opcode == MOV && inst->opds[1]->kind == SK_Temp)
+		{
+			p = inst->opds[1];
+		}
+		else if ((inst->opcode == ADD || inst->opcode == SUB) && IsIntConstant(inst->opds[2]))
+		{
+			ref->offset += inst->opcode == ADD ? inst->opds[2]->val.i[0] : -inst->opds[2]->val.i[0];
+			p = inst->opds[1];
+		}
+		else
+		{
+			break;
+		}
+	}
+	return p;
+}
+
+/**
+ * The access of type ty through the address addr, *addr
+ */
+void IndirectRef(MemRef ref, Type ty, Symbol addr)
+{
+	IRInst inst;
+	Symbol p, q;
+	int i;
+
+	ref->base = addr;
+	ref->index = NULL;
+	ref->offset = 0;
+	ref->size = ty->size;
+	ref->ty = ty;
+	ref->object = 0;
+	ref->origin = RestrictSafe ? FindOrigin(addr) : &Mixed;
+
+	for (i = 0; i < MAX_DECOMPOSE && (inst = DefOf(ref->base)) != NULL; i++)
+	{
+		p = inst->opds[1];
+		q = inst->opds[2];
+		if (inst->opcode == ADDR)
+		{
+			ref->base = Root(p, &ref->offset);
+			ref->object = 1;
+			ref->origin = NULL;
+			return;
+		}
+		if (inst->opcode == MOV && p->kind == SK_Temp)
+		{
+			ref->base = p;
+		}
+		else if ((inst->opcode == ADD || inst->opcode == SUB) && IsIntConstant(q))
+		{
+			ref->offset += inst->opcode == ADD ? q->val.i[0] : -q->val.i[0];
+			ref->base = p;
+		}
+		else if (inst->opcode == ADD && ref->index == NULL)
+		{
+			// the address is p + q or q + p
+			if (IsObjectAddress(q))
+			{
+				q = p;
+				p = inst->opds[2];
+			}
+			ref->index = DecomposeIndex(ref, q);
+			ref->base = p;
+		}
+		else
+		{
+			break;
+		}
+	}
+	// the value of a variable may change, the address isn't known
+	if (ref->base->kind != SK_Temp)
+	{
+		ref->base = ref->index = NULL;
+	}
+}
+
+/**
+ * The index is a value, not a variable which may be changed between two accesses
+ */
+static int IsValueIndex(MemRef ref)
+{
+	return ref->index == NULL || ref->index->kind == SK_Temp;
+}
+
+/**
+ * Return 1 if ref1 and ref2 access the same bytes
+ */
+int SameLocation(MemRef ref1, MemRef ref2)
+{
+	return ref1->base != NULL && ref1->base == ref2->base && ref1->index == ref2->index && IsValueIndex(ref1) &&
+	       ref1->offset == ref2->offset && ref1->size == ref2->size;
+}
+
+/**
+ * The objects of the types in the same class may be accessed by each other, see rule (4)
+ */
+static int AliasClass(Type ty)
+{
+	switch (Unqual(ty)->categ)
+	{
+	case SHORT:
+	case USHORT:
+		return 1;
+
+	case INT:
+	case UINT:
+	case LONG:
+	case ULONG:
+	case ENUM:
+		return 2;
+
+	case LONGLONG:
+	case ULONGLONG:
+		return 3;
+
+	case FLOAT:
+		return 4;
+
+	case DOUBLE:
+	case LONGDOUBLE:
+		return 5;
+
+	case POINTER:
+		return 6;
+
+	default:
+		// char, a record or an array
+		return 0;
+	}
+}
+
+/**
+ * A volatile variable, or a field or an element of one
+ */
+static int IsVolatileObject(Symbol p)
+{
+	int offset = 0;
+
+	if (p == NULL || (p->kind != SK_Variable && p->kind != SK_Offset))
+		return 0;
+
+	return (p->ty->qual & VOLATILE) || (Root(p, &offset)->ty->qual & VOLATILE);
+}
+
+/**
+	Return 1 if inst reads or writes a volatile object, it can't be removed
+	or merged with another access.   A load or a store through a pointer
+	has the type of the object accessed, see AccessType() in tranexpr.c:
+		volatile int *p;
+		t1 = *p;	t2 = *p;		----- both are kept
+	&g doesn't access g, the operands of a call and a phi aren't checked.
+ */
+int IsVolatileAccess(IRInst inst)
+{
+	int op = inst->opcode, i;
+
+	if ((op == DEREF || op == IMOV) && (inst->ty->qual & VOLATILE))
+		return 1;
+	if (op == ADDR || op == CALL || op == PHI || op == IJMP)
+		return 0;
+
+	// opds[0] of a jump is the target block
+	for (i = (op >= JZ && op <= JMP) ? 1 : 0; i < 3; i++)
+	{
+		if (IsVolatileObject(inst->opds[i]))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * A scalar variable in memory, whose value can be held by a temporary.
+ */
+int IsMemoryScalar(Symbol p)
+{
+	if (p == NULL || (p->kind != SK_Variable && p->kind != SK_Offset) || IsVolatileObject(p))
+		return 0;
+
+	return IsRealType(p->ty) || ((IsIntegType(p->ty) || IsPtrType(p->ty)) && p->ty->size <= 4);
+}
+
+/**
+ * A local variable whose address isn't taken, see rule (3)
+ */
+int IsPrivateRef(MemRef ref)
+{
+	Symbol p = ref->base;
+
+	return ref->object && p->level != 0 && p->sclass != TK_STATIC && p->sclass != TK_EXTERN && ! p->addressed;
+}
+
+/**
+ * Return 1 if ref1 and ref2 may access the same bytes
+ */
+int MayAlias(MemRef ref1, MemRef ref2)
+{
+	int c1, c2;
+
+	if (ref1->base != NULL && ref1->base == ref2->base)
+	{
+		if (ref1->index != ref2->index || ! IsValueIndex(ref1))
+			return 1;
+		return ref1->offset < ref2->offset + ref2->size && ref2->offset < ref1->offset + ref1->size;
+	}
+	if (ref1->object && ref2->object)
+		return 0;
+	if (IsPrivateRef(ref1) || IsPrivateRef(ref2))
+		return 0;
+
+	if (StrictAliasing)
+	{
+		c1 = AliasClass(ref1->ty);
+		c2 = AliasClass(ref2->ty);
+		if (c1 != 0 && c2 != 0 && c1 != c2)
+			return 0;
+	}
+
+	// rule (5), an object named or a pointer based on none has no origin
+	if (ref1->origin == &Mixed || ref2->origin == &Mixed || ref1->origin == ref2->origin)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,267 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Global copy propagation.
+
+	A copy d = s is available at a point, when it is done on every path
+	from the entry to the point, and neither d nor s is assigned after it.
+	A use of d is then replaced by s, and another d = s is deleted:
+
+		t4 = t2;						t4 = t2;
+		if (t4 == 0) goto BB3;			if (t2 == 0) goto BB3;
+	BB2:							BB2:
+		t5 = t4 + 1;		----->		t5 = t2 + 1;
+	BB3:							BB3:
+		t4 = t2;						----- deleted
+		return t4;						return t2;
+
+	The copies left after DestroySSA() and the ones translated from the
+	assignments of the promoted variables, see PromoteVariables(), are
+	propagated; a copy whose destination isn't used any more is deleted
+	by EliminateDeadStores().   The copies of a constant aren't propagated,
+	the constants are already propagated by PropagateConstants(), but a
+	copy of a constant which is available is deleted too.
+
+	The available copies are a forward dataflow problem, see dataflow.c,
+		In(B)  = ^ Out(P),  P is predecessor of B,  In(entry) is empty
+		Out(B) = Gen(B) U (In(B) - Kill(B))
+ */
+
+#define MAX_COPY_ROUNDS  3
+
+// the copies of current function, Copies[0 .. NumCopies - 1]
+static IRInst *Copies;
+static int NumCopies;
+// the temporary copied by Copies[i] is Sources[i], the copy itself may be propagated into
+static Symbol *Sources;
+// the copies reading or writing the temporary whose AsVar(t)->no is i are CopiesOf[i]
+static Vector *CopiesOf;
+static Dataflow Available;
+static BitSet Avail;
+
+#define IsCopyTemp(p) (IsSSATemp(p) && AsVar(p)->no != 0)
+
+/**
+ * d = s, d is a temporary, s is a temporary or a constant of the same type
+ */
+static int IsCopy(IRInst inst)
+{
+	Symbol *opds = inst->opds;
+
+	if (inst->opcode != MOV || ! IsCopyTemp(opds[0]) || TypeCode(opds[0]->ty) != TypeCode(inst->ty))
+		return 0;
+	if (opds[1]->kind == SK_Constant)
+		return 1;
+
+	return IsCopyTemp(opds[1]) && opds[1] != opds[0] && SameValueType(opds[0], opds[1]);
+}
+
+static void AddCopy(Symbol p, int i)
+{
+	Vector v = CopiesOf[AsVar(p)->no];
+
+	if (v == NULL)
+		v = CopiesOf[AsVar(p)->no] = CreateVector(4);
+	INSERT_ITEM(v, (void *)(long)i);
+}
+
+/**
+ * Number the temporaries and the copies, inst->no is the number of copy inst, or -1
+ */
+static void NumberCopies(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int n;
+
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) ? ++n : 0;
+	}
+	CopiesOf = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Vector));
+	memset(CopiesOf, 0, (n + 1) * sizeof(Vector));
+
+	NumCopies = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			inst->no = IsCopy(inst) ? NumCopies++ : -1;
+		}
+	}
+	Copies = HeapAllocate(CurrentHeap, (NumCopies + 1) * sizeof(IRInst));
+	Sources = HeapAllocate(CurrentHeap, (NumCopies + 1) * sizeof(Symbol));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->no < 0)
+				continue;
+			Copies[inst->no] = inst;
+			Sources[inst->no] = inst->opds[1];
+			AddCopy(inst->opds[0], inst->no);
+			if (inst->opds[1]->kind != SK_Constant)
+				AddCopy(inst->opds[1], inst->no);
+		}
+	}
+}
+
+/**
+ * The copies reading or writing the temporary p are not available after it is assigned
+ */
+static void KillCopies(BitSet avail, BitSet kill, Symbol p)
+{
+	Vector v;
+	int i, c;
+
+	if (! IsCopyTemp(p) || (v = CopiesOf[AsVar(p)->no]) == NULL)
+		return;
+
+	for (i = 0; i < LEN(v); i++)
+	{
+		c = (int)(long)GET_ITEM(v, i);
+		ClearBit(avail, c);
+		if (kill != NULL)
+			SetBit(kill, c);
+	}
+}
+
+static BitSet CurKill;
+
+static void VisitKill(Symbol *opd, int def)
+{
+	if (def)
+		KillCopies(Avail, CurKill, *opd);
+}
+
+/**
+ * Update the available copies after inst
+ */
+static void Transfer(IRInst inst, BitSet kill)
+{
+	CurKill = kill;
+	VisitOperands(inst, VisitKill);
+	if (inst->no >= 0)
+	{
+		SetBit(Avail, inst->no);
+		if (kill != NULL)
+			ClearBit(kill, inst->no);
+	}
+}
+
+static void ComputeAvailableCopies(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+
+	Available = CreateDataflow(fsym, DF_FORWARD, DF_INTERSECT, NumCopies);
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		Avail = Available->gen[bb->no];
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			Transfer(inst, Available->kill[bb->no]);
+		}
+	}
+	SolveDataflow(Available);
+}
+
+/**
+ * Return the source of the copy to temporary p which is available, or NULL
+ */
+static Symbol AvailableSource(Symbol p)
+{
+	Vector v;
+	IRInst copy;
+	int i, c;
+
+	if (! IsCopyTemp(p) || (v = CopiesOf[AsVar(p)->no]) == NULL)
+		return NULL;
+
+	for (i = 0; i < LEN(v); i++)
+	{
+		c = (int)(long)GET_ITEM(v, i);
+		copy = Copies[c];
+		if (TestBit(Avail, c) && copy->opds[0] == p && Sources[c]->kind != SK_Constant)
+			return Sources[c];
+	}
+	return NULL;
+}
+
+static int Changed;
+
+static void ReplaceUse(Symbol *opd, int def)
+{
+	Symbol src;
+
+	if (def || (src = AvailableSource(*opd)) == NULL)
+		return;
+
+	(*opd)->ref--;
+	src->ref++;
+	*opd = src;
+	Changed = 1;
+}
+
+static void PropagateBlock(BBlock bb)
+{
+	IRInst inst, next;
+
+	CopyBits(Avail, Available->in[bb->no]);
+	for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+	{
+		next = inst->next;
+		// t++ uses and defines t in one operand
+		if (inst->opcode != INC && inst->opcode != DEC)
+			VisitOperands(inst, ReplaceUse);
+
+		// t1 = t0; ... t0 = t1;	----->	t0 = t0;
+		if ((inst->no >= 0 && TestBit(Avail, inst->no)) ||
+		    (inst->opcode == MOV && inst->opds[0] == inst->opds[1] && IsSSATemp(inst->opds[0])))
+		{
+			inst->opds[0]->ref--;
+			inst->opds[1]->ref--;
+			RemoveInst(bb, inst);
+			Changed = 1;
+			continue;
+		}
+		Transfer(inst, NULL);
+	}
+}
+
+/**
+	Replace the uses of the copied temporaries by their sources in fsym.
+	A chain of copies t1 = t0; t2 = t1; is shortened by one copy in every
+	round, at most MAX_COPY_ROUNDS rounds are done.
+ */
+void PropagateCopies(FunctionSymbol fsym)
+{
+	BBlock bb;
+	Symbol p;
+	int round = 0;
+
+	RebuildCFG(fsym);
+	do
+	{
+		NumberCopies(fsym);
+		Changed = 0;
+		if (NumCopies == 0)
+			break;
+		ComputeAvailableCopies(fsym);
+		Avail = NewBitSet();
+		for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+		{
+			PropagateBlock(bb);
+		}
+	} while (Changed && ++round < MAX_COPY_ROUNDS);
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+}
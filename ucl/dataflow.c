@@ -0,0 +1,634 @@
+#include <time.h>
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Iterative dataflow analysis over the basic blocks of a function.
+
+	A problem is given by its direction, its meet operator, and the Gen
+	and Kill sets of every block, see CreateDataflow():
+		forward:	In(B)  = meet Out(P),  P is predecessor of B
+					Out(B) = Gen(B) U (In(B) - Kill(B))
+		backward:	Out(B) = meet In(S),  S is successor of B
+					In(B)  = Gen(B) U (Out(B) - Kill(B))
+	The meet is U for a "may" problem, e.g. liveness, and ^ for a "must"
+	problem, e.g. the available copies.   The sets of a "may" problem start
+	empty and only grow, the ones of a "must" problem start full and only
+	shrink, they are updated in place.   In(B) of a block without
+	predecessors, or Out(B) of a block without successors for a backward
+	problem, is empty.
+
+	The blocks are visited in reverse postorder for a forward problem and
+	in postorder for a backward one, then a block is put in the worklist
+	again when a set it is computed from changes.   A problem without
+	loops is solved in one pass.
+
+	The sets are sparse bit vectors, a sorted list of chunks of CHUNK_BITS
+	bits, only the chunks with some bit set are allocated.   A function with
+	tens of thousands of temporaries has only a few of them live at a point,
+	the size of a set is proportional to its numbers, not to the number of
+	the temporaries.   A set remembers the chunk accessed last, the bits are
+	mostly visited in increasing order.
+
+	The liveness of the temporaries is the first client, see ComputeLiveness().
+ */
+
+#define CHUNK_WORDS  4
+#define CHUNK_BITS   (CHUNK_WORDS * 32)
+
+typedef struct bitChunk
+{
+	struct bitChunk *next;
+	// the first bit in the chunk is base * CHUNK_BITS
+	int base;
+	unsigned int bits[CHUNK_WORDS];
+} *BitChunk;
+
+struct bitSet
+{
+	BitChunk head;
+	// the chunk accessed last
+	BitChunk cur;
+	// the chunks taken out of the set, they are reused by it
+	BitChunk free;
+};
+
+// the statistics of the problems solved, see -ftime-report
+int DataflowProblems;
+int DataflowVisits;
+int DataflowChunks;
+double DataflowSeconds;
+double LivenessSeconds;
+
+BitSet NewBitSet(void)
+{
+	BitSet set;
+
+	CALLOC(set);
+
+	return set;
+}
+
+static BitChunk NewChunk(BitSet set, int base)
+{
+	BitChunk c;
+
+	if (set->free != NULL)
+	{
+		c = set->free;
+		set->free = c->next;
+	}
+	else
+	{
+		ALLOC(c);
+		DataflowChunks++;
+	}
+	c->base = base;
+	c->bits[0] = c->bits[1] = c->bits[2] = c->bits[3] = 0;
+
+	return c;
+}
+
+/**
+ * The chunk of set which starts at base * CHUNK_BITS, an empty one is inserted if create is 1
+ */
+static BitChunk FindChunk(BitSet set, int base, int create)
+{
+	BitChunk *pprev, c;
+
+	if (set->cur != NULL && set->cur->base <= base)
+	{
+		if (set->cur->base == base)
+			return set->cur;
+		pprev = &set->cur->next;
+	}
+	else
+	{
+		pprev = &set->head;
+	}
+	while ((c = *pprev) != NULL && c->base < base)
+	{
+		pprev = &c->next;
+	}
+	if (c != NULL && c->base == base)
+		return set->cur = c;
+	if (! create)
+		return NULL;
+
+	c = NewChunk(set, base);
+	c->next = *pprev;
+	*pprev = c;
+
+	return set->cur = c;
+}
+
+static int IsEmptyChunk(BitChunk c)
+{
+	return (c->bits[0] | c->bits[1] | c->bits[2] | c->bits[3]) == 0;
+}
+
+/**
+ * Take the empty chunks out of set
+ */
+static void RemoveEmptyChunks(BitSet set)
+{
+	BitChunk *pprev, c;
+
+	pprev = &set->head;
+	while ((c = *pprev) != NULL)
+	{
+		if (IsEmptyChunk(c))
+		{
+			*pprev = c->next;
+			c->next = set->free;
+			set->free = c;
+			continue;
+		}
+		pprev = &c->next;
+	}
+	set->cur = NULL;
+}
+
+int TestBit(BitSet set, int i)
+{
+	BitChunk c = FindChunk(set, i / CHUNK_BITS, 0);
+
+	return c != NULL && (c->bits[(i % CHUNK_BITS) >> 5] & (1u << (i & 31)));
+}
+
+void SetBit(BitSet set, int i)
+{
+	BitChunk c = FindChunk(set, i / CHUNK_BITS, 1);
+
+	c->bits[(i % CHUNK_BITS) >> 5] |= 1u << (i & 31);
+}
+
+/**
+ * The chunk is kept even if it becomes empty, the bit is often set again
+ */
+void ClearBit(BitSet set, int i)
+{
+	BitChunk c = FindChunk(set, i / CHUNK_BITS, 0);
+
+	if (c != NULL)
+		c->bits[(i % CHUNK_BITS) >> 5] &= ~(1u << (i & 31));
+}
+
+void ClearBits(BitSet set)
+{
+	BitChunk c;
+
+	if (set->head == NULL)
+		return;
+	for (c = set->head; c->next != NULL; c = c->next)
+		;
+	c->next = set->free;
+	set->free = set->head;
+	set->head = set->cur = NULL;
+}
+
+void CopyBits(BitSet dst, BitSet src)
+{
+	BitChunk c, *pprev;
+
+	ClearBits(dst);
+	pprev = &dst->head;
+	for (c = src->head; c != NULL; c = c->next)
+	{
+		if (IsEmptyChunk(c))
+			continue;
+		*pprev = NewChunk(dst, c->base);
+		memcpy((*pprev)->bits, c->bits, sizeof(c->bits));
+		pprev = &(*pprev)->next;
+	}
+	*pprev = NULL;
+}
+
+/**
+ * dst = dst U (src - kill), kill may be NULL.   Return 1 if dst is changed.
+ */
+static int UnionMinus(BitSet dst, BitSet src, BitSet kill)
+{
+	BitChunk c, d, k;
+	unsigned int w;
+	int j, changed = 0;
+
+	for (c = src->head; c != NULL; c = c->next)
+	{
+		k = kill != NULL ? FindChunk(kill, c->base, 0) : NULL;
+		d = NULL;
+		for (j = 0; j < CHUNK_WORDS; j++)
+		{
+			w = k != NULL ? c->bits[j] & ~k->bits[j] : c->bits[j];
+			if (w == 0)
+				continue;
+			if (d == NULL)
+				d = FindChunk(dst, c->base, 1);
+			if ((d->bits[j] | w) != d->bits[j])
+			{
+				d->bits[j] |= w;
+				changed = 1;
+			}
+		}
+	}
+	return changed;
+}
+
+/**
+ * dst = dst U src, return 1 if dst is changed
+ */
+int UnionBits(BitSet dst, BitSet src)
+{
+	return UnionMinus(dst, src, NULL);
+}
+
+/**
+ * dst = dst - src, return 1 if dst is changed
+ */
+int MinusBits(BitSet dst, BitSet src)
+{
+	BitChunk c, s;
+	int j, changed = 0;
+
+	for (c = dst->head; c != NULL; c = c->next)
+	{
+		if ((s = FindChunk(src, c->base, 0)) == NULL)
+			continue;
+		for (j = 0; j < CHUNK_WORDS; j++)
+		{
+			if (c->bits[j] & s->bits[j])
+			{
+				c->bits[j] &= ~s->bits[j];
+				changed = 1;
+			}
+		}
+	}
+	if (changed)
+		RemoveEmptyChunks(dst);
+	return changed;
+}
+
+/**
+ * dst = dst ^ src, return 1 if dst is changed
+ */
+int IntersectBits(BitSet dst, BitSet src)
+{
+	BitChunk c, s;
+	int j, changed = 0;
+
+	for (c = dst->head; c != NULL; c = c->next)
+	{
+		s = FindChunk(src, c->base, 0);
+		for (j = 0; j < CHUNK_WORDS; j++)
+		{
+			if (c->bits[j] & ~(s != NULL ? s->bits[j] : 0))
+			{
+				c->bits[j] &= s != NULL ? s->bits[j] : 0;
+				changed = 1;
+			}
+		}
+	}
+	if (changed)
+		RemoveEmptyChunks(dst);
+	return changed;
+}
+
+/**
+ * Return 1 if set1 and set2 have no number in common.   The chunks of set1 are
+ * visited and the ones of set2 are searched, set1 should be the smaller one.
+ */
+int DisjointBits(BitSet set1, BitSet set2)
+{
+	BitChunk c, s;
+
+	for (c = set1->head; c != NULL; c = c->next)
+	{
+		if ((s = FindChunk(set2, c->base, 0)) == NULL)
+			continue;
+		if ((c->bits[0] & s->bits[0]) | (c->bits[1] & s->bits[1]) |
+		    (c->bits[2] & s->bits[2]) | (c->bits[3] & s->bits[3]))
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * dst = dst ^ (gen U (src - kill)), return 1 if dst is changed
+ */
+static int IntersectTransfer(BitSet dst, BitSet gen, BitSet src, BitSet kill)
+{
+	BitChunk c, g, s, k;
+	unsigned int w;
+	int j, changed = 0;
+
+	for (c = dst->head; c != NULL; c = c->next)
+	{
+		g = FindChunk(gen, c->base, 0);
+		s = FindChunk(src, c->base, 0);
+		k = FindChunk(kill, c->base, 0);
+		for (j = 0; j < CHUNK_WORDS; j++)
+		{
+			w = s != NULL ? s->bits[j] : 0;
+			if (k != NULL)
+				w &= ~k->bits[j];
+			if (g != NULL)
+				w |= g->bits[j];
+			if (c->bits[j] & ~w)
+			{
+				c->bits[j] &= w;
+				changed = 1;
+			}
+		}
+	}
+	if (changed)
+		RemoveEmptyChunks(dst);
+	return changed;
+}
+
+/**
+ * The least number in set which isn't less than i, or -1
+ */
+int NextBit(BitSet set, int i)
+{
+	BitChunk c;
+	unsigned int w;
+	int j, n;
+
+	if (i < 0)
+		i = 0;
+	c = set->cur != NULL && set->cur->base <= i / CHUNK_BITS ? set->cur : set->head;
+	for (; c != NULL; c = c->next)
+	{
+		if ((c->base + 1) * CHUNK_BITS <= i)
+			continue;
+		n = c->base * CHUNK_BITS;
+		j = i > n ? (i - n) >> 5 : 0;
+		for (; j < CHUNK_WORDS; j++)
+		{
+			w = c->bits[j];
+			// the bits before i in the first word
+			if (n + j * 32 < i)
+				w &= ~0u << (i & 31);
+			if (w == 0)
+				continue;
+			set->cur = c;
+			n += j * 32;
+			while (! (w & 1))
+			{
+				w >>= 1;
+				n++;
+			}
+			return n;
+		}
+	}
+	return -1;
+}
+
+/**
+ * The numbers 0 .. n - 1
+ */
+static void FillBits(BitSet set, int n)
+{
+	BitChunk c;
+	int i, j;
+
+	ClearBits(set);
+	for (i = 0; i * CHUNK_BITS < n; i++)
+	{
+		c = FindChunk(set, i, 1);
+		for (j = 0; j < CHUNK_WORDS; j++)
+		{
+			c->bits[j] = ~0u;
+		}
+	}
+	for (i = n; i % CHUNK_BITS != 0; i++)
+	{
+		ClearBit(set, i);
+	}
+}
+
+/**
+	Number the blocks of fsym in the order of the list and make an empty
+	problem, the client fills the Gen and Kill sets before SolveDataflow().
+ */
+Dataflow CreateDataflow(FunctionSymbol fsym, int dir, int meet, int size)
+{
+	Dataflow df;
+	BBlock bb;
+	int i, n;
+
+	CALLOC(df);
+	df->dir = dir;
+	df->meet = meet;
+	df->size = size;
+
+	n = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = n++;
+	}
+	df->nblock = n;
+	df->blocks = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	df->in = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BitSet));
+	df->out = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BitSet));
+	df->gen = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BitSet));
+	df->kill = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BitSet));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		i = bb->no;
+		df->blocks[i] = bb;
+		df->in[i] = NewBitSet();
+		df->out[i] = NewBitSet();
+		df->gen[i] = NewBitSet();
+		df->kill[i] = NewBitSet();
+	}
+	return df;
+}
+
+/**
+ * The blocks in reverse postorder, the ones not reached from the entry come last
+ */
+static BBlock *SortBlocks(Dataflow df)
+{
+	BBlock *order, *stack, bb;
+	CFGEdge *succ, edge;
+	int *visited;
+	int i, top, n, k;
+
+	n = df->nblock;
+	order = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	stack = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	succ = HeapAllocate(CurrentHeap, (n + 1) * sizeof(CFGEdge));
+	visited = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	memset(visited, 0, (n + 1) * sizeof(int));
+
+	k = n;
+	top = 0;
+	stack[top++] = df->blocks[0];
+	visited[0] = 1;
+	succ[0] = df->blocks[0]->succs;
+	while (top != 0)
+	{
+		bb = stack[top - 1];
+		if (succ[bb->no] == NULL)
+		{
+			order[--k] = bb;
+			top--;
+			continue;
+		}
+		edge = succ[bb->no];
+		succ[bb->no] = edge->next;
+		if (! visited[edge->bb->no])
+		{
+			visited[edge->bb->no] = 1;
+			succ[edge->bb->no] = edge->bb->succs;
+			stack[top++] = edge->bb;
+		}
+	}
+	// the reached blocks are order[k .. n - 1]
+	memmove(order, order + k, (n - k) * sizeof(BBlock));
+	for (i = 0, k = n - k; i < n; i++)
+	{
+		if (! visited[i])
+			order[k++] = df->blocks[i];
+	}
+	return order;
+}
+
+void SolveDataflow(Dataflow df)
+{
+	BBlock bb, *order, *worklist;
+	BitSet *before, *after;
+	CFGEdge edge, next;
+	int *queued;
+	int i, n, head, count, changed;
+	clock_t start = clock();
+
+	n = df->nblock;
+	DataflowProblems++;
+	if (n == 0)
+		return;
+
+	// the meet is done on the sets before the blocks, the transfer gives the sets after them
+	before = df->dir == DF_FORWARD ? df->in : df->out;
+	after = df->dir == DF_FORWARD ? df->out : df->in;
+	order = SortBlocks(df);
+	worklist = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	queued = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	for (i = 0; i < n; i++)
+	{
+		bb = df->dir == DF_FORWARD ? order[i] : order[n - 1 - i];
+		worklist[i] = bb;
+		queued[bb->no] = 1;
+
+		next = df->dir == DF_FORWARD ? bb->preds : bb->succs;
+		if (df->meet == DF_UNION || next == NULL)
+		{
+			CopyBits(after[bb->no], df->gen[bb->no]);
+			// the boundary doesn't change
+			if (df->meet == DF_INTERSECT)
+				queued[bb->no] = 0;
+			continue;
+		}
+		FillBits(before[bb->no], df->size);
+		FillBits(after[bb->no], df->size);
+		MinusBits(after[bb->no], df->kill[bb->no]);
+		UnionBits(after[bb->no], df->gen[bb->no]);
+	}
+
+	head = 0;
+	count = n;
+	while (count != 0)
+	{
+		bb = worklist[head];
+		head = (head + 1) % n;
+		count--;
+		if (! queued[bb->no])
+			continue;
+		queued[bb->no] = 0;
+		DataflowVisits++;
+
+		i = bb->no;
+		edge = df->dir == DF_FORWARD ? bb->preds : bb->succs;
+		for (; edge != NULL; edge = edge->next)
+		{
+			if (df->meet == DF_UNION)
+				UnionBits(before[i], after[edge->bb->no]);
+			else
+				IntersectBits(before[i], after[edge->bb->no]);
+		}
+		if (df->meet == DF_UNION)
+			changed = UnionMinus(after[i], before[i], df->kill[i]);
+		else
+			changed = IntersectTransfer(after[i], df->gen[i], before[i], df->kill[i]);
+		if (! changed)
+			continue;
+
+		edge = df->dir == DF_FORWARD ? bb->succs : bb->preds;
+		for (; edge != NULL; edge = edge->next)
+		{
+			if (! queued[edge->bb->no] && (df->meet == DF_UNION || (df->dir == DF_FORWARD ?
+			    edge->bb->preds : edge->bb->succs) != NULL))
+			{
+				queued[edge->bb->no] = 1;
+				worklist[(head + count) % n] = edge->bb;
+				count++;
+			}
+		}
+	}
+	DataflowSeconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static BitSet CurUse, CurDef;
+
+static void VisitUseDef(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+	int i;
+
+	if (! IsTracked(p))
+		return;
+
+	i = AsVar(p)->no - 1;
+	if (def)
+	{
+		SetBit(CurDef, i);
+	}
+	else if (! TestBit(CurDef, i))
+	{
+		SetBit(CurUse, i);
+	}
+}
+
+/**
+	The liveness of the temporaries and variables of fsym numbered by
+	AsVar(p)->no, bit no - 1 is set for p.   A variable or temporary is live
+	at a point if it may be read on some path from there before it is
+	assigned again:
+		Out(B) = U In(S),  S is successor of B
+		In(B)  = Use(B) U (Out(B) - Def(B))
+	Use(B) is the set read in B before assigned in it.   The live ones at
+	the entry and exit of block bb are in[bb->no] and out[bb->no].
+ */
+Dataflow ComputeLiveness(FunctionSymbol fsym, int size)
+{
+	Dataflow df;
+	BBlock bb;
+	IRInst inst;
+	clock_t start = clock();
+
+	df = CreateDataflow(fsym, DF_BACKWARD, DF_UNION, size);
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		CurUse = df->gen[bb->no];
+		CurDef = df->kill[bb->no];
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			VisitOperands(inst, VisitUseDef);
+		}
+	}
+	SolveDataflow(df);
+	LivenessSeconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	return df;
+}
@@ -665,7 +665,7 @@ static AstDeclarator ParseDeclarator(int kind)
 
 		NEXT_TOKEN;
 		//	[type-qualifier-list]
-		while (CurrentToken == TK_CONST || CurrentToken == TK_VOLATILE)
+		while (CurrentToken == TK_CONST || CurrentToken == TK_VOLATILE || CurrentToken == TK_RESTRICT)
 		{
 			CREATE_AST_NODE(tok, Token);
 			tok->token = CurrentToken;
@@ -996,6 +996,10 @@ enumerator_list:
  *  type-qualifier:
  *		const
  *		volatile
+ *		restrict
+ *
+ *  function-specifier:
+ *		inline
  *
  *  type-specifier:
  *		void
@@ -1015,7 +1019,7 @@ static AstSpecifiers ParseDeclarationSpecifiers(void)
 {
 	AstSpecifiers specs;
 	AstToken tok;
-	AstNode *scTail, *tqTail, *tsTail;
+	AstNode *scTail, *tqTail, *tsTail, *fsTail;
 	int seeTy = 0;
 
 	CREATE_AST_NODE(specs, Specifiers);
@@ -1025,6 +1029,8 @@ static AstSpecifiers ParseDeclarationSpecifiers(void)
 	tqTail = &specs->tyQuals;
 	// int, double ,	...
 	tsTail = &specs->tySpecs;
+	// inline
+	fsTail = &specs->funcSpecs;
 	/**
 		The real parsing we do here is :
 			declaration-specifiers(opt)
@@ -1052,6 +1058,7 @@ next_specifier:
 
 	case TK_CONST:
 	case TK_VOLATILE:
+	case TK_RESTRICT:
 		// type-qualifier
 		CREATE_AST_NODE(tok, Token);
 		tok->token = CurrentToken;
@@ -1060,6 +1067,15 @@ next_specifier:
 		NEXT_TOKEN;
 		break;
 
+	case TK_INLINE:
+		// function-specifier, a hint for the inliner, see inline.c
+		CREATE_AST_NODE(tok, Token);
+		tok->token = CurrentToken;
+		*fsTail = (AstNode)tok;
+		fsTail = &tok->next;
+		NEXT_TOKEN;
+		break;
+
 	case TK_VOID:
 	case TK_CHAR:
 	case TK_SHORT:
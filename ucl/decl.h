@@ -332,6 +332,7 @@ typedef struct astToken
 		storage-class-specifier	...		(static auto register...)
 		type-specifier 		....			(int, void, ...)
 		type-qualifier		...			(const volatile)
+		function-specifier	...			(inline)
 */
 // (static | int | const| ...) +
 struct astSpecifiers
@@ -340,8 +341,11 @@ struct astSpecifiers
 	AstNode stgClasses;
 	AstNode tyQuals;
 	AstNode tySpecs;
+	AstNode funcSpecs;
 	// After semantics check ,we know the storage-class
 	int sclass;
+	// 1 for inline
+	int inlined;
 	Type ty;
 };
 /**
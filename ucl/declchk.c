@@ -552,10 +552,11 @@ static Type DeriveType(TypeDerivList tyDrvList, Type ty,Coord coord){
 		astFunctionDeclarator.ids
 	@id		"a"
 	@ty		the type of parameter "a"
+	@qual	the qualifiers of "a", dropped from @ty
 	@reg	whether the formal parameter is in register
 	@coord				
  */
-static void AddParameter(Vector params, char *id, Type ty, int reg, Coord coord)
+static void AddParameter(Vector params, char *id, Type ty, int qual, int reg, Coord coord)
 {
 	Parameter param;
 	//	f(a,a,b)		is illegal,  redefinition of parameter.
@@ -571,6 +572,7 @@ static void AddParameter(Vector params, char *id, Type ty, int reg, Coord coord)
 
 	param->id = id;
 	param->ty = ty;
+	param->qual = qual;
 	param->reg = reg;
 	INSERT_ITEM(params, param);
 }
@@ -582,6 +584,7 @@ static void CheckParameterDeclaration(AstFunctionDeclarator funcDec,
 {
 	char *id = NULL;
 	Type ty = NULL;
+	int qual = 0;
 	
 	CheckDeclarationSpecifiers(paramDecl->specs);
 	if (paramDecl->specs->sclass && paramDecl->specs->sclass != TK_REGISTER)
@@ -605,8 +608,12 @@ static void CheckParameterDeclaration(AstFunctionDeclarator funcDec,
 
 	ty = DeriveType(paramDecl->dec->tyDrvList, ty,&paramDecl->coord);
 	// when we are here, the type information for parameter is completer now.
+	// void f(int *restrict p), p is a restrict pointer in f, the type of f is void (int *)
 	if (ty != NULL)
+	{
+		qual = ty->categ == ARRAY || ty->categ == FUNCTION ? 0 : ty->qual;
 		ty = AdjustParameter(ty);
+	}
 
 	if (ty == NULL){	
 		Error(&paramDecl->coord, "Illegal parameter type");
@@ -627,7 +634,7 @@ static void CheckParameterDeclaration(AstFunctionDeclarator funcDec,
 		return;
 	}
 	
-	AddParameter(funcDec->sig->params, id, ty, 
+	AddParameter(funcDec->sig->params, id, ty, qual,
 		paramDecl->specs->sclass == TK_REGISTER, &paramDecl->coord);
 }
 //	"int a, int b , int c "	in 	f(int a, int b, int c).
@@ -684,7 +691,7 @@ static void CheckFunctionDeclarator(AstFunctionDeclarator dec)
 		 */	
 		char *id;
 		FOR_EACH_ITEM(char*, id, funcDec->ids)
-			AddParameter(funcDec->sig->params, id, NULL, 0, &funcDec->coord);
+			AddParameter(funcDec->sig->params, id, NULL, 0, 0, &funcDec->coord);
 		ENDFOR 
 	}
 	else if (LEN(funcDec->ids))
@@ -739,7 +746,7 @@ static void CheckPointerDeclarator(AstPointerDeclarator ptrDec)
 	//	"ptrDec->tyDrvList->next = ptrDec->dec->tyDrvList;"
 	while (tok)
 	{
-		qual |= tok->token == TK_CONST ? CONST : VOLATILE;
+		qual |= tok->token == TK_CONST ? CONST : (tok->token == TK_VOLATILE ? VOLATILE : RESTRICT);
 		tok = (AstToken)tok->next;
 	}
 
@@ -1170,11 +1177,13 @@ static void CheckDeclarationSpecifiers(AstSpecifiers specs)
 		}
 		specs->sclass = tok->token;
 	}
-	//type-qualifier:	const, volatile
+	//function-specifier:	inline
+	specs->inlined = specs->funcSpecs != NULL;
+	//type-qualifier:	const, volatile, restrict
 	tok = (AstToken)specs->tyQuals;
 	while (tok)
 	{
-		qual |= (tok->token == TK_CONST ? CONST : VOLATILE);
+		qual |= (tok->token == TK_CONST ? CONST : (tok->token == TK_VOLATILE ? VOLATILE : RESTRICT));
 		tok = (AstToken)tok->next;
 	}
 	//type-specifier:	int,double, struct ..., union ..., ...
@@ -1312,6 +1321,12 @@ static void CheckDeclarationSpecifiers(AstSpecifiers specs)
 		goto err;
 	}
 
+	// restrict int a;	only a pointer type can be restrict-qualified
+	if ((qual & RESTRICT) && ! IsPtrType(ty))
+	{
+		Error(&specs->coord, "Invalid use of restrict, it requires a pointer type.");
+		qual &= ~RESTRICT;
+	}
 	specs->ty = Qualify(qual, ty);
 	return;
 
@@ -1580,6 +1595,9 @@ static void CheckGlobalDeclaration(AstDeclaration decl)
 					sym->ty = CompositeType(ty, sym->ty);
 				}
 			}
+			// static inline int f(void);
+			if (decl->specs->inlined)
+				sym->inlined = 1;
 			goto next;
 		}
 		/**
@@ -1767,6 +1785,8 @@ void CheckFunction(AstFunction func)
 		}
 	}
 	func->fsym->defined = 1;
+	if (func->specs->inlined)
+		func->fsym->inlined = 1;
 	func->loops = CreateVector(4);
 	func->breakable = CreateVector(4);
 	func->swtches = CreateVector(4);
@@ -1780,7 +1800,7 @@ void CheckFunction(AstFunction func)
 		Vector v= ((FunctionType)ty)->sig->params;
 		
 		FOR_EACH_ITEM(Parameter, param, v)
-			AddVariable(param->id, param->ty, param->reg ? TK_REGISTER : TK_AUTO,&func->coord);
+			AddVariable(param->id, Qualify(param->qual, param->ty), param->reg ? TK_REGISTER : TK_AUTO,&func->coord);
 		ENDFOR
 
 		FSYM->locals = NULL;
@@ -0,0 +1,282 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Dead code and dead store elimination.
+
+	A temporary or a local variable kept in memory is live at a point, when
+	its value may be read on some path from the point before it is assigned
+	again.   An instruction which assigns a variable or a temporary, which
+	isn't live after it, is deleted:
+
+		s.x = 1;				----- deleted, s is assigned again
+		s = t;
+		t0 = a + b;				----- deleted, t0 isn't used
+		a = 3;					----- deleted, a isn't read before return
+		return s.y;
+
+	A field or an element of a variable is assigned by a partial store, it
+	doesn't kill the variable, but it is deleted as well when the variable
+	isn't live.   The variables whose address is taken are read by every
+	call and indirect read, *p, the object p points to isn't known.
+	A volatile variable is never deleted.
+
+	The liveness is a backward dataflow problem, see dataflow.c,
+		Out(B) = U In(S),  S is successor of B,  Out(exit) is empty
+		In(B)  = Use(B) U (Out(B) - Def(B))
+	Use(B) has the exposed variables if B has a call or an indirect read,
+	Def(B) has only the variables assigned as a whole.   Deleting an
+	instruction may make other ones dead, so it is done again until
+	nothing is deleted.
+ */
+
+static Dataflow Liveness;
+// the variables whose address is taken
+static BitSet Exposed;
+static BitSet Live;
+static IRInst CurInst;
+static BitSet CurUse, CurDef;
+
+static int IsMemoryLocal(Symbol p)
+{
+	return p->kind == SK_Variable && p->sclass != TK_STATIC && p->sclass != TK_EXTERN;
+}
+
+/**
+ * The variable or temporary which opd is part of, s for s.x and s[2]
+ */
+static Symbol Root(Symbol p)
+{
+	while (p->kind == SK_Offset)
+		p = p->link;
+
+	return p;
+}
+
+/**
+ * Return 1 if inst assigns the whole of p, the value of p before inst is dead
+ */
+static int IsKilled(IRInst inst, Symbol p)
+{
+	if (IsSSATemp(p))
+		return 1;
+	if (inst->opcode == CLR)
+		return inst->opds[1]->val.i[0] == p->ty->size;
+
+	// p = q, p = f(), p = a + b;  not s.x = 1, it is an offset of s
+	return inst->ty->size == p->ty->size;
+}
+
+static void VisitDef(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+
+	if (! def || ! IsTracked(p) || ! IsKilled(CurInst, p))
+		return;
+
+	ClearBit(Live, AsVar(p)->no - 1);
+	if (CurDef != NULL)
+	{
+		SetBit(CurDef, AsVar(p)->no - 1);
+		ClearBit(CurUse, AsVar(p)->no - 1);
+	}
+}
+
+static void VisitUse(Symbol *opd, int def)
+{
+	Symbol p = Root(*opd);
+
+	if (def || ! IsTracked(p))
+		return;
+
+	SetBit(Live, AsVar(p)->no - 1);
+	if (CurUse != NULL)
+		SetBit(CurUse, AsVar(p)->no - 1);
+}
+
+/**
+ * Update the live set before inst, Live is the one after it
+ */
+static void Transfer(IRInst inst, BitSet use, BitSet def)
+{
+	CurInst = inst;
+	CurUse = use;
+	CurDef = def;
+	if (inst->opcode == CLR)
+	{
+		VisitDef(&inst->opds[0], 1);
+		return;
+	}
+	VisitOperands(inst, VisitDef);
+	VisitOperands(inst, VisitUse);
+	// the object read through a pointer may be any variable whose address is taken
+	if (inst->opcode == DEREF || inst->opcode == CALL)
+	{
+		UnionBits(Live, Exposed);
+		if (use != NULL)
+			UnionBits(use, Exposed);
+	}
+}
+
+/**
+ * Number the temporaries and the local variables
+ */
+static int NumberSymbols(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int n = 0;
+
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = IsMemoryLocal(p) ? ++n : 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp || p->kind == SK_Variable)
+			AsVar(p)->no = p->kind == SK_Temp || IsMemoryLocal(p) ? ++n : 0;
+	}
+
+	Exposed = NewBitSet();
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->opcode == ADDR && IsTracked(Root(inst->opds[1])))
+				SetBit(Exposed, AsVar(Root(inst->opds[1]))->no - 1);
+		}
+	}
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (AsVar(p)->no != 0 && p->addressed)
+			SetBit(Exposed, AsVar(p)->no - 1);
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if ((p->kind == SK_Temp || p->kind == SK_Variable) && AsVar(p)->no != 0 && p->addressed)
+			SetBit(Exposed, AsVar(p)->no - 1);
+	}
+	return n;
+}
+
+static void ComputeLiveVariables(FunctionSymbol fsym, int n)
+{
+	BBlock bb;
+	IRInst inst;
+
+	Liveness = CreateDataflow(fsym, DF_BACKWARD, DF_UNION, n);
+	Live = NewBitSet();
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.prev; inst != &bb->insth; inst = inst->prev)
+		{
+			Transfer(inst, Liveness->gen[bb->no], Liveness->kill[bb->no]);
+		}
+	}
+	SolveDataflow(Liveness);
+}
+
+static void DecreaseReference(Symbol *opd, int def)
+{
+	(*opd)->ref--;
+}
+
+/**
+ * Return 1 if inst only assigns its destination, which is dead after it
+ */
+static int IsDeadStore(IRInst inst)
+{
+	Symbol p;
+
+	if (inst->opcode == CLR || inst->opcode == INC || inst->opcode == DEC)
+		p = inst->opds[0];
+	else if (inst->opcode <= SELZ || (inst->opcode >= ADDR && inst->opcode <= MOV))
+		p = inst->opds[0];
+	else
+		return 0;
+
+	p = Root(p);
+	// int x = g;  int y = *p;  with  volatile int g, *p;
+	if (! IsTracked(p) || IsVolatileAccess(inst))
+		return 0;
+
+	return ! TestBit(Live, AsVar(p)->no - 1);
+}
+
+static int EliminateBlock(BBlock bb)
+{
+	IRInst inst, pinst;
+	Symbol recv;
+	int found = 0;
+
+	CopyBits(Live, Liveness->out[bb->no]);
+	for (inst = bb->insth.prev; inst != &bb->insth; inst = pinst)
+	{
+		pinst = inst->prev;
+		if (IsDeadStore(inst))
+		{
+			if (inst->opcode == CLR)
+			{
+				inst->opds[0]->ref--;
+				inst->opds[1]->ref--;
+			}
+			else if (inst->opcode == INC || inst->opcode == DEC)
+			{
+				inst->opds[0]->ref--;
+			}
+			else
+			{
+				VisitOperands(inst, DecreaseReference);
+			}
+			RemoveInst(bb, inst);
+			found = 1;
+			continue;
+		}
+
+		// the value of the call isn't used, see EliminateCode() in simp.c
+		recv = inst->opds[0];
+		if (inst->opcode == CALL && recv != NULL && IsSSATemp(recv) && AsVar(recv)->no != 0 &&
+		    ! IsRecordType(recv->ty) && ! TestBit(Live, AsVar(recv)->no - 1))
+		{
+			recv->ref--;
+			inst->opds[0] = NULL;
+			found = 1;
+		}
+		Transfer(inst, NULL, NULL);
+	}
+	return found;
+}
+
+/**
+	Delete the instructions of fsym whose results are never read.
+ */
+void EliminateDeadStores(FunctionSymbol fsym)
+{
+	BBlock bb;
+	Symbol p;
+	int found, n;
+
+	RebuildCFG(fsym);
+	do
+	{
+		found = 0;
+		if ((n = NumberSymbols(fsym)) == 0)
+			break;
+		ComputeLiveVariables(fsym, n);
+		for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+		{
+			found |= EliminateBlock(bb);
+		}
+	} while (found);
+
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp || p->kind == SK_Variable)
+			AsVar(p)->no = 0;
+	}
+}
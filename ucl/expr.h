@@ -35,6 +35,7 @@ struct tokenOp
 	lvalue:	lvalue or not
 	bitfld:	bit-field or not
 	inreg:	declared as register variable or not,  in register --> inreg
+	isvolatile:	an rvalue read from a volatile object, see Adjust()
 	kids:	expression operands
 	val:		expression value
  */
@@ -48,7 +49,8 @@ struct astExpression
 	int lvalue  : 1;
 	int bitfld  : 1;
 	int inreg   : 1;
-	int unused  : 11;
+	int isvolatile : 1;
+	int unused  : 10;
 	struct astExpression *kids[2];
 	union value val;
 };
@@ -229,8 +229,9 @@ static AstExpression CheckArgument(FunctionType fty, AstExpression arg, int argN
 		if (! CanAssign(param->ty, arg))
 			goto err;
 
+		// the caller extends a char or short argument to int, see EmitCall()
 		if (param->ty->categ < INT)
-			arg = Cast(T(INT), arg);
+			arg = Cast(T(INT), Cast(param->ty, arg));
 		else
 			arg = Cast(param->ty, arg);
 
@@ -1559,6 +1560,9 @@ AstExpression Adjust(AstExpression expr, int rvalue)
 		qual = expr->ty->qual;
 		expr->ty = Unqual(expr->ty);
 		expr->lvalue = 0;
+		// the read of a volatile object is kept by the optimizer, see AccessType()
+		if (qual & VOLATILE)
+			expr->isvolatile = 1;
 		//PRINT_CUR_ASTNODE(expr);
 	}
 
@@ -333,3 +333,506 @@ void ExamineJump(BBlock bb)
 
 
 
+
+static void MarkReachable(BBlock bb)
+{
+	CFGEdge succ;
+
+	bb->ref = -1;
+	for (succ = bb->succs; succ != NULL; succ = succ->next)
+	{
+		if (succ->bb->ref >= 0)
+			MarkReachable(succ->bb);
+	}
+}
+/**
+	Draw the CFG again from the jumps and the fall-throughs of the basic blocks.
+	The edges updated by TryMergeBBlock() and ExamineJump() may be stale, e.g.
+	a jump to the next block is deleted, but the block is still a
+	successor twice.  The global optimizations need the exact CFG, every
+	edge is drawn once.
+	The blocks not reachable from the entry are removed, except the exit block,
+	then a jump to the next block isn't needed.
+	bb->ref is the number of jumps to bb, bb->no is the position of bb.
+ */
+void RebuildCFG(FunctionSymbol fsym)
+{
+	BBlock bb, *dstBBs;
+	IRInst lasti;
+	CFGEdge succ;
+	int i;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->succs = bb->preds = NULL;
+		bb->nsucc = bb->npred = 0;
+		bb->ref = 0;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		lasti = bb->insth.prev;
+		if (lasti->opcode >= JZ && lasti->opcode <= JMP)
+		{
+			TryAddSuccessor(bb, (BBlock)lasti->opds[0]);
+		}
+		else if (lasti->opcode == IJMP)
+		{
+			dstBBs = (BBlock *)lasti->opds[0];
+			for (i = 0; dstBBs[i] != NULL; i++)
+			{
+				TryAddSuccessor(bb, dstBBs[i]);
+			}
+		}
+		if (lasti->opcode != JMP && lasti->opcode != IJMP && bb->next != NULL)
+			TryAddSuccessor(bb, bb->next);
+	}
+
+	MarkReachable(fsym->entryBB);
+	fsym->exitBB->ref = -1;
+	for (bb = fsym->entryBB->next; bb != NULL; bb = bb->next)
+	{
+		if (bb->ref == 0)
+		{
+			bb->prev->next = bb->next;
+			if (bb->next)
+				bb->next->prev = bb->prev;
+		}
+	}
+
+	i = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		// the edge of a jump to the next block is the fall-through
+		lasti = bb->insth.prev;
+		if (lasti->opcode == JMP && (BBlock)lasti->opds[0] == bb->next)
+			RemoveInst(bb, lasti);
+		bb->ref = 0;
+		bb->no = i++;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		lasti = bb->insth.prev;
+		if (lasti->opcode >= JZ && lasti->opcode <= JMP)
+		{
+			((BBlock)lasti->opds[0])->ref++;
+		}
+		else if (lasti->opcode == IJMP)
+		{
+			dstBBs = (BBlock *)lasti->opds[0];
+			for (i = 0; dstBBs[i] != NULL; i++)
+			{
+				dstBBs[i]->ref++;
+			}
+		}
+		for (succ = bb->succs; succ != NULL; succ = succ->next)
+		{
+			AddPredecessor(succ->bb, bb);
+		}
+	}
+}
+
+#define MAX_ROTATED_INSTS  8
+
+static void CountReference(Symbol *opd, int def)
+{
+	(*opd)->ref++;
+}
+
+/**
+	The opposite of a conditional jump, or 0.   Only the comparisons of
+	integers and pointers are negated, !(a < b) isn't a >= b when a or b
+	is a NaN.
+ */
+int NegateJump(IRInst inst)
+{
+	static int rops[] = { JNZ, JZ, JNE, JE, JLE, JGE, JL, JG };
+
+	if (inst->opcode < JZ || inst->opcode > JLE)
+		return 0;
+	if (inst->opcode >= JG && IsRealType(inst->ty))
+		return 0;
+
+	return rops[inst->opcode - JZ];
+}
+
+/**
+ * Return 1 if the function returns when bb is entered, the blocks left are all empty
+ */
+int IsReturnBlock(BBlock bb)
+{
+	while (bb != NULL && bb->insth.next == &bb->insth)
+		bb = bb->next;
+
+	return bb == NULL;
+}
+
+/**
+	Rotate the loops whose test is at the bottom and entered by a jump:
+
+		goto BB2;						if (t0 >= t1) goto BB3;
+	BB1:							BB1:
+		...					------->		...
+	BB2:							BB2:
+		if (t0 < t1) goto BB1;			if (t0 < t1) goto BB1;
+	BB3:							BB3:
+
+	The test is copied in front of the loop as a guard with the opposite
+	condition, the guard falls through to the loop, every iteration
+	executes the conditional branch at the bottom only.   The loop is
+	entered only when it is run at least once, so the code put in its
+	preheader isn't executed for a loop run 0 times.   A test made of
+	one block without calls is copied, at most MAX_ROTATED_INSTS
+	instructions, a loop testing a floating-point a < b isn't rotated.
+ */
+void RotateLoops(FunctionSymbol fsym)
+{
+	Vector tests = CreateVector(4);
+	BBlock bb, testBB;
+	IRInst lasti, inst, copy;
+	int i, op;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		lasti = bb->insth.prev;
+		if (lasti->opcode != JMP)
+			continue;
+
+		testBB = (BBlock)lasti->opds[0];
+		inst = testBB->insth.prev;
+		if (testBB == bb || testBB->ninst > MAX_ROTATED_INSTS ||
+		    (op = NegateJump(inst)) == 0 || (BBlock)inst->opds[0] != bb->next)
+			continue;
+
+		for (inst = testBB->insth.next; inst != &testBB->insth; inst = inst->next)
+		{
+			if (inst->opcode == CALL)
+				break;
+		}
+		if (inst != &testBB->insth)
+			continue;
+
+		// the loop ends a void function, its empty exit block is merged, the guard needs a target
+		if (testBB->next == NULL)
+		{
+			testBB->next = CreateBBlock();
+			testBB->next->prev = testBB;
+		}
+
+		RemoveInst(bb, lasti);
+		for (inst = testBB->insth.next; inst != &testBB->insth; inst = inst->next)
+		{
+			ALLOC(copy);
+			*copy = *inst;
+			VisitOperands(copy, CountReference);
+			InsertAfter(bb, bb->insth.prev, copy);
+		}
+		copy->opcode = op;
+		copy->opds[0] = (Symbol)testBB->next;
+		INSERT_ITEM(tests, testBB);
+	}
+	if (LEN(tests) == 0)
+		return;
+
+	RebuildCFG(fsym);
+	// a test reached only from the block before it, e.g. for (...; i++), is merged with the block
+	for (i = 0; i < LEN(tests); i++)
+	{
+		testBB = GET_ITEM(tests, i);
+		bb = testBB->prev;
+		if (testBB->npred == 1 && bb->nsucc == 1 && bb->succs->bb == testBB)
+			TryMergeBBlock(bb, testBB);
+	}
+}
+
+#define MAX_THREADED_INSTS  6
+#define MAX_THREAD_DEPTH    4
+
+static Symbol Tested;
+static int Assigned;
+
+static void FindAssignment(Symbol *opd, int def)
+{
+	if (def && *opd == Tested)
+		Assigned = 1;
+}
+
+static int Defines(IRInst inst, Symbol p)
+{
+	Tested = p;
+	Assigned = 0;
+	VisitOperands(inst, FindAssignment);
+
+	return Assigned;
+}
+
+/**
+ * The test of the conditional jump inst is t op c, op is one of JE .. JLE, c is 0 for JZ and JNZ
+ */
+static int TestOf(IRInst inst, int *c)
+{
+	if (inst->opcode == JZ || inst->opcode == JNZ)
+	{
+		*c = 0;
+		return inst->opcode == JZ ? JE : JNE;
+	}
+	*c = inst->opds[2]->val.i[0];
+
+	return inst->opcode;
+}
+
+/**
+ * The values of t op c which are in the range [lo, hi], no range for !=
+ */
+static int RangeOf(int op, long long c, long long min, long long max, long long *lo, long long *hi)
+{
+	*lo = min;
+	*hi = max;
+	switch (op)
+	{
+	case JE:
+		*lo = *hi = c;
+		break;
+
+	case JG:
+		*lo = c + 1;
+		break;
+
+	case JL:
+		*hi = c - 1;
+		break;
+
+	case JGE:
+		*lo = c;
+		break;
+
+	case JLE:
+		*hi = c;
+		break;
+
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+/**
+	When t op1 c1 is known to be true, t op2 c2 is 1 if it is true,
+	0 if it is false, or -1 if it isn't known.   Either test is a
+	comparison of unsign integers if unsign1 or unsign2 is 1.
+ */
+static int Implies(int op1, int c1, int unsign1, int op2, int c2, int unsign2)
+{
+	long long min, max, lo1, hi1, lo2, hi2, v1, v2;
+	int unsign;
+
+	// == and != are the same for signed and unsigned, a < b isn't
+	if (op1 != JE && op1 != JNE && op2 != JE && op2 != JNE && unsign1 != unsign2)
+		return -1;
+	unsign = op1 == JE || op1 == JNE ? unsign2 : unsign1;
+	min = unsign ? 0 : (int)0x80000000;
+	max = unsign ? 0xFFFFFFFFLL : 0x7FFFFFFF;
+	v1 = unsign ? (long long)(unsigned int)c1 : c1;
+	v2 = unsign ? (long long)(unsigned int)c2 : c2;
+
+	if (! RangeOf(op1, v1, min, max, &lo1, &hi1))
+	{
+		// t != c1
+		if (op2 == JE || op2 == JNE)
+			return v1 == v2 ? op2 == JNE : -1;
+		return -1;
+	}
+	if (lo1 > hi1)
+		return -1;
+	if (! RangeOf(op2, v2, min, max, &lo2, &hi2))
+	{
+		if (v2 < lo1 || v2 > hi1)
+			return 1;
+		return lo1 == hi1 ? 0 : -1;
+	}
+	if (lo2 <= lo1 && hi1 <= hi2)
+		return 1;
+	if (hi1 < lo2 || hi2 < lo1)
+		return 0;
+
+	return -1;
+}
+
+static int IsThreadedTest(IRInst inst)
+{
+	return inst->opcode >= JZ && inst->opcode <= JLE && IsSSATemp(inst->opds[1]) &&
+	       ! IsRealType(inst->ty) && inst->ty->size <= 4 &&
+	       (inst->opds[2] == NULL || inst->opds[2]->kind == SK_Constant);
+}
+
+/**
+	Return 1 if the conditional jump at the end of bb is taken when bb is
+	entered from pred, 0 if it isn't, or -1 if it isn't known.   The value
+	tested is a constant assigned in pred, or it is tested by pred, or by
+	a block before pred which pred is reached from only.
+ */
+static int KnownCondition(BBlock pred, BBlock bb, IRInst jump)
+{
+	static int negs[] = { JNE, JE, JLE, JGE, JL, JG };
+	Symbol t = jump->opds[1];
+	IRInst lasti, inst;
+	int i, op, c, op2, c2, unsign2;
+
+	op2 = TestOf(jump, &c2);
+	unsign2 = IsPtrType(jump->ty) || IsUnsigned(jump->ty);
+	for (i = 0; i < MAX_THREAD_DEPTH && pred != bb; i++)
+	{
+		lasti = pred->insth.prev;
+		if (lasti->opcode == IJMP)
+			return -1;
+		if (IsThreadedTest(lasti) && lasti->opds[1] == t && (BBlock)lasti->opds[0] != pred->next)
+		{
+			op = TestOf(lasti, &c);
+			// the test is false on the edge falling through
+			if ((BBlock)lasti->opds[0] != bb)
+				op = negs[op - JE];
+			return Implies(op, c, IsPtrType(lasti->ty) || IsUnsigned(lasti->ty), op2, c2, unsign2);
+		}
+		for (inst = lasti; inst != &pred->insth; inst = inst->prev)
+		{
+			if (! Defines(inst, t))
+				continue;
+			// t = c;
+			if (inst->opcode == MOV && inst->opds[1]->kind == SK_Constant)
+				return Implies(JE, inst->opds[1]->val.i[0], unsign2, op2, c2, unsign2);
+			return -1;
+		}
+		if (pred->npred != 1)
+			return -1;
+		bb = pred;
+		pred = pred->preds->bb;
+	}
+	return -1;
+}
+
+/**
+ * A block which doesn't fall through, a new block can be put after it.
+ */
+static BBlock FindGap(FunctionSymbol fsym, BBlock bb)
+{
+	BBlock p;
+
+	for (p = bb; p != NULL; p = p->next)
+	{
+		if (p != fsym->exitBB && (p->insth.prev->opcode == JMP || p->insth.prev->opcode == IJMP))
+			return p;
+	}
+	for (p = fsym->entryBB; p != bb; p = p->next)
+	{
+		if (p != fsym->exitBB && (p->insth.prev->opcode == JMP || p->insth.prev->opcode == IJMP))
+			return p;
+	}
+	return NULL;
+}
+
+/**
+ * Make pred reach a copy of bb, which jumps to target instead of testing again
+ */
+static void ThreadJump(FunctionSymbol fsym, BBlock pred, BBlock bb, BBlock target)
+{
+	IRInst lasti = pred->insth.prev, inst, copy;
+	BBlock after, nbb;
+
+	if (pred->next == bb)
+		after = pred;
+	else if ((after = FindGap(fsym, pred)) == NULL)
+		return;
+
+	nbb = CreateBBlock();
+	CurrentBB = nbb;
+	for (inst = bb->insth.next; inst != bb->insth.prev; inst = inst->next)
+	{
+		ALLOC(copy);
+		*copy = *inst;
+		VisitOperands(copy, CountReference);
+		AppendInst(copy);
+	}
+	GenerateJump(target);
+
+	if (lasti->opcode >= JZ && lasti->opcode <= JMP && (BBlock)lasti->opds[0] == bb)
+		lasti->opds[0] = (Symbol)nbb;
+	nbb->prev = after;
+	nbb->next = after->next;
+	after->next->prev = nbb;
+	after->next = nbb;
+}
+
+/**
+	Jump threading.   When the value tested at the end of a small block
+	is known on an edge coming into it, the block is copied for the
+	edge, the copy jumps to the successor without testing:
+
+		if (! t5) goto BB2;				if (! t5) goto BB5;
+	BB1:							BB1:
+		t0 = g(1);						t0 = g(1);
+		t1 = 0 + t0;					t1 = 0 + t0;
+	BB2:				------->	BB4:
+		t2 = t1 + t6;					t2 = t1 + t6;
+		if (! t5) goto BB4;				goto BB3;
+	BB3:							...
+		...							BB5:
+										t2 = t1 + t6;
+										goto BB4;
+
+	The flag of a && b or a || b used as a value is tested after it is
+	assigned 0 or 1, the assignment jumps to the successor of the test.
+	A temporary tested with 0 or a constant is looked up, the tests of
+	the blocks before, MAX_THREAD_DEPTH at most, tell its range on the
+	edge.   A block of MAX_THREADED_INSTS instructions at most, without
+	calls, is copied.   The header of a loop isn't copied, the loop
+	would have more than one entry.   A block not reached any more is
+	removed by RebuildCFG(), which makes the edges and the references
+	again.
+ */
+void ThreadJumps(FunctionSymbol fsym)
+{
+	Vector preds = CreateVector(4);
+	BBlock bb, next, pred, target;
+	IRInst lasti, inst;
+	CFGEdge edge;
+	int i, taken, found;
+
+	ComputeDominators(fsym);
+	FindLoops(fsym);
+	for (bb = fsym->entryBB->next; bb != NULL; bb = next)
+	{
+		next = bb->next;
+		lasti = bb->insth.prev;
+		if (bb->npred == 0 || bb->ninst > MAX_THREADED_INSTS + 1 || bb->next == NULL || ! IsThreadedTest(lasti))
+			continue;
+		// the loop would be entered in the middle, see RotateLoops()
+		if (bb->loop != NULL && bb->loop->header == bb)
+			continue;
+		for (inst = bb->insth.next; inst != lasti; inst = inst->next)
+		{
+			if (inst->opcode == CALL || Defines(inst, lasti->opds[1]))
+				break;
+		}
+		if (inst != lasti)
+			continue;
+
+		// the conditions are found before the blocks are changed
+		preds->len = 0;
+		for (edge = bb->preds; edge != NULL; edge = edge->next)
+		{
+			if (edge->bb == bb || (taken = KnownCondition(edge->bb, bb, lasti)) < 0)
+				continue;
+			INSERT_ITEM(preds, edge->bb);
+			INSERT_ITEM(preds, taken ? (BBlock)lasti->opds[0] : bb->next);
+		}
+		found = 0;
+		for (i = 0; i < LEN(preds); i += 2)
+		{
+			pred = GET_ITEM(preds, i);
+			target = GET_ITEM(preds, i + 1);
+			ThreadJump(fsym, pred, bb, target);
+			found = 1;
+		}
+		if (found)
+			RebuildCFG(fsym);
+	}
+}
@@ -5,7 +5,6 @@
 #include "expr.h"
 #include "input.h"
 
-#define IsCommute(op) 0
 
 BBlock CurrentBB;
 /**
@@ -30,56 +29,6 @@ int OPMap[] =
 #include "opinfo.h"
 #undef  OPINFO
 };
-/**
-	we are sure that :
-			p->kind == SK_Variable
-	p is for local/global/static variable, not for temporary variable.
-*/
-static void TrackValueChange(Symbol p)
-{
-	ValueUse use = AsVar(p)->uses;
-
-	assert(p->kind == SK_Variable);
-
-	while (use)
-	{
-		/**
-			mark the definitions useing @p as operands invalid.
-			Unless it contains the address of a variable.
-			The content of a variable changes while its address not.
-			So the temporary is still valid in this case.
-				t1 = &var;	------ var changes, but &var not.
-				
-		 */	
-		if (use->def->op != ADDR)
-			use->def->dst = NULL;
-
-		use = use->next;
-	}
-}
-/**
-	record that @p is used in defintion @def.
-	we are sure that:
-		p->kind == SK_Variable
-	We never track the temporary-variable, only track local/global/static
-	variable used in defintion of temporary.
-		t3 = a + b
-	If a is changed , t3 is made invalid via 
-	But no track in the following situtation.
-		c = a + b		
- */
-static void TrackValueUse(Symbol p, ValueDef def)
-{
-	ValueUse use;
-
-	assert(p->kind == SK_Variable);
-
-	ALLOC(use);
-	use->def = def;
-	use->next = AsVar(p)->uses;
-	AsVar(p)->uses = use;
-}
-
 /**
 	(1)see UCC document 9.2
 		UCC only allocates register for temporary.
@@ -105,8 +54,6 @@ void DefineTemp(Symbol t, int op, Symbol src1, Symbol src2)
 	def->op = op;
 	def->src1 = src1;	//	If op is MOV/CALL,  src1 is an  (IRInst) .see PeepHole(BBlock bb) for MOV	
 	def->src2 = src2;
-	def->ownBB = CurrentBB;
-	
 
 	assert(t->kind == SK_Temp);	
 	
@@ -116,20 +63,6 @@ void DefineTemp(Symbol t, int op, Symbol src1, Symbol src2)
 		AsVar(t)->def = def;
 		return;
 	}
-
-	if (src1->kind == SK_Variable)
-	{
-		/**
-			t = src1 op src2
-			the definition of 't' here use @src1.
-			In other words, @src1 is used in this definition.			
-		 */
-		TrackValueUse(src1, def);
-	}
-	if (src2 && src2->kind == SK_Variable)
-	{
-		TrackValueUse(src2, def);
-	}
 	AsVar(t)->def = def;
 }
 /**
@@ -235,15 +168,7 @@ void GenerateMove(Type ty, Symbol dst, Symbol src)
 	inst->opds[1] = src;
 	inst->opds[2] = NULL;
 	AppendInst(inst);
-	/**
-		If a named variable is the destination of MOV,
-		all the calculated subexpression using this variable is invalid.
-	 */
-	if (dst->kind == SK_Variable)
-	{
-		TrackValueChange(dst);
-	}
-	else if (dst->kind == SK_Temp)
+	if (dst->kind == SK_Temp)
 	{
 		DefineTemp(dst, MOV, (Symbol)inst, NULL);
 	}
@@ -481,20 +406,34 @@ void GenerateClear(Symbol dst, int size)
 	AppendInst(inst);
 }
 
+/**
+	Remove the load of temporary p generated by Deref(), only the address
+	of the object is needed, as in  a[i] = 3  or  &p->b.   A volatile object
+	must not be read.   The load is the last instruction while p isn't used.
+ */
+void DiscardLoad(Symbol p)
+{
+	IRInst inst = CurrentBB->insth.prev;
+
+	if (p->kind == SK_Temp && inst != &CurrentBB->insth && inst->opcode == DEREF && inst->opds[0] == p)
+	{
+		p->ref--;
+		inst->opds[1]->ref--;
+		RemoveInst(CurrentBB, inst);
+	}
+}
+
 Symbol AddressOf(Symbol p)
 {
 	if (p->kind == SK_Temp && AsVar(p)->def->op == DEREF)
-	{		
+	{
+		DiscardLoad(p);
 		return AsVar(p)->def->src1;
 	}
 
 	assert(p->kind != SK_Temp);
 
 	p->addressed = 1;
-	if (p->kind == SK_Variable)
-	{
-		TrackValueChange(p);
-	}
 	return TryAddValue(T(POINTER), ADDR, p, NULL); 
 }
 
@@ -513,140 +452,102 @@ Symbol Deref(Type ty, Symbol addr)
 		//#endif
 		return AsVar(addr)->def->src1;
 	}
-	tmp = CreateTemp(ty);
+	// the load has the qualifiers of the object, see IsVolatileAccess()
+	tmp = CreateTemp(Unqual(ty));
 	GenerateAssign(ty, tmp, DEREF, addr, NULL);
 	return tmp;
 }
 /**
-	If we try to do : 	a + b
-	we first find in the hashtable whether it is a common subexpression
-	calculated before.
- (1)
-	int a = 1, b = 2 , c = 3, d;
-	d = a + b + c;	
-	d = a + b
-	c = a + b + c;
-
-
-	t0 = a + b;
-	t1 = t0 + c;
-	d = t1;
-	d = t0;		------------	a + b is still valid in t0
-	c = t1;		------------	a + b + c is still valid in t1
-
-(2)
-	 d = a + b + c;  
-	 b = 3;
-	 d = a + b;
-	 c = a + b + c;
-
-	 t0 = a + b;
-	 t1 = t0 + c;
-	 d = t1;
-	 b = 3;	------------------	assignment to b makes t0 invalid
-	 t2 = a + b;	-------------	recalculate a+b
-	 d = t2;
-	 t3 = t2 + c;
-	 c = t3;
-(3)
-	 int a = 3,b = 2, c = 1,d;
-	 dt.b = 5;
-	 d = a + dt.b + c;
-	 d = a + dt.b;
-	 dt.b = 6;
-	 d = a + dt.b;
-
-	dt[4] = 5;
-	t1 = a + dt[4];---------------	See CreateOffset()
-								SK_Offset is addressed.
-	t2 = t1 + c;
-	d = t2;
-	t3 = a + dt[4];
-	d = t3;
-	dt[4] = 6;
-	t4 = a + dt[4];
-	d = t4;	 
-(4)
-	int a = 1, b = 2 , c = 3, d;
-	int * ptr = &b;	----------------- b is addressed, so we had better not reuse the 
-									  common subexpression containing b.
-									 	We have to create a new temporary for conservative considering.
-	d = a + b + c;	
-	*ptr = 30;
-	d = a + b;
-	c = a + b + c;	
-
-	t0 = &b;
-	ptr = t0;
-	t1 = a + b;
-	t2 = t1 + c;
-	d = t2;
-	*ptr = 30;
-	t5 = a + b;
-	d = t5;
-	t6 = a + b;
-	t7 = t6 + c;
-	c = t7;	
-But:
-	There are some temporaries are used across basic blocks.
-	See examples/cfg/crossBB.c
+	Create a temporary holding the value of src1 op src2.
+	The common subexpressions are not reused here, a variable may be
+	changed by a call or through a pointer between two computations.
+	They are removed by GlobalValueNumbering() on the SSA form, after the
+	local variables become temporaries, see gvn.c.
  */
 Symbol TryAddValue(Type ty, int op, Symbol src1, Symbol src2)
 {
-	int h = ((unsigned)src1 + (unsigned)src2 + op) & 15;
-	ValueDef def = FSYM->valNumTable[h];
 	Symbol t;
-	/**
-		OP_CAST is used in AST,
-		CVTI4F4 is used in uil.	Here, @op is something in opcode.h
-		CVTI4F4 is done in TranslateCast(), not here.
-	 */
 
 	assert(op != CVTI4F4 && op != CALL && op != MOV);
 
-	/**
-		struct Data{
-			int val;
-		};
-		int a;
-		int * ptr = &a;	// a  is addressed.
-		Data dt;
-		dt.val = 3;		------		SK_Offset is addressed.
-	 */
-	if (op != ADDR && (src1->addressed || (src2 && src2->addressed)))
-		goto new_temp;
-	/**
-		Search for the temorary defintion : src1 op src2 in hashtable.
-	 */
-	while (def)
-	{
-		if (def->op == op && (def->src1 == src1 && def->src2 == src2))
-			break;
-		def = def->link;
-	}
-	/**
-		def:		if we find a def
-		def->dst != NULL	: 	it is a valid definition
-			The reason for "def->dst == NULL" is we set it to NULL
-				in function TrackValueChange().
-		def->ownBB == CurrentBB
-				if(a){
-					a = 10;
-					c = a + b;	----------(1)
-				}else{
-					d = a + b;	----------(2)
-				}
-				//	(1) and (2) are in different basic block
-	 */
-	if (def && def->ownBB == CurrentBB && def->dst != NULL)
-		return def->dst;
-
-new_temp:
 	t = CreateTemp(ty);
 	GenerateAssign(ty, t, op, src1, src2);
-
-	def = AsVar(t)->def;
-	def->link = FSYM->valNumTable[h];
-	FSYM->valNumTable[h] = def;
 	return t;
 }
+
+/**
+ * Call visit() for every operand read by inst, then for every operand written by inst.
+ * visit() may replace the operand through opd.
+ */
+void VisitOperands(IRInst inst, void (*visit)(Symbol *opd, int def))
+{
+	Vector args;
+	int i;
+
+	switch (inst->opcode)
+	{
+	case JMP:
+	case NOP:
+	case CLR:
+		// CLR only clears memory object
+		return;
+
+	case IJMP:
+		visit(&inst->opds[1], 0);
+		return;
+
+	case CALL:
+		if (inst->opds[1]->kind != SK_Function)
+			visit(&inst->opds[1], 0);
+		args = (Vector)inst->opds[2];
+		for (i = 0; i < LEN(args); i++)
+		{
+			visit(&((ILArg)GET_ITEM(args, i))->sym, 0);
+		}
+		if (inst->opds[0] != NULL)
+			visit(&inst->opds[0], 1);
+		return;
+
+	case RET:
+	case IMOV:
+		visit(&inst->opds[0], 0);
+		if (inst->opds[1] != NULL)
+			visit(&inst->opds[1], 0);
+		return;
+
+	case INC:
+	case DEC:
+		visit(&inst->opds[0], 0);
+		visit(&inst->opds[0], 1);
+		return;
+
+	case PHI:
+		args = (Vector)inst->opds[1];
+		for (i = 0; i < LEN(args); i++)
+		{
+			visit(&((PhiArg)GET_ITEM(args, i))->sym, 0);
+		}
+		visit(&inst->opds[0], 1);
+		return;
+
+	case ADDR:
+		// the operand is a memory object, its value is not read
+		visit(&inst->opds[0], 1);
+		return;
+
+	default:
+		if (inst->opcode >= JZ && inst->opcode <= JLE)
+		{
+			// inst->opds[0] is the target basic block
+			visit(&inst->opds[1], 0);
+			if (inst->opds[2] != NULL)
+				visit(&inst->opds[2], 0);
+			return;
+		}
+		visit(&inst->opds[1], 0);
+		if (inst->opds[2] != NULL)
+			visit(&inst->opds[2], 0);
+		visit(&inst->opds[0], 1);
+		return;
+	}
+}
@@ -25,6 +25,7 @@ see uildasm.c
 	ty:		instruction operating type
 	opcode:	operation code
 	opds:	operands, at most three
+	no:		position in the linear instruction order, see regalloc.c
  */
 typedef struct irinst
 {
@@ -33,6 +34,7 @@ typedef struct irinst
 	Type ty;
 	int opcode;
 	Symbol opds[3];
+	int no;
 } *IRInst;
 // control flow graph edge
 typedef struct cfgedge
@@ -51,6 +53,14 @@ typedef struct cfgedge
 		ninst:	number of instructions
 		nsucc:	number of successors
 		npred:	number of predecessors
+		no:		index of the basic block in function's block list
+		idom:	immediate dominator, NULL for the entry block, see ssa.c
+		kids:	first child in the dominator tree
+		sibling:	next child of idom in the dominator tree
+		pre:	preorder number in the dominator tree
+		last:	the largest preorder number in the subtree of the block
+		loop:	the innermost loop containing the block, see loop.c
+		depth:	loop nesting depth, 0 outside any loop
  */
 struct bblock
 {
@@ -69,9 +79,14 @@ struct bblock
 	// number of predecessors
 	int npred;
 	int ref;
-	#if 0		// commented
-	//int no;
-	#endif
+	int no;
+	struct bblock *idom;
+	struct bblock *kids;
+	struct bblock *sibling;
+	int pre;
+	int last;
+	struct loop *loop;
+	int depth;
 };
 
 typedef struct ilarg
@@ -79,9 +94,96 @@ typedef struct ilarg
 	Symbol sym;
 	Type ty;
 } *ILArg;
+/**
+	argument of a phi function, sym is the value coming from predecessor bb.
+	The phi function
+		t5 : phi(t3 BB1, t4 BB2);
+	is a PHI instruction, DST is t5, SRC1 is the vector of the arguments.
+ */
+typedef struct phiarg
+{
+	Symbol sym;
+	BBlock bb;
+} *PhiArg;
+
+/**
+	natural loop, see loop.c
+		header:	the target of the back edges, it dominates the loop
+		preheader:	the only predecessor of header outside the loop, it has
+					no other successor; NULL if there isn't such a block
+		blocks:	the blocks of the loop, header is the first one
+		parent:	the innermost loop containing this loop
+		depth:	nesting depth, 1 for an outermost loop
+ */
+typedef struct loop
+{
+	BBlock header;
+	BBlock preheader;
+	Vector blocks;
+	struct loop *parent;
+	int depth;
+} *Loop;
+
+/**
+	memory access, see alias.c
+		base:	the object accessed, or the pointer the address is computed from
+		index:	the temporary added to base, NULL if there isn't one
+		offset:	the constant added to base
+		size:	the number of bytes accessed
+		ty:		the type of the access
+		object:	1 if base is an object
+		origin:	the restrict parameter the address is based on
+ */
+typedef struct memRef
+{
+	Symbol base;
+	Symbol index;
+	int offset;
+	int size;
+	Type ty;
+	int object;
+	Symbol origin;
+} *MemRef;
+
+// sparse bit vector, see dataflow.c
+typedef struct bitSet *BitSet;
+
+// a temporary numbered by the pass running, AsVar(p)->no indexes its tables
+#define IsNumbered(p) ((p) != NULL && (p)->kind == SK_Temp && AsVar(p)->no != 0)
+// a temporary or a variable numbered by the pass running, AsVar(p)->no indexes its tables
+#define IsTracked(p) \
+	((p) != NULL && ((p)->kind == SK_Temp || (p)->kind == SK_Variable) && AsVar(p)->no != 0)
+
+#define DF_FORWARD    0
+#define DF_BACKWARD   1
+#define DF_UNION      0
+#define DF_INTERSECT  1
+
+/**
+	dataflow problem over the basic blocks of a function, see dataflow.c
+		dir:	DF_FORWARD or DF_BACKWARD
+		meet:	DF_UNION or DF_INTERSECT
+		size:	the sets of a DF_INTERSECT problem start with 0 .. size - 1
+		blocks:	the blocks, blocks[bb->no] is bb
+		in, out:	the solution, in[bb->no] holds at the entry of bb, out[bb->no] at its exit
+		gen, kill:	filled by the client before SolveDataflow()
+ */
+typedef struct dataflow
+{
+	int dir;
+	int meet;
+	int size;
+	int nblock;
+	BBlock *blocks;
+	BitSet *in;
+	BitSet *out;
+	BitSet *gen;
+	BitSet *kill;
+} *Dataflow;
 
 BBlock CreateBBlock(void);
 void   StartBBlock(BBlock bb);
+void   AppendInst(IRInst inst);
 
 void GenerateMove(Type ty, Symbol dst, Symbol src);
 void GenerateIndirectMove(Type ty, Symbol dst, Symbol src);
@@ -97,16 +199,86 @@ void GenerateClear(Symbol dst, int size);
 
 void DefineTemp(Symbol t, int op, Symbol src1, Symbol src2);
 Symbol AddressOf(Symbol sym);
+void   DiscardLoad(Symbol p);
 Symbol Deref(Type ty, Symbol addr);
 Symbol TryAddValue(Type ty, int op, Symbol src1, Symbol src2);
 Symbol Simplify(Type ty, int op, Symbol src1, Symbol src2);
+void VisitOperands(IRInst inst, void (*visit)(Symbol *opd, int def));
 
 void DrawCFGEdge(BBlock head, BBlock tail);
 void ExamineJump(BBlock bb);
 BBlock TryMergeBBlock(BBlock bb1, BBlock bb2);
 void Optimize(FunctionSymbol fsym);
+void PromoteVariables(FunctionSymbol fsym);
+void RebuildCFG(FunctionSymbol fsym);
+void RotateLoops(FunctionSymbol fsym);
+void ThreadJumps(FunctionSymbol fsym);
+int  NegateJump(IRInst inst);
+int  IsReturnBlock(BBlock bb);
+void LayoutBlocks(FunctionSymbol fsym);
+void InlineCalls(FunctionSymbol fsym);
+void EliminateTailRecursion(FunctionSymbol fsym);
+void UnrollLoops(FunctionSymbol fsym);
+void ComputeDominators(FunctionSymbol fsym);
+int  Dominates(BBlock bb1, BBlock bb2);
+void BuildSSA(FunctionSymbol fsym);
+void DestroySSA(FunctionSymbol fsym);
+int  IsSSATemp(Symbol p);
+int  SameValueType(Symbol p1, Symbol p2);
+void InsertAfter(BBlock bb, IRInst pos, IRInst inst);
+void InsertBeforeJump(BBlock bb, IRInst inst);
+void RemoveInst(BBlock bb, IRInst inst);
+void PropagateConstants(FunctionSymbol fsym);
+Vector FindLoops(FunctionSymbol fsym);
+Vector InsertPreheaders(FunctionSymbol fsym);
+int  InLoop(Loop loop, BBlock bb);
+void HoistLoopInvariants(FunctionSymbol fsym);
+void ReduceInductionVariables(FunctionSymbol fsym);
+void GlobalValueNumbering(FunctionSymbol fsym);
+void PropagateCopies(FunctionSymbol fsym);
+void EliminateDeadStores(FunctionSymbol fsym);
+BitSet NewBitSet(void);
+int  TestBit(BitSet set, int i);
+void SetBit(BitSet set, int i);
+void ClearBit(BitSet set, int i);
+void ClearBits(BitSet set);
+void CopyBits(BitSet dst, BitSet src);
+int  UnionBits(BitSet dst, BitSet src);
+int  MinusBits(BitSet dst, BitSet src);
+int  IntersectBits(BitSet dst, BitSet src);
+int  DisjointBits(BitSet set1, BitSet set2);
+int  NextBit(BitSet set, int i);
+Dataflow CreateDataflow(FunctionSymbol fsym, int dir, int meet, int size);
+void SolveDataflow(Dataflow df);
+Dataflow ComputeLiveness(FunctionSymbol fsym, int size);
+void SetupAlias(FunctionSymbol fsym, int n);
+void ObjectRef(MemRef ref, Symbol p, int size);
+void IndirectRef(MemRef ref, Type ty, Symbol addr);
+int  SameLocation(MemRef ref1, MemRef ref2);
+int  MayAlias(MemRef ref1, MemRef ref2);
+int  IsPrivateRef(MemRef ref);
+int  IsMemoryScalar(Symbol p);
+int  IsVolatileAccess(IRInst inst);
+void SetOptimizeLevel(char *level);
+void SetUnrollFactor(char *factor);
+int  ChoosePass(char *name, int enabled);
+void SetDumpIRAfter(char *name);
+void SetupPasses(void);
+void RunPasses(FunctionSymbol fsym);
+void ReportPasses(void);
+void DAssemPass(FunctionSymbol fsym);
 
 extern BBlock CurrentBB;
+extern int UnrollFactor;
+extern int TailCalls;
+extern int ReorderBlocks;
+extern int StrictAliasing;
+extern char *DumpIRAfter;
+extern int DataflowProblems;
+extern int DataflowVisits;
+extern int DataflowChunks;
+extern double DataflowSeconds;
+extern double LivenessSeconds;
 extern int OPMap[];
 
 #endif
@@ -5,7 +5,8 @@
     TK_AUTO,   TK_EXTERN,   TK_REGISTER, TK_STATIC,   TK_TYPEDEF,   \
     TK_CONST,  TK_VOLATILE, TK_SIGNED,   TK_UNSIGNED, TK_SHORT,     \
     TK_LONG,   TK_CHAR,     TK_INT,      TK_INT64,    TK_FLOAT,	    \
-    TK_DOUBLE, TK_ENUM,     TK_STRUCT,   TK_UNION,    TK_VOID, TK_ID
+    TK_DOUBLE, TK_ENUM,     TK_STRUCT,   TK_UNION,    TK_VOID,      \
+    TK_INLINE, TK_RESTRICT, TK_ID
 // fisrt token of an expression
 #define FIRST_EXPRESSION                                                          \
     TK_SIZEOF,       TK_ID,         TK_INTCONST,    TK_UINTCONST,  TK_LONGCONST,  \
@@ -0,0 +1,601 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Global value numbering on the SSA form.
+	(Preston Briggs, Keith D. Cooper and L. Taylor Simpson, "Value Numbering")
+
+	Every temporary is defined once, so two instructions with the same
+	operator and the same operands compute the same value.   The dominator
+	tree is walked in preorder, the expressions computed by the dominators
+	of a block are in the hash table, an expression found there is redundant:
+
+		t0 = i << 2;					t0 = i << 2;
+		t1 = t5 + t0;					t1 = t5 + t0;
+		if (t1 > 0) goto BB2;			if (t1 > 0) goto BB2;
+	BB1:							BB1:
+		t2 = i << 2;		------->		t4 = *t1;
+		t3 = t5 + t2;
+		t4 = *t3;
+
+	A phi function whose arguments are all the same value is that value.
+
+	Then the same expression computed in both successors of a branch is
+	computed once before the branch:
+
+		if (c) goto BB1;				t1 = i << 2;
+		t1 = i << 2;					t2 = t0 + t1;
+		t2 = t0 + t1;		------->	if (c) goto BB1;
+		*t2 = 1;						*t2 = 1;
+		goto BB2;						goto BB2;
+	BB1:							BB1:
+		t4 = i << 2;					*t2 = 2;
+		t5 = t0 + t4;
+		*t5 = 2;
+
+	A load reads the value of the last store into the same location, or
+	of the last load from it, unless a store or a call between them may
+	change the location, see MayAlias() in alias.c:
+
+		t1 = g;							t1 = g;
+		*t2 = 3;			------->	*t2 = 3;
+		t3 = g;							t4 = t1 + 1;		----- *t2 isn't g, if t2 is
+		t4 = t3 + 1;										----- based on restrict p
+		*t5 = t4;						*t5 = t4;
+		t6 = *t5;						t7 = 3;
+		t7 = *t2;						t8 = t4 + t7;
+		t8 = t6 + t7;					return t8;
+		return t8;
+
+	A load of a constant stored becomes a move, see AcceptsConstant().
+	A load or a store of a volatile object is never reused, see
+	IsVolatileAccess(), each of these loads is kept:
+		volatile int *p;		return *p + *p;
+		volatile int st;		return r->st - r->st;
+		for (i = 0; i < n; i++) s += *p;		----- unrolled 4 times
+
+	The loads and stores known are passed down the dominator tree to a
+	block with one predecessor, the other blocks start with none.
+	The address of an object is only reused in the same block, it is
+	formed again by one or two instructions, keeping it in a register
+	across the blocks costs more.
+ */
+
+typedef struct expr
+{
+	int op;
+	int categ;
+	Symbol src1;
+	Symbol src2;
+	// the temporary holding the value
+	Symbol val;
+	BBlock bb;
+	struct expr *link;
+} *Expr;
+
+// Buckets[0 .. Mask]
+static Expr *Buckets;
+static unsigned int Mask;
+// the expressions in the hash table, the last one is on the top
+static Expr *Scope;
+static int ScopeTop;
+
+// the temporary replacing the temporary t is Leaders[AsVar(t)->no]
+static Symbol *Leaders;
+// the block defining the temporary
+static BBlock *DefBBs;
+
+// the value of a memory location, the last load from it or store into it
+typedef struct memValue
+{
+	struct memRef ref;
+	Symbol val;
+	struct memValue *link;
+} *MemValue;
+
+// the memory locations whose values are known, a list is never changed
+static MemValue Memory;
+static int MemoryCount;
+static IRInst CurInst;
+
+#define MAX_MEMORY  32
+
+#define IsCommutative(op) \
+	((op) == ADD || (op) == MUL || (op) == BAND || (op) == BOR || (op) == BXOR || \
+	 (op) == SEQ || (op) == SNE || (op) == MIN || (op) == MAX)
+
+static Symbol Leader(Symbol p)
+{
+	while (p != NULL && IsNumbered(p) && Leaders[AsVar(p)->no] != p)
+		p = Leaders[AsVar(p)->no];
+	return p;
+}
+
+static int IsValueOperand(Symbol p)
+{
+	return p == NULL || p->kind == SK_Constant || IsNumbered(p);
+}
+
+/**
+	The assignments whose value only depends on the operands.
+	The address of an object never changes in the function.
+ */
+static int IsPureInst(IRInst inst)
+{
+	int op = inst->opcode;
+
+	if (! IsSSATemp(inst->opds[0]))
+		return 0;
+	if (op == ADDR)
+		return 1;
+	if (op > SELZ && (op < EXTI1 || op > CVTF8U4))
+		return 0;
+
+	return IsValueOperand(inst->opds[1]) && IsValueOperand(inst->opds[2]);
+}
+
+static void MakeKey(IRInst inst, struct expr *e)
+{
+	Symbol t;
+
+	e->op = inst->opcode;
+	e->categ = inst->opds[0]->ty->categ;
+	e->src1 = inst->opcode == ADDR ? inst->opds[1] : Leader(inst->opds[1]);
+	e->src2 = Leader(inst->opds[2]);
+	if (IsCommutative(e->op) && (unsigned long)e->src1 > (unsigned long)e->src2)
+	{
+		t = e->src1; e->src1 = e->src2; e->src2 = t;
+	}
+}
+
+static unsigned int Hash(Expr e)
+{
+	unsigned long h;
+
+	h = (unsigned long)e->src1 * 31 + (unsigned long)e->src2 + e->op;
+	return (unsigned int)(h ^ (h >> 7) ^ (h >> 13)) & Mask;
+}
+
+static Expr LookupExpr(BBlock bb, IRInst inst)
+{
+	struct expr key;
+	Expr e;
+
+	MakeKey(inst, &key);
+	for (e = Buckets[Hash(&key)]; e != NULL; e = e->link)
+	{
+		if (e->op == key.op && e->categ == key.categ && e->src1 == key.src1 && e->src2 == key.src2 &&
+		    SameValueType(inst->opds[0], e->val))
+			return e->op != ADDR || e->bb == bb ? e : NULL;
+	}
+	return NULL;
+}
+
+static void InsertExpr(BBlock bb, IRInst inst)
+{
+	unsigned int h;
+	Expr e;
+
+	ALLOC(e);
+	MakeKey(inst, e);
+	e->val = inst->opds[0];
+	e->bb = bb;
+	h = Hash(e);
+	e->link = Buckets[h];
+	Buckets[h] = e;
+	Scope[ScopeTop++] = e;
+}
+
+static void ReplaceOperand(Symbol *opd, int def)
+{
+	if (! def)
+		*opd = Leader(*opd);
+}
+
+/**
+	t : phi(a BB1, a BB2) is a.   The arguments coming from the back edges
+	may not be numbered yet, so it isn't always found.
+ */
+static Symbol SameArguments(IRInst inst)
+{
+	Vector args = (Vector)inst->opds[1];
+	Symbol p, val = NULL;
+	int i;
+
+	for (i = 0; i < LEN(args); i++)
+	{
+		p = Leader(((PhiArg)GET_ITEM(args, i))->sym);
+		if (p == inst->opds[0] || p == val)
+			continue;
+		if (val != NULL)
+			return NULL;
+		val = p;
+	}
+	return val;
+}
+
+/**
+ * Return 1 if temporary or constant val can hold the value of type ty read from memory
+ */
+static int HoldsValue(Symbol val, Type ty)
+{
+	if (val->kind == SK_Constant)
+		return (IsIntegType(val->ty) || IsPtrType(val->ty)) && (IsIntegType(ty) || IsPtrType(ty)) && ty->size == 4;
+
+	return val->ty == ty || (Unqual(val->ty)->categ == Unqual(ty)->categ && ! IsPtrType(ty));
+}
+
+static Symbol LookupMemory(MemRef ref)
+{
+	MemValue m;
+
+	for (m = Memory; m != NULL; m = m->link)
+	{
+		if (SameLocation(&m->ref, ref) && HoldsValue(m->val, ref->ty))
+			return m->val;
+	}
+	return NULL;
+}
+
+/**
+	Remember val is the value of the location, val is a temporary or an
+	integer constant.   A char or a short held by a temporary may not be
+	extended as the load does, it is only known from a load.
+ */
+static void RememberMemory(MemRef ref, Symbol val, int load)
+{
+	MemValue m;
+
+	if (MemoryCount == MAX_MEMORY || ref->base == NULL || (! IsNumbered(val) && val->kind != SK_Constant) ||
+	    ! HoldsValue(val, ref->ty) ||
+	    (! load && IsIntegType(ref->ty) && ref->ty->size < 4))
+		return;
+
+	ALLOC(m);
+	m->ref = *ref;
+	m->val = val;
+	m->link = Memory;
+	Memory = m;
+	MemoryCount++;
+}
+
+/**
+ * Forget the values of the locations which may be changed by a store into ref, or by a call if ref is NULL
+ */
+static void ForgetMemory(MemRef ref)
+{
+	MemValue m, n, list = NULL;
+
+	MemoryCount = 0;
+	for (m = Memory; m != NULL; m = m->link)
+	{
+		if (ref == NULL ? ! IsPrivateRef(&m->ref) : MayAlias(&m->ref, ref))
+			continue;
+
+		ALLOC(n);
+		*n = *m;
+		n->link = list;
+		list = n;
+		MemoryCount++;
+	}
+	Memory = list;
+}
+
+static void ForgetDef(Symbol *opd, int def)
+{
+	struct memRef ref;
+
+	if (def && ! IsNumbered(*opd))
+	{
+		ObjectRef(&ref, *opd, (*opd)->ty->size);
+		ForgetMemory(&ref);
+	}
+}
+
+/**
+	Return 1 if the operand opd of CurInst can be a constant.   An
+	instruction whose operands are all constants isn't folded after
+	constant propagation, neither is a cast or a unary operator.
+ */
+static int AcceptsConstant(Symbol *opd)
+{
+	int op = CurInst->opcode;
+	Symbol other;
+
+	if (op == MOV || op == RET)
+		return 1;
+	if (op == CALL || op == IMOV)
+		return opd != &CurInst->opds[op == CALL ? 1 : 0];
+	if (op == NEG || op == BCOM || op == JZ || op == JNZ || (op > SLE && op < JE) || op > JLE)
+		return 0;
+
+	other = opd == &CurInst->opds[1] ? CurInst->opds[2] : CurInst->opds[1];
+	return other != NULL && other->kind != SK_Constant;
+}
+
+/**
+ * Replace the read of a memory variable by the temporary or constant holding its value
+ */
+static void ReplaceRead(Symbol *opd, int def)
+{
+	struct memRef ref;
+	Symbol val;
+
+	if (def || ! IsMemoryScalar(*opd))
+		return;
+
+	ObjectRef(&ref, *opd, (*opd)->ty->size);
+	if ((val = LookupMemory(&ref)) != NULL && (val->kind != SK_Constant || AcceptsConstant(opd)))
+	{
+		(*opd)->ref--;
+		*opd = val;
+	}
+}
+
+/**
+	Forward the values known to the loads in inst, and update the values
+	known after inst.   Return 1 if inst is a load deleted.
+ */
+static int NumberMemory(BBlock bb, IRInst inst)
+{
+	struct memRef ref;
+	Symbol val, src, *opds = inst->opds;
+
+	src = opds[1];
+	CurInst = inst;
+	// x++ reads and writes the same operand
+	if (inst->opcode != INC && inst->opcode != DEC)
+		VisitOperands(inst, ReplaceRead);
+
+	switch (inst->opcode)
+	{
+	case DEREF:
+		if (IsVolatileAccess(inst) || ! IsNumbered(opds[0]))
+			break;
+
+		IndirectRef(&ref, inst->ty, opds[1]);
+		if ((val = LookupMemory(&ref)) != NULL && val->kind == SK_Constant)
+		{
+			// *t1 = 1;  t2 = *t1;	----- t2 = 1;
+			inst->opcode = MOV;
+			opds[1] = val;
+			return 0;
+		}
+		if (val != NULL && SameValueType(opds[0], val))
+		{
+			Leaders[AsVar(opds[0])->no] = val;
+			RemoveInst(bb, inst);
+			return 1;
+		}
+		RememberMemory(&ref, opds[0], 1);
+		return 0;
+
+	case IMOV:
+		IndirectRef(&ref, inst->ty, opds[0]);
+		ForgetMemory(&ref);
+		if (! IsVolatileAccess(inst))
+			RememberMemory(&ref, opds[1], 0);
+		return 0;
+
+	case CLR:
+		ObjectRef(&ref, opds[0], opds[1]->val.i[0]);
+		ForgetMemory(&ref);
+		return 0;
+
+	case CALL:
+		ForgetMemory(NULL);
+		break;
+
+	case MOV:
+		if (IsMemoryScalar(src) && IsNumbered(opds[0]))
+		{
+			// t1 = g;  ...  t2 = g;
+			if (opds[1] != src && IsNumbered(opds[1]) && SameValueType(opds[0], opds[1]))
+			{
+				Leaders[AsVar(opds[0])->no] = opds[1];
+				RemoveInst(bb, inst);
+				return 1;
+			}
+			// g = 1;  ...  t2 = 1;
+			if (opds[1] != src)
+				return 0;
+			ObjectRef(&ref, src, src->ty->size);
+			RememberMemory(&ref, opds[0], 1);
+			return 0;
+		}
+		if (IsMemoryScalar(opds[0]))
+		{
+			ObjectRef(&ref, opds[0], opds[0]->ty->size);
+			ForgetMemory(&ref);
+			RememberMemory(&ref, opds[1], 0);
+			return 0;
+		}
+		break;
+	}
+	VisitOperands(inst, ForgetDef);
+	return 0;
+}
+
+static void NumberBlock(BBlock bb)
+{
+	IRInst inst, next;
+	BBlock kid;
+	Expr e;
+	Symbol val;
+	MemValue memory;
+	int top = ScopeTop, count;
+
+	for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+	{
+		next = inst->next;
+		if (inst->opcode == PHI)
+		{
+			if ((val = SameArguments(inst)) != NULL && IsNumbered(inst->opds[0]))
+			{
+				Leaders[AsVar(inst->opds[0])->no] = val;
+				RemoveInst(bb, inst);
+			}
+			continue;
+		}
+
+		VisitOperands(inst, ReplaceOperand);
+		if (NumberMemory(bb, inst) || ! IsPureInst(inst))
+			continue;
+
+		if ((e = LookupExpr(bb, inst)) != NULL)
+		{
+			Leaders[AsVar(inst->opds[0])->no] = e->val;
+			RemoveInst(bb, inst);
+		}
+		else
+		{
+			InsertExpr(bb, inst);
+		}
+	}
+
+	memory = Memory;
+	count = MemoryCount;
+	for (kid = bb->kids; kid != NULL; kid = kid->sibling)
+	{
+		Memory = kid->npred == 1 ? memory : NULL;
+		MemoryCount = kid->npred == 1 ? count : 0;
+		NumberBlock(kid);
+	}
+
+	while (ScopeTop > top)
+	{
+		e = Scope[--ScopeTop];
+		Buckets[Hash(e)] = e->link;
+	}
+}
+
+static int SameExpr(IRInst inst1, IRInst inst2)
+{
+	struct expr e1, e2;
+
+	if (inst1->opcode != inst2->opcode || ! SameValueType(inst1->opds[0], inst2->opds[0]))
+		return 0;
+
+	MakeKey(inst1, &e1);
+	MakeKey(inst2, &e2);
+	return e1.categ == e2.categ && e1.src1 == e2.src1 && e1.src2 == e2.src2;
+}
+
+static int IsAvailable(Symbol p, BBlock bb)
+{
+	return p == NULL || ! IsNumbered(p) || DefBBs[AsVar(p)->no] != bb;
+}
+
+/**
+	bb ends with a conditional branch to s1 and s2, bb is the only
+	predecessor of them.   An expression computed in both s1 and s2 from
+	the values defined before them is moved to the end of bb.
+	Division isn't moved, it may be done by a function call.  Neither is
+	an address, see above.
+ */
+static void HoistCommonExprs(BBlock bb, BBlock s1, BBlock s2)
+{
+	IRInst inst, next, inst2;
+
+	for (inst = s1->insth.next; inst != &s1->insth; inst = next)
+	{
+		next = inst->next;
+		if (! IsPureInst(inst) || inst->opcode == ADDR || inst->opcode == DIV || inst->opcode == MOD)
+			continue;
+
+		if (! IsAvailable(Leader(inst->opds[1]), s1) || ! IsAvailable(Leader(inst->opds[2]), s1))
+			continue;
+
+		for (inst2 = s2->insth.next; inst2 != &s2->insth; inst2 = inst2->next)
+		{
+			if (IsPureInst(inst2) && SameExpr(inst, inst2))
+				break;
+		}
+		if (inst2 == &s2->insth)
+			continue;
+
+		RemoveInst(s1, inst);
+		InsertBeforeJump(bb, inst);
+		DefBBs[AsVar(inst->opds[0])->no] = bb;
+		Leaders[AsVar(inst2->opds[0])->no] = inst->opds[0];
+		RemoveInst(s2, inst2);
+	}
+}
+
+static void VisitDef(Symbol *opd, int def)
+{
+	if (def && IsNumbered(*opd))
+		DefBBs[AsVar(*opd)->no] = CurrentBB;
+}
+
+void GlobalValueNumbering(FunctionSymbol fsym)
+{
+	BBlock bb, s1, s2;
+	IRInst inst, lasti;
+	Symbol p;
+	int n, ninst;
+
+	n = ninst = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) ? ++n : 0;
+	}
+	Leaders = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	DefBBs = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	memset(DefBBs, 0, (n + 1) * sizeof(BBlock));
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp && AsVar(p)->no != 0)
+			Leaders[AsVar(p)->no] = p;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		ninst += bb->ninst;
+	}
+
+	// about one bucket for every instruction
+	for (Mask = 63; Mask < (unsigned int)ninst; Mask = Mask * 2 + 1)
+		;
+	Buckets = HeapAllocate(CurrentHeap, (Mask + 1) * sizeof(Expr));
+	memset(Buckets, 0, (Mask + 1) * sizeof(Expr));
+	Scope = HeapAllocate(CurrentHeap, (ninst + 1) * sizeof(Expr));
+	ScopeTop = 0;
+	Memory = NULL;
+	MemoryCount = 0;
+	SetupAlias(fsym, n);
+
+	NumberBlock(fsym->entryBB);
+
+	for (CurrentBB = fsym->entryBB; CurrentBB != NULL; CurrentBB = CurrentBB->next)
+	{
+		for (inst = CurrentBB->insth.next; inst != &CurrentBB->insth; inst = inst->next)
+		{
+			VisitOperands(inst, VisitDef);
+		}
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		lasti = bb->insth.prev;
+		if (bb->nsucc != 2 || lasti->opcode < JZ || lasti->opcode > JLE)
+			continue;
+
+		s1 = bb->succs->bb;
+		s2 = bb->succs->next->bb;
+		if (s1->npred == 1 && s2->npred == 1)
+			HoistCommonExprs(bb, s1, s2);
+	}
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			VisitOperands(inst, ReplaceOperand);
+		}
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+}
@@ -0,0 +1,939 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Strength reduction of induction variables on the SSA form.
+	(Frances E. Allen, John Cocke and Ken Kennedy, "Reduction of Operator
+	Strength")
+
+	A basic induction variable i is defined by a phi function in the loop
+	header, i : phi(init BBp, i2 BB1), and i2 : i + c in the loop.
+	A temporary computed from i by adding an invariant or a constant,
+	multiplying or shifting by a constant, is base + s * i + off.   It is
+	replaced by a new induction variable p, which starts at base + s * init
+	+ off and is bumped by s * c:
+
+		int a[100];					t1 :&a;						t1 :&a;
+		void f(int n){				goto BB2;					goto BB2;
+			int i;				BB1:						BB1:
+			for (i = 0; i < n; i++)		t0 : t9 << 2;				*t11 = t9;
+				a[i] = i;				t2 : t1 + t0;		---->	t10 : t9 + 1;
+		}								*t2 = t9;					t12 : t11 + 4;
+										t10 : t9 + 1;			BB2:
+									BB2:							t11 : phi(t12 BB1, t1 BB0);
+										t9 : phi(t10 BB1, 0 BB0);	t9 : phi(t10 BB1, 0 BB0);
+										if (t9 < t7) goto BB1;		if (t9 < t7) goto BB1;
+
+	When the counter is only compared with a constant in the exit test,
+	the test is done on the new pointer instead, the counter is removed:
+
+		for (i = 0; i < 100; i++)		t1 :&a;
+			sum += a[i];				t15 : t1 + 400;
+										goto BB5;
+									BB4:
+										t3 :*t13;
+										t4 : t9 + t3;
+										t14 : t13 + 4;
+									BB5:
+										t13 : phi(t14 BB4, t1 BB3);
+										t9 : phi(t4 BB4, 0 BB3);
+										if (t13 < t15) goto BB4;
+
+	Every value is a 32-bit integer or pointer, base + s * i + off wraps
+	around exactly as the instructions it replaces.   The inner loops are
+	done first, the new induction variables of an inner loop may be derived
+	from the induction variables of the outer loop.
+ */
+
+/**
+	The value of a temporary derived from the basic induction variable iv,
+		base + scale * iv + off
+	base is a loop-invariant temporary, or NULL.
+ */
+typedef struct form
+{
+	Symbol iv;
+	Symbol base;
+	int scale;
+	int off;
+} *Form;
+
+/**
+	The induction variable replacing the temporaries of the same form,
+		p : phi(p0 BBp, p2 BB1);	p2 : p + scale * step;
+ */
+typedef struct reduced
+{
+	struct form form;
+	Type ty;
+	Symbol p;
+	Symbol p2;
+	struct reduced *link;
+} *Reduced;
+
+/**
+	i : phi(init BBp, i2 BB1, ...) in the loop header, i2 : i + step in the loop.
+ */
+typedef struct basiciv
+{
+	IRInst phi;
+	IRInst inc;
+	BBlock incBB;
+	Symbol init;
+	int step;
+	// set when the counter has no use other than the derived values and one test
+	int removable;
+	Reduced reduced;
+	struct basiciv *link;
+} *BasicIV;
+
+// the tables of temporary t are indexed by AsVar(t)->no
+static struct form *Forms;
+static IRInst *DefInsts;
+static BBlock *DefBBs;
+// the induction variable replacing t
+static Symbol *Replaces;
+static int *Uses;
+static int *LoopUses;
+// the uses by the instructions computing other derived values
+static int *DerivedUses;
+static int *Live;
+static Symbol *Stack;
+static int NumTemps, MaxTemps;
+
+static Loop CurLoop;
+static BasicIV BasicIVs;
+static BBlock CurBB;
+static IRInst CurInst;
+static int Count;
+static BasicIV CurIV;
+// set when CurLoop has a call
+static int HasCall;
+
+#define IsIntConst(p) ((p) != NULL && (p)->kind == SK_Constant && ! IsRealType((p)->ty))
+#define IsDerivation(op) ((op) == MOV || (op) == ADD || (op) == SUB || (op) == LSH || (op) == MUL)
+#define IsWord(ty)    ((IsIntegType(ty) || IsPtrType(ty)) && (ty)->size == 4)
+
+static Form FormOf(Symbol p)
+{
+	return IsNumbered(p) && Forms[AsVar(p)->no].iv != NULL ? &Forms[AsVar(p)->no] : NULL;
+}
+
+static int IsInvariantTemp(Symbol p)
+{
+	BBlock bb;
+
+	if (! IsNumbered(p))
+		return 0;
+	bb = DefBBs[AsVar(p)->no];
+	return bb == NULL || ! InLoop(CurLoop, bb);
+}
+
+/**
+	Create t : src1 op src2 after pos in bb, at the end of bb if pos is NULL.
+ */
+static Symbol Append(BBlock bb, IRInst pos, Type ty, int op, Symbol src1, Symbol src2)
+{
+	IRInst inst;
+	Symbol t;
+
+	t = CreateTemp(ty);
+	AsVar(t)->no = ++NumTemps;
+	ALLOC(inst);
+	inst->ty = ty;
+	inst->opcode = op;
+	inst->opds[0] = t;
+	inst->opds[1] = src1;
+	inst->opds[2] = src2;
+	if (pos == NULL)
+		InsertBeforeJump(bb, inst);
+	else
+		InsertAfter(bb, pos, inst);
+	DefInsts[NumTemps] = inst;
+	DefBBs[NumTemps] = bb;
+
+	return t;
+}
+
+/**
+ * t * n in the preheader, by a shift if n is a power of 2.
+ */
+static Symbol Multiply(Type ty, Symbol t, int n)
+{
+	int k;
+
+	if (n == 1)
+		return t;
+	if (n > 0 && (n & (n - 1)) == 0)
+	{
+		for (k = 0; (1 << k) != n; k++)
+			;
+		return Append(CurLoop->preheader, NULL, ty, LSH, t, IntConstant(k));
+	}
+	return Append(CurLoop->preheader, NULL, ty, MUL, t, IntConstant(n));
+}
+
+/**
+ * Compute base + scale * x + off of form f in the preheader.
+ */
+static Symbol Materialize(Form f, Symbol x, Type ty)
+{
+	BBlock ph = CurLoop->preheader;
+	Symbol t;
+	int k;
+
+	if (IsIntConst(x))
+	{
+		k = (int)((unsigned)f->scale * (unsigned)x->val.i[0] + (unsigned)f->off);
+		if (f->base == NULL)
+			return IntConstant(k);
+		return k == 0 ? f->base : Append(ph, NULL, ty, ADD, f->base, IntConstant(k));
+	}
+
+	t = Multiply(ty, x, f->scale);
+	if (f->off != 0)
+		t = Append(ph, NULL, ty, ADD, t, IntConstant(f->off));
+	if (f->base != NULL)
+		t = Append(ph, NULL, ty, ADD, f->base, t);
+	return t;
+}
+
+/**
+	Find the basic induction variables of CurLoop.
+	i2 must be computed in CurLoop itself, not in an inner loop.
+ */
+static void FindBasicIVs(void)
+{
+	BBlock header = CurLoop->header;
+	IRInst inst, inc;
+	Symbol i, i2, init, *opds;
+	Vector args;
+	PhiArg arg;
+	BasicIV biv;
+	int j, step;
+
+	BasicIVs = NULL;
+	for (inst = header->insth.next; inst->opcode == PHI; inst = inst->next)
+	{
+		i = inst->opds[0];
+		if (! IsNumbered(i) || ! IsIntegType(i->ty) || i->ty->size != 4)
+			continue;
+
+		init = i2 = NULL;
+		args = (Vector)inst->opds[1];
+		for (j = 0; j < LEN(args); j++)
+		{
+			arg = GET_ITEM(args, j);
+			if (arg->bb == CurLoop->preheader && init == NULL)
+				init = arg->sym;
+			else if (InLoop(CurLoop, arg->bb) && (i2 == NULL || i2 == arg->sym))
+				i2 = arg->sym;
+			else
+				break;
+		}
+		if (j < LEN(args) || init == NULL || ! IsNumbered(i2))
+			continue;
+
+		inc = DefInsts[AsVar(i2)->no];
+		if (inc == NULL || DefBBs[AsVar(i2)->no]->loop != CurLoop)
+			continue;
+		opds = inc->opds;
+		if (inc->opcode == ADD && opds[1] == i && IsIntConst(opds[2]))
+			step = opds[2]->val.i[0];
+		else if (inc->opcode == ADD && opds[2] == i && IsIntConst(opds[1]))
+			step = opds[1]->val.i[0];
+		else if (inc->opcode == SUB && opds[1] == i && IsIntConst(opds[2]))
+			step = -opds[2]->val.i[0];
+		else
+			continue;
+		if (step == 0)
+			continue;
+
+		CALLOC(biv);
+		biv->phi = inst;
+		biv->inc = inc;
+		biv->incBB = DefBBs[AsVar(i2)->no];
+		biv->init = init;
+		biv->step = step;
+		biv->link = BasicIVs;
+		BasicIVs = biv;
+
+		Forms[AsVar(i)->no].iv = i;
+		Forms[AsVar(i)->no].scale = 1;
+	}
+}
+
+/**
+	Compute the form of the value defined by inst.   The invariant part
+	is computed in the preheader, it is removed later if not used.
+ */
+static void ComputeForm(IRInst inst)
+{
+	Symbol dst = inst->opds[0], src1 = inst->opds[1], src2 = inst->opds[2], t;
+	BBlock ph = CurLoop->preheader;
+	struct form g;
+	Form f;
+	int op = inst->opcode, c;
+
+	if (! IsNumbered(dst) || ! IsWord(dst->ty) || NumTemps + 2 > MaxTemps)
+		return;
+
+	if ((op == ADD || op == MUL) && FormOf(src1) == NULL)
+	{
+		t = src1; src1 = src2; src2 = t;
+	}
+	if ((f = FormOf(src1)) == NULL)
+		return;
+	g = *f;
+	c = IsIntConst(src2) ? src2->val.i[0] : 0;
+
+	switch (op)
+	{
+	case MOV:
+		break;
+
+	case ADD:
+	case SUB:
+		if (IsIntConst(src2))
+		{
+			g.off = (int)(op == ADD ? (unsigned)g.off + c : (unsigned)g.off - c);
+		}
+		else if (IsInvariantTemp(src2))
+		{
+			if (g.base != NULL)
+				g.base = Append(ph, NULL, dst->ty, op, g.base, src2);
+			else
+				g.base = op == ADD ? src2 : Append(ph, NULL, dst->ty, NEG, src2, NULL);
+		}
+		else
+		{
+			return;
+		}
+		break;
+
+	case LSH:
+		if (! IsIntConst(src2) || c < 0 || c > 31)
+			return;
+		c = 1 << c;
+		goto scale;
+
+	case MUL:
+		if (! IsIntConst(src2))
+			return;
+	scale:
+		g.scale = (int)((unsigned)g.scale * c);
+		g.off = (int)((unsigned)g.off * c);
+		if (g.base != NULL)
+			g.base = op == LSH ? Append(ph, NULL, dst->ty, LSH, g.base, src2) :
+			                     Append(ph, NULL, dst->ty, MUL, g.base, src2);
+		break;
+
+	default:
+		return;
+	}
+	Forms[AsVar(dst)->no] = g;
+}
+
+static void CountUse(Symbol *opd, int def)
+{
+	Symbol dst = CurInst->opds[0];
+	int no;
+
+	if (def || ! IsNumbered(*opd))
+		return;
+
+	no = AsVar(*opd)->no;
+	Uses[no]++;
+	if (! InLoop(CurLoop, CurBB))
+		return;
+	LoopUses[no]++;
+	if (IsDerivation(CurInst->opcode) && FormOf(dst) != NULL)
+		DerivedUses[no]++;
+}
+
+/**
+	Count the uses of the temporaries, the use by a phi function is at the
+	end of the predecessor where the argument comes from.
+ */
+static void CountUses(FunctionSymbol fsym)
+{
+	BBlock bb;
+	Vector args;
+	PhiArg arg;
+	int i;
+
+	memset(Uses, 0, (MaxTemps + 1) * sizeof(int));
+	memset(LoopUses, 0, (MaxTemps + 1) * sizeof(int));
+	memset(DerivedUses, 0, (MaxTemps + 1) * sizeof(int));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (CurInst = bb->insth.next; CurInst != &bb->insth; CurInst = CurInst->next)
+		{
+			CurBB = bb;
+			if (CurInst->opcode != PHI)
+			{
+				VisitOperands(CurInst, CountUse);
+				continue;
+			}
+			args = (Vector)CurInst->opds[1];
+			for (i = 0; i < LEN(args); i++)
+			{
+				arg = GET_ITEM(args, i);
+				CurBB = arg->bb;
+				CountUse(&arg->sym, 0);
+			}
+		}
+	}
+}
+
+static BasicIV FindBasicIV(Symbol i)
+{
+	BasicIV biv;
+
+	for (biv = BasicIVs; biv != NULL; biv = biv->link)
+	{
+		if (biv->phi->opds[0] == i)
+			break;
+	}
+	return biv;
+}
+
+/**
+	A derived temporary used inside the loop only, and not only for
+	computing other derived values, is replaced.   An integer is replaced
+	only when it is multiplied, t + c isn't replaced when t is, it is an
+	addition either way.   In a loop with calls, the new induction variable
+	takes a callee-saved register, it must replace the counter.
+ */
+static int IsCandidate(IRInst inst)
+{
+	Symbol dst = inst->opds[0], src;
+	Form f = FormOf(dst);
+	int no;
+
+	if (f == NULL || ! IsDerivation(inst->opcode) || f->iv == dst || inst == FindBasicIV(f->iv)->inc)
+		return 0;
+	if (HasCall && ! FindBasicIV(f->iv)->removable)
+		return 0;
+	if (f->scale == 1 && ! IsPtrType(dst->ty))
+		return 0;
+
+	if (inst->opcode == MOV || ((inst->opcode == ADD || inst->opcode == SUB) && IsIntConst(inst->opds[2])))
+	{
+		src = inst->opds[1];
+		if (IsNumbered(src) && Replaces[AsVar(src)->no] != NULL)
+			return 0;
+	}
+	if (inst->opcode == ADD && IsIntConst(inst->opds[1]))
+	{
+		src = inst->opds[2];
+		if (IsNumbered(src) && Replaces[AsVar(src)->no] != NULL)
+			return 0;
+	}
+
+	no = AsVar(dst)->no;
+	return Uses[no] == LoopUses[no] && Uses[no] > DerivedUses[no];
+}
+
+static int SameForm(Form f1, Form f2)
+{
+	return f1->iv == f2->iv && f1->base == f2->base && f1->scale == f2->scale && f1->off == f2->off;
+}
+
+/**
+ * Return 1 if inst is after pos in the same block.
+ */
+static int Follows(BBlock bb, IRInst pos, IRInst inst)
+{
+	IRInst p;
+
+	for (p = pos->next; p != &bb->insth; p = p->next)
+	{
+		if (p == inst)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+	The temporary of form f is replaced by the induction variable of the
+	same form.   When an induction variable differs from f only in off,
+	e.g. for a[i] and a[i + 1], the temporary is computed from it by an
+	addition, which is usually folded into the address of a load or store.
+	After the increment, p + scale * step is p2 already.
+ */
+static void Reduce(IRInst inst)
+{
+	BBlock header = CurLoop->header;
+	Symbol dst = inst->opds[0], p0;
+	Form f = FormOf(dst);
+	BasicIV biv = FindBasicIV(f->iv);
+	Vector args, ivargs;
+	PhiArg arg, ivarg;
+	IRInst phi;
+	Reduced r;
+	unsigned d;
+	int i;
+
+	for (r = biv->reduced; r != NULL; r = r->link)
+	{
+		if (SameForm(&r->form, f) && r->ty->categ == dst->ty->categ)
+			break;
+	}
+	if (r == NULL)
+	{
+		for (r = biv->reduced; r != NULL; r = r->link)
+		{
+			if (r->form.base == f->base && r->form.scale == f->scale && r->ty->categ == dst->ty->categ)
+				break;
+		}
+		if (r != NULL)
+		{
+			d = (unsigned)f->off - (unsigned)r->form.off;
+			if (d == (unsigned)f->scale * (unsigned)biv->step && Follows(biv->incBB, biv->inc, inst))
+			{
+				Replaces[AsVar(dst)->no] = r->p2;
+				return;
+			}
+			inst->ty = dst->ty;
+			inst->opcode = ADD;
+			inst->opds[1] = r->p;
+			inst->opds[2] = IntConstant((int)d);
+			return;
+		}
+	}
+	if (r == NULL)
+	{
+		CALLOC(r);
+		r->form = *f;
+		r->ty = dst->ty;
+		p0 = Materialize(f, biv->init, dst->ty);
+
+		r->p = CreateTemp(dst->ty);
+		AsVar(r->p)->no = ++NumTemps;
+		ivargs = (Vector)biv->phi->opds[1];
+		args = CreateVector(LEN(ivargs));
+		for (i = 0; i < LEN(ivargs); i++)
+		{
+			ivarg = GET_ITEM(ivargs, i);
+			ALLOC(arg);
+			arg->sym = ivarg->bb == CurLoop->preheader ? p0 : NULL;
+			arg->bb = ivarg->bb;
+			INSERT_ITEM(args, arg);
+		}
+		ALLOC(phi);
+		phi->ty = dst->ty;
+		phi->opcode = PHI;
+		phi->opds[0] = r->p;
+		phi->opds[1] = (Symbol)args;
+		phi->opds[2] = NULL;
+		InsertAfter(header, &header->insth, phi);
+		DefInsts[NumTemps] = phi;
+		DefBBs[NumTemps] = header;
+
+		r->p2 = Append(biv->incBB, biv->inc, dst->ty, ADD, r->p,
+		               IntConstant((int)((unsigned)f->scale * (unsigned)biv->step)));
+		for (i = 0; i < LEN(args); i++)
+		{
+			arg = GET_ITEM(args, i);
+			if (arg->sym == NULL)
+				arg->sym = r->p2;
+		}
+
+		r->link = biv->reduced;
+		biv->reduced = r;
+	}
+	Replaces[AsVar(dst)->no] = r->p;
+}
+
+static void ReplaceUse(Symbol *opd, int def)
+{
+	if (def)
+		return;
+	while (IsNumbered(*opd) && Replaces[AsVar(*opd)->no] != NULL)
+		*opd = Replaces[AsVar(*opd)->no];
+}
+
+static void ReplaceUses(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			VisitOperands(inst, ReplaceUse);
+		}
+	}
+}
+
+/**
+	t1 = t2 of the same value type, or of two 32-bit integer types, t1 is
+	replaced by t2.   The operation decides whether the bits are signed,
+	e.g. (unsigned)i < 10 is a copy of i compared as unsigned.
+ */
+static void PropagateSSACopies(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+
+	memset(Replaces, 0, (MaxTemps + 1) * sizeof(Symbol));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->opcode == MOV && IsNumbered(inst->opds[0]) && IsNumbered(inst->opds[1]) &&
+			    (SameValueType(inst->opds[0], inst->opds[1]) || (IsWord(inst->opds[0]->ty) &&
+			     IsIntegType(inst->opds[0]->ty) && IsWord(inst->opds[1]->ty) && IsIntegType(inst->opds[1]->ty))))
+				Replaces[AsVar(inst->opds[0])->no] = inst->opds[1];
+		}
+	}
+	ReplaceUses(fsym);
+}
+
+static void MarkLive(Symbol *opd, int def)
+{
+	int no;
+
+	if (def || ! IsNumbered(*opd))
+		return;
+
+	no = AsVar(*opd)->no;
+	if (! Live[no])
+	{
+		Live[no] = 1;
+		Stack[Count++] = *opd;
+	}
+}
+
+/**
+ * The instructions which only compute the value of a temporary.
+ */
+static int IsRemovable(IRInst inst)
+{
+	int op = inst->opcode;
+	Symbol src = inst->opds[1];
+
+	if (! IsNumbered(inst->opds[0]) || IsVolatileAccess(inst))
+		return 0;
+	if (op == MOV)
+		return src->kind == SK_Temp || src->kind == SK_Constant;
+
+	return op == PHI || op == ADDR || op <= SELZ || (op >= EXTI1 && op <= CVTF8U4);
+}
+
+/**
+	Remove the computations whose values are never used, including the
+	cycle of a phi function and the increment using each other.
+ */
+static void RemoveDeadCode(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst, next;
+	Symbol t;
+
+	memset(Live, 0, (MaxTemps + 1) * sizeof(int));
+	Count = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (! IsRemovable(inst))
+				VisitOperands(inst, MarkLive);
+		}
+	}
+	while (Count > 0)
+	{
+		t = Stack[--Count];
+		inst = DefInsts[AsVar(t)->no];
+		if (inst != NULL && IsRemovable(inst))
+			VisitOperands(inst, MarkLive);
+	}
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+		{
+			next = inst->next;
+			if (IsRemovable(inst) && ! Live[AsVar(inst->opds[0])->no])
+				RemoveInst(bb, inst);
+		}
+	}
+}
+
+static void CountIVUse(Symbol *opd, int def)
+{
+	if (! def && (*opd == CurIV->phi->opds[0] || *opd == CurIV->inc->opds[0]))
+		Count++;
+}
+
+/**
+ * The jump of y op x for x op y.
+ */
+static int Swap(int op)
+{
+	switch (op)
+	{
+	case JG:  return JL;
+	case JL:  return JG;
+	case JGE: return JLE;
+	case JLE: return JGE;
+	default:  return op;
+	}
+}
+
+/**
+ * The jump of !(x op y).
+ */
+static int Negate(int op)
+{
+	switch (op)
+	{
+	case JE:  return JNE;
+	case JNE: return JE;
+	case JG:  return JLE;
+	case JL:  return JGE;
+	case JGE: return JL;
+	default:  return JG;
+	}
+}
+
+/**
+	if (i op n) goto BBx is the only use of the counter other than its
+	increment, it leaves the loop when i reaches n.   Then base + s * i + off
+	never wraps around for any i tested, (an address out of the object
+	doesn't exist), and i op n is p op L, L = base + s * n + off.
+	The pointers are compared as unsigned, the integers as int, s * i + off
+	must be an int for every i tested.
+ */
+static void ReplaceTest(FunctionSymbol fsym, BasicIV biv)
+{
+	Symbol i = biv->phi->opds[0], i2 = biv->inc->opds[0], x, n;
+	IRInst test = NULL;
+	BBlock bb, testBB = NULL, target;
+	Reduced r, p = NULL;
+	long long init, bound, step, lo, hi, s, off;
+	int op, cont, unsign;
+
+	if (! IsIntConst(biv->init))
+		return;
+	// a pointer is preferred, it has no other use
+	for (r = biv->reduced; r != NULL; r = r->link)
+	{
+		if (r->form.scale > 0 && (IsPtrType(r->ty) || p == NULL))
+			p = r;
+	}
+	if ((r = p) == NULL)
+		return;
+
+	CurIV = biv;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (CurInst = bb->insth.next; CurInst != &bb->insth; CurInst = CurInst->next)
+		{
+			if (CurInst == biv->phi || CurInst == biv->inc)
+				continue;
+			Count = 0;
+			VisitOperands(CurInst, CountIVUse);
+			if (Count == 0)
+				continue;
+			if (test != NULL || Count != 1 || CurInst->opcode < JE || CurInst->opcode > JLE)
+				return;
+			test = CurInst;
+			testBB = bb;
+		}
+	}
+	if (test == NULL || ! InLoop(CurLoop, testBB))
+		return;
+	target = (BBlock)test->opds[0];
+	// the last block falls through to the end of the function
+	if (InLoop(CurLoop, target) == (testBB->next != NULL && InLoop(CurLoop, testBB->next)))
+		return;
+
+	op = test->opcode;
+	x = test->opds[1];
+	n = test->opds[2];
+	if (x != i && x != i2)
+	{
+		op = Swap(op);
+		x = test->opds[2];
+		n = test->opds[1];
+	}
+	if (! IsIntConst(n))
+		return;
+
+	// the loop goes on while (x cont n)
+	cont = InLoop(CurLoop, target) ? op : Negate(op);
+	unsign = IsPtrType(test->ty) || IsUnsigned(test->ty);
+	init = unsign ? (long long)(unsigned)biv->init->val.i[0] : biv->init->val.i[0];
+	bound = unsign ? (long long)(unsigned)n->val.i[0] : n->val.i[0];
+	step = biv->step;
+	if (x == i2)
+		init += step;
+	if (cont == JNE)
+	{
+		if ((bound - init) % step != 0 || (bound - init) / step < 0)
+			return;
+	}
+	else if (step > 0 ? cont != JL && cont != JLE : cont != JG && cont != JGE)
+	{
+		return;
+	}
+
+	step = step > 0 ? step : -step;
+	lo = (init < bound ? init : bound) - step;
+	hi = (init < bound ? bound : init) + step;
+	if (unsign ? lo < 0 || hi > 0xFFFFFFFFLL : lo < -0x80000000LL || hi > 0x7FFFFFFFLL)
+		return;
+	s = r->form.scale;
+	off = r->form.off;
+	if (s * lo + off < -0x80000000LL || s * hi + off > 0x7FFFFFFFLL)
+		return;
+
+	test->opcode = op;
+	test->ty = IsPtrType(r->ty) ? r->ty : T(INT);
+	test->opds[1] = x == i ? r->p : r->p2;
+	test->opds[2] = Materialize(&r->form, n, r->ty);
+}
+
+static int ComparePre(const void *p1, const void *p2)
+{
+	return (*(BBlock *)p1)->pre - (*(BBlock *)p2)->pre;
+}
+
+static void ReduceLoop(FunctionSymbol fsym, Loop loop)
+{
+	BBlock *blocks;
+	BasicIV biv;
+	IRInst inst;
+	Vector args;
+	int i, i1, i2, n = LEN(loop->blocks), changed = 0;
+
+	CurLoop = loop;
+	memset(Forms, 0, (MaxTemps + 1) * sizeof(struct form));
+	FindBasicIVs();
+	if (BasicIVs == NULL)
+		return;
+
+	// the operands are defined before in the preorder of the dominator tree
+	blocks = HeapAllocate(CurrentHeap, n * sizeof(BBlock));
+	for (i = 0; i < n; i++)
+	{
+		blocks[i] = GET_ITEM(loop->blocks, i);
+	}
+	qsort(blocks, n, sizeof(BBlock), ComparePre);
+	HasCall = 0;
+	for (i = 0; i < n; i++)
+	{
+		for (inst = blocks[i]->insth.next; inst != &blocks[i]->insth; inst = inst->next)
+		{
+			HasCall |= inst->opcode == CALL;
+			if (inst->opcode != PHI)
+				ComputeForm(inst);
+		}
+	}
+
+	CountUses(fsym);
+	for (biv = BasicIVs; biv != NULL; biv = biv->link)
+	{
+		i1 = AsVar(biv->phi->opds[0])->no;
+		i2 = AsVar(biv->inc->opds[0])->no;
+		args = (Vector)biv->phi->opds[1];
+		// the uses by the phi function and the test
+		biv->removable = Uses[i1] - DerivedUses[i1] + Uses[i2] - DerivedUses[i2] <= LEN(args);
+	}
+	memset(Replaces, 0, (MaxTemps + 1) * sizeof(Symbol));
+	for (i = 0; i < n; i++)
+	{
+		for (inst = blocks[i]->insth.next; inst != &blocks[i]->insth; inst = inst->next)
+		{
+			if (inst->opcode == PHI || NumTemps + 8 > MaxTemps || ! IsCandidate(inst))
+				continue;
+			Reduce(inst);
+			changed = 1;
+		}
+	}
+	if (! changed)
+	{
+		RemoveDeadCode(fsym);
+		return;
+	}
+
+	ReplaceUses(fsym);
+	RemoveDeadCode(fsym);
+
+	for (biv = BasicIVs; biv != NULL && NumTemps + 4 <= MaxTemps; biv = biv->link)
+	{
+		ReplaceTest(fsym, biv);
+	}
+	RemoveDeadCode(fsym);
+}
+
+static void VisitDef(Symbol *opd, int def)
+{
+	if (def && IsNumbered(*opd))
+	{
+		DefInsts[AsVar(*opd)->no] = CurInst;
+		DefBBs[AsVar(*opd)->no] = CurBB;
+	}
+}
+
+void ReduceInductionVariables(FunctionSymbol fsym)
+{
+	Vector loops;
+	Loop loop;
+	Symbol p;
+	BBlock bb;
+	int i, n;
+
+	loops = InsertPreheaders(fsym);
+	if (LEN(loops) == 0)
+		return;
+
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) ? ++n : 0;
+	}
+	NumTemps = n;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		n += 4 * bb->ninst;
+	}
+	MaxTemps = n + 16;
+
+	Forms = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(struct form));
+	DefInsts = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(IRInst));
+	DefBBs = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(BBlock));
+	Replaces = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(Symbol));
+	Uses = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(int));
+	LoopUses = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(int));
+	DerivedUses = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(int));
+	Live = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(int));
+	Stack = HeapAllocate(CurrentHeap, (MaxTemps + 1) * sizeof(Symbol));
+	memset(DefInsts, 0, (MaxTemps + 1) * sizeof(IRInst));
+	memset(DefBBs, 0, (MaxTemps + 1) * sizeof(BBlock));
+	for (CurBB = fsym->entryBB; CurBB != NULL; CurBB = CurBB->next)
+	{
+		for (CurInst = CurBB->insth.next; CurInst != &CurBB->insth; CurInst = CurInst->next)
+		{
+			VisitOperands(CurInst, VisitDef);
+		}
+	}
+
+	PropagateSSACopies(fsym);
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		if (loop->preheader != NULL)
+			ReduceLoop(fsym, loop);
+	}
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+}
@@ -0,0 +1,526 @@
+#include "ucl.h"
+#include "gen.h"
+#include "output.h"
+
+/**
+	Function inlining.
+
+	After a function is optimized by Optimize(), a copy of its body is kept
+	when it is small.   A later call of the function is replaced by a copy
+	of the kept body, with new variables and temporaries for the parameters
+	and the locals of the callee:
+
+		static int get(struct point *p){		function main
+			return p->x;							t2 :&pt;
+		}											p.0 = t2;			----- the argument
+		int main(){									t4 = p.0;
+			struct point pt = {1, 2};				t5 :*t4;
+			return get(&pt);						t1 = t5;			----- the return value
+		}										BB2:
+													return t1;
+
+	The return of the callee assigns the receiver of the call, and the
+	exit block of the copy falls through to the instructions after the call.
+	The global optimizations see the copy as a part of the caller, e.g. the
+	parameters are promoted and constants are propagated into the copy.
+
+	A function is kept when it has a prototype without ..., returns a scalar
+	or nothing, has scalar parameters and small locals, and its size is
+	MAX_INLINED_INSTS at most.   The size is doubled for a static function,
+	whose definition isn't emitted when all the calls are inlined, see
+	EmitFunctions(), and is 4 times for an inline function.   The calls in a
+	function are inlined before its body is kept, so a call chain is
+	inlined bottom up; a recursive call is never inlined, the body of the
+	function isn't kept yet.   Only the functions defined before the caller
+	are inlined, the callers are translated in the order of the definitions.
+ */
+
+#define MAX_INLINED_INSTS   12
+// a caller isn't inlined into beyond this size
+#define MAX_CALLER_INSTS    1200
+// the largest local of a function inlined
+#define MAX_INLINED_FRAME   64
+
+typedef struct inlineBody
+{
+	// the copies of the blocks, from the entry block to the exit block
+	BBlock *blocks;
+	int nblock;
+	// the copies of the parameters, locals and temporaries, vars[1..nvar]
+	Symbol *vars;
+	int nvar;
+	Symbol *params;
+	int nparam;
+	int size;
+} *InlineBody;
+
+// the copies of the blocks, Blocks[bb->no]
+static BBlock *Blocks;
+// the kept variables Vars[] when a body is kept, the new variables when it is inlined
+static Symbol *Vars;
+
+static int SizeOf(FunctionSymbol fsym)
+{
+	BBlock bb;
+	int size = 0;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		size += bb->ninst;
+	}
+	return size;
+}
+
+/**
+ * The copy of a parameter, local or temporary of the function whose body is kept.
+ */
+static Symbol KeepSymbol(Symbol p)
+{
+	VariableSymbol v;
+
+	if ((p->kind == SK_Variable || p->kind == SK_Temp) && AsVar(p)->no != 0)
+		return Vars[AsVar(p)->no];
+
+	if (p->kind == SK_Offset && AsVar(p->link)->no != 0)
+	{
+		ALLOC(v);
+		*v = *AsVar(p);
+		v->link = Vars[AsVar(p->link)->no];
+		return (Symbol)v;
+	}
+	return p;
+}
+
+/**
+ * The new variable or temporary of the caller replacing the kept one.
+ */
+static Symbol NewSymbol(Symbol p)
+{
+	VariableSymbol v;
+	int no;
+
+	if (p->kind == SK_Offset && AsVar(p->link)->no != 0)
+		return CreateOffset(p->ty, NewSymbol(p->link), AsVar(p)->offset, p->pcoord);
+
+	if ((p->kind != SK_Variable && p->kind != SK_Temp) || (no = AsVar(p)->no) == 0)
+		return p;
+
+	if (Vars[no] == NULL)
+	{
+		if (p->kind == SK_Temp)
+		{
+			Vars[no] = CreateTemp(p->ty);
+			Vars[no]->addressed = p->addressed;
+			return Vars[no];
+		}
+		CALLOC(v);
+		v->kind = SK_Variable;
+		v->name = FormatName("%s.%d", p->name, TempNum++);
+		v->ty = p->ty;
+		v->level = p->level;
+		v->sclass = p->sclass;
+		v->addressed = p->addressed;
+		v->pcoord = p->pcoord;
+		*FSYM->lastv = (Symbol)v;
+		FSYM->lastv = &v->next;
+		Vars[no] = (Symbol)v;
+	}
+	return Vars[no];
+}
+
+static void KeepOperand(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+
+	*opd = KeepSymbol(p);
+	// the unused parameters aren't assigned
+	if (*opd != p)
+		(*opd)->ref++;
+}
+
+static void NewOperand(Symbol *opd, int def)
+{
+	*opd = NewSymbol(*opd);
+	(*opd)->ref++;
+}
+
+static IRInst CopyInst(IRInst inst, void (*visit)(Symbol *opd, int def))
+{
+	BBlock *dstBBs, *srcBBs;
+	Vector args, srcArgs;
+	ILArg arg, p;
+	IRInst copy;
+	int i;
+
+	ALLOC(copy);
+	*copy = *inst;
+	copy->prev = copy->next = NULL;
+	if (inst->opcode >= JZ && inst->opcode <= JMP)
+	{
+		copy->opds[0] = (Symbol)Blocks[((BBlock)inst->opds[0])->no];
+	}
+	else if (inst->opcode == IJMP)
+	{
+		srcBBs = (BBlock *)inst->opds[0];
+		for (i = 0; srcBBs[i] != NULL; i++)
+			;
+		dstBBs = HeapAllocate(CurrentHeap, (i + 1) * sizeof(BBlock));
+		for (i = 0; srcBBs[i] != NULL; i++)
+		{
+			dstBBs[i] = Blocks[srcBBs[i]->no];
+		}
+		dstBBs[i] = NULL;
+		copy->opds[0] = (Symbol)dstBBs;
+	}
+	else if (inst->opcode == CALL)
+	{
+		srcArgs = (Vector)inst->opds[2];
+		args = CreateVector(LEN(srcArgs) + 1);
+		FOR_EACH_ITEM(ILArg, p, srcArgs)
+			ALLOC(arg);
+			*arg = *p;
+			INSERT_ITEM(args, arg);
+		ENDFOR
+		copy->opds[2] = (Symbol)args;
+	}
+	else if (inst->opcode == CLR)
+	{
+		// not visited by VisitOperands()
+		visit(&copy->opds[0], 1);
+	}
+	else if (inst->opcode == ADDR)
+	{
+		// the object whose address is taken
+		visit(&copy->opds[1], 0);
+	}
+	VisitOperands(copy, visit);
+
+	return copy;
+}
+
+/**
+ * Record the definition of a temporary as the translator does, see DefineTemp().
+ */
+static void DefineCopy(IRInst inst)
+{
+	Symbol dst = inst->opds[0];
+	int op = inst->opcode;
+
+	if (dst == NULL || dst->kind != SK_Temp)
+		return;
+
+	if (op == MOV || op == CALL)
+		DefineTemp(dst, op, (Symbol)inst, NULL);
+	else if (op <= SELZ || (op >= ADDR && op < MOV))
+		DefineTemp(dst, op, inst->opds[1], inst->opds[2]);
+}
+
+static int IsInlinable(FunctionSymbol fsym, int size)
+{
+	FunctionType fty = (FunctionType)fsym->ty;
+	int limit = MAX_INLINED_INSTS;
+	Symbol p;
+
+	if (! fty->sig->hasProto || fty->sig->hasEllipsis)
+		return 0;
+	if (fty->bty->categ != VOID && ! IsScalarType(fty->bty))
+		return 0;
+
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (! IsScalarType(p->ty))
+			return 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->ty->size > MAX_INLINED_FRAME)
+			return 0;
+	}
+
+	if (fsym->inlined)
+		limit *= 4;
+	else if (fsym->sclass == TK_STATIC)
+		limit *= 2;
+	return size <= limit;
+}
+
+static void CopySymbol(InlineBody body, Symbol p)
+{
+	VariableSymbol v;
+
+	ALLOC(v);
+	*v = *AsVar(p);
+	v->ref = 0;
+	v->def = NULL;
+	v->next = NULL;
+	body->vars[v->no] = (Symbol)v;
+}
+
+/**
+ * Keep a copy of the body of fsym, the kept symbols are numbered by no.
+ */
+static void KeepBody(FunctionSymbol fsym)
+{
+	InlineBody body;
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int n;
+
+	ALLOC(body);
+	n = 0;
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = ++n;
+		body->nparam++;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable || p->kind == SK_Temp)
+			AsVar(p)->no = ++n;
+	}
+	body->nvar = n;
+	body->vars = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	body->params = body->vars + 1;
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		CopySymbol(body, p);
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable || p->kind == SK_Temp)
+			CopySymbol(body, p);
+	}
+
+	n = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = n++;
+	}
+	body->nblock = n;
+	body->blocks = HeapAllocate(CurrentHeap, n * sizeof(BBlock));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		body->blocks[bb->no] = CreateBBlock();
+		body->blocks[bb->no]->no = bb->no;
+	}
+
+	Blocks = body->blocks;
+	Vars = body->vars;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		CurrentBB = Blocks[bb->no];
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			AppendInst(CopyInst(inst, KeepOperand));
+		}
+	}
+	body->size = SizeOf(fsym);
+
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable || p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+	fsym->body = body;
+}
+
+static int IsCallable(IRInst call, InlineBody body)
+{
+	Vector args = (Vector)call->opds[2];
+	ILArg arg;
+	Type ty;
+	int i;
+
+	if (LEN(args) != body->nparam)
+		return 0;
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		ty = body->params[i]->ty;
+		// a char or short argument is passed as int, see CheckArgument()
+		if (TypeCode(arg->ty) != TypeCode(ty->categ < INT ? T(INT) : ty))
+			return 0;
+	}
+	return 1;
+}
+
+/**
+	A char or short argument is extended to int by the caller, see
+	CheckArgument().   The temporary holding the value before the
+	extension is passed as it is:
+		t0 = (char)t9;
+		t1 = (int)(char)t0;
+		f(t1);				----- c.2 = t0;
+ */
+static Symbol NarrowArgument(Type ty, Symbol arg)
+{
+	ValueDef def;
+	Symbol t;
+	int op;
+
+	if (arg->kind == SK_Temp && (def = AsVar(arg)->def) != NULL)
+	{
+		op = def->op;
+		if ((op == EXTI1 || op == EXTU1 || op == EXTI2 || op == EXTU2) &&
+		    def->src1->kind == SK_Temp && TypeCode(def->src1->ty) == TypeCode(ty))
+			return def->src1;
+	}
+	t = CreateTemp(ty);
+	GenerateAssign(ty, t, ty->size == 1 ? TRUI1 : TRUI2, arg, NULL);
+	return t;
+}
+
+/**
+	Replace call in bb by a copy of the kept body, return the block
+	of the instructions after the call.
+ */
+static BBlock InlineCall(BBlock bb, IRInst call, InlineBody body)
+{
+	BBlock next = bb->next, restBB;
+	Vector args = (Vector)call->opds[2];
+	Symbol recv = call->opds[0], p;
+	IRInst inst, copy;
+	ILArg arg;
+	int i;
+
+	// the instructions after the call are moved to restBB
+	restBB = CreateBBlock();
+	if (call->next != &bb->insth)
+	{
+		restBB->insth.next = call->next;
+		restBB->insth.prev = bb->insth.prev;
+		restBB->insth.next->prev = restBB->insth.prev->next = &restBB->insth;
+		for (inst = restBB->insth.next; inst != &restBB->insth; inst = inst->next)
+		{
+			restBB->ninst++;
+		}
+	}
+	bb->insth.prev = call->prev;
+	call->prev->next = &bb->insth;
+	bb->ninst -= restBB->ninst + 1;
+
+	call->opds[1]->ref--;
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		arg->sym->ref--;
+	}
+	if (recv != NULL)
+	{
+		recv->ref--;
+		AsVar(recv)->def = NULL;
+	}
+
+	// the arguments are assigned to the new parameters
+	Vars = HeapAllocate(CurrentHeap, (body->nvar + 1) * sizeof(Symbol));
+	memset(Vars, 0, (body->nvar + 1) * sizeof(Symbol));
+	CurrentBB = bb;
+	for (i = 0; i < body->nparam; i++)
+	{
+		if (body->params[i]->ref == 0)
+			continue;
+		p = NewSymbol(body->params[i]);
+		arg = GET_ITEM(args, i);
+		if (p->ty->categ < INT)
+		{
+			GenerateMove(p->ty, p, NarrowArgument(p->ty, arg->sym));
+		}
+		else
+		{
+			GenerateMove(p->ty, p, arg->sym);
+		}
+	}
+
+	Blocks = HeapAllocate(CurrentHeap, body->nblock * sizeof(BBlock));
+	for (i = 0; i < body->nblock; i++)
+	{
+		Blocks[i] = CreateBBlock();
+	}
+	for (i = 0; i < body->nblock; i++)
+	{
+		StartBBlock(Blocks[i]);
+		for (inst = body->blocks[i]->insth.next; inst != &body->blocks[i]->insth; inst = inst->next)
+		{
+			copy = CopyInst(inst, NewOperand);
+			if (copy->opcode == CALL && copy->opds[1]->kind == SK_Function)
+			{
+				copy->opds[1]->ref++;
+			}
+			else if (copy->opcode == RET)
+			{
+				// return t;	----->	recv = t;
+				if (recv == NULL)
+				{
+					copy->opds[0]->ref--;
+					continue;
+				}
+				copy->ty = recv->ty;
+				copy->opcode = MOV;
+				copy->opds[1] = copy->opds[0];
+				copy->opds[0] = recv;
+				recv->ref++;
+			}
+			AppendInst(copy);
+			DefineCopy(copy);
+		}
+	}
+	// the exit block of the copy falls through
+	StartBBlock(restBB);
+	restBB->next = next;
+	if (next != NULL)
+		next->prev = restBB;
+
+	return restBB;
+}
+
+static InlineBody FindBody(IRInst call)
+{
+	Symbol f = call->opds[1];
+
+	if (f->kind != SK_Function || AsFunc(f)->body == NULL || ! IsCallable(call, AsFunc(f)->body))
+		return NULL;
+
+	return AsFunc(f)->body;
+}
+
+/**
+	Inline the calls of the functions whose bodies are kept, then keep the
+	body of fsym if it is small.   The CFG is drawn again if a call is inlined.
+ */
+void InlineCalls(FunctionSymbol fsym)
+{
+	InlineBody body;
+	BBlock bb;
+	IRInst inst;
+	int size = SizeOf(fsym), inlined = 0;
+
+	bb = fsym->entryBB;
+	while (bb != NULL)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->opcode == CALL && (body = FindBody(inst)) != NULL && size + body->size <= MAX_CALLER_INSTS)
+				break;
+		}
+		if (inst == &bb->insth)
+		{
+			bb = bb->next;
+			continue;
+		}
+		// the calls in the copy are not inlined again
+		size += body->size;
+		bb = InlineCall(bb, inst, body);
+		inlined = 1;
+	}
+	if (inlined)
+		RebuildCFG(fsym);
+
+	size = SizeOf(fsym);
+	if (IsInlinable(fsym, size))
+		KeepBody(fsym);
+}
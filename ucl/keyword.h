@@ -8,6 +8,9 @@ struct keyword
 static struct keyword keywords_[] = 
 {
 	{"__int64", 0, TK_INT64},
+	{"__inline", 8, TK_INLINE},
+	{"__restrict", 10, TK_RESTRICT},
+	{"__restrict__", 12, TK_RESTRICT},
 	{NULL,      0, TK_ID}
 };
 
@@ -68,9 +71,10 @@ static struct keyword keywordsH[] =
 
 static struct keyword keywordsI[] = 
 {
-	{"if",  2, TK_IF},
-	{"int", 3, TK_INT},
-	{NULL,  0, TK_ID}
+	{"if",     2, TK_IF},
+	{"inline", 6, TK_INLINE},
+	{"int",    3, TK_INT},
+	{NULL,     0, TK_ID}
 };
 
 static struct keyword keywordsJ[] = 
@@ -117,6 +121,7 @@ static struct keyword keywordsQ[] =
 static struct keyword keywordsR[] = 
 {
 	{"register", 8, TK_REGISTER},
+	{"restrict", 8, TK_RESTRICT},
 	{"return",   6, TK_RETURN},
 	{NULL,       0, TK_ID}
 };
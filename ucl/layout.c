@@ -0,0 +1,489 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Basic block placement.
+
+	The blocks are put in chains, the edge from the end of a chain to the
+	beginning of another one joins them, the heavier edges are tried first.
+	A block falls through to the next one in its chain:
+
+		BB1:							BB1:
+			if (t0 == 0) goto BB3;			if (t0 != 0) goto BB4;
+		BB2:							BB3:
+			goto BB4;		------->		t1 = t0 + 1;
+		BB3:								...
+			t1 = t0 + 1;				BB4:
+			...								...
+		BB4:
+			...
+
+	A conditional jump to the next block is negated, a block which doesn't
+	fall through to its old successor any more jumps to it.   There is no
+	profile, the weight of an edge is the frequency of its source times
+	its probability, see ComputeFrequencies().   The probability of a
+	conditional jump is guessed by the heuristics of Ball and Larus, the
+	first one which tells its successors apart is used:
+		loop branch:	the back edge of a loop is taken
+		loop exit:		the edge leaving a loop isn't taken
+		return:			the successor returning isn't reached
+		opcode:			a == b and a == 0 are false
+	The entry block stays the first one, the last block stays at the end,
+	the epilogue follows it.   See -fno-reorder-blocks.
+
+	The blocks are placed after the registers are allocated, see
+	EmitFunction().   The live range of a temporary is numbered in the
+	order of the source then, a block moved far from its predecessor
+	doesn't make the ranges longer.
+ */
+
+// reorder the basic blocks, see -fno-reorder-blocks
+int ReorderBlocks = 1;
+
+// a loop is guessed to run LOOP_FREQ times every time it is entered
+#define LOOP_FREQ  8
+
+typedef struct layoutEdge
+{
+	BBlock src;
+	BBlock dst;
+	double weight;
+	int fall;
+} *LayoutEdge;
+
+static BBlock *Blocks;
+static int NumBlocks;
+// the old successor which bb falls through to, or NULL
+static BBlock *Fall;
+// the next block in chain, and the chain of bb, Chains[bb->no] is the no of its first block
+static BBlock *Next;
+static int *Chains;
+// the probability in percent that the conditional jump ending bb is taken
+static int *Taken;
+// the number of times bb is executed, the entry block is executed once
+static double *Freq;
+// the blocks which only jump and aren't reached any more, see SkipJumps()
+static int *Skipped;
+// the position of bb in reverse postorder, and the blocks in reverse postorder
+static int *Order;
+static BBlock *Sorted;
+
+/**
+ * A back edge goes to a block not after its source in reverse postorder,
+ * it closes a cycle, also a cycle entered at more than one block.
+ */
+static int IsBackEdge(BBlock src, BBlock dst)
+{
+	return Order[dst->no] <= Order[src->no];
+}
+
+static int IsLoopExit(BBlock src, BBlock dst)
+{
+	return src->loop != NULL && ! InLoop(src->loop, dst);
+}
+
+static int IsReturning(BBlock bb)
+{
+	IRInst inst;
+
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+	{
+		if (inst->opcode == RET)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Number the blocks reached from the entry in reverse postorder, by depth-first search
+ */
+static void SortBlocks(void)
+{
+	BBlock bb, *stack;
+	CFGEdge *succ, edge;
+	int i, top, n;
+
+	stack = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	succ = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(CFGEdge));
+	for (i = 0; i < NumBlocks; i++)
+	{
+		// not reached, e.g. the exit block after an endless loop
+		Order[i] = NumBlocks;
+		Sorted[i] = NULL;
+	}
+
+	n = 0;
+	Order[0] = -1;
+	top = 0;
+	stack[top++] = Blocks[0];
+	succ[0] = Blocks[0]->succs;
+	while (top != 0)
+	{
+		bb = stack[top - 1];
+		if (succ[bb->no] == NULL)
+		{
+			top--;
+			Sorted[n++] = bb;
+			continue;
+		}
+		edge = succ[bb->no];
+		succ[bb->no] = edge->next;
+		if (Order[edge->bb->no] == NumBlocks)
+		{
+			Order[edge->bb->no] = -1;
+			succ[edge->bb->no] = edge->bb->succs;
+			stack[top++] = edge->bb;
+		}
+	}
+	// Sorted[] is in postorder now
+	for (i = 0; i < n / 2; i++)
+	{
+		bb = Sorted[i];
+		Sorted[i] = Sorted[n - 1 - i];
+		Sorted[n - 1 - i] = bb;
+	}
+	for (i = 0; i < n; i++)
+	{
+		Order[Sorted[i]->no] = i;
+	}
+}
+
+/**
+ * The probability in percent that the conditional jump at the end of bb is taken
+ */
+static int TakenProbability(BBlock bb)
+{
+	IRInst lasti = bb->insth.prev;
+	BBlock taken = (BBlock)lasti->opds[0];
+	BBlock fall = Fall[bb->no];
+
+	if (IsBackEdge(bb, taken) != IsBackEdge(bb, fall))
+		return IsBackEdge(bb, taken) ? 88 : 12;
+	if (IsLoopExit(bb, taken) != IsLoopExit(bb, fall))
+		return IsLoopExit(bb, taken) ? 20 : 80;
+	if (IsReturning(taken) != IsReturning(fall))
+		return IsReturning(taken) ? 28 : 72;
+	if (lasti->opcode == JZ || lasti->opcode == JE)
+		return 16;
+	if (lasti->opcode == JNZ || lasti->opcode == JNE)
+		return 84;
+
+	return 50;
+}
+
+/**
+ * The probability that src goes to its successor dst
+ */
+static double EdgeProbability(BBlock src, BBlock dst)
+{
+	IRInst lasti = src->insth.prev;
+
+	if (lasti->opcode >= JZ && lasti->opcode <= JLE && (BBlock)lasti->opds[0] != Fall[src->no])
+		return ((BBlock)lasti->opds[0] == dst ? Taken[src->no] : 100 - Taken[src->no]) / 100.0;
+	if (lasti->opcode == IJMP)
+		return 1.0 / src->nsucc;
+
+	return 1.0;
+}
+
+/**
+	The frequency of a block is the sum of the frequencies of the edges
+	coming into it, except the back edges, the frequency of an edge is
+	the frequency of its source times its probability.   The target of
+	a back edge is executed LOOP_FREQ times as often as the cycle is
+	entered.   The sources of the edges other than back edges come first
+	in reverse postorder.
+ */
+static void ComputeFrequencies(void)
+{
+	BBlock bb;
+	CFGEdge edge;
+	int i, loop;
+
+	for (i = 0; i < NumBlocks; i++)
+	{
+		Freq[i] = 0;
+	}
+	Freq[0] = 1;
+	for (i = 0; i < NumBlocks && Sorted[i] != NULL; i++)
+	{
+		bb = Sorted[i];
+		loop = 0;
+		for (edge = bb->preds; edge != NULL; edge = edge->next)
+		{
+			if (IsBackEdge(edge->bb, bb))
+				loop = 1;
+			else
+				Freq[bb->no] += Freq[edge->bb->no] * EdgeProbability(edge->bb, bb);
+		}
+		if (loop)
+			Freq[bb->no] *= LOOP_FREQ;
+	}
+}
+
+static void AddEdge(Vector edges, BBlock src, BBlock dst, int fall)
+{
+	LayoutEdge e;
+
+	if (dst == Blocks[0] || dst == src)
+		return;
+
+	ALLOC(e);
+	e->src = src;
+	e->dst = dst;
+	e->weight = Freq[src->no] * EdgeProbability(src, dst);
+	e->fall = fall;
+	INSERT_ITEM(edges, e);
+}
+
+/**
+ * The heavier edge first, the fall-through and the earlier block first if equal
+ */
+static int CompareWeight(const void *p1, const void *p2)
+{
+	LayoutEdge e1 = *(LayoutEdge *)p1;
+	LayoutEdge e2 = *(LayoutEdge *)p2;
+
+	if (e1->weight != e2->weight)
+		return e1->weight < e2->weight ? 1 : -1;
+	if (e1->fall != e2->fall)
+		return e2->fall - e1->fall;
+
+	return e1->src->no != e2->src->no ? e1->src->no - e2->src->no : e1->dst->no - e2->dst->no;
+}
+
+/**
+	A conditional jump over a block which only jumps is negated:
+
+		if (t0 < t1) goto BB3;			if (t0 >= t1) goto BB9;
+	BB2:							BB2:
+		goto BB9;		------->		----- not reached
+	BB3:							BB3:
+
+	BB3 is the successor which bb falls through to then, wherever the
+	blocks are placed.   The block skipped is deleted by RebuildCFG().
+ */
+static void SkipJumps(void)
+{
+	BBlock bb, jbb;
+	IRInst lasti, jmp;
+	int i, op;
+
+	for (i = 0; i < NumBlocks; i++)
+	{
+		bb = Blocks[i];
+		lasti = bb->insth.prev;
+		jbb = Fall[i];
+		if (lasti->opcode < JZ || lasti->opcode > JLE || jbb == NULL || (BBlock)lasti->opds[0] == jbb)
+			continue;
+
+		jmp = jbb->insth.next;
+		if (jmp->opcode != JMP || jmp->next != &jbb->insth || (BBlock)jmp->opds[0] == jbb ||
+		    jbb->npred != 1 || (op = NegateJump(lasti)) == 0)
+			continue;
+
+		lasti->opcode = op;
+		Fall[i] = (BBlock)lasti->opds[0];
+		lasti->opds[0] = jmp->opds[0];
+		Taken[i] = 100 - Taken[i];
+		Skipped[jbb->no] = 1;
+	}
+}
+
+/**
+	The edges which save a jump when their ends are put together: the
+	jump, the fall-through and the jump taken by a conditional jump which
+	can be negated, except a back edge.   The last block is never
+	followed by another one.
+ */
+static Vector CollectEdges(void)
+{
+	Vector edges = CreateVector(NumBlocks * 2);
+	BBlock bb, fall;
+	IRInst lasti;
+	int i;
+
+	for (i = 0; i < NumBlocks - 1; i++)
+	{
+		bb = Blocks[i];
+		if (Skipped[i])
+			continue;
+		lasti = bb->insth.prev;
+		fall = Fall[i];
+		if (lasti->opcode == JMP)
+		{
+			AddEdge(edges, bb, (BBlock)lasti->opds[0], 0);
+		}
+		else if (lasti->opcode >= JZ && lasti->opcode <= JLE && (BBlock)lasti->opds[0] != fall)
+		{
+			AddEdge(edges, bb, fall, 1);
+			// the loop is tested at its bottom, see RotateLoops()
+			if (NegateJump(lasti) != 0 && ! IsBackEdge(bb, (BBlock)lasti->opds[0]))
+				AddEdge(edges, bb, (BBlock)lasti->opds[0], 0);
+		}
+		else if (fall != NULL)
+		{
+			AddEdge(edges, bb, fall, 1);
+		}
+	}
+	qsort(edges->data, LEN(edges), sizeof(LayoutEdge), CompareWeight);
+
+	return edges;
+}
+
+static void BuildChains(Vector edges)
+{
+	LayoutEdge e;
+	BBlock bb;
+	int i, chain;
+
+	for (i = 0; i < NumBlocks; i++)
+	{
+		Next[i] = NULL;
+		Chains[i] = i;
+	}
+	for (i = 0; i < LEN(edges); i++)
+	{
+		e = GET_ITEM(edges, i);
+		// e->src ends a chain, e->dst begins another one
+		if (Next[e->src->no] != NULL || Chains[e->dst->no] != e->dst->no ||
+		    Chains[e->src->no] == e->dst->no)
+			continue;
+		// the other chains can't be put between the entry block and the last block
+		if (Chains[e->src->no] == 0 && Chains[e->dst->no] == Chains[NumBlocks - 1])
+			continue;
+
+		Next[e->src->no] = e->dst;
+		chain = Chains[e->src->no];
+		for (bb = e->dst; bb != NULL; bb = Next[bb->no])
+		{
+			Chains[bb->no] = chain;
+		}
+	}
+}
+
+/**
+	Link the blocks chain by chain, the chains in the order of their first
+	blocks, except that the chain of the last block is put at the end.
+ */
+static void PlaceChains(FunctionSymbol fsym)
+{
+	BBlock bb, prev, last;
+	int i, lastChain;
+
+	last = Blocks[NumBlocks - 1];
+	lastChain = Chains[last->no];
+	prev = NULL;
+	for (i = 0; i <= NumBlocks; i++)
+	{
+		if (i < NumBlocks && (Chains[i] != i || i == lastChain))
+			continue;
+
+		for (bb = Blocks[i < NumBlocks ? i : lastChain]; bb != NULL; bb = Next[bb->no])
+		{
+			bb->prev = prev;
+			if (prev != NULL)
+				prev->next = bb;
+			prev = bb;
+		}
+	}
+	prev->next = NULL;
+	fsym->entryBB = Blocks[0];
+}
+
+/**
+	A conditional jump to the next block is negated to jump to its old
+	fall-through, a block not followed by its old fall-through jumps to it.
+ */
+static void FixJumps(void)
+{
+	BBlock bb, fall, jbb;
+	IRInst lasti;
+	int i, op;
+
+	for (i = 0; i < NumBlocks; i++)
+	{
+		bb = Blocks[i];
+		fall = Fall[i];
+		if (fall == NULL || bb->next == fall)
+			continue;
+
+		lasti = bb->insth.prev;
+		if (lasti->opcode >= JZ && lasti->opcode <= JLE)
+		{
+			if ((BBlock)lasti->opds[0] == bb->next && (op = NegateJump(lasti)) != 0)
+			{
+				lasti->opcode = op;
+				lasti->opds[0] = (Symbol)fall;
+				continue;
+			}
+			// if (...) goto BB1; goto BB2;
+			jbb = CreateBBlock();
+			jbb->sym = CreateLabel();
+			jbb->prev = bb;
+			jbb->next = bb->next;
+			if (bb->next != NULL)
+				bb->next->prev = jbb;
+			bb->next = jbb;
+			CurrentBB = jbb;
+		}
+		else
+		{
+			CurrentBB = bb;
+		}
+		GenerateJump(fall);
+	}
+}
+
+/**
+	Reorder the blocks of fsym to make the likely successor of a block
+	follow it, the CFG is drawn again.
+ */
+void LayoutBlocks(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst lasti;
+	int i;
+
+	if (! ReorderBlocks || fsym->entryBB->next == NULL)
+		return;
+
+	ComputeDominators(fsym);
+	FindLoops(fsym);
+
+	NumBlocks = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		NumBlocks++;
+	}
+	Blocks = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	Fall = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	Next = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	Chains = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+	Taken = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+	Freq = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(double));
+	Skipped = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+	Order = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+	Sorted = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	memset(Skipped, 0, (NumBlocks + 1) * sizeof(int));
+	for (i = 0, bb = fsym->entryBB; bb != NULL; i++, bb = bb->next)
+	{
+		Blocks[i] = bb;
+		lasti = bb->insth.prev;
+		Fall[i] = lasti->opcode != JMP && lasti->opcode != IJMP ? bb->next : NULL;
+	}
+
+	SortBlocks();
+	for (i = 0; i < NumBlocks; i++)
+	{
+		lasti = Blocks[i]->insth.prev;
+		if (lasti->opcode >= JZ && lasti->opcode <= JLE)
+			Taken[i] = Fall[i] != NULL ? TakenProbability(Blocks[i]) : 50;
+	}
+	ComputeFrequencies();
+	SkipJumps();
+	BuildChains(CollectEdges());
+	PlaceChains(fsym);
+	FixJumps();
+	RebuildCFG(fsym);
+}
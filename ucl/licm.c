@@ -0,0 +1,292 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Loop-invariant code motion on the SSA form.
+
+	An instruction in a loop whose operands are defined outside the loop,
+	or by the instructions already moved, computes the same value in every
+	iteration, it is moved to the end of the preheader:
+
+		int a[100], b[100];					t1 :&a;				----- preheader
+		void f(int n, int k){				t4 : t13 << 2;
+			int i;							t5 :&b;
+			for (i = 0; i < n; i++)			t6 : t5 + t4;
+				a[i] = b[k] + i;			goto BB2;
+		}								BB1:
+												t0 : t16 << 2;
+												t2 : t1 + t0;
+												t7 :*t6;
+												...
+
+	A loop without calls can't change a memory variable it doesn't assign,
+	or store into through a pointer which may point to it, see MayAlias(),
+	such a variable is read once in the preheader.
+	The instruction moved is executed even if it isn't reached in the loop,
+	so it must have no side effect and can't trap, a division is moved
+	only when the divisor is a constant other than 0, a load through a
+	pointer is never moved.   In a loop with calls, an address isn't moved,
+	it is formed again by one or two instructions, while the value kept
+	across the calls takes a callee-saved register.   The inner loops are
+	done first, an instruction may be moved out of several loops.
+ */
+
+typedef struct load
+{
+	Symbol var;
+	Symbol temp;
+	struct load *link;
+} *Load;
+
+// the block defining temporary t, DefBBs[AsVar(t)->no]
+static BBlock *DefBBs;
+static int NumTemps, MaxTemps;
+static Loop CurLoop;
+// the memory variables read once before CurLoop
+static Load Loads;
+// the memory variables assigned in CurLoop
+static Vector Written;
+// the indirect stores in CurLoop
+static Vector Stores;
+// set when CurLoop has a call
+static int HasCall;
+
+static Symbol BaseOf(Symbol p)
+{
+	return p->kind == SK_Offset ? p->link : p;
+}
+
+/**
+ * Return 1 if p1 and p2 share some bytes, two fields of a record may not.
+ */
+static int Overlaps(Symbol p1, Symbol p2)
+{
+	int off1, off2;
+
+	if (BaseOf(p1) != BaseOf(p2))
+		return 0;
+	if (p1->kind != SK_Offset || p2->kind != SK_Offset)
+		return 1;
+
+	off1 = AsVar(p1)->offset;
+	off2 = AsVar(p2)->offset;
+	return off1 < off2 + p2->ty->size && off2 < off1 + p1->ty->size;
+}
+
+static int IsWritten(Symbol p)
+{
+	struct memRef ref;
+	int i;
+
+	for (i = 0; i < LEN(Written); i++)
+	{
+		if (Overlaps(GET_ITEM(Written, i), p))
+			return 1;
+	}
+	ObjectRef(&ref, p, p->ty->size);
+	for (i = 0; i < LEN(Stores); i++)
+	{
+		if (MayAlias(GET_ITEM(Stores, i), &ref))
+			return 1;
+	}
+	return 0;
+}
+
+static void FindWrites(IRInst inst)
+{
+	int op = inst->opcode;
+	Symbol dst = inst->opds[0];
+	MemRef ref;
+
+	if (op == CALL)
+	{
+		HasCall = 1;
+	}
+	else if (op == IMOV)
+	{
+		ALLOC(ref);
+		IndirectRef(ref, inst->ty, dst);
+		INSERT_ITEM(Stores, ref);
+	}
+	else if ((op <= SELZ || (op >= ADDR && op <= MOV) || op == INC || op == DEC || op == CLR) && dst->kind != SK_Temp)
+	{
+		// c = t1;  c : (char)(int)t2;  c : a + 1;
+		INSERT_ITEM(Written, dst);
+	}
+}
+
+/**
+ * Replace the read of a memory variable by the temporary loaded in the preheader.
+ */
+static void ReplaceLoad(Symbol *opd, int def)
+{
+	IRInst inst;
+	Load ld;
+
+	if (def || ! IsMemoryScalar(*opd) || IsWritten(*opd))
+		return;
+
+	for (ld = Loads; ld != NULL; ld = ld->link)
+	{
+		if (ld->var == *opd)
+			break;
+	}
+	if (ld == NULL)
+	{
+		if (NumTemps == MaxTemps)
+			return;
+		ALLOC(ld);
+		ld->var = *opd;
+		ld->temp = CreateTemp((*opd)->ty);
+		AsVar(ld->temp)->no = ++NumTemps;
+		DefBBs[NumTemps] = CurLoop->preheader;
+		ld->link = Loads;
+		Loads = ld;
+
+		ALLOC(inst);
+		inst->ty = (*opd)->ty;
+		inst->opcode = MOV;
+		inst->opds[0] = ld->temp;
+		inst->opds[1] = *opd;
+		inst->opds[2] = NULL;
+		InsertBeforeJump(CurLoop->preheader, inst);
+	}
+	*opd = ld->temp;
+}
+
+static int IsInvariant(Symbol p)
+{
+	if (p == NULL || p->kind == SK_Constant || p->kind == SK_Function || p->kind == SK_String)
+		return 1;
+	if (! IsNumbered(p))
+		return 0;
+
+	return DefBBs[AsVar(p)->no] == NULL || ! InLoop(CurLoop, DefBBs[AsVar(p)->no]);
+}
+
+/**
+ * An instruction computing a loop-invariant value, which is safe to execute early.
+ */
+static int IsHoistable(IRInst inst)
+{
+	int op = inst->opcode;
+	Symbol divisor = inst->opds[2];
+
+	if (! IsNumbered(inst->opds[0]))
+		return 0;
+	if (op == ADDR)
+		return ! HasCall;
+	if (op == DIV || op == MOD)
+	{
+		if (divisor->kind != SK_Constant || IsRealType(divisor->ty) || divisor->val.i[0] == 0)
+			return 0;
+	}
+	if (op > SELZ && (op < EXTI1 || op > CVTF8U4) && op != MOV)
+		return 0;
+
+	return IsInvariant(inst->opds[1]) && IsInvariant(inst->opds[2]);
+}
+
+static int ComparePre(const void *p1, const void *p2)
+{
+	return (*(BBlock *)p1)->pre - (*(BBlock *)p2)->pre;
+}
+
+static void HoistLoop(Loop loop)
+{
+	BBlock bb, *blocks;
+	IRInst inst, next;
+	int i, n = LEN(loop->blocks);
+
+	CurLoop = loop;
+	Loads = NULL;
+	Written = CreateVector(4);
+	Stores = CreateVector(4);
+	HasCall = 0;
+
+	// a definition dominates its uses, it is visited first in the preorder of the dominator tree
+	blocks = HeapAllocate(CurrentHeap, n * sizeof(BBlock));
+	for (i = 0; i < n; i++)
+	{
+		blocks[i] = GET_ITEM(loop->blocks, i);
+		for (inst = blocks[i]->insth.next; inst != &blocks[i]->insth; inst = inst->next)
+		{
+			FindWrites(inst);
+		}
+	}
+	qsort(blocks, n, sizeof(BBlock), ComparePre);
+
+	for (i = 0; i < n; i++)
+	{
+		bb = blocks[i];
+		for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+		{
+			next = inst->next;
+			if (! HasCall)
+				VisitOperands(inst, ReplaceLoad);
+			if (! IsHoistable(inst))
+				continue;
+
+			RemoveInst(bb, inst);
+			InsertBeforeJump(loop->preheader, inst);
+			DefBBs[AsVar(inst->opds[0])->no] = loop->preheader;
+		}
+	}
+}
+
+static void VisitDef(Symbol *opd, int def)
+{
+	if (def && IsNumbered(*opd))
+		DefBBs[AsVar(*opd)->no] = CurrentBB;
+}
+
+void HoistLoopInvariants(FunctionSymbol fsym)
+{
+	Vector loops;
+	Loop loop;
+	IRInst inst;
+	Symbol p;
+	BBlock bb;
+	int i, n;
+
+	loops = InsertPreheaders(fsym);
+	if (LEN(loops) == 0)
+		return;
+
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) ? ++n : 0;
+	}
+	NumTemps = n;
+	// an instruction reads two memory variables at most
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		n += 2 * bb->ninst;
+	}
+	MaxTemps = n;
+	SetupAlias(fsym, NumTemps);
+	DefBBs = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	memset(DefBBs, 0, (n + 1) * sizeof(BBlock));
+	for (CurrentBB = fsym->entryBB; CurrentBB != NULL; CurrentBB = CurrentBB->next)
+	{
+		for (inst = CurrentBB->insth.next; inst != &CurrentBB->insth; inst = inst->next)
+		{
+			VisitOperands(inst, VisitDef);
+		}
+	}
+
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		if (loop->preheader != NULL)
+			HoistLoop(loop);
+	}
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+}
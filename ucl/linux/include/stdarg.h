@@ -2,6 +2,8 @@
 #define __STDARG_H_
 
 #define ALIGN_INT(n)	((sizeof(n) + sizeof(int) - 1) & ~(sizeof(int) - 1))
+/* a variadic double starts at an 8-byte aligned word */
+#define ALIGN_ARG(t)	(sizeof(t) > sizeof(int) ? 2 * sizeof(int) : sizeof(int))
 
 #if !defined(_VA_LIST) && !defined(__VA_LIST_DEFINED)
 
@@ -14,7 +16,7 @@ typedef char *__va_list;
 typedef __va_list va_list;
 
 #define va_start(list, start) (list = (va_list)&start + ALIGN_INT(start))
-#define va_arg(list, t) (*(t *)((list += ALIGN_INT(t)) - ALIGN_INT(t))) 
+#define va_arg(list, t) (*(t *)((list = (va_list)(((unsigned)list + ALIGN_ARG(t) - 1) & ~(ALIGN_ARG(t) - 1)) + ALIGN_INT(t)) - ALIGN_INT(t)))
 #define va_end(list) (list = (va_list)0)
 
 typedef void *__gnuc_va_list;
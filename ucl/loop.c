@@ -0,0 +1,338 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Natural loops.
+	An edge t -> h is a back edge when h dominates t.   The natural loop of
+	the back edge is h and the blocks reaching t without going through h,
+	the loops of all the back edges to h are one loop.
+
+		int sum(int *a, int n){			function sum
+			int i, s = 0;					t3 = 0;				----- preheader
+			for(i = 0; i < n; i++)			t13 = 0;
+				s += a[i];					goto BB5;
+			return s;					BB4:					----- depth 1
+		}									t0 : t13 << 2;
+											...
+											++t13;
+										BB5:					----- header, depth 1
+											if (t13 < t7) goto BB4;
+
+	Two natural loops are disjoint, or one contains the other.
+	bb->loop is the innermost loop containing bb, bb->depth is the number
+	of the loops containing bb.   A cycle entered at more than one block
+	(irreducible) has no header dominating it, it isn't a loop here.
+	The dominator tree must be computed before, see ComputeDominators().
+ */
+
+static int CompareSize(const void *p1, const void *p2)
+{
+	Loop l1 = *(Loop *)p1;
+	Loop l2 = *(Loop *)p2;
+
+	return LEN(l1->blocks) - LEN(l2->blocks);
+}
+
+/**
+ * Return 1 if loop contains bb.
+ */
+int InLoop(Loop loop, BBlock bb)
+{
+	Loop l;
+
+	for (l = bb->loop; l != NULL; l = l->parent)
+	{
+		if (l == loop)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+	The only predecessor of the header outside the loop, when the loop
+	is its only successor.   The instructions put at its end are executed
+	once before the loop.
+ */
+static BBlock FindPreheader(Loop loop)
+{
+	BBlock bb = NULL;
+	CFGEdge pred;
+
+	for (pred = loop->header->preds; pred != NULL; pred = pred->next)
+	{
+		if (InLoop(loop, pred->bb))
+			continue;
+		if (bb != NULL)
+			return NULL;
+		bb = pred->bb;
+	}
+	return bb != NULL && bb->nsucc == 1 ? bb : NULL;
+}
+
+/**
+	Find the natural loops of fsym, they are returned in a vector,
+	an inner loop comes before the loops containing it.
+ */
+Vector FindLoops(FunctionSymbol fsym)
+{
+	Vector loops = CreateVector(4);
+	BBlock bb, b, *stack;
+	CFGEdge pred, p;
+	Loop loop, outer;
+	int *mark;
+	int i, j, n, top;
+
+	n = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = n++;
+		bb->loop = NULL;
+		bb->depth = 0;
+	}
+	stack = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	mark = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	memset(mark, -1, (n + 1) * sizeof(int));
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		loop = NULL;
+		for (pred = bb->preds; pred != NULL; pred = pred->next)
+		{
+			if (bb->pre < 0 || pred->bb->pre < 0 || ! Dominates(bb, pred->bb))
+				continue;
+
+			if (loop == NULL)
+			{
+				CALLOC(loop);
+				loop->header = bb;
+				loop->blocks = CreateVector(8);
+				INSERT_ITEM(loop->blocks, bb);
+				mark[bb->no] = LEN(loops);
+				INSERT_ITEM(loops, loop);
+			}
+			if (mark[pred->bb->no] == LEN(loops) - 1)
+				continue;
+
+			// walk backward from the source of the back edge to the header
+			top = 0;
+			mark[pred->bb->no] = LEN(loops) - 1;
+			INSERT_ITEM(loop->blocks, pred->bb);
+			stack[top++] = pred->bb;
+			while (top != 0)
+			{
+				b = stack[--top];
+				for (p = b->preds; p != NULL; p = p->next)
+				{
+					if (p->bb->pre < 0 || mark[p->bb->no] == LEN(loops) - 1)
+						continue;
+					mark[p->bb->no] = LEN(loops) - 1;
+					INSERT_ITEM(loop->blocks, p->bb);
+					stack[top++] = p->bb;
+				}
+			}
+		}
+	}
+
+	// a loop is found after the smaller loops nested in it
+	qsort(loops->data, LEN(loops), sizeof(Loop), CompareSize);
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		for (j = 0; j < LEN(loop->blocks); j++)
+		{
+			bb = GET_ITEM(loop->blocks, j);
+			if (bb->loop == NULL)
+			{
+				bb->loop = loop;
+				continue;
+			}
+			for (outer = bb->loop; outer->parent != NULL; outer = outer->parent)
+				;
+			if (outer != loop)
+				outer->parent = loop;
+		}
+	}
+	for (i = LEN(loops) - 1; i >= 0; i--)
+	{
+		loop = GET_ITEM(loops, i);
+		loop->depth = loop->parent != NULL ? loop->parent->depth + 1 : 1;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		if (bb->loop != NULL)
+			bb->depth = bb->loop->depth;
+	}
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		loop->preheader = FindPreheader(loop);
+	}
+
+	return loops;
+}
+
+static void Retarget(BBlock bb, BBlock old, BBlock new)
+{
+	IRInst lasti = bb->insth.prev;
+	BBlock *dstBBs;
+	int i;
+
+	if (lasti->opcode >= JZ && lasti->opcode <= JMP)
+	{
+		if ((BBlock)lasti->opds[0] == old)
+			lasti->opds[0] = (Symbol)new;
+	}
+	else if (lasti->opcode == IJMP)
+	{
+		dstBBs = (BBlock *)lasti->opds[0];
+		for (i = 0; dstBBs[i] != NULL; i++)
+		{
+			if (dstBBs[i] == old)
+				dstBBs[i] = new;
+		}
+	}
+}
+
+/**
+	Put a new block ph in front of the header, the edges coming from
+	outside the loop go to ph:
+
+		BB1:							BB1:
+			if (t0 < 0) goto BB3;			if (t0 < 0) goto BB7;
+			...								...
+		BB2:							BB2:
+			...								...
+			goto BB3;	---------->			goto BB7;
+		BB3:							BB7:
+			t5 : phi(t1 BB1, t2 BB2,		t6 : phi(t1 BB1, t2 BB2);
+			         t4 BB5);			BB3:
+										t5 : phi(t6 BB7, t4 BB5);
+
+	When a block in the loop falls through to the header, ph is put after
+	a predecessor outside the loop which jumps to the header, and ph jumps
+	to the header; the jump is executed once before the loop.
+ */
+static int CreatePreheader(Loop loop)
+{
+	BBlock header = loop->header, ph, pos, outside = NULL;
+	IRInst inst, lasti, phi;
+	CFGEdge pred;
+	Vector args, outer;
+	PhiArg arg;
+	Symbol val;
+	int i, n, nout = 0;
+
+	pos = NULL;
+	for (pred = header->preds; pred != NULL; pred = pred->next)
+	{
+		if (InLoop(loop, pred->bb))
+			continue;
+		outside = pred->bb;
+		nout++;
+		if (pred->bb->insth.prev->opcode == JMP)
+			pos = pred->bb;
+	}
+	if (nout == 0)
+		return 0;
+
+	ph = CreateBBlock();
+	lasti = header->prev->insth.prev;
+	if (InLoop(loop, header->prev) && lasti->opcode != JMP && lasti->opcode != IJMP)
+	{
+		if (pos == NULL)
+			return 0;
+
+		ALLOC(inst);
+		inst->ty = T(VOID);
+		inst->opcode = JMP;
+		inst->opds[0] = (Symbol)header;
+		inst->opds[1] = inst->opds[2] = NULL;
+		InsertBeforeJump(ph, inst);
+	}
+	else
+	{
+		pos = header->prev;
+	}
+	ph->prev = pos;
+	ph->next = pos->next;
+	pos->next->prev = ph;
+	pos->next = ph;
+
+	for (pred = header->preds; pred != NULL; pred = pred->next)
+	{
+		if (! InLoop(loop, pred->bb))
+			Retarget(pred->bb, header, ph);
+	}
+
+	for (inst = header->insth.next; inst->opcode == PHI; inst = inst->next)
+	{
+		args = (Vector)inst->opds[1];
+		if (nout == 1)
+		{
+			for (i = 0; i < LEN(args); i++)
+			{
+				arg = GET_ITEM(args, i);
+				if (arg->bb == outside)
+					arg->bb = ph;
+			}
+			continue;
+		}
+
+		outer = CreateVector(nout);
+		val = NULL;
+		n = 0;
+		for (i = 0; i < LEN(args); i++)
+		{
+			arg = GET_ITEM(args, i);
+			if (InLoop(loop, arg->bb))
+			{
+				args->data[n++] = arg;
+				continue;
+			}
+			val = val == NULL || val == arg->sym ? arg->sym : inst->opds[0];
+			INSERT_ITEM(outer, arg);
+		}
+		args->len = n;
+
+		if (val == inst->opds[0])
+		{
+			ALLOC(phi);
+			phi->ty = inst->ty;
+			phi->opcode = PHI;
+			phi->opds[0] = val = CreateTemp(inst->opds[0]->ty);
+			phi->opds[1] = (Symbol)outer;
+			phi->opds[2] = NULL;
+			InsertBeforeJump(ph, phi);
+		}
+		ALLOC(arg);
+		arg->sym = val;
+		arg->bb = ph;
+		INSERT_ITEM(args, arg);
+	}
+
+	return 1;
+}
+
+/**
+	Find the natural loops of fsym and give every loop a preheader when it
+	is possible.   The dominator tree is computed again if the CFG is changed.
+ */
+Vector InsertPreheaders(FunctionSymbol fsym)
+{
+	Vector loops = FindLoops(fsym);
+	Loop loop;
+	int i, changed = 0;
+
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		if (loop->preheader == NULL)
+			changed |= CreatePreheader(loop);
+	}
+	if (changed)
+	{
+		ComputeDominators(fsym);
+		loops = FindLoops(fsym);
+	}
+	return loops;
+}
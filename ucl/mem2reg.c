@@ -0,0 +1,192 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Promote memory variables to registers (mem2reg).
+
+	A local variable or parameter whose address is never taken can only be
+	accessed by name, so it is replaced by a new temporary in every
+	instruction of the function. The temporaries are register candidates of
+	the register allocator (see regalloc.c), thus the variable no longer
+	has to be loaded from and stored to its stack slot on every access.
+
+		int sum(int *a, int n){
+			int i, s = 0;
+			for(i = 0; i < n; i++)
+				s += a[i];
+			return s;
+		}
+		------------------------------------
+		function sum
+			t5 = a;				----- the parameters are copied once at entry
+			t6 = n;
+			t7 = 0;				----- s = 0
+			t8 = 0;				----- i = 0
+			goto BB2;
+		BB1:
+			t0 = t8 * 4;
+			t1 = t5 + t0;
+			t2 = *t1;
+			t3 = t7 + t2;
+			t7 = t3;
+			t8++;
+		BB2:
+			if (t8 < t6) goto BB1;
+
+	Only scalar integers, pointers and floating-point values are promoted. Aggregates, volatile
+	and static variables, and the variables whose address is taken stay
+	in memory.
+ */
+
+// the temporary replacing a variable, Promoted[AsVar(p)->no]
+static Symbol *Promoted;
+
+static int IsPromotable(Symbol p)
+{
+	return p->kind == SK_Variable && ! p->addressed &&
+	       p->sclass != TK_STATIC && p->sclass != TK_EXTERN &&
+	       ! (p->ty->qual & VOLATILE) &&
+	       (IsRealType(p->ty) || ((IsIntegType(p->ty) || IsPtrType(p->ty)) && p->ty->size <= 4));
+}
+
+static Symbol Rename(Symbol p)
+{
+	if (p != NULL && p->kind == SK_Variable && AsVar(p)->no != 0)
+		return Promoted[AsVar(p)->no];
+
+	return p;
+}
+
+static void RenameOperands(IRInst inst)
+{
+	Vector args;
+	ILArg arg;
+	int i;
+
+	switch (inst->opcode)
+	{
+	case JMP:
+	case NOP:
+		return;
+
+	case IJMP:
+		// DST is the array of target basic blocks
+		inst->opds[1] = Rename(inst->opds[1]);
+		return;
+
+	case CALL:
+		inst->opds[0] = Rename(inst->opds[0]);
+		inst->opds[1] = Rename(inst->opds[1]);
+		args = (Vector)inst->opds[2];
+		for (i = 0; i < LEN(args); i++)
+		{
+			arg = GET_ITEM(args, i);
+			arg->sym = Rename(arg->sym);
+		}
+		return;
+
+	default:
+		// DST of branch is the target basic block
+		if (inst->opcode < JZ || inst->opcode > JLE)
+			inst->opds[0] = Rename(inst->opds[0]);
+		inst->opds[1] = Rename(inst->opds[1]);
+		inst->opds[2] = Rename(inst->opds[2]);
+	}
+}
+
+/**
+ * Copy parameter p into its temporary, after instruction pos of the entry block
+ */
+static IRInst InsertParamCopy(BBlock bb, IRInst pos, Symbol p)
+{
+	Symbol t = Promoted[AsVar(p)->no];
+	IRInst inst;
+
+	ALLOC(inst);
+	inst->ty = p->ty;
+	inst->opcode = MOV;
+	inst->opds[0] = t;
+	inst->opds[1] = p;
+	inst->opds[2] = NULL;
+	t->ref++;
+	p->ref = 1;
+
+	inst->next = pos->next;
+	inst->prev = pos;
+	pos->next->prev = inst;
+	pos->next = inst;
+	bb->ninst++;
+
+	return inst;
+}
+
+void PromoteVariables(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+	Symbol p, t;
+	int n;
+
+	n = 0;
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = IsPromotable(p) && p->ref > 0 ? ++n : 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable)
+			AsVar(p)->no = IsPromotable(p) && p->ref > 0 ? ++n : 0;
+	}
+	if (n == 0)
+		return;
+
+	Promoted = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	/**
+		CreateTemp() appends to fsym->locals, the new temporaries
+		are after all the variables.
+	 */
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (AsVar(p)->no != 0)
+		{
+			t = CreateTemp(p->ty);
+			t->ref = p->ref;
+			Promoted[AsVar(p)->no] = t;
+		}
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable && AsVar(p)->no != 0)
+		{
+			t = CreateTemp(p->ty);
+			t->ref = p->ref;
+			p->ref = 0;
+			Promoted[AsVar(p)->no] = t;
+		}
+	}
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			RenameOperands(inst);
+		}
+	}
+
+	inst = &fsym->entryBB->insth;
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (AsVar(p)->no != 0)
+			inst = InsertParamCopy(fsym->entryBB, inst, p);
+	}
+	// no is reused by the register allocator
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = 0;
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Variable)
+			AsVar(p)->no = 0;
+	}
+}
@@ -11,11 +11,21 @@ OPCODE(LSH,     "<<",                   Assign)
 OPCODE(RSH,     ">>",                   Assign)
 OPCODE(ADD,     "+",                    Assign)
 OPCODE(SUB,     "-",                    Assign)
-OPCODE(MUL,     "*",                    Assign)
-OPCODE(DIV,     "/",                    Assign)
-OPCODE(MOD,     "%",                    Assign)
+OPCODE(MUL,     "*",                    MulDiv)
+OPCODE(DIV,     "/",                    MulDiv)
+OPCODE(MOD,     "%",                    MulDiv)
 OPCODE(NEG,     "-",                    Assign)
 OPCODE(BCOM,    "~",                    Assign)
+OPCODE(SEQ,     "==",                   Assign)
+OPCODE(SNE,     "!=",                   Assign)
+OPCODE(SGT,     ">",                    Assign)
+OPCODE(SLT,     "<",                    Assign)
+OPCODE(SGE,     ">=",                   Assign)
+OPCODE(SLE,     "<=",                   Assign)
+OPCODE(MIN,     "min",                  Select)
+OPCODE(MAX,     "max",                  Select)
+OPCODE(SELNZ,   "?",                    Select)
+OPCODE(SELZ,    "!?",                   Select)
 OPCODE(JZ,      "",                     Branch)
 OPCODE(JNZ,     "!",                    Branch)
 OPCODE(JE,      "==",                   Branch)
@@ -51,5 +61,6 @@ OPCODE(IMOV,    "*=",                   IndirectMove)
 OPCODE(CALL,    "call",                 Call)
 OPCODE(RET,     "ret",                  Return)
 OPCODE(CLR,     "",                     Clear)
+OPCODE(PHI,     "phi",                  Phi)
 OPCODE(NOP,     "NOP",                  NOP)
 
@@ -0,0 +1,229 @@
+#include <time.h>
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	The optimization passes run on the IR of every function, in the order
+	of Passes[]:
+
+		peephole				Optimize(), see simp.c
+		optimize-sibling-calls	EliminateTailRecursion(), tail calls in EmitCall()
+		inline					InlineCalls()
+		rotate-loops			RotateLoops()
+		promote-variables		PromoteVariables()
+		thread-jumps			ThreadJumps()
+		unroll-loops			UnrollLoops()
+		build-ssa				BuildSSA()
+		propagate-constants		PropagateConstants()
+		gvn						GlobalValueNumbering()
+		move-loop-invariants	HoistLoopInvariants()
+		strength-reduce			ReduceInductionVariables()
+		destroy-ssa				DestroySSA()
+		copy-prop				PropagateCopies()
+		dse						EliminateDeadStores()
+		reorder-blocks			LayoutBlocks(), run by the back end
+		strict-aliasing			the types of the accesses used by MayAlias()
+
+	-O0 runs none of them, -O1 the cheap ones which pay off in any code,
+	-O2 all of them, it is the default.   -Os is -O2 without the passes
+	which copy code: inlining, loop rotation, jump threading and unrolling.
+	-f<pass> and -fno-<pass> run or skip one pass whatever the level is.
+	build-ssa and destroy-ssa can't be chosen, they run when one of the
+	passes between them runs.   A pass of the back end, or a pass the back
+	end has to know about, has a flag set when the options are read, see
+	SetupPasses().
+
+	-ftime-report reports the time spent in every pass,
+	--dump-IR-after=pass writes the IR after the pass into a file named
+	xxx.pass.uil, see DAssemPass().
+ */
+
+// the pass works on the SSA form
+#define PASS_SSA   0x1
+// the pass builds or destroys the SSA form
+#define PASS_FORM  0x2
+
+typedef struct pass
+{
+	char *name;
+	void (*run)(FunctionSymbol fsym);
+	// the flag of the back end set to 1 if the pass runs
+	int *flag;
+	// the lowest -O level which runs the pass
+	int level;
+	// -Os runs the pass
+	int size;
+	int attr;
+	// 1 by -f<pass>, -1 by -fno-<pass>, otherwise 0
+	int chosen;
+	int enabled;
+	double seconds;
+} *Pass;
+
+static struct pass Passes[] =
+{
+	{"peephole",               Optimize,                  NULL,            1, 1, 0,         0, 0, 0},
+	{"optimize-sibling-calls", EliminateTailRecursion,    &TailCalls,      2, 1, 0,         0, 0, 0},
+	{"inline",                 InlineCalls,               NULL,            2, 0, 0,         0, 0, 0},
+	{"rotate-loops",           RotateLoops,               NULL,            2, 0, 0,         0, 0, 0},
+	{"promote-variables",      PromoteVariables,          NULL,            1, 1, 0,         0, 0, 0},
+	{"thread-jumps",           ThreadJumps,               NULL,            2, 0, 0,         0, 0, 0},
+	{"unroll-loops",           UnrollLoops,               NULL,            2, 0, 0,         0, 0, 0},
+	{"build-ssa",              BuildSSA,                  NULL,            0, 0, PASS_FORM, 0, 0, 0},
+	{"propagate-constants",    PropagateConstants,        NULL,            1, 1, PASS_SSA,  0, 0, 0},
+	{"gvn",                    GlobalValueNumbering,      NULL,            2, 1, PASS_SSA,  0, 0, 0},
+	{"move-loop-invariants",   HoistLoopInvariants,       NULL,            2, 1, PASS_SSA,  0, 0, 0},
+	{"strength-reduce",        ReduceInductionVariables,  NULL,            2, 1, PASS_SSA,  0, 0, 0},
+	{"destroy-ssa",            DestroySSA,                NULL,            0, 0, PASS_FORM, 0, 0, 0},
+	{"copy-prop",              PropagateCopies,           NULL,            1, 1, 0,         0, 0, 0},
+	{"dse",                    EliminateDeadStores,       NULL,            1, 1, 0,         0, 0, 0},
+	{"reorder-blocks",         NULL,                      &ReorderBlocks,  1, 1, 0,         0, 0, 0},
+	{"strict-aliasing",        NULL,                      &StrictAliasing, 2, 1, 0,         0, 0, 0},
+};
+
+#define NPASS  (int)(sizeof(Passes) / sizeof(Passes[0]))
+// the most copies of a loop body, see -funroll-loops=N
+#define MAX_UNROLL_FACTOR  64
+
+// the optimization level, see -O
+static int OptimizeLevel = 2;
+static int OptimizeSize;
+// the pass after which the IR is dumped, see --dump-IR-after=pass
+char *DumpIRAfter;
+
+static Pass FindPass(char *name)
+{
+	int i;
+
+	for (i = 0; i < NPASS; i++)
+	{
+		if (strcmp(Passes[i].name, name) == 0)
+			return &Passes[i];
+	}
+	return NULL;
+}
+
+/**
+ * -O0, -O1, -O2, -Os and -O, which is -O1
+ */
+void SetOptimizeLevel(char *level)
+{
+	OptimizeSize = 0;
+	if (strcmp(level, "") == 0)
+		OptimizeLevel = 1;
+	else if (strcmp(level, "s") == 0)
+		OptimizeLevel = 2, OptimizeSize = 1;
+	else if (level[0] >= '0' && level[0] <= '2' && level[1] == 0)
+		OptimizeLevel = level[0] - '0';
+	else
+		Fatal("Unsupported -O%s, only -O0, -O1, -O2 and -Os are supported.", level);
+}
+
+/**
+ * -funroll-loops=N, N is from 1 to MAX_UNROLL_FACTOR
+ */
+void SetUnrollFactor(char *factor)
+{
+	char *end;
+	long n = strtol(factor, &end, 10);
+
+	if (*factor < '0' || *factor > '9' || *end != 0 || n < 1 || n > MAX_UNROLL_FACTOR)
+		Fatal("Invalid -funroll-loops=%s, N must be from 1 to %d.", factor, MAX_UNROLL_FACTOR);
+
+	UnrollFactor = (int)n;
+	ChoosePass("unroll-loops", 1);
+}
+
+/**
+ * -f<pass> or -fno-<pass>, return 0 if there isn't such a pass
+ */
+int ChoosePass(char *name, int enabled)
+{
+	Pass p = FindPass(name);
+
+	if (p == NULL || (p->attr & PASS_FORM))
+		return 0;
+
+	p->chosen = enabled ? 1 : -1;
+	return 1;
+}
+
+void SetDumpIRAfter(char *name)
+{
+	if (FindPass(name) == NULL)
+		Fatal("Unknown pass %s in --dump-IR-after.", name);
+
+	DumpIRAfter = name;
+}
+
+static int IsEnabled(Pass p)
+{
+	if (p->chosen != 0)
+		return p->chosen > 0;
+	if (OptimizeSize && ! p->size)
+		return 0;
+	return p->level != 0 && p->level <= OptimizeLevel;
+}
+
+/**
+ * Decide which passes run after the options are read
+ */
+void SetupPasses(void)
+{
+	int i, ssa = 0;
+
+	for (i = 0; i < NPASS; i++)
+	{
+		Passes[i].enabled = IsEnabled(&Passes[i]);
+		if (Passes[i].attr & PASS_SSA)
+			ssa |= Passes[i].enabled;
+	}
+	for (i = 0; i < NPASS; i++)
+	{
+		if (Passes[i].attr & PASS_FORM)
+			Passes[i].enabled = ssa;
+		if (Passes[i].flag != NULL)
+			*Passes[i].flag = Passes[i].enabled;
+	}
+}
+
+/**
+ * Run the enabled passes on fsym
+ */
+void RunPasses(FunctionSymbol fsym)
+{
+	clock_t start;
+	int i;
+
+	for (i = 0; i < NPASS; i++)
+	{
+		if (! Passes[i].enabled || Passes[i].run == NULL)
+			continue;
+
+		start = clock();
+		Passes[i].run(fsym);
+		Passes[i].seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		if (DumpIRAfter != NULL && strcmp(DumpIRAfter, Passes[i].name) == 0)
+			DAssemPass(fsym);
+	}
+}
+
+/**
+ * The time spent in every pass, see -ftime-report
+ */
+void ReportPasses(void)
+{
+	double total = 0;
+	int i;
+
+	for (i = 0; i < NPASS; i++)
+	{
+		if (! Passes[i].enabled || Passes[i].run == NULL)
+			continue;
+
+		fprintf(stderr, "%-24s %.3f s\n", Passes[i].name, Passes[i].seconds);
+		total += Passes[i].seconds;
+	}
+	fprintf(stderr, "%-24s %.3f s\n", "passes", total);
+}
@@ -12,169 +12,90 @@
 Symbol TempRegs[T6 + 1];
 Symbol FuncRegs[A7 + 1];
 Symbol SaveRegs[S11 + 1];
+Symbol FTempRegs[FT11 + 1];
+Symbol FArgRegs[FA7 + 1];
+Symbol FSaveRegs[FS11 + 1];
+/**
+	All the registers indexed by hardware number,
+		RISCVRegs[ZERO], RISCVRegs[S0], RISCVRegs[10] is a0, ...
+		RISCVRegs[FREG_BASE + 10] is fa0
+	the entries of gp/tp are NULL.
+ */
+Symbol RISCVRegs[2 * FREG_BASE];
 
 
 /**
 	see static void EmitBBlock(BBlock bb)
-	We set UsedRegs to 0 before we emit assembly code 
+	We set UsedRegs to 0 before we emit assembly code
 	for every UIL instruction.
+	Bit i is set when the scratch register xi is occupied
+	by the current UIL instruction.
  */
-int UsedRegs;
-
-static int FindEmptyReg(int endr)
-{
-	int i;
-	
-	for (i = A0; i <= endr; ++i)
-	{
-		/**
-		
-			if(X86Regs[i] != NULL && (1 << i & UsedRegs)){
-				assert(X86Regs[i]->link != NULL);	----------- This assertion fails.
-			}
-		*/
-		if (FuncRegs[i] != NULL && FuncRegs[i]->link == NULL && ! (1 << i & UsedRegs))
-			return i;
-	}
+unsigned int UsedRegs;
+// bit i is set when the scratch register fi is occupied
+unsigned int UsedFRegs;
 
-	return NO_REG;
-}
-
-static int SelectSpillReg(int endr)
+/**
+	Temporaries live in the registers assigned by the register
+	allocator(see regalloc.c) during their whole live range.
+	The assembly code for one UIL instruction may still need some
+	registers, to load a spilled temporary or a constant, or to
+	form a memory address:
+		lui t0, %hi(a)
+		lw t0, %lo(a)(t0)
+	GetReg() hands out the scratch registers t0, t1, t2 for that.
+ */
+Symbol GetReg(void)
 {
-	Symbol p;
 	int i;
-	int reg = NO_REG;
-	int ref, mref = INT_MAX;
 
-	for (i = A0; i <= endr; ++i)
+	for (i = T0; i < T0 + SCRATCH_REGS; ++i)
 	{
-		/**
-			(1)	X86Regs[i] == NULL	when i is ESP or EBP
-			(2)	(1 << i & UsedRegs):
-				the current UIL instruction has used X86Regs[i] for one of its operands.
-				We can't spill this register.
-			(3)	We clear UsedRegs to zero before emit assembly code for 
-				a UIL instruction in EmitBBlock();
-		 */		
-		if (FuncRegs[i] == NULL || (1 << i & UsedRegs))
-			continue;
-
-		p = FuncRegs[i]->link;
-		ref = 0;
-		// calculate the total references of current register
-		while (p)
-		{
-			// the content of the register needs to be written back
-			if (p->needwb && p->ref > 0)
-			{
-				ref += p->ref;
-			}
-			p = p->link;
-		}
-		// find the least referenced register to spill
-		if (ref < mref)
+		if (! (UsedRegs & (1u << TempRegs[i]->val.i[0])))
 		{
-			mref = ref;
-			reg = i;
+			UsedRegs |= 1u << TempRegs[i]->val.i[0];
+			return TempRegs[i];
 		}
 	}
-
-	assert(reg != NO_REG);
-	return reg;
-}
-
-static Symbol GetRegInternal(int width)
-{
-	int i, endr;
-	Symbol *regs;
-
-	endr = A7;
-	regs = FuncRegs;
-	// try to find an unused register, that is , empty
-	i = FindEmptyReg(endr);
-	// If there is no empty register
-	if (i == NO_REG)
-	{
-		// spill the content of the selected register to memory
-		i = SelectSpillReg(endr);
-		SpillReg(FuncRegs[i]);
-	}
-	//  If AL is used, EAX is used.  Vice versa.
-	UsedRegs |= 1 << i;
-
-	return regs[i];
+	assert(0);
+	return NULL;
 }
-
-
 /**
-	#define	b(i)	(b[i]+b[i+1])
-	 int main(){
-		 int b[11];
-		 int a = b(1) + (b(2) + (b(3) + (b(4) + (b(5) + (b(6)
-							  + (b(7)+ (b(8)+ (b(9) + (b(0)+0)+b(1))+b(2))
-									 +b(3))+b(4))+b(5))+b(6))+b(7))+b(8));
-		 return 0;
-	 }
-*/
-void SpillReg(Symbol reg)
+	The floating-point values are computed in f registers,
+		lui t0, %hi(.flt0)
+		fld ft0, %lo(.flt0)(t0)
+		fadd.d fs1, fs1, ft0
+	GetFReg() hands out the scratch registers ft0, ft1, ft2.
+ */
+Symbol GetFReg(void)
 {
-	Symbol p;
-	/**
-		If some variable have the same content,
-		their contents may be in the same register.
-		When we spill a register, 
-		we should write back all these variables.
-		But it seems there is at most one element in the link-list
-	 */
-	p = reg->link;
-	while (p)
+	int i, no;
+
+	for (i = FT0; i < FT0 + SCRATCH_REGS; ++i)
 	{
-		// After writing back, variable is not in register anymore.
-		p->reg = NULL;
-		if (p->needwb && p->ref > 0)
+		no = FTempRegs[i]->val.i[0] - FREG_BASE;
+		if (! (UsedFRegs & (1u << no)))
 		{
-			// After it is synchronized, set needwb to 0.
-			p->needwb = 0;		
-			/**
-				we are sure that p is a SK_Temp,
-				because it may be reused as a common sub-expression,
-				we have to allocate temporary momory for it .
-			 */
-			StoreVar(reg, p);
+			UsedFRegs |= 1u << no;
+			return FTempRegs[i];
 		}
-		p = p->link;
 	}
-	reg->link = NULL;
+	assert(0);
+	return NULL;
 }
 /**
-	When we are leaving a basic block,
-	this function is calling to spill all the registers .
+	t0-t6, a0-a7, ft0-ft11 and fa0-fa7 are not preserved across function calls.
  */
-void ClearRegs(void)
+int IsCallerSaved(Symbol reg)
 {
-	int i;
+	int no = reg->val.i[0];
 
-	for (i = A0; i <= A7; ++i)
+	if (no >= FREG_BASE)
 	{
-		if (FuncRegs[i])
-			SpillReg(FuncRegs[i]);
+		no -= FREG_BASE;
+		return no <= 7 || (no >= 10 && no <= 17) || no >= 28;
 	}
-}
-
-Symbol GetByteReg(void)
-{
-	return GetRegInternal(1);
-}
-
-Symbol GetWordReg(void)
-{
-	return GetRegInternal(2);
-}
-
-Symbol GetReg(void)
-{
-	return GetRegInternal(4);
+	return (no >= 5 && no <= 7) || (no >= 10 && no <= 17) || no >= 28;
 }
 /**
 	for example:
@@ -183,7 +104,7 @@ Symbol GetReg(void)
 		X86WordRegs[EAX] = CreateReg("%ax", NULL, EAX);
 	@name			"%ebx"
 	@iname			"(%ebx)"		indirect addressing name
-	@no			EAX		EBX		...
+	@no			hardware register number, 10 for a0, FREG_BASE + 10 for fa0
 */
 Symbol CreateReg(char *name, char *iname, int no)
 {
@@ -202,6 +123,7 @@ Symbol CreateReg(char *name, char *iname, int no)
 		reg->next->kind = SK_IRegister;
 		reg->next->name = reg->next->aname = iname;
 	}
+	RISCVRegs[no] = reg;
 
 	return reg;
 }
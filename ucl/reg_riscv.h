@@ -4,24 +4,63 @@
 enum {T0, T1, T2, T3, T4, T5, T6};
 enum {A0, A1, A2, A3, A4, A5, A6, A7};
 enum {S1, S2, S3, S4, S5, S6, S7, S8, S9, S10, S11};
-enum {S0, RA, SP, GP, TP};
+enum {FT0, FT1, FT2, FT3, FT4, FT5, FT6, FT7, FT8, FT9, FT10, FT11};
+enum {FA0, FA1, FA2, FA3, FA4, FA5, FA6, FA7};
+enum {FS0, FS1, FS2, FS3, FS4, FS5, FS6, FS7, FS8, FS9, FS10, FS11};
+/**
+	hardware register numbers of the special registers.
+	Every register symbol keeps its hardware number (x0 ... x31) in val.i[0],
+	see SetupRegisters().
+ */
+enum {ZERO, RA, SP, GP, TP, S0 = 8};
+/**
+	The floating-point register fi is numbered FREG_BASE + i,
+	RISCVRegs[FREG_BASE + 10] is fa0.
+ */
+#define FREG_BASE 32
+#define IsFloatReg(reg) ((reg)->val.i[0] >= FREG_BASE)
 //  indirect addressing   register,  [eax] or (%eax)
 #define SK_IRegister (SK_Register + 1)
 //  no register is satisfied
 #define NO_REG -1
+/**
+	t0, t1, t2 are never assigned to temporaries by the register allocator,
+	they are the scratch registers used inside the code sequence of one
+	UIL instruction.	see GetReg()
+	So are ft0, ft1, ft2 for floating-point values, see GetFReg().
+ */
+#define SCRATCH_REGS  3
+/**
+	block moves larger than this are done by calling memcpy()/memset(),
+	the register allocator treats such instructions as calls.
+ */
+#define MAX_INLINE_BLOCK 256
 
-void StoreVar(Symbol reg, Symbol v);
-void SpillReg(Symbol reg);
-void ClearRegs(void);
 Symbol CreateReg(char *name, char *iname, int no);
-Symbol GetByteReg(void);
-Symbol GetWordReg(void);
 Symbol GetReg(void);
+Symbol GetFReg(void);
+int IsCallerSaved(Symbol reg);
+
+void AllocateRegisters(FunctionSymbol fsym);
+Vector LiveAcrossCall(IRInst inst);
+int IsCallInst(IRInst inst);
+int IsSqrtCall(IRInst inst);
+int IsMulDivCall(IRInst inst);
 
 extern Symbol TempRegs[];
 extern Symbol FuncRegs[];
 extern Symbol SaveRegs[];
+extern Symbol FTempRegs[];
+extern Symbol FArgRegs[];
+extern Symbol FSaveRegs[];
+extern Symbol RISCVRegs[];
 // bit mask for register use
-extern int UsedRegs;
+extern unsigned int UsedRegs;
+// bit mask for floating-point register use
+extern unsigned int UsedFRegs;
+// bit mask of the callee-saved registers used by current function
+extern unsigned int UsedSaveRegs;
+// bit mask of the callee-saved floating-point registers used by current function
+extern unsigned int UsedSaveFRegs;
 
 #endif
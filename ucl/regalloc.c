@@ -0,0 +1,493 @@
+#include "ucl.h"
+#include "gen.h"
+#include "reg_riscv.h"
+
+/**
+	Global register allocation by linear scan.
+	(Massimiliano Poletto and Vivek Sarkar, "Linear Scan Register Allocation")
+
+	(1) Number the instructions in the order they are emitted.
+		An operand is read at position no and written at position no + 1.
+			BB0:
+				0:	t0 = a + b;
+				2:	t1 = t0 * 2;
+				4:	if (t1 < c) goto BB1;
+	(2)	Compute the live register candidates at the entry and exit of every
+		basic block, see ComputeLiveness() in dataflow.c.
+	(3)	The live interval of a candidate is [start, end], the smallest range
+		covering all its definitions, uses and the basic blocks through which
+		it is live.   In the above example,
+			t0:		[1, 2]
+			t1:		[3, 4]
+		t1 can reuse the register of t0.
+	(4)	Scan the intervals in increasing start order, keep the active ones
+		sorted by increasing end.   When all the registers are occupied,
+		the interval ending furthest is spilled:  it lives in its stack slot
+		and every access goes through a scratch register.
+
+	The caller-saved registers don't survive a call.  An interval crossing
+	calls prefers the callee-saved s1-s11, which are saved only once in the
+	prologue, the others prefer t3-t6 and a0-a7.  When a candidate still has
+	to live in a caller-saved register across a call, it is written to its
+	stack slot before the call and reloaded after it; that is the only place
+	its interval is split.
+	See LiveAcrossCall() and EmitCall() in riscv.c.
+
+	The floating-point temporaries are allocated by a separate scan over
+	the f registers, ft3-ft11 and fa7-fa0 are caller-saved, fs0-fs11 are
+	callee-saved.
+ */
+typedef struct interval
+{
+	Symbol sym;
+	int start;
+	int end;
+	// number of calls the interval crosses
+	int calls;
+	struct interval *link;
+} *Interval;
+
+// the register candidates of current function, Vars[no - 1]
+static Symbol *Vars;
+static int NumVars;
+// live interval of Vars[i] is Intervals[i]
+static struct interval *Intervals;
+static BBlock *Blocks;
+static int NumBlocks;
+static Dataflow Liveness;
+// CallLives[no / 2] : the candidates live across the call at position no
+static BitSet *CallLives;
+static int NumInsts;
+/**
+	registers which can be assigned to candidates,
+		Pool[0 .. NumCallerSaved - 1]			caller-saved, t3-t6, a7-a0
+		Pool[NumCallerSaved .. PoolSize - 1]	callee-saved, s1-s11
+	or the f registers when the floating-point candidates are scanned.
+ */
+static Symbol Pool[32];
+static int PoolSize;
+static int NumCallerSaved;
+
+static BitSet CurLive;
+
+/**
+	bit i is set when the callee-saved register xi is assigned to some
+	candidate of current function, see EmitPrologue() in riscv.c
+ */
+unsigned int UsedSaveRegs;
+// bit i is set when fi is assigned
+unsigned int UsedSaveFRegs;
+static int CurPos;
+
+static int IsRegCandidate(Symbol p)
+{
+	if (p->kind != SK_Temp || p->addressed)
+		return 0;
+
+	return IsRealType(p->ty) || ((IsIntegType(p->ty) || IsPtrType(p->ty)) && p->ty->size <= 4);
+}
+
+/**
+	sqrt() and sqrtf() are computed by fsqrt.d and fsqrt.s in place,
+	see EmitCall() in riscv.c.  errno isn't set for a negative argument.
+ */
+int IsSqrtCall(IRInst inst)
+{
+	Vector args = (Vector)inst->opds[2];
+	Symbol fn = inst->opds[1];
+	int tcode = TypeCode(inst->ty);
+
+	if (inst->opcode != CALL || fn->kind != SK_Function || inst->opds[0] == NULL || LEN(args) != 1)
+		return 0;
+	if (TypeCode(((ILArg)GET_ITEM(args, 0))->ty) != tcode)
+		return 0;
+
+	return (tcode == F8 && strcmp(fn->name, "sqrt") == 0) ||
+	       (tcode == F4 && strcmp(fn->name, "sqrtf") == 0);
+}
+/**
+ * Block moves, calls, and mul/div without the M extension are done by function calls.
+ */
+int IsCallInst(IRInst inst)
+{
+	Type ty = inst->ty;
+
+	switch (inst->opcode)
+	{
+	case CALL:
+		return ! IsSqrtCall(inst);
+
+	case MUL:
+	case DIV:
+	case MOD:
+		return IsMulDivCall(inst);
+
+	case CLR:
+		return inst->opds[1]->val.i[0] > MAX_INLINE_BLOCK;
+
+	case MOV:
+	case IMOV:
+	case DEREF:
+	case RET:
+		return TypeCode(ty) == B && ty->size > MAX_INLINE_BLOCK;
+
+	default:
+		return 0;
+	}
+}
+
+static void ExtendInterval(int i, int pos)
+{
+	if (pos < Intervals[i].start)
+		Intervals[i].start = pos;
+	if (pos > Intervals[i].end)
+		Intervals[i].end = pos;
+}
+
+static void VisitDef(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+	int i;
+
+	if (! def || ! IsTracked(p))
+		return;
+
+	i = AsVar(p)->no - 1;
+	ExtendInterval(i, CurPos + 1);
+	ClearBit(CurLive, i);
+}
+
+static void VisitUse(Symbol *opd, int def)
+{
+	Symbol p = *opd;
+	int i;
+
+	if (def || ! IsTracked(p))
+		return;
+
+	i = AsVar(p)->no - 1;
+	ExtendInterval(i, CurPos);
+	SetBit(CurLive, i);
+}
+
+/**
+ * Number the basic blocks and instructions, collect the register candidates.
+ */
+static void NumberFunction(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int no;
+
+	NumVars = 0;
+	p = fsym->locals;
+	while (p != NULL)
+	{
+		p->reg = NULL;
+		p->needwb = 0;
+		if (p->kind == SK_Temp || p->kind == SK_Variable)
+		{
+			AsVar(p)->no = IsRegCandidate(p) ? ++NumVars : 0;
+		}
+		p = p->next;
+	}
+	Vars = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(Symbol));
+	Intervals = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(struct interval));
+	p = fsym->locals;
+	while (p != NULL)
+	{
+		if ((p->kind == SK_Temp || p->kind == SK_Variable) && AsVar(p)->no != 0)
+		{
+			no = AsVar(p)->no - 1;
+			Vars[no] = p;
+			Intervals[no].sym = p;
+			Intervals[no].start = INT_MAX;
+			Intervals[no].end = -1;
+			Intervals[no].calls = 0;
+			Intervals[no].link = NULL;
+		}
+		p = p->next;
+	}
+	NumBlocks = 0;
+	no = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = NumBlocks++;
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			inst->no = no;
+			no += 2;
+		}
+		// the position of an empty block
+		bb->insth.no = no;
+	}
+	Blocks = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		Blocks[bb->no] = bb;
+	}
+	NumInsts = no / 2;
+	CallLives = HeapAllocate(CurrentHeap, (NumInsts + 1) * sizeof(BitSet));
+	memset(CallLives, 0, (NumInsts + 1) * sizeof(BitSet));
+}
+
+/**
+ * Walk every basic block backward to build the live intervals,
+ * and record the candidates live across every call.
+ */
+static void BuildIntervals(void)
+{
+	BBlock bb;
+	IRInst inst;
+	int i, j, first, last;
+
+	CurLive = NewBitSet();
+	for (i = 0; i < NumBlocks; i++)
+	{
+		bb = Blocks[i];
+		first = bb->insth.next != &bb->insth ? bb->insth.next->no : bb->insth.no;
+		last = bb->insth.prev != &bb->insth ? bb->insth.prev->no + 1 : bb->insth.no;
+
+		CopyBits(CurLive, Liveness->out[i]);
+		for (j = NextBit(CurLive, 0); j >= 0; j = NextBit(CurLive, j + 1))
+		{
+			ExtendInterval(j, last);
+		}
+		for (inst = bb->insth.prev; inst != &bb->insth; inst = inst->prev)
+		{
+			CurPos = inst->no;
+			VisitOperands(inst, VisitDef);
+			if (IsCallInst(inst))
+			{
+				CallLives[inst->no / 2] = NewBitSet();
+				CopyBits(CallLives[inst->no / 2], CurLive);
+				for (j = NextBit(CurLive, 0); j >= 0; j = NextBit(CurLive, j + 1))
+				{
+					Intervals[j].calls++;
+				}
+			}
+			VisitOperands(inst, VisitUse);
+		}
+		for (j = NextBit(Liveness->in[i], 0); j >= 0; j = NextBit(Liveness->in[i], j + 1))
+		{
+			ExtendInterval(j, first);
+		}
+	}
+}
+
+static int CompareStart(const void *p1, const void *p2)
+{
+	Interval i1 = *(Interval *)p1;
+	Interval i2 = *(Interval *)p2;
+
+	if (i1->start != i2->start)
+		return i1->start < i2->start ? -1 : 1;
+	return AsVar(i1->sym)->no - AsVar(i2->sym)->no;
+}
+
+/**
+ * Insert interval it into the active list which is sorted by increasing end
+ */
+static void AddActive(Interval *active, Interval it)
+{
+	while (*active != NULL && (*active)->end <= it->end)
+	{
+		active = &(*active)->link;
+	}
+	it->link = *active;
+	*active = it;
+}
+
+/**
+ * Return the index of a free register in Pool, PoolSize if there is none.
+ * The callee-saved registers are tried first when callee is 1.
+ */
+static int FindFreeReg(int free[], int callee)
+{
+	int k;
+
+	if (callee)
+	{
+		for (k = NumCallerSaved; k < PoolSize; k++)
+		{
+			if (free[k])
+				return k;
+		}
+	}
+	for (k = 0; k < PoolSize; k++)
+	{
+		if (free[k])
+			return k;
+	}
+	return PoolSize;
+}
+
+/**
+ * Fill Pool with the integer registers, or the f registers when fp is 1
+ */
+static void SetupPool(int fp)
+{
+	int i;
+
+	PoolSize = 0;
+	if (fp)
+	{
+		for (i = FT3; i <= FT11; i++)
+		{
+			Pool[PoolSize++] = FTempRegs[i];
+		}
+		for (i = FA7; i >= FA0; i--)
+		{
+			Pool[PoolSize++] = FArgRegs[i];
+		}
+		NumCallerSaved = PoolSize;
+		for (i = FS0; i <= FS11; i++)
+		{
+			Pool[PoolSize++] = FSaveRegs[i];
+		}
+		return;
+	}
+
+	for (i = T3; i <= T6; i++)
+	{
+		Pool[PoolSize++] = TempRegs[i];
+	}
+	for (i = A7; i >= A0; i--)
+	{
+		Pool[PoolSize++] = FuncRegs[i];
+	}
+	NumCallerSaved = PoolSize;
+	for (i = S1; i <= S11; i++)
+	{
+		Pool[PoolSize++] = SaveRegs[i];
+	}
+}
+
+/**
+ * Allocate registers to the integer candidates, or the floating-point ones when fp is 1
+ */
+static void LinearScan(int fp)
+{
+	Interval *sorted, active, it, *pprev;
+	int free[32];
+	int i, k, n;
+
+	SetupPool(fp);
+	sorted = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(Interval));
+	n = 0;
+	for (i = 0; i < NumVars; i++)
+	{
+		// a temporary which never appears in the instructions
+		if (Intervals[i].start > Intervals[i].end)
+			continue;
+		if ((IsRealType(Vars[i]->ty) != 0) != fp)
+			continue;
+		sorted[n++] = &Intervals[i];
+	}
+	qsort(sorted, n, sizeof(Interval), CompareStart);
+
+	for (k = 0; k < PoolSize; k++)
+	{
+		free[k] = 1;
+	}
+	active = NULL;
+	for (i = 0; i < n; i++)
+	{
+		it = sorted[i];
+		// expire old intervals
+		while (active != NULL && active->end < it->start)
+		{
+			for (k = 0; Pool[k] != active->sym->reg; k++)
+				;
+			free[k] = 1;
+			active = active->link;
+		}
+
+		k = FindFreeReg(free, it->calls != 0);
+		if (k < PoolSize)
+		{
+			free[k] = 0;
+			it->sym->reg = Pool[k];
+			AddActive(&active, it);
+			continue;
+		}
+		// spill the interval which ends furthest
+		pprev = &active;
+		while ((*pprev)->link != NULL)
+		{
+			pprev = &(*pprev)->link;
+		}
+		if ((*pprev)->end > it->end)
+		{
+			it->sym->reg = (*pprev)->sym->reg;
+			(*pprev)->sym->reg = NULL;
+			*pprev = NULL;
+			AddActive(&active, it);
+		}
+	}
+}
+
+/**
+ * Assign registers to the temporaries of fsym.  After allocation,
+ * p->reg is the register of temporary p, or NULL when p is spilled.
+ * p->needwb is set when p must be saved in its stack slot around calls.
+ */
+void AllocateRegisters(FunctionSymbol fsym)
+{
+	int i, j, no;
+
+	UsedSaveRegs = UsedSaveFRegs = 0;
+	NumberFunction(fsym);
+	if (NumVars == 0)
+		return;
+
+	Liveness = ComputeLiveness(fsym, NumVars);
+	BuildIntervals();
+	LinearScan(0);
+	LinearScan(1);
+
+	for (i = 0; i < NumVars; i++)
+	{
+		if (Vars[i]->reg == NULL || IsCallerSaved(Vars[i]->reg))
+			continue;
+		no = Vars[i]->reg->val.i[0];
+		if (no >= FREG_BASE)
+			UsedSaveFRegs |= 1u << (no - FREG_BASE);
+		else
+			UsedSaveRegs |= 1u << no;
+	}
+	for (j = 0; j < NumInsts; j++)
+	{
+		if (CallLives[j] == NULL)
+			continue;
+		for (i = NextBit(CallLives[j], 0); i >= 0; i = NextBit(CallLives[j], i + 1))
+		{
+			if (Vars[i]->reg != NULL && IsCallerSaved(Vars[i]->reg))
+				Vars[i]->needwb = 1;
+		}
+	}
+}
+
+/**
+ * Return the temporaries which are in caller-saved registers and live
+ * across the call instruction inst.
+ */
+Vector LiveAcrossCall(IRInst inst)
+{
+	Vector v = CreateVector(4);
+	BitSet live = CallLives[inst->no / 2];
+	int i;
+
+	if (live == NULL)
+		return v;
+
+	for (i = NextBit(live, 0); i >= 0; i = NextBit(live, i + 1))
+	{
+		if (Vars[i]->reg != NULL && IsCallerSaved(Vars[i]->reg))
+		{
+			INSERT_ITEM(v, Vars[i]);
+		}
+	}
+	return v;
+}
@@ -3,6 +3,7 @@
 #include "expr.h"
 #include "gen.h"
 #include "reg_riscv.h"
+#include "sel_riscv.h"
 #include "target.h"
 #include "output.h"
 
@@ -24,32 +25,49 @@ const char * GetAsmCodeName(int code){
 }
 
 /**
-	 TEMPLATE(X86_ORI4, 	"orl %2, %0")		X86_OR		I4
-	 TEMPLATE(X86_ORU4, 	"orl %2, %0")					U4
-	 TEMPLATE(X86_ORF4, 	NULL)						F4
-	 TEMPLATE(X86_ORF8, 	NULL)						F8
-	 
-	 TEMPLATE(X86_XORI4,	"xorl %2, %0")			X86_XOR		I4
-	 TEMPLATE(X86_XORU4,	"xorl %2, %0")					U4
-	 TEMPLATE(X86_XORF4,	NULL)								F4
-	 TEMPLATE(X86_XORF8,	NULL)								F8
+	 TEMPLATE(RISCV_BORI4,     "or %0, %1, %2")		BOR		I4
+	 TEMPLATE(RISCV_BORU4,     "or %0, %1, %2")				U4
+	 TEMPLATE(RISCV_BORF4,     NULL)						F4
+	 TEMPLATE(RISCV_BORF8,     NULL)						F8
+
+	 TEMPLATE(RISCV_BXORI4,    "xor %0, %1, %2")		BXOR	I4
+	 TEMPLATE(RISCV_BXORU4,    "xor %0, %1, %2")				U4
+	 TEMPLATE(RISCV_BXORF4,    NULL)						F4
+	 TEMPLATE(RISCV_BXORF8,    NULL)						F8
 
  */
 #define ASM_CODE(opcode, tcode) ((opcode << 2) + tcode - I4)
 #define DST  inst->opds[0]
 #define SRC1 inst->opds[1]
 #define SRC2 inst->opds[2]
-#define IsNormalRecord(rty) (rty->size != 1 && rty->size != 2 && rty->size != 4 && rty->size != 8)
+// the records returned through a hidden pointer, see EmitCall()
+#define IsNormalRecord(rty) (rty->size > 8)
 /**
-	 main:
-		 pushl s0
+	the saved ra and s0 at the top of each frame
+		-4(s0)		ra
+		-8(s0)		old s0
  */
-#define PRESERVE_REGS 0
-#define SCRATCH_REGS  4
+#define FRAME_HEADER_SIZE 8
 #define STACK_ALIGN_SIZE 4
-
-static Symbol X87Top;
-static int X87TCode;
+#define FRAME_ALIGN_SIZE 16
+#define IsImm12(n) ((n) >= -2048 && (n) < 2048)
+
+// the size of current frame, see EmitFunction()
+static int FrameSize;
+// the size of the area saving callee-saved registers, see SaveCalleeRegs()
+static int SaveAreaSize;
+// the size of the area saving a0-a7 in a variadic function, see LayoutFrame()
+static int VarArgSize;
+// the word of every parameter, see AssignParams()
+static int *ParamWords;
+// the fa register of every floating-point parameter, -1 if it is passed in words
+static int *ParamFRegs;
+// the instruction copying a parameter in register to its temporary
+static IRInst *ParamInReg;
+// 1 if no address of an object on the frame is taken, see EmitFunction()
+static int FrameClosed;
+// 1 if the call being emitted is a tail call, or the last block ends with one
+static int TailCall;
 
 
 /**
@@ -64,496 +82,550 @@ static void Move(int code, Symbol dst, Symbol src)
 	PutASMCode(code, opds);
 }
 
+/**
+ * Put assembly code of the register instruction code, dst = src1 op src2
+ */
+static void Assemble(int code, Symbol dst, Symbol src1, Symbol src2)
+{
+	Symbol opds[3];
 
-static int GetListLen(Symbol reg){
-	int len = 0;
-	Symbol next = reg->link;
-	while(next){
-		len++;
-		next = next->link;
-	}
-	return len;
+	opds[0] = dst;
+	opds[1] = src1;
+	opds[2] = src2;
+	PutASMCode(code, opds);
 }
 
-
 /**
- * Mark the variable is in register
+ * Put assembly code to copy register src into register dst of the same class
  */
+static void MoveReg(Symbol dst, Symbol src)
+{
+	Move(IsFloatReg(dst) ? RISCV_FMOV : RISCV_MOV, dst, src);
+}
+
 /**
-	This function only add @v into @reg link-list, 
-	and we are sure that @v is a SK_Temp.
-	This function is different from static Symbol PutInReg(Symbol p),
-		whick @p could be SK_Variable.
+	Global/static variables, functions and strings are accessed by their
+	names:
+		lui t0, %hi(a)
+		lw t0, %lo(a)(t0)
+	the others are on the stack frame, accessed relative to s0:
+		lw t0, -12(s0)
  */
-static void AddVarToReg(Symbol reg, Symbol v)
+static int IsGlobalObject(Symbol p)
 {
+	if (p->kind == SK_Offset)
+		p = p->link;
 
-	assert(v->kind == SK_Temp );
-	assert(GetListLen(reg) == 0);
-
-	v->link = reg->link;
-	reg->link = v;
-	v->reg = reg;
+	return p->kind == SK_String || p->kind == SK_Function ||
+	       p->level == 0 || p->sclass == TK_STATIC || p->sclass == TK_EXTERN;
 }
 
+static int FrameOffset(Symbol p)
+{
+	if (p->kind == SK_Offset)
+		return AsVar(p)->offset + AsVar(p->link)->offset;
+
+	return AsVar(p)->offset;
+}
 
 /**
- * When a variable is modified, if it is not in a register, do nothing;
- * otherwise, spill othere variables in this register, set the variable's
- * needWB flag.(need write back to memory)
+ * Return the memory operand of frame object p.  If its offset doesn't fit
+ * in 12 bits, the address is computed in register reg.
  */
-static void ModifyVar(Symbol p)
+static Symbol FrameOperand(Symbol p, Symbol reg)
 {
-	Symbol reg;
+	Symbol opds[2];
+	int offset = FrameOffset(p);
 
-	if (p->reg == NULL)
-		return;
+	if (IsImm12(offset))
+		return p;
 
-	p->needwb = 0;
-	reg = p->reg;
-	/**
-		The following assertion seems to be right.
-		In fact, the only thing we have to do here 
-		is set
-		p->needwb = 1; 	?
-	 */
-	assert(GetListLen(reg) == 1);
-	assert(p == reg->link);
+	if (reg == NULL)
+		reg = GetReg();
+	opds[0] = reg;
+	opds[1] = IntConstant(offset);
+	// TEMPLATE(RISCV_LEAL,     "li %0, %1;add %0, %0, s0")
+	PutASMCode(RISCV_LEAL, opds);
+
+	return reg->next;
+}
 
-	SpillReg(reg);
-	
-	AddVarToReg(reg, p);
+/**
+	Load the memory object p of type tcode into register reg.
+	An f register can't hold the address, so the address of a
+	floating-point value is formed in a scratch register.
+		lui t0, %hi(.flt0)
+		fld ft0, %lo(.flt0)(t0)
+ */
+static void LoadMemory(Symbol reg, Symbol p, int tcode)
+{
+	Symbol opds[3];
 
-	p->needwb = 1;
+	assert(tcode <= F8);
+	opds[0] = reg;
+	if (IsGlobalObject(p))
+	{
+		opds[1] = p;
+		opds[2] = IsFloatReg(reg) ? GetReg() : reg;
+		PutASMCode(RISCV_LDGI1 + tcode - I1, opds);
+	}
+	else
+	{
+		opds[1] = FrameOperand(p, IsFloatReg(reg) ? NULL : reg);
+		PutASMCode(RISCV_LDI1 + tcode - I1, opds);
+	}
 }
 
 /**
- * Allocate register for instruction operand. index indicates which operand
+ * Store register reg into the memory object p of type tcode
  */
-static void AllocateReg(IRInst inst, int index)
+static void StoreMemory(Symbol reg, Symbol p, int tcode)
 {
-	Symbol reg;
-	Symbol p;
+	Symbol opds[3];
 
-	p = inst->opds[index];
+	assert(tcode <= F8);
+	opds[0] = reg;
+	if (IsGlobalObject(p))
+	{
+		opds[1] = p;
+		opds[2] = GetReg();
+		PutASMCode(RISCV_STGI1 + tcode - I1, opds);
+	}
+	else
+	{
+		opds[1] = FrameOperand(p, NULL);
+		PutASMCode(RISCV_STI1 + tcode - I1, opds);
+	}
+}
 
-	// In x86, UCC only allocates register for temporary
-	if (p->kind != SK_Temp)
-		return;
+/**
+ * Put the address of memory object p into register reg
+ */
+static void LoadAddress(Symbol reg, Symbol p)
+{
+	Symbol opds[3];
+	int offset;
 
-	// if it is already in a register, mark the register as used by current uil
-	if (p->reg != NULL)
+	opds[0] = reg;
+	if (IsGlobalObject(p))
 	{
-		UsedRegs |= 1 << p->reg->val.i[0];
+		opds[1] = p;
+		PutASMCode(RISCV_LA, opds);
 		return;
 	}
 
-	/// in x86, the first source operand is also destination operand, 
-	/// reuse the first source operand's register if the first source operand 
-	/// will not be used after this instruction
-	if (index == 0 && SRC1->ref == 1 && SRC1->reg != NULL)
+	offset = FrameOffset(p);
+	if (IsImm12(offset))
 	{
-		reg = SRC1->reg;
-		reg->link = NULL;
-		AddVarToReg(reg, p);
-		return;
+		opds[1] = RISCVRegs[S0];
+		opds[2] = IntConstant(offset);
+		PutASMCode(RISCV_ADDIMM, opds);
+	}
+	else
+	{
+		opds[1] = IntConstant(offset);
+		PutASMCode(RISCV_LEAL, opds);
 	}
+}
 
-	/// get a register, if the operand is not destination operand, load the 
-	/// variable into the register
-	reg = GetReg();
-	if (index != 0)
+/**
+	A temporary in register is written back to its stack slot before
+	a call and reloaded after the call, see EmitCall().
+	The register is detached from p temporarily, otherwise
+	PutASMCode() prints the register name instead of the slot.
+ */
+static void SpillTemp(Symbol p, int reload)
+{
+	Symbol reg = p->reg;
+
+	p->reg = NULL;
+	if (reload)
+	{
+		LoadMemory(reg, p, TypeCode(p->ty));
+	}
+	else
 	{
-		//Move(X86_MOVI4, reg, p);
-		Symbol opds[2];
+		StoreMemory(reg, p, TypeCode(p->ty));
+	}
+	p->reg = reg;
+}
 
-        opds[0] = reg;
-		opds[1] = p;		
-		PutASMCode(RISCV_MEM2REG, opds);
-	
+/**
+ * Sign or zero extend the low bits of register src into dst, according to tcode
+ */
+static void ExtendReg(Symbol dst, Symbol src, int tcode)
+{
+	static int codes[] = { RISCV_TRUI1, RISCV_TRUU1, RISCV_TRUI2, RISCV_TRUU2 };
+
+	if (tcode <= U2)
+	{
+		Move(codes[tcode - I1], dst, src);
+	}
+	else if (dst != src)
+	{
+		Move(RISCV_MOV, dst, src);
 	}
-	AddVarToReg(reg, p);
 }
 
 /**
- * Before executing an float instruction, UCC ensures that only TOP register of x87 stack 
- * may be used. And whenenver a basic block ends, save the x87 stack top if needed. Thus
- * we can assure that when entering and leaving each basic block, the x87 register stack
- * is in init status.
+	Load the value of p into register reg.  tcode is the type of the value.
+	A floating-point constant is loaded from memory, see DefineFloatConstant().
  */
-static void SaveX87Top(void)
+static void LoadValue(Symbol reg, Symbol p, int tcode)
 {
-#if 0
-	if (X87Top == NULL)
-		return;
+	if (p->reg != NULL)
+	{
+		if (p->reg != reg)
+		{
+			MoveReg(reg, p->reg);
+		}
+	}
+	else if (p->kind == SK_Constant && tcode < F4)
+	{
+		// char c = 200;	------	li t3, -56
+		if (tcode == I1)
+			p = IntConstant((signed char)p->val.i[0]);
+		else if (tcode == U1)
+			p = IntConstant((unsigned char)p->val.i[0]);
+		else if (tcode == I2)
+			p = IntConstant((short)p->val.i[0]);
+		else if (tcode == U2)
+			p = IntConstant((unsigned short)p->val.i[0]);
+		Move(RISCV_LI, reg, p);
+	}
+	else if (p->kind == SK_Function || p->kind == SK_String)
+	{
+		// function designator and string literal stand for their addresses
+		LoadAddress(reg, p);
+	}
+	else
+	{
+		LoadMemory(reg, p, tcode);
+	}
+}
+
+/**
+	Return the register holding the value of p.
+	Register candidates live in their registers, see regalloc.c;
+	the others are loaded into a scratch register.
+	A register holding a value of type char/short is always
+	sign/zero extended according to the type.
+ */
+static Symbol PutInReg(Symbol p)
+{
+	Symbol reg;
+
+	if (p->reg != NULL)
+		return p->reg;
 
-	assert(X87Top->kind == SK_Temp);
-	if (X87Top->needwb && X87Top->ref > 0)
+	if (IsRealType(p->ty))
 	{
-		/**
-			 TEMPLATE(X86_LDF4, 	"flds %0")
-			 TEMPLATE(X86_LDF8, 	"fldl %0")
-			 TEMPLATE(X86_STF4, 	"fstps %0")
-			 TEMPLATE(X86_STF8, 	"fstpl %0")
-		*/
-		PutASMCode(X86_STF4 + X87TCode - F4, &X87Top);
+		reg = GetFReg();
+		LoadValue(reg, p, TypeCode(p->ty));
+		return reg;
 	}
-	X87Top = NULL;
-#endif	
+
+	if (p->kind == SK_Constant && p->val.i[0] == 0)
+		return RISCVRegs[ZERO];
+
+	reg = GetReg();
+	LoadValue(reg, p, TypeCode(p->ty));
+
+	return reg;
 }
 
 /**
- * Emit floating point branch instruction
+ * Return the register to hold the result written to dst.
  */
-static void EmitX87Branch(IRInst inst, int tcode)
+static Symbol GetDstReg(Symbol dst)
 {
-#if 0
-	// see EmitBranch(). We have called ClearRegs() before jumping.
-	PutASMCode(X86_LDF4 + tcode - F4, &SRC1);
-	PutASMCode(ASM_CODE(inst->opcode, tcode), inst->opds);
-#endif
+	if (dst->reg != NULL)
+		return dst->reg;
 
+	return IsRealType(dst->ty) ? GetFReg() : GetReg();
 }
 
 /**
-	@index
-		0		DST
-		1		SRC1
-		2		SRC2
+ * If dst is not in register, write its result in reg back to memory
  */
-static int IsLiveAfterCurEmit(IRInst inst,int index){
-	int isLive = 1;
-	// Try decrement ref
-	if (! (inst->opcode >= JZ && inst->opcode <= IJMP) &&
-		    inst->opcode != CALL){
-		DST->ref--;
-		if (SRC1 && SRC1->kind != SK_Function) SRC1->ref--;
-		if (SRC2 && SRC2->kind != SK_Function) SRC2->ref--;
+static void WriteBack(Symbol dst, Symbol reg, int tcode)
+{
+	if (dst->reg == NULL)
+	{
+		StoreMemory(reg, dst, tcode);
 	}
-	isLive = (inst->opds[index]->ref > 0);
+}
+
+/**
+ * Return the register containing the address of memory object p
+ */
+static Symbol AddressInReg(Symbol p)
+{
+	Symbol reg = GetReg();
 
-	// roll back
-	if (! (inst->opcode >= JZ && inst->opcode <= IJMP) &&
-		    inst->opcode != CALL){
-		DST->ref++;
-		if (SRC1 && SRC1->kind != SK_Function) SRC1->ref++;
-		if (SRC2 && SRC2->kind != SK_Function) SRC2->ref++;
-	}	
-	return isLive;
+	LoadAddress(reg, p);
+	return reg;
 }
 
 /**
- * Emit floating point move instruction
+ * Store the live temporaries in caller-saved registers before a call
  */
-static void EmitX87Move(IRInst inst, int tcode)
+static Vector SaveLiveRegs(IRInst inst)
 {
-#if 0
-	// let X87 TOP be the first source operand
-	if (X87Top != SRC1)
+	Vector live = LiveAcrossCall(inst);
+	unsigned int used = UsedRegs;
+	int i;
+
+	for (i = 0; i < LEN(live); i++)
 	{
-		SaveX87Top();
-		// TEMPLATE(X86_LDF4,	   "flds %0")
-		PutASMCode(X86_LDF4 + tcode - F4, &SRC1);
+		UsedRegs = used;
+		SpillTemp(GET_ITEM(live, i), 0);
 	}
+	return live;
+}
 
-	// only put temporary in register
-	/**
-		Because 
-		TryAddValue(Type ty, int op, Symbol src1, Symbol src2) in gen.c
-		knows nothing about X87 FPU,
-		It seems that we have to 
-	*/
-	if (DST->kind != SK_Temp)
-	{		
-		/**
-			When we get here, we are sure that
-			SRC1 are on the TOP of X87 stack.
-			We will do the following:
-			(1) store X87 top to DST, by X86_STF4_NO_POP / X86_STF4
-			(2) if SRC1 is a temporary and still alive later,
-				mark SRC1 be the X87Top.
-			     else
-			     	mark X87Top = NULL;
-		 */		
-		if(SRC1->kind == SK_Temp  && IsLiveAfterCurEmit(inst,1)){
-			PutASMCode(X86_STF4_NO_POP + tcode - F4, &DST);
-			SRC1->needwb = 1;
-			X87Top = SRC1;
-			X87TCode = tcode;
-		}else{
-			PutASMCode(X86_STF4 + tcode - F4, &DST);
-			X87Top = NULL;
-		}
+static void RestoreLiveRegs(Vector live)
+{
+	unsigned int used = UsedRegs;
+	int i;
 
-	}
-	else
+	for (i = 0; i < LEN(live); i++)
 	{
-		/**
-			It seems that
-			the  situations we Move value To a temporary variable 
-			are
-			(1)in function EmitDeref().
-			(2)a = b > 1? c:d;
-		 */		
-		DST->needwb = 1;
-		X87Top = DST;
-		X87TCode = tcode;
+		UsedRegs = used;
+		SpillTemp(GET_ITEM(live, i), 1);
 	}
-#endif
 }
 
 /**
- * Emit floating point assign instruction
+ * Return the alignment known for the address of memory object p.
+ * The objects on stack frame are at least 4-byte aligned, see LayoutFrame().
  */
- //	1.23f + 1.1f,	1.0 * 2.0	,  -a,  see opcode.h
-static void EmitX87Assign(IRInst inst, int tcode)
+static int ObjectAlign(Symbol p)
 {
-#if 0
-	// SRC2 could be NULL when it is a unary operator, like '-a'
-	assert(DST->kind == SK_Temp && SRC1 != NULL);
-	// PRINT_CUR_IRInst(inst);
-	if(SRC1 != X87Top){
-		SaveX87Top();
-		PutASMCode(X86_LDF4 + tcode - F4, &SRC1);
-	}else{
-		/**
-			void GetValue(void){
-				float f1 = 1.0f, f2;
-				f2 = f1+1.0f;
-				f2 = (f1+1.0f)+(f1+1.0f);
-				printf("%f \n",f2);
-			}	
-			If SRC1 is also SRC2, or SRC1 is still alive after current emit,
-			we copy the top to memory of SRC1, because DST will be 
-			the X87 top later.
-			Else,
-				we can discard SRC1 later, no need to write back.
-		 */		 
-		if(SRC1 == SRC2 || IsLiveAfterCurEmit(inst,1)){
-			PutASMCode(X86_STF4_NO_POP + tcode - F4, &SRC1);
-		}		
-	}
-	/**
-		TEMPLATE(X86_ADDF8,    "faddl %2")
-		TEMPLATE(X86_SUBF8,    "fsubl %2")
-	 */	
-	PutASMCode(ASM_CODE(inst->opcode, tcode), inst->opds);
-	// now DST be the new TOP of X87
-	DST->needwb = 1;
-	X87Top = DST;
-	X87TCode = tcode;
-#endif
+	if (p->kind == SK_Offset || IsGlobalObject(p))
+		return p->ty->align;
+
+	return p->ty->align > STACK_ALIGN_SIZE ? p->ty->align : STACK_ALIGN_SIZE;
 }
 
 /**
- * Emit assembly code for block move
+ * dst = src + n, for any n
  */
-static void EmitMoveBlock(IRInst inst)
+static void AddImm(Symbol dst, Symbol src, int n)
 {
-	if(inst->ty->size == 0){
+	Symbol opds[3];
+
+	opds[0] = dst;
+	opds[1] = src;
+	if (IsImm12(n))
+	{
+		opds[2] = IntConstant(n);
+		PutASMCode(RISCV_ADDIMM, opds);
 		return;
 	}
-	int count = 0;
-    Symbol opds[3], rg0, rg1, rg2, rg3;
-	rg0 = GetReg();
-	rg1 = GetReg();
-	rg2 = GetReg();
-	rg3 = GetReg();
-	/**
-		 typedef struct{
-			 int data[10];
-		 }Data;
-		 Data a,b;
-		 int main(){
-			 a = b;
-			 return 0;
-		 }
-		--------------------
-		
-		 leal a, %edi
-		 leal b, %esi
-		 movl $40, %ecx
-		 rep movsb
-
-	 */
-
-	 opds[0] = rg0;
-	 opds[1] = rg1;
-	 opds[2] = inst->opds[0];	
-	 PutASMCode(RISCV_LUI_ADDI_LEAL, opds);
-
-	 opds[0] = rg3;
-	 opds[1] = rg1;
-	 opds[2] = inst->opds[1];
-	 PutASMCode(RISCV_LUI_ADDI_LEAL, opds);
-
-	 for(count = 0; count < inst->ty->size; count += 4)
-	 {
-	     //TODO: check the order
-	     DST = rg2;
-		 SRC1 = IntConstant(count);
-		 SRC2 = rg1;
-		 PutASMCode(RISCV_MEM2REG_OFFSET, inst->opds);	
-		 SRC2 = SRC1;
-		 SRC1 = rg2;
-		 DST = rg1;
-		 PutASMCode(RISCV_REG2MEM_OFFSET, inst->opds);	
-	 }
+	opds[2] = GetReg();
+	Move(RISCV_LI, opds[2], IntConstant(n));
+	PutASMCode(RISCV_ADDI4, opds);
+	UsedRegs &= ~(1u << opds[2]->val.i[0]);
 }
 
 /**
- * Emit assembly code for move
+	Load nbytes(1 to 4) at offset off of the memory addressed by register addr
+	into register reg, zero extended.  A memory not aligned for the load is
+	read byte by byte.
+		lbu a0, 0(t0)
+		lbu t1, 1(t0)
+		slli t1, t1, 8
+		or a0, a0, t1
+		......
  */
-static void EmitMove(IRInst inst)
+static void LoadPartialWord(Symbol reg, Symbol addr, int off, int nbytes, int align)
 {
-	int tcode = TypeCode(inst->ty);
-	Symbol reg, opds[2], reg0, reg1;
-	//PRINT_DEBUG_INFO(("%s",GetAsmCodeName(X86_X87_POP)));
-	if (tcode == F4 || tcode == F8)
+	Symbol opds[3], tmp;
+	int i;
+
+	opds[0] = reg;
+	opds[1] = addr;
+	opds[2] = IntConstant(off);
+	if ((nbytes == 4 && align >= 4) || (nbytes == 2 && align >= 2) || nbytes == 1)
 	{
-		EmitX87Move(inst, tcode);
+		PutASMCode(RISCV_LDOFF1 + (nbytes >> 1), opds);
 		return;
 	}
 
-	if (tcode == B)
+	PutASMCode(RISCV_LDOFF1, opds);
+	tmp = GetReg();
+	for (i = 1; i < nbytes; i++)
+	{
+		opds[0] = tmp;
+		opds[1] = addr;
+		opds[2] = IntConstant(off + i);
+		PutASMCode(RISCV_LDOFF1, opds);
+		opds[1] = tmp;
+		opds[2] = IntConstant(8 * i);
+		PutASMCode(RISCV_SLLI, opds);
+		opds[0] = reg;
+		opds[1] = reg;
+		opds[2] = tmp;
+		PutASMCode(RISCV_BORI4, opds);
+	}
+}
+
+/**
+ * Store the low nbytes(1 to 4) of register reg at offset off of the memory
+ * addressed by register addr.
+ */
+static void StorePartialWord(Symbol reg, Symbol addr, int off, int nbytes, int align)
+{
+	Symbol opds[3], tmp;
+	int i;
+
+	opds[0] = reg;
+	opds[1] = addr;
+	opds[2] = IntConstant(off);
+	if ((nbytes == 4 && align >= 4) || (nbytes == 2 && align >= 2) || nbytes == 1)
 	{
-		EmitMoveBlock(inst);
+		PutASMCode(RISCV_STOFF1 + (nbytes >> 1), opds);
 		return;
 	}
 
-	switch (tcode)
+	PutASMCode(RISCV_STOFF1, opds);
+	tmp = GetReg();
+	for (i = 1; i < nbytes; i++)
 	{
-	case I1: case U1:
-		/**
-			char a,b;
-			int main(){
-				a = b;
-				a = '3';
-				return 0;
-			}
+		opds[0] = tmp;
+		opds[1] = reg;
+		opds[2] = IntConstant(8 * i);
+		PutASMCode(RISCV_SRLI, opds);
+		opds[1] = addr;
+		opds[2] = IntConstant(off + i);
+		PutASMCode(RISCV_STOFF1, opds);
+	}
+}
 
-			----------------------------------------
-			movb b, %al
-			movb %al, a
-			
-			movb $51, a		// SK_Constant
+/**
+ * Copy size bytes from address in register src to address in register dst
+ * by loads and stores in units of their alignment.
+ */
+static void CopyBlock(Symbol dst, Symbol src, int size, int align)
+{
+	Symbol opds[3], reg;
+	int unit, offset;
 
-		 */
-		if (SRC1->kind == SK_Constant)
-		{
-			// TEMPLATE(X86_MOVI1,    "movb %1, %0")			
-			reg = GetByteReg();
-			SRC2 = reg;			
-			PutASMCode(RISCV_IMMED2MEM, inst->opds);		
-				
-		}
-		else
-		{		    
-		    Symbol opds[2];
-			reg = GetByteReg();
-				
-			opds[0] = reg;
-			opds[1] = SRC1;
-			PutASMCode(RISCV_MEM2REG, opds);
-
-			opds[0] = SRC1;
-			opds[1] = reg;
-			PutASMCode(RISCV_REG2MEM, opds);
-		}
-		break;
+	reg = GetReg();
+	unit = align >= 4 ? 4 : align;
+	offset = 0;
+	while (offset < size)
+	{
+		while (offset + unit > size)
+			unit >>= 1;
+		opds[0] = reg;
+		opds[1] = src;
+		opds[2] = IntConstant(offset);
+		PutASMCode(RISCV_LDOFF1 + (unit >> 1), opds);
+		opds[1] = dst;
+		PutASMCode(RISCV_STOFF1 + (unit >> 1), opds);
+		offset += unit;
+	}
+}
 
-	case I2: case U2:
-		if (SRC1->kind == SK_Constant)
-		{
-			reg = GetByteReg();
-			SRC2 = reg;			
-			PutASMCode(RISCV_IMMED2MEM, inst->opds);
-		}
-		else
-		{
-		    Symbol opds[2];
-			reg = GetByteReg();
-				
-			opds[0] = reg;
-			opds[1] = SRC1;
-			PutASMCode(RISCV_MEM2REG, opds);
-
-			opds[0] = SRC1;
-			opds[1] = reg;
-			PutASMCode(RISCV_REG2MEM, opds);
-		}
-		break;
+/**
+	Copy size bytes from address in register src to address in register dst.
+	Small blocks are copied inline in units of their alignment,
+	larger ones by memcpy().
+	 typedef struct{
+		 int data[10];
+	 }Data;
+	 Data a,b;
+	 int main(){
+		 a = b;
+		 return 0;
+	 }
+	--------------------
+		lui t1, %hi(a)
+		addi t1, t1, %lo(a)
+		lui t2, %hi(b)
+		addi t2, t2, %lo(b)
+		lw t0, 0(t2)
+		sw t0, 0(t1)
+		......
+ */
+static void EmitMoveBlock(IRInst inst, Symbol dst, Symbol src, int size, int align)
+{
+	Symbol opds[3];
+	Vector live;
 
-	case I4: case U4:
-		if (SRC1->kind == SK_Constant)
-		{
-			reg = GetByteReg();
-			SRC2 = reg;			
-			PutASMCode(RISCV_IMMED2MEM, inst->opds);
-		}
-		else
-		{
-			/**
-				we try to reuse the temporary value in register.
-			 */		
-			 
-			
-			 if(DST->kind != SK_Register)
-			 {
-				 reg0 = GetReg();
-				 opds[1] = DST;
-				 opds[0] = reg0; 
-				 PutASMCode(RISCV_MEM2REG, opds);  
-			 }
-			
-			 if(SRC1->kind != SK_Register)
-			 {
-				 reg1 = GetReg();
-				 opds[1] = SRC1;
-				 opds[0] = reg1; 
-				 PutASMCode(RISCV_MEM2REG, opds);  
-			 }					 
-
-			 
-			 opds[1] = reg1;
-			 opds[0] = reg0; 
-			 PutASMCode(RISCV_MV_R2R, opds); 
-
-			 if(DST->kind == SK_Variable)
-			 {
-			     opds[1] = reg0;
-				 opds[0] = DST; 
-				 PutASMCode(RISCV_REG2MEM, opds);  
-			 }
-
-			 
-		}
-		ModifyVar(DST);
-		break;
+	if (size == 0)
+		return;
 
-	default:
-		assert(0);
+	if (size > MAX_INLINE_BLOCK)
+	{
+		live = SaveLiveRegs(inst);
+		opds[0] = dst;
+		opds[1] = src;
+		opds[2] = IntConstant(size);
+		PutASMCode(RISCV_MEMCPY, opds);
+		RestoreLiveRegs(live);
+		return;
 	}
+
+	CopyBlock(dst, src, size, align);
 }
 
 /**
- * Put the variable in register
+ * Emit assembly code for move
  */
-static Symbol PutInReg(Symbol p)
+static void EmitMove(IRInst inst)
 {
+	int tcode = TypeCode(inst->ty);
 	Symbol reg;
-    Symbol opds[2];
-	if (p->reg != NULL){
-		assert(p->kind == SK_Temp);
-		return p->reg;
+
+	if (tcode == B)
+	{
+		Symbol src = AddressInReg(SRC1);
+
+		EmitMoveBlock(inst, AddressInReg(DST), src, inst->ty->size, inst->ty->align);
+		return;
+	}
+	/**
+		char a,b;
+		int main(){
+			a = b;
+			a = '3';
+			return 0;
+		}
+
+		----------------------------------------
+		lui t0, %hi(b)
+		lb t0, %lo(b)(t0)
+		lui t1, %hi(a)
+		sb t0, %lo(a)(t1)
+
+		li t0, 51
+		lui t1, %hi(a)
+		sb t0, %lo(a)(t1)
+
+	A char or short in a register is extended as its own type, a move
+	to a register of another type extends it again:
+
+		unsigned char v3 = p;	------	andi t3, t3, 255
+		signed char v4;
+		v4 = v3;				------	slli t4, t3, 24
+								------	srai t4, t4, 24
+	 */
+	if (DST->reg != NULL && SRC1->reg != NULL && tcode <= U2 && TypeCode(SRC1->ty) != tcode)
+	{
+		ExtendReg(DST->reg, SRC1->reg, tcode);
+	}
+	else if (DST->reg != NULL)
+	{
+		LoadValue(DST->reg, SRC1, tcode);
+	}
+	else
+	{
+		reg = PutInReg(SRC1);
+		StoreMemory(reg, DST, tcode);
 	}
-	reg = GetReg();
-	// TEMPLATE(X86_MOVI4,    "movl %1, %0")
-	//Move(X86_MOVI4, reg, p);
-	opds[1] = p;
-	opds[0] = reg;
-	PutASMCode(RISCV_MEM2REG, opds);
-	return reg;
 }
 
 /**
@@ -561,14 +633,20 @@ static Symbol PutInReg(Symbol p)
  */
 static void EmitIndirectMove(IRInst inst)
 {
-	Symbol reg;
+	Symbol opds[2], reg;
+	int tcode = TypeCode(inst->ty);
 
 	/// indirect move is the same as move, except using register indirect address
 	/// mode for destination operand
 	reg = PutInReg(DST);
-	inst->opcode = MOV;
-	DST = reg->next;
-	EmitMove(inst);
+	if (tcode == B)
+	{
+		EmitMoveBlock(inst, reg, AddressInReg(SRC1), inst->ty->size, inst->ty->align);
+		return;
+	}
+	opds[0] = PutInReg(SRC1);
+	opds[1] = reg->next;
+	PutASMCode(RISCV_STI1 + tcode - I1, opds);
 }
 
 /**
@@ -577,173 +655,613 @@ static void EmitIndirectMove(IRInst inst)
  //	a+b,		a-b,	a*b,a|b, a << 4
 static void EmitAssign(IRInst inst)
 {
-	int code;
 	int tcode= TypeCode(inst->ty);
-    Symbol opds[3], reg0, reg1, reg2;
+	Symbol opds[3];
 
-	assert(DST->kind == SK_Temp);
+	assert(tcode == I4 || tcode == U4 || tcode == F4 || tcode == F8);
 
-	if (tcode == F4 || tcode == F8)
-	{
-		EmitX87Assign(inst, tcode);//TODO
-		return;
-	}
+	// SRC2 is NULL for unary operator, like '-a'
+	opds[1] = PutInReg(SRC1);
+	opds[2] = SRC2 != NULL ? PutInReg(SRC2) : NULL;
+	opds[0] = GetDstReg(DST);
+	/**
+		TEMPLATE(RISCV_ADDI4,    "add %0, %1, %2")
+		TEMPLATE(RISCV_ADDF8,    "fadd.d %0, %1, %2")
+	 */
+	PutASMCode(ASM_CODE(inst->opcode, tcode), opds);
+	WriteBack(DST, opds[0], TypeCode(DST->ty));
+}
 
-	assert(tcode == I4 || tcode == U4);
+/**
+ * Whether the integer p is known to be 0 or 1
+ */
+static int IsBooleanValue(Symbol p)
+{
+	ValueDef def;
 
-	code = ASM_CODE(inst->opcode, tcode);
+	if (p->kind != SK_Temp)
+		return 0;
 
-    if(SRC1->kind != SK_Register)
-    {
-		reg1 = GetReg();
-		opds[1] = SRC1;
-		opds[0] = reg1;	
-		PutASMCode(RISCV_MEM2REG, opds);  
-    }
+	def = AsVar(p)->def;
+	return def != NULL && def->op >= SEQ && def->op <= SLE;
+}
 
-	if(SRC2->kind != SK_Register)
-	//if (SRC2->kind == SK_Constant)		
-	{
-		// Because "idivl $10" is illegal
-		reg2 = GetReg();
-		opds[1] = SRC2;
-		opds[0] = reg2;	
-		PutASMCode(RISCV_MEM2REG, opds);			
+/**
+	Emit assembly code for min/max and the selects of ?: .
+	Zbb has min/max, Zicond has czero.eqz/czero.nez; without them
+	the value is selected by a mask, there is no branch either.
+		int clamp(int x){
+			return x < 0 ? 0 : x;
+		}
+		---------------------------
+		t0 : max(x, 0)
+		---------------------------
+		max a0, a0, zero			-----	rv32g_zbb
+		srai t0, a0, 31			-----	rv32g
+		not t0, t0
+		and a0, a0, t0
+
+		c ? a : b
+		---------------------------
+		t0 : c ? a : 0
+		t1 : c ? 0 : b
+		t2 : t0 | t1
+		---------------------------
+		czero.eqz t3, a, c			-----	rv32g_zicond
+		czero.nez t4, b, c
+		or t5, t3, t4
+		neg t0, c				-----	rv32g, c is the 0/1 value of a comparison
+		and t3, a, t0
+		addi t0, c, -1
+		and t4, b, t0
+		or t5, t3, t4
+ */
+static void EmitSelect(IRInst inst)
+{
+	int tcode = TypeCode(inst->ty);
+	int op = inst->opcode;
+	Symbol opds[5];
+	Symbol src1 = SRC1, src2 = SRC2;
+	int code, k;
+
+	assert(tcode == I4 || tcode == U4);
+
+	if (op <= MAX && src1->kind == SK_Constant && src1->val.i[0] == 0)
+	{
+		src1 = SRC2;
+		src2 = SRC1;
+	}
+	opds[1] = PutInReg(src1);
+	opds[2] = PutInReg(src2);
+	opds[3] = opds[4] = NULL;
+
+	if ((op <= MAX && (ISAExtensions & ISA_ZBB)) || (op >= SELNZ && (ISAExtensions & ISA_ZICOND)))
+	{
+		code = ASM_CODE(op, tcode);
+	}
+	else if (op <= MAX && tcode == I4 && opds[2] == RISCVRegs[ZERO])
+	{
+		code = RISCV_MINZERO + op - MIN;
+		opds[3] = GetReg();
+	}
+	else if (op <= MAX)
+	{
+		code = RISCV_MASKMINI4 + ((op - MIN) << 1) + tcode - I4;
+		opds[3] = GetReg();
+		// min doesn't read %1 after %4 is written, max doesn't read %2, the scratch register it is loaded in is reused
+		k = op == MIN ? 1 : 2;
+		opds[4] = (k == 1 ? src1 : src2)->reg == NULL && opds[k] != RISCVRegs[ZERO] ? opds[k] : GetReg();
 	}
-	/*else
+	else
 	{
-		AllocateReg(inst, 2);
-	}*/
+		code = (IsBooleanValue(src2) ? RISCV_MASKNZB : RISCV_MASKNZ) + op - SELNZ;
+		opds[3] = GetReg();
+	}
+	// the mask sequences write %0 last, a scratch register can hold the result
+	opds[0] = DST->reg != NULL ? DST->reg : (opds[3] != NULL ? opds[3] : GetReg());
+	PutASMCode(code, opds);
+	WriteBack(DST, opds[0], tcode);
+}
 
-	
+// the steps of a shift/add sequence, a positive step is a left shift
+enum { MUL_ADD = -1, MUL_SUB = -2 };
+// the longest shift/add sequence tried
+#define MAX_MUL_STEPS 12
+// with the M extension, a longer sequence is worse than li + mul
+#define MAX_MUL_STEPS_M 3
 
-    if(DST->kind != SK_Register)
-    {
-		reg0 = GetReg();
-		opds[1] = DST;
-		opds[0] = reg0;	
-		PutASMCode(RISCV_MEM2REG, opds);  
-   }
-	/**
-		We are sure that dst is a temporary,
-		its content is in EAX or EDX
-	 */ 	
-	opds[0] = reg0;
-	opds[1] = reg1;
-	opds[2] = reg2;	
-	PutASMCode(code, opds);
-	/*SpillReg(FuncRegs[A0]);
-	opds[1] = reg0;
-	opds[0] =  FuncRegs[A0];	
-	PutASMCode(RISCV_MV_R2R, opds);*/
-	opds[1] = reg0;
-	opds[0] = DST;	
-	PutASMCode(RISCV_REG2MEM, opds);
-	ModifyVar(DST);
-}
-/**
-	 double c = 9.87;
-	 double d;
-	 int a = 50;char b = 'x';
-	 
-	 int main(){
-		 a = (int)c;
-		 printf("%d \n",a);
-		 a = (int)(c+1.23);
-		 b = (char)(c+1.23);
-		 printf("%d %d .\n",a,b);
-		 d = c + 1.23;
-		 c = (double)((float)(c+1.23))+(c+1.23);
-		 printf("%f\n",c);
-		 return 0;
-	 }
+/**
+	Find the shortest sequence of shifts and adds computing x * c from x,
+	return its length, or a number greater than limit if there is no
+	sequence of at most limit steps.
+		x * 12 = ((x << 1) + x) << 2
+		---------------------------
+		steps:	1, MUL_ADD, 2
+		slli t0, x, 1
+		add t0, t0, x
+		slli dst, t0, 2
+ */
+static int MulSequence(unsigned int c, int steps[], int limit)
+{
+	int seq[MAX_MUL_STEPS];
+	int best, n, k;
+
+	if (c == 1)
+		return 0;
+	if (c == 0 || limit <= 0)
+		return limit + 1;
+
+	if ((c & 1) == 0)
+	{
+		for (k = 0; (c & 1) == 0; k++)
+			c >>= 1;
+		n = MulSequence(c, steps, limit - 1);
+		if (n > limit - 1)
+			return limit + 1;
+		steps[n] = k;
+		return n + 1;
+	}
+
+	// c = (c - 1) + 1 or (c + 1) - 1, the shorter one
+	best = limit + 1;
+	n = MulSequence(c - 1, seq, best - 2);
+	if (n <= best - 2)
+	{
+		memcpy(steps, seq, n * sizeof(int));
+		steps[n] = MUL_ADD;
+		best = n + 1;
+	}
+	if (c != 0xFFFFFFFF)
+	{
+		n = MulSequence(c + 1, seq, best - 2);
+		if (n <= best - 2)
+		{
+			memcpy(steps, seq, n * sizeof(int));
+			steps[n] = MUL_SUB;
+			best = n + 1;
+		}
+	}
+	return best;
+}
 
+/**
+	The shift/add sequence of x * c worth using instead of mul, c or -c is
+	computed, *neg is set if the product is negated at last.
+	Return the number of steps, -1 if mul/__mulsi3 is used.
  */
-static void EmitCast(IRInst inst)
+static int MulSteps(int c, int steps[], int *neg)
 {
-	Symbol dst, reg, opds[2];
-	int code;
+	int seq[MAX_MUL_STEPS];
+	int limit = (ISAExtensions & ISA_M) ? MAX_MUL_STEPS_M : MAX_MUL_STEPS;
+	int n, m;
+
+	*neg = 0;
+	n = MulSequence(c, steps, limit);
+	m = MulSequence(-(unsigned int)c, seq, (n <= limit ? n : limit + 1) - 2);
+	if (m + 1 < n && m + 1 <= limit)
+	{
+		memcpy(steps, seq, m * sizeof(int));
+		*neg = 1;
+		return m;
+	}
+	return n <= limit ? n : -1;
+}
 
-	dst = DST;
+/**
+	Emit dst = x * c by the steps found by MulSteps(), the intermediate
+	results are in register tmp.
+ */
+static void EmitMulSequence(Symbol dst, Symbol x, Symbol tmp, int steps[], int n, int neg)
+{
+	Symbol acc = x, to;
+	int i;
 
-	//  this assertion fails, because TypeCast is not treated as common subexpression in UCC.
-	// assert(DST->kind == SK_Temp);		//  See TryAddValue(..)
+	if (n == 0 && ! neg)
+		MoveReg(dst, x);
+	for (i = 0; i < n; i++)
+	{
+		to = i == n - 1 && ! neg ? dst : tmp;
+		if (steps[i] > 0)
+			Assemble(RISCV_SLLI, to, acc, IntConstant(steps[i]));
+		else
+			Assemble(steps[i] == MUL_ADD ? RISCV_ADDI4 : RISCV_SUBI4, to, acc, x);
+		acc = to;
+	}
+	if (neg)
+		Move(RISCV_NEGI4, dst, acc);
+}
 
-	reg = NULL;
-	code = inst->opcode + RISCV_EXTI1 - EXTI1;
-	switch (code)
+/**
+	The magic number of the signed division by d, 2 <= |d| < 2 power of 31,
+	see Hacker's Delight, 10-4:
+		q = (mulh(x, m) [+ x, if d > 0 and m < 0] [- x, if d < 0 and m > 0]) >> s;
+		q += q >>> 31;		----	round toward zero
+ */
+static void SignedMagic(int d, int *m, int *s)
+{
+	const unsigned int two31 = 0x80000000;
+	unsigned int ad, anc, delta, q1, r1, q2, r2, t;
+	int p;
+
+	ad = d < 0 ? -(unsigned int)d : d;
+	t = two31 + ((unsigned int)d >> 31);
+	anc = t - 1 - t % ad;
+	p = 31;
+	q1 = two31 / anc;
+	r1 = two31 - q1 * anc;
+	q2 = two31 / ad;
+	r2 = two31 - q2 * ad;
+	do
 	{
-	case RISCV_EXTI1:
-	case RISCV_EXTI2:
-	case RISCV_EXTU1:
-	case RISCV_EXTU2:
-		assert(TypeCode(inst->ty) == I4 );
-		AllocateReg(inst, 0);
-		if (DST->reg == NULL)
+		p++;
+		q1 = 2 * q1;
+		r1 = 2 * r1;
+		if (r1 >= anc)
 		{
-			DST = GetReg();
-		}		
-		PutASMCode(code, inst->opds);
-		//	If dst != DST, then the original destination is not temporary,
-		//	we mov the value in register to the named variable.	
-		if (dst != DST)
+			q1++;
+			r1 -= anc;
+		}
+		q2 = 2 * q2;
+		r2 = 2 * r2;
+		if (r2 >= ad)
 		{
-			//Move(X86_MOVI4, dst, DST);			
-			opds[0] = dst;
-			opds[1] =  DST;	
-			PutASMCode(RISCV_REG2MEM, opds);
-		}		
-		break;
+			q2++;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
 
-	case RISCV_TRUI1:		// truncate I4/U4 ---------->  I1		
-		assert(TypeCode(SRC1->ty) == I4 || TypeCode(SRC1->ty) == U4);
+	*m = q2 + 1;
+	if (d < 0)
+		*m = -*m;
+	*s = p - 32;
+}
 
-		if (SRC1->reg != NULL)
+/**
+	The magic number of the unsigned division by d, 2 <= d < 2 power of 31,
+	see Hacker's Delight, 10-8.
+	If *add is 0:
+		q = mulhu(x, m) >> s;
+	otherwise m is 2 power of 32 too small:
+		t = mulhu(x, m);
+		q = (((x - t) >> 1) + t) >> (s - 1);
+ */
+static void UnsignedMagic(unsigned int d, unsigned int *m, int *s, int *add)
+{
+	unsigned int nc, delta, q1, r1, q2, r2;
+	int p;
+
+	*add = 0;
+	nc = -1 - (-d) % d;
+	p = 31;
+	q1 = 0x80000000 / nc;
+	r1 = 0x80000000 - q1 * nc;
+	q2 = 0x7FFFFFFF / d;
+	r2 = 0x7FFFFFFF - q2 * d;
+	do
+	{
+		p++;
+		if (r1 >= nc - r1)
 		{
-			reg = GetByteReg();
+			q1 = 2 * q1 + 1;
+			r1 = 2 * r1 - nc;
 		}
-		if (reg == NULL)
+		else
 		{
-			reg = GetByteReg();
-			//Move(X86_MOVI4, X86Regs[reg->val.i[0]], SRC1);
-			opds[0] = reg;
-			opds[1] =  SRC1;	
-			PutASMCode(RISCV_MEM2REG, opds);			
+			q1 = 2 * q1;
+			r1 = 2 * r1;
 		}
-		//Move(X86_MOVI1, DST, reg);
-		opds[0] = DST;
-		opds[1] = reg;	
-		PutASMCode(RISCV_REG2MEM, opds);		
-		break;
+		if (r2 + 1 >= d - r2)
+		{
+			if (q2 >= 0x7FFFFFFF)
+				*add = 1;
+			q2 = 2 * q2 + 1;
+			r2 = 2 * r2 + 1 - d;
+		}
+		else
+		{
+			if (q2 >= 0x80000000)
+				*add = 1;
+			q2 = 2 * q2;
+			r2 = 2 * r2 + 1;
+		}
+		delta = d - 1 - r2;
+	} while (p < 64 && (q1 < delta || (q1 == delta && r1 == 0)));
+
+	*m = q2 + 1;
+	*s = p - 32;
+}
+
+/**
+	Whether the integer division x / d or x % d is done inline.
+	Dividing by the constant is a multiply-high by its magic number, which
+	needs the M extension; a few divisors only need compares or shifts.
+ */
+static int IsInlineDivision(int tcode, int d)
+{
+	if (d == 0 || d == 1)
+		return 0;
+	if (tcode == U4)
+		return (unsigned int)d >= 0x80000000 || (ISAExtensions & ISA_M);
+
+	return d == -1 || d == INT_MIN || (ISAExtensions & ISA_M);
+}
+
+/**
+	Emit x / d or x % d into register dst, or into a scratch register
+	if dst is NULL, return the register, see IsInlineDivision().
+		unsigned f(unsigned x){
+			return x / 10;
+		}
+		---------------------------
+		li t0, -858993459
+		mulhu t0, a0, t0
+		srli a0, t0, 3
+
+		int g(int x){
+			return x % 1000;
+		}
+		---------------------------
+		li t0, 274877907
+		mulh t0, a0, t0
+		srai t0, t0, 6
+		srli t1, t0, 31
+		add t0, t0, t1
+		li t1, 1000
+		mul t1, t0, t1
+		sub a0, a0, t1
+ */
+static Symbol EmitDivision(IRInst inst, Symbol dst, Symbol x, int d)
+{
+	int tcode = TypeCode(inst->ty);
+	int mod = inst->opcode == MOD;
+	int steps[MAX_MUL_STEPS];
+	Symbol q, t, last;
+	unsigned int um;
+	int m, s, add, n, neg;
+
+	q = GetReg();
+	t = GetReg();
+	if (dst == NULL)
+		dst = q;
+	// the last instruction of the quotient writes dst directly
+	last = mod ? q : dst;
+
+	if (tcode == I4 && d == -1)
+	{
+		// x % -1 is 0
+		if (mod)
+			Move(RISCV_MOV, dst, RISCVRegs[ZERO]);
+		else
+			Move(RISCV_NEGI4, dst, x);
+		return dst;
+	}
+	if (tcode == I4 && d == INT_MIN)
+	{
+		// q = (x == INT_MIN), r = x - (q << 31)
+		LoadValue(t, IntConstant(d), I4);
+		Assemble(ASM_CODE(SEQ, I4), last, x, t);
+		if (mod)
+		{
+			Assemble(RISCV_SLLI, t, q, IntConstant(31));
+			Assemble(RISCV_SUBI4, dst, x, t);
+		}
+		return dst;
+	}
+	if (tcode == U4 && (unsigned int)d >= 0x80000000)
+	{
+		// q = (x >= d), r = x - (q ? d : 0)
+		LoadValue(t, IntConstant(d), U4);
+		Assemble(ASM_CODE(SGE, U4), last, x, t);
+		if (mod)
+		{
+			Move(RISCV_NEGI4, q, q);
+			Assemble(RISCV_BANDI4, t, t, q);
+			Assemble(RISCV_SUBI4, dst, x, t);
+		}
+		return dst;
+	}
+
+	if (tcode == I4)
+	{
+		SignedMagic(d, &m, &s);
+		LoadValue(q, IntConstant(m), I4);
+		Assemble(RISCV_MULH, q, x, q);
+		if (d > 0 && m < 0)
+			Assemble(RISCV_ADDI4, q, q, x);
+		else if (d < 0 && m > 0)
+			Assemble(RISCV_SUBI4, q, q, x);
+		if (s > 0)
+			Assemble(RISCV_SRAI, q, q, IntConstant(s));
+		Assemble(RISCV_SRLI, t, q, IntConstant(31));
+		Assemble(RISCV_ADDI4, last, q, t);
+	}
+	else
+	{
+		UnsignedMagic(d, &um, &s, &add);
+		LoadValue(q, IntConstant(um), U4);
+		if (! add)
+		{
+			Assemble(RISCV_MULHU, s > 0 ? q : last, x, q);
+			if (s > 0)
+				Assemble(RISCV_SRLI, last, q, IntConstant(s));
+		}
+		else
+		{
+			Assemble(RISCV_MULHU, q, x, q);
+			Assemble(RISCV_SUBI4, t, x, q);
+			Assemble(RISCV_SRLI, t, t, IntConstant(1));
+			Assemble(RISCV_ADDI4, s > 1 ? q : last, t, q);
+			if (s > 1)
+				Assemble(RISCV_SRLI, last, q, IntConstant(s - 1));
+		}
+	}
+	if (! mod)
+		return dst;
+
+	// r = x - q * d, or x + q * -d
+	n = MulSteps(tcode == I4 && d < 0 ? -d : d, steps, &neg);
+	if (n > 0)
+	{
+		EmitMulSequence(t, q, t, steps, n, neg);
+	}
+	else
+	{
+		LoadValue(t, IntConstant(tcode == I4 && d < 0 ? -d : d), I4);
+		Assemble(RISCV_MULI4, t, q, t);
+	}
+	Assemble(tcode == I4 && d < 0 ? RISCV_ADDI4 : RISCV_SUBI4, dst, x, t);
+	return dst;
+}
+
+/**
+	Whether the integer MUL/DIV/MOD instruction calls __mulsi3 etc.,
+	which is only done without the M extension.
+	The register allocator treats such instructions as calls.
+ */
+int IsMulDivCall(IRInst inst)
+{
+	int steps[MAX_MUL_STEPS];
+	int tcode = TypeCode(inst->ty);
+	int neg;
+
+	if ((ISAExtensions & ISA_M) || tcode == F4 || tcode == F8)
+		return 0;
+
+	if (inst->opcode == MUL)
+	{
+		if (SRC2->kind == SK_Constant)
+			return MulSteps(SRC2->val.i[0], steps, &neg) < 0;
+		return SRC1->kind != SK_Constant || MulSteps(SRC1->val.i[0], steps, &neg) < 0;
+	}
+	return SRC2->kind != SK_Constant || ! IsInlineDivision(tcode, SRC2->val.i[0]);
+}
+
+/**
+	Emit assembly code for MUL, DIV and MOD.
+	An integer multiplication by constant is done by shifts and adds, and
+	a division by constant by the multiply-high of its magic number,
+	see MulSteps() and EmitDivision().
+	The powers of 2 are already shifts and masks, see Simplify().
+	Without the M extension, the others call __mulsi3, __divsi3,
+	__udivsi3, __modsi3 or __umodsi3 of libgcc.
+ */
+static void EmitMulDiv(IRInst inst)
+{
+	int tcode = TypeCode(inst->ty);
+	int steps[MAX_MUL_STEPS];
+	Symbol opds[3], x, c;
+	Vector live;
+	int n, neg;
+
+	if (tcode == F4 || tcode == F8)
+	{
+		EmitAssign(inst);
+		return;
+	}
 
-	case RISCV_TRUI2:		// // truncate I4/U4 ---------->  I2
+	x = SRC1;
+	c = SRC2;
+	if (inst->opcode == MUL && x->kind == SK_Constant)
+	{
+		x = SRC2;
+		c = SRC1;
+	}
+	if (c->kind == SK_Constant && inst->opcode == MUL && (n = MulSteps(c->val.i[0], steps, &neg)) >= 0)
+	{
+		opds[1] = PutInReg(x);
+		opds[0] = GetDstReg(DST);
+		EmitMulSequence(opds[0], opds[1], GetReg(), steps, n, neg);
+		WriteBack(DST, opds[0], tcode);
+		return;
+	}
+	if (c->kind == SK_Constant && inst->opcode != MUL && IsInlineDivision(tcode, c->val.i[0]))
+	{
+		opds[1] = PutInReg(x);
+		opds[0] = EmitDivision(inst, DST->reg, opds[1], c->val.i[0]);
+		WriteBack(DST, opds[0], tcode);
+		return;
+	}
+	if (ISAExtensions & ISA_M)
+	{
+		EmitAssign(inst);
+		return;
+	}
 
-		assert(TypeCode(SRC1->ty) == I4 || TypeCode(SRC1->ty) == U4);
+	live = SaveLiveRegs(inst);
+	opds[1] = PutInReg(SRC1);
+	opds[2] = PutInReg(SRC2);
+	// SRC2 in a0 would be overwritten by the first argument
+	if (opds[2] == FuncRegs[A0])
+	{
+		opds[2] = GetReg();
+		MoveReg(opds[2], FuncRegs[A0]);
+	}
+	opds[0] = GetDstReg(DST);
+	if (inst->opcode == MUL)
+		PutASMCode(RISCV_MULSI3, opds);
+	else
+		PutASMCode((inst->opcode == DIV ? RISCV_DIVSI3 : RISCV_MODSI3) + (tcode == U4), opds);
+	WriteBack(DST, opds[0], tcode);
+	RestoreLiveRegs(live);
+}
+/**
+	 char ch = -1;
+	 unsigned short us;
+	 int main(){
+		 int a = ch;		-------- EXTI1, lb of ch extends it already
+		 us = (unsigned short) a;	-------- TRUI2
+		 return 0;
+	 }
+	The value of a char/short temporary in register is kept extended,
+	so EXT* is a register move, and TRU* extends the low bits.
+ */
+static void EmitCast(IRInst inst)
+{
+	Symbol opds[2];
+	int code, tcode, stcode;
 
-		if (SRC1->reg != NULL)
+	code = inst->opcode + RISCV_EXTI1 - EXTI1;
+	tcode = TypeCode(inst->ty);
+	switch (code)
+	{
+	case RISCV_EXTI1:
+	case RISCV_EXTI2:
+	case RISCV_EXTU1:
+	case RISCV_EXTU2:
+		assert(tcode == I4);
+		// (int)(unsigned char)c, the extension is decided by the opcode, not by c
+		stcode = I1 + code - RISCV_EXTI1;
+		opds[0] = GetDstReg(DST);
+		if (SRC1->reg != NULL && TypeCode(SRC1->ty) != stcode)
+		{
+			ExtendReg(opds[0], SRC1->reg, stcode);
+		}
+		else
 		{
-			reg = GetReg();
+			LoadValue(opds[0], SRC1, stcode);
 		}
-		if (reg == NULL)
+		WriteBack(DST, opds[0], tcode);
+		break;
+
+	case RISCV_TRUI1:		// truncate I4/U4 ---------->  I1/U1
+	case RISCV_TRUI2:		// truncate I4/U4 ---------->  I2/U2
+		opds[1] = PutInReg(SRC1);
+		if (DST->reg == NULL)
 		{
-			reg = GetReg();
-			//Move(X86_MOVI4, X86Regs[reg->val.i[0]], SRC1);
-			opds[0] = reg;
-		    opds[1] = SRC1;	
-		    PutASMCode(RISCV_MEM2REG, opds);
+			// sb/sh takes the low bits
+			StoreMemory(opds[1], DST, tcode);
+			break;
 		}
-		//Move(X86_MOVI2, DST, reg);
-		opds[0] = DST;
-	    opds[1] = reg;	
-		PutASMCode(RISCV_REG2MEM, opds);		
+		ExtendReg(DST->reg, opds[1], tcode);
 		break;
 	/**
 		Warning:
 			There is not X86_CVTI1F4/X86_CVTU1F4/X86_CVTI2F4/X86_CVTU2F4
 			Because the actual work is done by 2 steps:
-				
+
 			For example:
-			
+
 			char ch = 'a';
 			double d;
 			int main(){
@@ -756,134 +1274,115 @@ static void EmitCast(IRInst inst)
 			d = (double)(int)t0;	-----------CVTI4F8
 			return 0;
 			ret
-			-----------------------------------
-			 movsbl ch, %eax		-----------EXTI1
-			 
-			 pushl %eax			-----------CVTI4F8
-			 fildl (%esp)
-			 fstpl d
-			 
-			 movl $0, %eax
-
 	 */
-	case RISCV_CVTI4F4:
-	case RISCV_CVTI4F8:
-	case RISCV_CVTU4F4:
-	case RISCV_CVTU4F8:	
-		assert(X87Top != DST);		
-		/**
-			 TEMPLATE(X86_CVTI4F4,	"pushl %1;fildl (%%esp);fstps %0")
-			TEMPLATE(X86_CVTI4F8,  "pushl %1;fildl (%%esp);fstpl %0")
-			TEMPLATE(X86_CVTU4F4,  "pushl $0;pushl %1;fildq (%%esp);fstps %0")
-			TEMPLATE(X86_CVTU4F8,  "pushl $0;pushl %1;fildq (%%esp);fstpl %0")
-		 */
-		PutASMCode(code, inst->opds); //TODO
-		break;
-
 	default:
 		/**
-			Because the following PutASMCode(...) doesn't check X87 TOP,
-			so we have to save it here.
+			TEMPLATE(RISCV_CVTI4F8,  "fcvt.d.w %0, %1")
+			TEMPLATE(RISCV_CVTF8I4,  "fcvt.w.d %0, %1, rtz")
+			C truncates toward zero when converting to integer.
 		 */
-		SaveX87Top();
-		if(code != RISCV_CVTF4 && code != RISCV_CVTF8){
-			/**
-				CVTF4I4,CVTF4U4,CVTF8I4,CVTF8U4
-				The assembly code in x86linux.tpl use EAX to store
-				the casted result.				
-			 */
-			assert(code == RISCV_CVTF4I4 || code == RISCV_CVTF4U4
-					|| code == RISCV_CVTF8I4 || code == RISCV_CVTF8U4 ); 
-			SpillReg(FuncRegs[A0]);
-			AllocateReg(inst, 0);
-			PutASMCode(code, inst->opds);
-			/**
-				(DST->reg && DST->reg != X86Regs[EAX]) :
-					DST is a temporary and allocated in another register other than EAX,
-				DST->reg == NULL
-					DST is global/static/local variable
-			 */
-			if ((DST->reg && DST->reg != FuncRegs[A0]) || DST->reg == NULL){
-				//Move(X86_MOVI4, DST, X86Regs[EAX]);
-				opds[0] = DST;
-	    		opds[1] = FuncRegs[A0];	
-				PutASMCode(RISCV_REG2MEM, opds);
-			}			
-		}else{
-			PutASMCode(code, inst->opds); 
-		}
-		// we have touched the X87top in the last statement; mark it invalid explicitely.
-		X87Top = NULL;
+		opds[1] = PutInReg(SRC1);
+		opds[0] = GetDstReg(DST);
+		PutASMCode(code, opds);
+		WriteBack(DST, opds[0], tcode);
 		break;
 	}
-	ModifyVar(dst);
+}
+/**
+	f++, the constant 1.0 is converted from integer 1
+		li t0, 1
+		fcvt.s.w ft0, t0
+		fadd.s fs0, fs0, ft0
+ */
+static void EmitFloatIncDec(IRInst inst, int code)
+{
+	int tcode = TypeCode(inst->ty);
+	Symbol opds[3];
 
+	opds[0] = PutInReg(DST);
+	opds[1] = GetReg();
+	opds[2] = GetFReg();
+	PutASMCode(code + tcode, opds);
+	WriteBack(DST, opds[0], tcode);
 }
-//	a++	, float/double is also done here.	
+//	a++	, float/double is also done here.
 static void EmitInc(IRInst inst)
 {
+	int tcode = TypeCode(inst->ty);
+	Symbol reg;
+
+	if (tcode == F4 || tcode == F8)
+	{
+		EmitFloatIncDec(inst, RISCV_INCI1);
+		return;
+	}
+
+	reg = DST->reg != NULL ? DST->reg : PutInReg(DST);
 	/**
-		 TEMPLATE(X86_INCI1,	"incb %0")
-		 TEMPLATE(X86_INCU1,	"incb %0")
-		 TEMPLATE(X86_INCI2,	"incw %0")
-		 TEMPLATE(X86_INCU2,	"incw %0")				 
-		 TEMPLATE(X86_INCI4,	"incl %0")
-		 TEMPLATE(X86_INCU4,	"incl %0")
-		 TEMPLATE(X86_INCF4,	"fld1;fadds %0;fstps %0")
+		 TEMPLATE(RISCV_INCI4,    "addi %0, %0, 1")
 	 */
-	PutASMCode(RISCV_INCI1 + TypeCode(inst->ty), inst->opds);
+	PutASMCode(RISCV_INCI1 + tcode, &reg);
+	if (DST->reg != NULL)
+		ExtendReg(reg, reg, tcode);
+	WriteBack(DST, reg, TypeCode(DST->ty));
 }
 //	a--
 static void EmitDec(IRInst inst)
 {
-	//PRINT_CUR_IRInst(inst);
-	PutASMCode(RISCV_DECI1 + TypeCode(inst->ty), inst->opds);
+	int tcode = TypeCode(inst->ty);
+	Symbol reg;
+
+	if (tcode == F4 || tcode == F8)
+	{
+		EmitFloatIncDec(inst, RISCV_DECI1);
+		return;
+	}
+
+	reg = DST->reg != NULL ? DST->reg : PutInReg(DST);
+	PutASMCode(RISCV_DECI1 + tcode, &reg);
+	if (DST->reg != NULL)
+		ExtendReg(reg, reg, tcode);
+	WriteBack(DST, reg, TypeCode(DST->ty));
 }
 
 static void EmitBranch(IRInst inst)
 {
 	int tcode = TypeCode(inst->ty);
 	BBlock p = (BBlock)DST;
+	Symbol opds[4];
 	/**
 		We make the inst->opds[0] to a SK_Lable here.
 	 */
-	DST = p->sym;
+	opds[0] = p->sym;
 	if (tcode == F4 || tcode == F8)
 	{
-		//  see examples/cfg/crossBB.c
-		ClearRegs();
-		EmitX87Branch(inst, tcode);//TODO
+		/**
+			The comparison result is set in an integer register,
+			f == 0.0 is compared with the zero made in opds[2].
+			TEMPLATE(RISCV_JLF8,     "flt.d %3, %1, %2;bnez %3, %0")
+		 */
+		opds[1] = PutInReg(SRC1);
+		opds[2] = SRC2 != NULL ? PutInReg(SRC2) : GetFReg();
+		opds[3] = GetReg();
+		PutASMCode(ASM_CODE(inst->opcode, tcode), opds);
 		return;
 	}
+	// char/short values in register are extended already
+	if (tcode < I4)
+		tcode = tcode & 1 ? U4 : I4;
 
-	assert(tcode >= I4);
-	
-	if (SRC2)
-	{
-		if (SRC2->kind != SK_Constant)
-		{
-			SRC1 = PutInReg(SRC1);
-		}
-	}
-
-	SRC1->ref--;
-	if (SRC1->reg != NULL)
-		SRC1 = SRC1->reg;
-	if (SRC2)
-	{
-		SRC2->ref--;
-		if (SRC2->reg != NULL)
-			SRC2 = SRC2->reg;
-	}
-	ClearRegs();
-	PutASMCode(ASM_CODE(inst->opcode, tcode), inst->opds);
+	opds[1] = PutInReg(SRC1);
+	opds[2] = SRC2 != NULL ? PutInReg(SRC2) : NULL;
+	/**
+		TEMPLATE(RISCV_JLI4,     "blt %1, %2, %0")
+	 */
+	PutASMCode(ASM_CODE(inst->opcode, tcode), opds);
 }
 /**
 	(1)	the target of Jump is a BBlock, not Variable.
 		So no DST->ref -- here.
-	(2)  X87 top is saved in EmitBlock(),
-		because Jump must be the last IL in a basic 
-		block.
+	(2)	Every temporary stays in its register across basic blocks,
+		nothing has to be spilled before jumping.
  */
 static void EmitJump(IRInst inst)
 {
@@ -891,9 +1390,7 @@ static void EmitJump(IRInst inst)
 
 	DST = p->sym;
 	assert(DST->kind == SK_Label);
-	ClearRegs();
-	//PutASMCode(X86_JMP, inst->opds); 
-	PutASMCode(RISCV_JUMP_OFFSET, inst->opds); 
+	PutASMCode(RISCV_JMP, inst->opds);
 }
 /**
 	 switch(a){
@@ -902,13 +1399,13 @@ static void EmitJump(IRInst inst)
 			 break;
 		 case 2:
 			 a = 200;
-			 break;  
-		 case 3:	 
+			 break;
+		 case 3:
 			 a = 300;
 			 break;
 	 }
-	 
-	IRinst	goto (BB0,BB1,BB2,)[t0];	 ---------------  ijmp	 21 
+
+	IRinst	goto (BB0,BB1,BB2,)[t0];	 ---------------  ijmp	 21
 
 			SRC1--------------t0
 			DST	--------------[BB0,BB1,BB2,NULL]
@@ -917,22 +1414,23 @@ static void EmitJump(IRInst inst)
 	 swtchTable1:	 .long	 .BB0	----------	DefineAddress()
 				 .long	 .BB1
 				 .long	 .BB2
-				 
-	 .text
-	 
-		 jmp *swtchTable1(,%eax,4)
 
+	 .text
+		slli t0, a0, 2
+		lui t1, %hi(swtchTable1)
+		add t0, t0, t1
+		lw t0, %lo(swtchTable1)(t0)
+		jr t0
  */
 static void EmitIndirectJump(IRInst inst)
 {
 	BBlock *p;
 	Symbol swtch;
 	int len;
-	Symbol reg, reg1, reg2, opds[3];
-	
-	SRC1->ref--;
+	Symbol opds[4];
+
 	p = (BBlock *)DST;
-	reg = PutInReg(SRC1);
+	opds[1] = PutInReg(SRC1);
 
 	PutString("\n");
 	Segment(DATA);
@@ -945,9 +1443,7 @@ static void EmitIndirectJump(IRInst inst)
 	swtch->level = 0;
 	DefineGlobal(swtch);
 
-	DST = swtch;
-	len = strlen(DST->aname);
-	//PRINT_DEBUG_INFO(("%s ",DST->aname));
+	len = strlen(swtch->aname);
 	while (*p != NULL)
 	{
 		DefineAddress((*p)->sym);
@@ -960,48 +1456,25 @@ static void EmitIndirectJump(IRInst inst)
 
 	Segment(CODE);
 
-	SRC1 = reg;
-	ClearRegs();
-	// TEMPLATE(X86_IJMP,     "jmp *%0(,%1,4)")
-	//mul %1 * 4
-	reg1 = GetReg();
-	reg2 = GetReg();
-	opds[0] = reg2;
-	opds[1] = IntConstant(4);	
-	PutASMCode(RISCV_LOADIMME2REG, opds);
-    opds[0] = reg1;
-    opds[1] = reg2;
-    opds[2] = reg;	
-	PutASMCode(RISCV_MULI4, opds);
-    opds[0] = reg2;
-    opds[1] = reg1;
-    opds[2] = DST;	
-	PutASMCode(RISCV_ADDI4, opds);
-	DST = reg2;
-	//PutASMCode(X86_IJMP, inst->opds);
-	PutASMCode(RISCV_JUMP_OFFSET, inst->opds);
+	opds[0] = GetReg();
+	opds[2] = GetReg();
+	opds[3] = swtch;
+	PutASMCode(RISCV_IJMP, opds);
 }
 /**
-	See TranslateReturnStatement()							
+	See TranslateReturnStatement()
 	(1) The actual return action is done by Jumping to exitBB.
 	(2) EmitReturn() here is just preparing the return value.
  */
 static void EmitReturn(IRInst inst)
 {
 	Type ty = inst->ty;
+	Symbol addr;
 
+	// float and double are returned in fa0
 	if (IsRealType(ty))
-	{		
-		if (X87Top != DST)
-		{			
-		    //TODO:
-			int tcode = TypeCode(ty);
-			SaveX87Top();
-			// TEMPLATE(X86_LDF4,	   "flds %0")
-			// When X87Top is NULL, X87TCode could be 0.
-			PutASMCode(RISCV_LDF4 + tcode - F4, inst->opds);
-		}
-		X87Top = NULL;
+	{
+		LoadValue(FArgRegs[FA0], DST, TypeCode(ty));
 		return;
 	}
 	/**
@@ -1009,131 +1482,238 @@ static void EmitReturn(IRInst inst)
 	 */
 	if (IsRecordType(ty) && IsNormalRecord(ty))
 	{
-		inst->opcode = IMOV;
-		SRC1 = DST;
-		// see  EmitFunction()
-		DST = FSYM->params;
-		// The actual work is done in EmitMoveBlock()
-		EmitIndirectMove(inst);
+		Symbol src = AddressInReg(DST);
+
+		// see  EmitFunction(), recvaddr is the first parameter
+		EmitMoveBlock(inst, PutInReg(FSYM->params), src, ty->size, ty->align);
 		return;
 	}
 	/**
-		We don't need to  call SpillReg(...) for EAX and EDX here.
-		because in UCC, register only contains value for temporaries.
-		When we return from function,these temporaries is not needed
-		any more.
+		 typedef struct{
+			 int arr[2];
+		 }Data;
+		 ---------------------------------
+		 Data GetData(void){
+			Data dt;
+			return dt;
+		}
+		-------------------------------------
+		 GetData:
+			........
+			addi t0, s0, -16
+			lw a0, 0(t0)
+			lw a1, 4(t0)
 	 */
-
-	Symbol opds[2];
-	switch (ty->size)
+	if (IsRecordType(ty))
 	{
-	case 1:
-		//Move(X86_MOVI1, X86ByteRegs[EAX], DST);
-		opds[1] = DST;
-		opds[0] = FuncRegs[A0];
-		PutASMCode(RISCV_MEM2REG, opds);
-		break;
+		if (ty->size == 0)
+			return;
+		addr = AddressInReg(DST);
+		LoadPartialWord(FuncRegs[A0], addr, 0, ty->size > 4 ? 4 : ty->size, ObjectAlign(DST));
+		if (ty->size > 4)
+			LoadPartialWord(FuncRegs[A1], addr, 4, ty->size - 4, ObjectAlign(DST));
+		return;
+	}
+	LoadValue(FuncRegs[A0], DST, TypeCode(ty));
+}
 
-	case 2:
-		//Move(X86_MOVI2, X86WordRegs[EAX], DST);
-		opds[1] = DST;
-		opds[0] = FuncRegs[A0];
-		PutASMCode(RISCV_MEM2REG, opds);		
-		break;
+/**
+	RISC-V ILP32D calling convention.
+	A float or double argument in fixed position, i.e. not matching the
+	ellipsis of a variadic function, is passed in fa0-fa7 while they last.
+	The other arguments are laid out in consecutive words:
+		(1) a scalar of at most 4 bytes takes one word,
+		(2) a double or a record of at most 8 bytes takes one or two words;
+			when it is 8-byte aligned and it is a variadic argument or
+			passed on stack, it starts at an even word,
+		(3) a bigger record is copied by the caller, and the address
+			of the copy takes one word.
+	The first 8 words are passed in a0-a7, word i (i >= 8) is passed
+	at (i - 8) * 4 of the stack pointer at the call, which is 16-byte aligned.
+	When the returned record is bigger than 8 bytes, the address to receive it
+	is passed as word 0, see EmitFunction().
+	A float or double is returned in fa0.
+ */
+#define NUM_ARG_REGS 8
+#define NUM_FARG_REGS 8
+#define ByReference(ty) (IsRecordType(ty) && (ty)->size > 2 * STACK_ALIGN_SIZE)
+// the argument passed in words is accessed word by word
+#define InWords(ty) (IsRecordType(ty) || IsRealType(ty))
 
-	case 4:
-		/*if (DST->reg != X86Regs[EAX])
-		{
-			Move(X86_MOVI4, X86Regs[EAX], DST);
-		}*/
-		opds[1] = DST;
-		opds[0] = FuncRegs[A0];
-		PutASMCode(RISCV_MEM2REG, opds);		
-		break;
+static int ArgWords(Type ty)
+{
+	if (ByReference(ty))
+		return 1;
 
-	case 8:
-		/**
-			 typedef struct{
-				 int arr[2];
-			 }Data;
-			 ---------------------------------
-			 Data GetData(void){
-				Data dt;
-				return dt;
-			}
-			-------------------------------------
-			 GetData:
-				........
-				 subl $8, %esp
-				 movl -8(%ebp), %eax
-				 movl -4(%ebp), %edx
+	return ALIGN(ty->size, STACK_ALIGN_SIZE) / STACK_ALIGN_SIZE;
+}
 
-		 */
-		//Move(X86_MOVI4, X86Regs[EAX], DST);
-		//Move(X86_MOVI4, X86Regs[EDX], CreateOffset(T(INT), DST, 4,DST->pcoord));
+/**
+ * Return the word of the argument after the one of type ty starting from word w
+ */
+static int NextArgWord(Type ty, int variadic, int *w)
+{
+	if (ty->align > STACK_ALIGN_SIZE && ! ByReference(ty) && (variadic || *w >= NUM_ARG_REGS))
+		*w = ALIGN(*w, 2);
 
-		opds[1] = DST;
-		opds[0] = FuncRegs[A0];
-		PutASMCode(RISCV_MEM2REG, opds);
+	return *w + ArgWords(ty);
+}
 
-		opds[1] = CreateOffset(T(INT), DST, 4,DST->pcoord);
-		opds[0] = FuncRegs[A1];
-		PutASMCode(RISCV_MEM2REG, opds);
-		break;
+/**
+ * Return the number of arguments in fixed position when calling fn with nargs arguments
+ */
+static int FixedArgs(Symbol fn, int nargs)
+{
+	Type ty = fn->ty;
+	Signature sig;
 
-	default:
-		assert(0);
-	}
+	if (IsPtrType(ty))
+		ty = ty->bty;
+	sig = ((FunctionType)ty)->sig;
+	if (! sig->hasEllipsis)
+		return nargs;
+
+	return sig->params != NULL ? LEN(sig->params) : 0;
 }
 
-static void PushArgument(Symbol p, Type ty)
+/**
+	Put word j of argument p passed in words into register reg.
+	A record or a floating-point value in memory is read through
+	its address in register addr.  RV32 can't move a double from
+	f register to integer registers directly, it goes through stack.
+ */
+static void LoadArgWord(Symbol reg, Symbol p, Symbol addr, int j)
 {
-	int tcode = TypeCode(ty);
-	/**
-		We call SaveX87Top() in EmitBBlock() when it is "EmitCall()".
-		In fact, when "p == X87Top",
-		we can generate more efficient code here.
-	 */
-	if (tcode == F4)
+	Symbol opds[3];
+	int size;
+
+	if (addr == NULL)
 	{
-		PutASMCode(RISCV_PUSHF4, &p);//TODO
+		if (TypeCode(p->ty) == F4)
+		{
+			Move(RISCV_FMVXW, reg, p->reg);
+			return;
+		}
+		opds[j] = reg;
+		opds[1 - j] = GetReg();
+		opds[2] = p->reg;
+		PutASMCode(RISCV_FMVXD, opds);
+		return;
 	}
-	else if (tcode == F8)
+	size = p->ty->size - j * 4 > 4 ? 4 : p->ty->size - j * 4;
+	LoadPartialWord(reg, addr, j * 4, size, ObjectAlign(p));
+}
+
+/**
+	Copy size bytes from address in register src to the top of stack, which
+	is then lowered below the copy.  Bigger blocks are copied by a loop,
+	which can't clobber any register holding an argument as memcpy() does.
+		addi sp, sp, -304
+		addi t0, t0, 300
+		addi t1, sp, 300
+	.BB9:
+		addi t0, t0, -4
+		addi t1, t1, -4
+		lw t2, 0(t0)
+		sw t2, 0(t1)
+		bne t1, sp, .BB9
+ */
+static void PushBlock(Symbol src, int size, int align)
+{
+	Symbol opds[5];
+	int unit = align >= 4 ? 4 : 1;
+
+	opds[0] = IntConstant(ALIGN(size, FRAME_ALIGN_SIZE));
+	PutASMCode(RISCV_EXPANDF, opds);
+	if (size <= MAX_INLINE_BLOCK)
 	{
-		PutASMCode(RISCV_PUSHF8, &p);//TODO
+		CopyBlock(RISCVRegs[SP], src, size, align);
+		return;
 	}
-	else if (tcode == B)
+
+	size = ALIGN(size, unit);
+	AddImm(src, src, size);
+	opds[2] = GetReg();
+	AddImm(opds[2], RISCVRegs[SP], size);
+
+	opds[0] = CreateLabel();
+	opds[1] = src;
+	opds[3] = GetReg();
+	opds[4] = IntConstant(unit);
+	DefineLabel(opds[0]);
+	PutASMCode(unit == 4 ? RISCV_COPYDOWN4 : RISCV_COPYDOWN1, opds);
+}
+
+/**
+	Move the values of srcs[i] into the registers dsts[i] at the same time.
+	The registers are all integer registers or all f registers.
+	A register move waits until its destination is not the source of
+	another pending move; when all the pending moves wait for each other,
+	one source is copied to a scratch register to break the cycle.
+ */
+static void ParallelMove(Symbol dsts[], Symbol srcs[], int n)
+{
+	Symbol from[NUM_ARG_REGS], reg, cycle[2];
+	int pending[NUM_ARG_REGS];
+	int i, j, npending, blocked, progress;
+
+	cycle[0] = cycle[1] = NULL;
+
+	npending = 0;
+	for (i = 0; i < n; i++)
 	{
-		int count = 0;
-		Symbol opds[3], rg0, rg1, rg2;
-		rg0 = GetReg();
-		rg1 = GetReg();
-		rg2 = GetReg();
-			
-	    opds[0] = p;
-		opds[1] = rg0; 	
-		PutASMCode(RISCV_LUI_ADDI_LEAL, opds);
-		PutASMCode(RISCV_EXPANDF, IntConstant(ALIGN(ty->size, STACK_ALIGN_SIZE)));
-		
+		from[i] = srcs[i];
+		pending[i] = from[i] != dsts[i];
+		npending += pending[i];
+	}
 
-		for(count = 0; count < ty->size; count += 4)
+	while (npending > 0)
+	{
+		progress = 0;
+		for (i = 0; i < n; i++)
 		{
-			 opds[0] = rg2;
-			 opds[1] = IntConstant(count);
-			 opds[2] = rg0;
-			 PutASMCode(RISCV_MEM2REG_OFFSET, opds);	
-			 PutASMCode(RISCV_REG2STACK, opds);	
+			if (! pending[i])
+				continue;
+			blocked = 0;
+			for (j = 0; j < n; j++)
+			{
+				if (j != i && pending[j] && from[j] == dsts[i])
+					blocked = 1;
+			}
+			if (! blocked)
+			{
+				MoveReg(dsts[i], from[i]);
+				pending[i] = 0;
+				npending--;
+				progress = 1;
+			}
+		}
+		if (! progress)
+		{
+			for (i = 0; ! pending[i]; i++)
+				;
+			// the register breaking a cycle before is free when no move reads it
+			reg = cycle[IsFloatReg(from[i])];
+			for (j = 0; j < n && reg != NULL; j++)
+			{
+				if (pending[j] && from[j] == reg)
+					reg = NULL;
+			}
+			if (reg == NULL)
+				reg = IsFloatReg(from[i]) ? GetFReg() : GetReg();
+			cycle[IsFloatReg(from[i])] = reg;
+			MoveReg(reg, from[i]);
+			for (j = 0; j < n; j++)
+			{
+				if (pending[j] && from[j] == from[i] && j != i)
+					from[j] = reg;
+			}
+			from[i] = reg;
 		}
-	}
-	else
-	{
-		//PutASMCode(X86_PUSH, &p);
-		Symbol opds[2];
-		opds[0] = GetReg();
-		opds[1] = p;
-		PutASMCode(RISCV_PUSHM2S, opds);
 	}
 }
+static void EmitEpilogue(int stksize, int tail);
+
 /**
 	DST:
 			return value
@@ -1141,173 +1721,298 @@ static void PushArgument(Symbol p, Type ty)
 			function name
 	SRC2:
 			arguments_list
-*/
+
+	(1)	copy the records passed by reference
+	(2)	store the arguments passed on stack
+	(3)	move the arguments in registers to a0-a7 and fa0-fa7, the register
+		to register moves are done before loading any other value
+	 int f(int a, int b, ...);
+	 f(x, 3, ...)
+	 -------------------------
+		addi sp, sp, -16
+		li t0, 9
+		sw t0, 0(sp)
+		......
+		mv a0, s1
+		li a1, 3
+		call f
+		addi sp, sp, 16
+	A tail call with all the arguments in registers is done by a jump
+	after the epilogue, the callee returns to our caller:
+	 return g(x + 1);
+	 -------------------------
+		addi a0, s1, 1
+		lw s1, -12(s0)
+		lw ra, 12(sp)
+		lw s0, 8(sp)
+		addi sp, sp, 16
+		tail g
+ */
 static void EmitCall(IRInst inst)
 {
-	Vector args;
+	Vector args, live;
 	ILArg arg;
-	Type rty;
-	int i, stksize;
+	Type rty, ty;
+	Symbol opds[3], fptr, recv, addr;
+	Symbol dsts[NUM_ARG_REGS], srcs[NUM_ARG_REGS];
+	int *words, *fregs, *copies;
+	int i, j, w, f, n, nfixed, nwords, stksize, cpysize;
+	unsigned int used, keep;
 
 	args = (Vector)SRC2;
-	stksize = 0;
 	rty = inst->ty;
+	if (IsSqrtCall(inst))
+	{
+		opds[1] = PutInReg(((ILArg)GET_ITEM(args, 0))->sym);
+		opds[0] = GetDstReg(DST);
+		PutASMCode(RISCV_FSQRTF4 + TypeCode(rty) - F4, opds);
+		WriteBack(DST, opds[0], TypeCode(rty));
+		return;
+	}
+	live = SaveLiveRegs(inst);
+	used = UsedRegs;
 
-	/*for (i = LEN(args) - 1; i >= 0; --i)
+	recv = NULL;
+	w = 0;
+	if (IsRecordType(rty) && IsNormalRecord(rty))
+	{
+		recv = DST;
+		DST = NULL;
+		w = 1;
+	}
+	words = HeapAllocate(CurrentHeap, (LEN(args) + 1) * sizeof(int));
+	fregs = HeapAllocate(CurrentHeap, (LEN(args) + 1) * sizeof(int));
+	copies = HeapAllocate(CurrentHeap, (LEN(args) + 1) * sizeof(int));
+	nfixed = FixedArgs(SRC1, LEN(args));
+	f = 0;
+	for (i = 0; i < LEN(args); i++)
 	{
 		arg = GET_ITEM(args, i);
-		PushArgument(arg->sym, arg->ty);
-		if (arg->sym->kind != SK_Function) arg->sym->ref--;
-		stksize += ALIGN(arg->ty->size, STACK_ALIGN_SIZE);
-	}*/
-	 if((LEN(args) == 1) && ( ((ILArg)GET_ITEM(args, 0))->ty->size <= STACK_ALIGN_SIZE))
-    {
-         //put arg 0 in A0; put arg 1 in A1
-        Symbol opds[2];
-		SpillReg( FuncRegs[A0]);
-		opds[0] = FuncRegs[A0];
-		opds[1] = ((ILArg)GET_ITEM(args, 0))->sym;		
-		PutASMCode(RISCV_MEM2REG, opds);
-    }
-    else if((LEN(args) == 2) && ( ((ILArg)GET_ITEM(args, 0))->ty->size <= STACK_ALIGN_SIZE) && (((ILArg)GET_ITEM(args, 0))->ty->size <= STACK_ALIGN_SIZE))
-    {
-         //put arg 0 in A0; put arg 1 in A1
-        Symbol opds[2];
-		SpillReg( FuncRegs[A0]);
-		SpillReg( FuncRegs[A1]);
-		opds[0] = FuncRegs[A0];
-		opds[1] = ((ILArg)GET_ITEM(args, 0))->sym;		
-		PutASMCode(RISCV_MEM2REG, opds);
-
-		opds[0] = FuncRegs[A1];
-		opds[1] = ((ILArg)GET_ITEM(args, 1))->sym;		
-		PutASMCode(RISCV_MEM2REG, opds);		
-    }
-	else
+		fregs[i] = -1;
+		if (IsRealType(arg->ty) && i < nfixed && f < NUM_FARG_REGS)
+		{
+			fregs[i] = f++;
+			continue;
+		}
+		n = NextArgWord(arg->ty, i >= nfixed, &w);
+		words[i] = w;
+		w = n;
+	}
+	nwords = w;
+	stksize = nwords > NUM_ARG_REGS ? ALIGN((nwords - NUM_ARG_REGS) * STACK_ALIGN_SIZE, FRAME_ALIGN_SIZE) : 0;
+	// the large epilogue uses t0, which may hold the function pointer
+	if (stksize != 0 || (SRC1->kind != SK_Function && ! IsImm12(FrameSize)))
+		TailCall = 0;
+
+	cpysize = 0;
+	for (i = 0; i < LEN(args); i++)
 	{
-		for (i = LEN(args) - 1; i >= 0; --i)
+		arg = GET_ITEM(args, i);
+		if (ByReference(arg->ty))
 		{
-			arg = GET_ITEM(args, i);
-			PushArgument(arg->sym, arg->ty);
-			if (arg->sym->kind != SK_Function) arg->sym->ref--;
-			stksize += ALIGN(arg->ty->size, STACK_ALIGN_SIZE);
-		}	
+			TailCall = 0;
+			PushBlock(AddressInReg(arg->sym), arg->ty->size, ObjectAlign(arg->sym));
+			cpysize += ALIGN(arg->ty->size, FRAME_ALIGN_SIZE);
+			copies[i] = cpysize;
+			UsedRegs = used;
+		}
 	}
-	/**
-		 We don't have to call ClearRegs() in EmitCall(),
-		 Because ESI/EDI/EBX are saved in EmitPrologue().
-	 */
-	//SpillReg(X86Regs[EAX]);
-	//SpillReg(X86Regs[ECX]);
-	//SpillReg(X86Regs[EDX]);
-	if (IsRecordType(rty) && IsNormalRecord(rty))
-	{		
-		Symbol opds[2];
-		
-		opds[0] = GetReg();
-		opds[1] = DST;
-		//PutASMCode(X86_ADDR, opds);
-		PutASMCode(RISCV_PUSHM2S, opds);
-		//PutASMCode(X86_PUSH, opds);
-		stksize += 4;
-		DST = NULL;
-    }
 
-	PutASMCode(SRC1->kind == SK_Function ? RISCV_CALL : RISCV_ICALL, inst->opds);
-	if(stksize != 0){
-		Symbol p;
-		p = IntConstant(stksize);
-		PutASMCode(RISCV_REDUCEF, &p);
+	if (stksize != 0)
+	{
+		opds[0] = IntConstant(stksize);
+		PutASMCode(RISCV_EXPANDF, opds);
 	}
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		ty = arg->ty;
+		w = words[i];
+		if (fregs[i] >= 0 || w + ArgWords(ty) <= NUM_ARG_REGS)
+			continue;
 
-
-	if (DST != NULL)
-		DST->ref--;
-	if (SRC1->kind != SK_Function) SRC1->ref--;
-
-	if(DST == NULL){
-		/**
-			We have set X87Top to NULL in EmitReturn()
-		 */
-		if (IsRealType(rty)){
-			PutASMCode(RISCV_X87_POP, inst->opds); //TODO
+		opds[1] = RISCVRegs[SP];
+		if (ByReference(ty))
+		{
+			opds[0] = GetReg();
+			AddImm(opds[0], RISCVRegs[SP], stksize + cpysize - copies[i]);
+			opds[2] = IntConstant((w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+			PutASMCode(RISCV_STOFF4, opds);
 		}
-		return;
+		else if (IsRealType(ty) && arg->sym->reg != NULL && w >= NUM_ARG_REGS)
+		{
+			opds[0] = arg->sym->reg;
+			opds[2] = IntConstant((w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+			PutASMCode(TypeCode(ty) == F4 ? RISCV_FSTOFF4 : RISCV_FSTOFF8, opds);
+		}
+		else if (InWords(ty))
+		{
+			addr = arg->sym->reg == NULL ? AddressInReg(arg->sym) : NULL;
+			keep = UsedRegs;
+			for (j = 0; j < ArgWords(ty); j++, w++)
+			{
+				if (w < NUM_ARG_REGS)
+					continue;
+				opds[0] = GetReg();
+				LoadArgWord(opds[0], arg->sym, addr, j);
+				opds[1] = RISCVRegs[SP];
+				opds[2] = IntConstant((w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+				PutASMCode(RISCV_STOFF4, opds);
+				UsedRegs = keep;
+			}
+		}
+		else
+		{
+			opds[0] = PutInReg(arg->sym);
+			opds[2] = IntConstant((w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+			PutASMCode(RISCV_STOFF4, opds);
+		}
+		UsedRegs = used;
 	}
 
-
-	if (IsRealType(rty))
+	fptr = SRC1;
+	if (SRC1->kind != SK_Function)
 	{
-		// 		TEMPLATE(X86_STF4,	   "fstps %0")
-		PutASMCode(RISCV_STF4 + (rty->categ != FLOAT), inst->opds); //TODO
-		return;
+		// the function pointer may be in an argument register
+		fptr = GetReg();
+		LoadValue(fptr, SRC1, U4);
+		used = UsedRegs;
 	}
 
-
-	Symbol opds[2];		
-	switch (rty->size)
+	n = 0;
+	for (i = 0; i < LEN(args); i++)
 	{
-	case 1:
-		//Move(X86_MOVI1, DST, X86ByteRegs[EAX]);
-		opds[0] = DST;
-		opds[1] = FuncRegs[A0];
-		PutASMCode(RISCV_REG2MEM, opds);
-		break;
+		arg = GET_ITEM(args, i);
+		if (fregs[i] < 0 && words[i] < NUM_ARG_REGS && ! InWords(arg->ty) && arg->sym->reg != NULL)
+		{
+			dsts[n] = FuncRegs[A0 + words[i]];
+			srcs[n++] = arg->sym->reg;
+		}
+	}
+	ParallelMove(dsts, srcs, n);
+	UsedRegs = used;
+	// the floating-point values in f registers passed in a0-a7
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		w = words[i];
+		if (fregs[i] >= 0 || w >= NUM_ARG_REGS || ! IsRealType(arg->ty) || arg->sym->reg == NULL)
+			continue;
 
-	case 2:
-		//Move(X86_MOVI2, DST, X86WordRegs[EAX]);
-		opds[0] = DST;
-		opds[1] = FuncRegs[A0];
-		PutASMCode(RISCV_REG2MEM, opds);		
-		break;
+		if (TypeCode(arg->ty) == F8 && w + 1 < NUM_ARG_REGS)
+		{
+			// printf("%f", d), both words of d in registers
+			opds[0] = FuncRegs[A0 + w];
+			opds[1] = FuncRegs[A0 + w + 1];
+			opds[2] = arg->sym->reg;
+			PutASMCode(RISCV_FMVXD, opds);
+			continue;
+		}
+		LoadArgWord(FuncRegs[A0 + w], arg->sym, NULL, 0);
+		UsedRegs = used;
+	}
+	n = 0;
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		if (fregs[i] >= 0 && arg->sym->reg != NULL)
+		{
+			dsts[n] = FArgRegs[FA0 + fregs[i]];
+			srcs[n++] = arg->sym->reg;
+		}
+	}
+	ParallelMove(dsts, srcs, n);
+	UsedRegs = used;
 
-	case 4:
-		/*AllocateReg(inst, 0);
-		if (DST->reg != X86Regs[EAX])
+	if (recv != NULL)
+	{
+		LoadAddress(FuncRegs[A0], recv);
+	}
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		ty = arg->ty;
+		w = words[i];
+		if (fregs[i] >= 0)
 		{
-			Move(X86_MOVI4, DST, X86Regs[EAX]);
+			if (arg->sym->reg == NULL)
+				LoadValue(FArgRegs[FA0 + fregs[i]], arg->sym, TypeCode(ty));
+			UsedRegs = used;
+			continue;
 		}
-		ModifyVar(DST);*/
-		opds[0] = DST;
-		opds[1] = FuncRegs[A0];
-		PutASMCode(RISCV_REG2MEM, opds);	
-		break;
+		if (w >= NUM_ARG_REGS)
+			continue;
 
-	case 8:
-		//Move(X86_MOVI4, DST, X86Regs[EAX]);
-		//Move(X86_MOVI4, CreateOffset(T(INT), DST, 4,DST->pcoord), X86Regs[EDX]);
-		opds[0] = DST;
-		opds[1] = FuncRegs[A0];
-		PutASMCode(RISCV_REG2MEM, opds);
+		if (ByReference(ty))
+		{
+			AddImm(FuncRegs[A0 + w], RISCVRegs[SP], stksize + cpysize - copies[i]);
+		}
+		else if (InWords(ty) && arg->sym->reg == NULL)
+		{
+			addr = AddressInReg(arg->sym);
+			for (j = 0; j < ArgWords(ty) && w < NUM_ARG_REGS; j++, w++)
+			{
+				LoadArgWord(FuncRegs[A0 + w], arg->sym, addr, j);
+			}
+		}
+		else if (arg->sym->reg == NULL)
+		{
+			LoadValue(FuncRegs[A0 + w], arg->sym, TypeCode(ty));
+		}
+		UsedRegs = used;
+	}
 
-		opds[0] = CreateOffset(T(INT), DST, 4,DST->pcoord);
-		opds[1] = FuncRegs[A1];
-		PutASMCode(RISCV_REG2MEM, opds);				
-		break;
+	opds[1] = fptr;
+	if (TailCall)
+	{
+		EmitEpilogue(FrameSize, 1);
+		PutASMCode(SRC1->kind == SK_Function ? RISCV_TAIL : RISCV_ITAIL, opds);
+		return;
+	}
+	PutASMCode(SRC1->kind == SK_Function ? RISCV_CALL : RISCV_ICALL, opds);
+	if(stksize + cpysize != 0){
+		opds[0] = IntConstant(stksize + cpysize);
+		PutASMCode(RISCV_REDUCEF, opds);
+	}
 
-	default:
-		assert(0);
+	if (DST != NULL && IsRealType(rty))
+	{
+		if (DST->reg != NULL)
+			MoveReg(DST->reg, FArgRegs[FA0]);
+		else
+			StoreMemory(FArgRegs[FA0], DST, TypeCode(rty));
 	}
+	else if (DST != NULL && IsRecordType(rty))
+	{
+		if (rty->size != 0)
+		{
+			addr = AddressInReg(DST);
+			StorePartialWord(FuncRegs[A0], addr, 0, rty->size > 4 ? 4 : rty->size, ObjectAlign(DST));
+			if (rty->size > 4)
+				StorePartialWord(FuncRegs[A1], addr, 4, rty->size - 4, ObjectAlign(DST));
+		}
+	}
+	else if (DST != NULL)
+	{
+		if (DST->reg != NULL)
+			Move(RISCV_MOV, DST->reg, FuncRegs[A0]);
+		else
+			StoreMemory(FuncRegs[A0], DST, TypeCode(rty));
+	}
+	RestoreLiveRegs(live);
 }
 
 static void EmitAddress(IRInst inst)
 {
+	Symbol reg;
+
 	assert(DST->kind == SK_Temp && SRC1->kind != SK_Temp);
-	Symbol opds[3];	
-	//AllocateReg(inst, 0);
-	//PutASMCode(X86_ADDR, inst->opds);
-	//PutASMCode(RISCV_REG2MEM, inst->opds);
-	opds[0] = GetReg();
-	opds[1] = GetReg();
-	opds[2] = SRC1;
-	PutASMCode(RISCV_LUI_ADDI_LEAL, opds);	
-	opds[1] = opds[0];
-	opds[0] = DST;
-	PutASMCode(RISCV_REG2MEM, opds);
-	//ModifyVar(DST); //TODO
+	reg = GetDstReg(DST);
+	LoadAddress(reg, SRC1);
+	WriteBack(DST, reg, U4);
 }
 /**
-	 
+
 	 int a;
 	 int *ptr;
 	 int main(){
@@ -1324,26 +2029,26 @@ static void EmitAddress(IRInst inst)
 		return 0;
 		ret
 	--------------------------
-
-	 movl %eax, ptr
-	 //	EmitDeref(t1 = *ptr;)
-	 movl ptr, %ecx	---------------	PutInReg(ptr);
-	 movl (%ecx), %edx
-	 
-	 movl %edx, a
-
+		lui t0, %hi(ptr)		-------	PutInReg(ptr)
+		lw t0, %lo(ptr)(t0)
+		lw a7, (t0)
  */
 static void EmitDeref(IRInst inst)
 {
-	Symbol reg;
+	Symbol opds[2], reg;
+	int tcode = TypeCode(inst->ty);
 
 	reg = PutInReg(SRC1);
-	inst->opcode = MOV;
-	SRC1 = reg->next;
-	assert(SRC1->kind == SK_IRegister);
-	EmitMove(inst);
-	ModifyVar(DST);
-	return;
+	if (tcode == B)
+	{
+		EmitMoveBlock(inst, AddressInReg(DST), reg, inst->ty->size, inst->ty->align);
+		return;
+	}
+	opds[0] = GetDstReg(DST);
+	opds[1] = reg->next;
+	assert(opds[1]->kind == SK_IRegister);
+	PutASMCode(RISCV_LDI1 + tcode - I1, opds);
+	WriteBack(DST, opds[0], tcode);
 }
 /**
 	 int gArr[10] = {100};		--------  Not Need to EmitClear during runtime
@@ -1355,39 +2060,31 @@ static void EmitDeref(IRInst inst)
 static void EmitClear(IRInst inst)
 {
 	int size = SRC1->val.i[0];
-	Symbol p = IntConstant(0);
+	int unit, offset;
 	Symbol opds[3];
+	Vector live;
 
-	switch (size)
+	opds[1] = AddressInReg(DST);
+	if (size > MAX_INLINE_BLOCK)
 	{
-	case 1:
-		//Move(X86_MOVI1, DST, p);
-		opds[2] = GetByteReg();
-		opds[1] = p;
-        opds[0] = DST;	
-		PutASMCode(RISCV_IMMED2MEM, opds);
-		break;
-
-	case 2:
-		opds[2] = GetByteReg();
-		opds[1] = p;
-        opds[0] = DST;	
-		PutASMCode(RISCV_IMMED2MEM, opds);
-		break;
-
-	case 4:
-		opds[2] = GetByteReg();
-		opds[1] = p;
-        opds[0] = DST;	
-		PutASMCode(RISCV_IMMED2MEM, opds);
-		break;
+		live = SaveLiveRegs(inst);
+		opds[0] = opds[1];
+		opds[1] = SRC1;
+		PutASMCode(RISCV_MEMSET, opds);
+		RestoreLiveRegs(live);
+		return;
+	}
 
-	default:
-		opds[2] = GetByteReg();
-		opds[1] = p;
-        opds[0] = DST;	
-		PutASMCode(RISCV_IMMED2MEM, opds);
-		break;
+	opds[0] = RISCVRegs[ZERO];
+	unit = DST->ty->align >= 4 ? 4 : DST->ty->align;
+	offset = 0;
+	while (offset < size)
+	{
+		while (offset + unit > size)
+			unit >>= 1;
+		opds[2] = IntConstant(offset);
+		PutASMCode(RISCV_STOFF1 + (unit >> 1), opds);
+		offset += unit;
 	}
 }
 
@@ -1395,6 +2092,11 @@ static void EmitNOP(IRInst inst)
 {
 	assert(0);
 }
+// phi functions are replaced by moves before emission, see DestroySSA()
+static void EmitPhi(IRInst inst)
+{
+	assert(0);
+}
 /**
 	OPCODE(IJMP,    "ijmp",                 IndirectJump)
 	OPCODE(INC,     "++",                   Inc)
@@ -1404,9 +2106,9 @@ static void EmitNOP(IRInst inst)
 	OPCODE(EXTI1,   "(int)(char)",          Cast)
 	OPCODE(EXTU1,   "(int)(unsigned char)", Cast)
  */
-static void (* Emitter[])(IRInst inst) = 
+static void (* Emitter[])(IRInst inst) =
 {
-#define OPCODE(code, name, func) Emit##func, 
+#define OPCODE(code, name, func) Emit##func,
 #include "opcode.h"
 #undef OPCODE
 };
@@ -1419,151 +2121,663 @@ static void EmitIRInst(IRInst inst)
 	return;
 }
 
+/**
+	A floating-point product only used by the next addition or subtraction
+	is computed with it by one fused multiply-add instruction.
+		t0 = a * b;
+		t1 = t0 + c;		-------- fmadd.d t1, a, b, c
+		t1 = c - t0;		-------- fnmsub.d t1, a, b, c
+	Only the temporaries defined by DefineTemp() are fused, they hold the
+	intermediate results of one expression, so no contraction is done
+	across statements.
+	Return 1 if inst and the instruction after it are emitted.
+ */
+static int EmitFusedMulAdd(BBlock bb, IRInst inst)
+{
+	IRInst next = inst->next;
+	int tcode = TypeCode(inst->ty);
+	Symbol opds[4], c;
+	int code;
+
+	if (inst->opcode != MUL || (tcode != F4 && tcode != F8) || DST->kind != SK_Temp ||
+	    AsVar(DST)->def == NULL || DST->ref != 2 || next == &bb->insth)
+		return 0;
+	if ((next->opcode != ADD && next->opcode != SUB) || TypeCode(next->ty) != tcode)
+		return 0;
+
+	if (next->opds[1] == DST && next->opds[2] != DST)
+	{
+		c = next->opds[2];
+		code = next->opcode == ADD ? RISCV_FMADDF4 : RISCV_FMSUBF4;
+	}
+	else if (next->opds[2] == DST && next->opds[1] != DST)
+	{
+		c = next->opds[1];
+		code = next->opcode == ADD ? RISCV_FMADDF4 : RISCV_FNMSUBF4;
+	}
+	else
+	{
+		return 0;
+	}
+
+	opds[1] = PutInReg(SRC1);
+	opds[2] = PutInReg(SRC2);
+	opds[3] = PutInReg(c);
+	// at most 3 scratch registers
+	if (next->opds[0]->reg != NULL)
+		opds[0] = next->opds[0]->reg;
+	else
+		opds[0] = SRC1->reg == NULL ? opds[1] : GetFReg();
+	/**
+		TEMPLATE(RISCV_FMADDF4,  "fmadd.s %0, %1, %2, %3")
+	 */
+	PutASMCode(code + tcode - F4, opds);
+	WriteBack(next->opds[0], opds[0], tcode);
+
+	return 1;
+}
+
+/**
+ * Return the memory operand off(reg)
+ */
+static Symbol MemOperand(Symbol reg, int off)
+{
+	Symbol p;
+
+	if (off == 0)
+		return reg->next;
+
+	CALLOC(p);
+	p->kind = SK_IRegister;
+	p->name = p->aname = FormatName("%d(%s)", off, reg->name);
+
+	return p;
+}
+
+/**
+	Emit the load or store inst whose memory operand k contains the
+	address of a memory object, see struct kid.
+		t0 = &arr; t1 = i << 2; t2 = t0 + t1; t3 = *t2;
+		--------------------
+		lui t0, %hi(arr)				----- global object
+		add t0, t0, a5
+		lw a4, %lo(arr)(t0)
+
+		add t0, s0, a5					----- object on frame
+		lw a4, -48(t0)
+ */
+static void EmitObjectAccess(IRInst inst, Kid k)
+{
+	int tcode = TypeCode(inst->ty);
+	Symbol mem, opds[4], addr[3];
+
+	mem = k->off == 0 ? k->obj : CreateOffset(inst->ty, k->obj, k->off, k->obj->pcoord);
+	// the value stored
+	opds[0] = inst->opcode == IMOV ? PutInReg(SRC1) : NULL;
+	if (k->sym == NULL)
+	{
+		if (inst->opcode == IMOV)
+		{
+			StoreMemory(opds[0], mem, tcode);
+			return;
+		}
+		opds[0] = GetDstReg(DST);
+		LoadMemory(opds[0], mem, tcode);
+		WriteBack(DST, opds[0], tcode);
+		return;
+	}
+
+	addr[0] = GetReg();
+	addr[2] = PutInReg(k->sym);
+	if (IsGlobalObject(mem))
+	{
+		opds[1] = mem;
+		opds[2] = addr[0];
+		opds[3] = addr[2];
+		if (inst->opcode == IMOV)
+		{
+			PutASMCode(RISCV_STXI1 + tcode - I1, opds);
+			return;
+		}
+		opds[0] = GetDstReg(DST);
+		PutASMCode(RISCV_LDXI1 + tcode - I1, opds);
+		UsedRegs &= ~(1u << addr[0]->val.i[0]);
+		WriteBack(DST, opds[0], tcode);
+		return;
+	}
+
+	if (IsImm12(FrameOffset(mem)))
+	{
+		addr[1] = RISCVRegs[S0];
+		PutASMCode(RISCV_ADDI4, addr);
+		opds[1] = MemOperand(addr[0], FrameOffset(mem));
+	}
+	else
+	{
+		LoadAddress(addr[0], mem);
+		addr[1] = addr[0];
+		PutASMCode(RISCV_ADDI4, addr);
+		opds[1] = addr[0]->next;
+	}
+	if (inst->opcode == IMOV)
+	{
+		PutASMCode(RISCV_STI1 + tcode - I1, opds);
+		return;
+	}
+	opds[0] = GetDstReg(DST);
+	PutASMCode(RISCV_LDI1 + tcode - I1, opds);
+	UsedRegs &= ~(1u << addr[0]->val.i[0]);
+	WriteBack(DST, opds[0], tcode);
+}
+
+/**
+	Emit inst by the rule selected in m, see sel_riscv.c.
+	The kids of the rule are the operands %1 and %2 of its template,
+	%0 is the destination register or the label of a branch.
+		t2 = *t1;		RULE(NT_STMT, DEREF, TY_I4, NT_ADDR, NT_NONE, 1, RISCV_LDI4)
+		--------------------
+		lw a5, 8(a4)
+ */
+static void EmitMatch(IRInst inst, Match m)
+{
+	Rule r = &Rules[m->rule];
+	Symbol opds[3];
+	Kid k;
+	int i;
+
+	if (r->kids[0] == NT_ADDR && m->kids[0].obj != NULL)
+	{
+		EmitObjectAccess(inst, &m->kids[0]);
+		return;
+	}
+	for (i = 0; i < 2; i++)
+	{
+		k = &m->kids[i];
+		switch (r->kids[i])
+		{
+		case NT_REG:
+			opds[i + 1] = PutInReg(k->sym);
+			break;
+
+		case NT_ZERO:
+			opds[i + 1] = RISCVRegs[ZERO];
+			break;
+
+		case NT_IMM12:
+		case NT_SHAMT:
+			opds[i + 1] = IntConstant(k->sym->val.i[0]);
+			break;
+
+		case NT_NIMM12:
+			opds[i + 1] = IntConstant(-k->sym->val.i[0]);
+			break;
+
+		case NT_ADDR:
+			opds[i + 1] = MemOperand(PutInReg(k->sym), k->off);
+			break;
+
+		default:
+			opds[i + 1] = NULL;
+		}
+	}
+
+	if (inst->opcode >= JZ && inst->opcode <= JLE)
+	{
+		opds[0] = ((BBlock)DST)->sym;
+		PutASMCode(r->code, opds);
+	}
+	else if (inst->opcode == IMOV)
+	{
+		opds[0] = NULL;
+		PutASMCode(r->code, opds);
+	}
+	else
+	{
+		// the result of a comparison is int, whatever type the operands are
+		opds[0] = GetDstReg(DST);
+		PutASMCode(r->code, opds);
+		WriteBack(DST, opds[0], TypeCode(DST->ty));
+	}
+}
+
+/**
+	A call is a tail call when the function returns right after it, with
+	the value returned by the call if there is one:
+		t1 : g(t0);
+		return t1;
+		goto BB8;			-------- BB8 is the empty exit block
+	The frame of the caller is popped before the call, so the address of
+	an object on it can't be taken.  A variadic function, a call returning
+	a record and a call to setjmp() aren't done by tail calls either.
+ */
+static int IsTailCall(BBlock bb, IRInst inst)
+{
+	IRInst next = inst->next;
+	Symbol fn = inst->opds[1];
+
+	if (! TailCalls || ! FrameClosed || VarArgSize != 0 || IsRecordType(inst->ty) || IsSqrtCall(inst))
+		return 0;
+	if (fn->kind == SK_Function && strstr(fn->name, "setjmp") != NULL)
+		return 0;
+
+	if (inst->opds[0] != NULL)
+	{
+		if (next == &bb->insth || next->opcode != RET || next->opds[0] != inst->opds[0] ||
+		    TypeCode(next->ty) != TypeCode(inst->ty))
+			return 0;
+		next = next->next;
+	}
+	else if (FSYM->ty->bty->categ != VOID)
+	{
+		return 0;
+	}
+	if (next != &bb->insth && next->opcode == JMP)
+		return next->next == &bb->insth && IsReturnBlock((BBlock)next->opds[0]);
+
+	return next == &bb->insth && IsReturnBlock(bb->next);
+}
+
+/**
+	The instructions are emitted by the rules selected by LabelBBlock(),
+	those without a matching rule by the Emit* functions.
+ */
 static void EmitBBlock(BBlock bb)
 {
 	IRInst inst = bb->insth.next;
+	Match m = LabelBBlock(bb);
 
+	TailCall = 0;
 	while (inst != &bb->insth)
 	{
-		UsedRegs = 0;
-		/**
-			This bug is found by testing "Livermore loops".
-			See	Line 1567 in cflops.c
-			  for (k=1 ; k<=n ; k++) {
-			    ox_1(k)= abs( x_1(k) - stat_1(7));	
-			  }
-			(1) see EmitX87Branch()
-			(2) ClearRegs() are called before generating assembly jumping
-				in EmitBranch()/EmitJump()/EmitIndirectJump()/EmitCall().			
-			(3) SaveX87Top() is called here to keep it simple.
-				For conditional-expr, temporaries are used across basic blocks.
-				see examples/cfg/crossBB.c
-		 */
-		/*if( (inst->opcode >= JZ && inst->opcode <= IJMP) || (inst->opcode == CALL)){
-			SaveX87Top();
-		}*/ //TODO: handle float
-		//  the kernel part of emit ASM from IR.
-		EmitIRInst(inst);
-		/**
-			ref is used as a factor in spilling register 
-				static int SelectSpillReg(int endr)
-		*/
-		if (! (inst->opcode >= JZ && inst->opcode <= IJMP) &&
-		    inst->opcode != CALL)
+		// the scratch registers are free at the beginning of every instruction
+		UsedRegs = UsedFRegs = 0;
+		if (inst->opcode == CALL && IsTailCall(bb, inst))
+		{
+			// the callee returns for us, unless EmitCall() can't do a tail call
+			TailCall = 1;
+			EmitIRInst(inst);
+			if (TailCall)
+				return;
+			inst = inst->next;
+			m++;
+			continue;
+		}
+		if (! m->folded && EmitFusedMulAdd(bb, inst))
 		{
-			DST->ref--;
-			if (SRC1 && SRC1->kind != SK_Function) SRC1->ref--;
-			if (SRC2 && SRC2->kind != SK_Function) SRC2->ref--;
+			inst = inst->next->next;
+			m += 2;
+			continue;
 		}
+		//  the kernel part of emit ASM from IR.
+		if (m->folded)
+			;
+		else if (m->rule >= 0)
+			EmitMatch(inst, m);
+		else
+			EmitIRInst(inst);
 		inst = inst->next;
+		m++;
 	}
-	ClearRegs();	
-	SaveX87Top();
 }
 /**
-	function(parameter1, parameter2, ....)
+	function(parameter1, ..., parameter8, parameter9, parameter10)
 
 	...............
-	parameter2
-	parameter1 _________	4(s0)			
-	s0 ______________	0(s0)
-	local variables and temporaries		-4(s0)
+	parameter10		4(s0)
+	parameter9 _________	0(s0)		---- sp of caller
+	ra						-4(s0)
+	old s0					-8(s0)
+	used callee-saved registers		-12(s0)
 									....
-	
+	parameters passed in registers
+	local variables and temporaries
+									....
+	The parameters passed in a0-a7 and fa0-fa7 are stored with the local
+	variables, except those only copied into a register at entry,
+	see EmitFunction().
+
+	A variadic function stores all of a0-a7 just below the parameters on stack,
+	and s0 is 32 bytes below the sp of caller, so all the arguments are
+	in consecutive words for va_arg():
+	...............
+	parameter9		32(s0)
+	a7				28(s0)
+	...
+	a0 _________	0(s0)
+	ra				-4(s0)
+	......
+
+	Only the temporaries which are spilled or have to be saved
+	around calls get a stack slot.
  */
-static int LayoutFrame(FunctionSymbol fsym, int fstParamPos)
+static int LayoutFrame(FunctionSymbol fsym)
 {
 	Symbol p;
-	int offset;
+	int i, offset, size, align;
 	/**
 		#include <stdio.h>
-		 
-		 void f(int a, int b){	-------		a, b are parameters		 	 
-			 int c = a + b;		-------		c is local variables.
-			 				
-			 printf("%d \n",c);
-		 }
-		 int main(){
-			 f(3,4);
-			 return 0;
+
+		 void f(int a, int b, int c){	-------		a, b, c are parameters
+			 int d = a + b + c;		-------		d is local variables.
+
+			 printf("%d \n",d);
 		 }
-			movl 4(s0), %eax		--------  a is 4(s0)
-			addl 8(s0), %eax		--------  b is 8(s0)
-			movl %eax, -4(s0)		--------  c is -4(s0)
+			sw a0, -12(s0)		--------  a is -12(s0), when its address is taken
+			sw t3, -16(s0)		--------  d is -16(s0), when it is spilled
 	 */
-	offset = fstParamPos * STACK_ALIGN_SIZE;
-	p = fsym->params;
-	//by riscv calling convention
-	while (p)
+	offset = FRAME_HEADER_SIZE + SaveAreaSize;
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
 	{
-		AsVar(p)->offset = offset;		
-		if(p->ty->size == 0){
-			//	empty struct or array of empty struct to be of 1 byte size
-			offset += ALIGN(EMPTY_OBJECT_SIZE, STACK_ALIGN_SIZE);
-		}else{
-			offset += ALIGN(p->ty->size, STACK_ALIGN_SIZE);
+		if (ParamInReg[i] != NULL)
+			continue;
+		if (ParamFRegs[i] >= 0 || ByReference(p->ty) || (VarArgSize == 0 && ParamWords[i] < NUM_ARG_REGS))
+		{
+			size = p->ty->size == 0 ? EMPTY_OBJECT_SIZE : ALIGN(p->ty->size, STACK_ALIGN_SIZE);
+			align = p->ty->align < STACK_ALIGN_SIZE ? STACK_ALIGN_SIZE : p->ty->align;
+			offset = ALIGN(offset + size, align);
+			AsVar(p)->offset = -offset;
+		}
+		else
+		{
+			AsVar(p)->offset = VarArgSize + (ParamWords[i] - NUM_ARG_REGS) * STACK_ALIGN_SIZE;
 		}
-		p = p->next;
 	}
 
-	offset = 0;
-	/**
-		SK_Temp/SK_Variable are in fsym->locals.
-		In fact, some SK_Temp are allocated to register,
-		but UCC always keep their stack position when the 
-		function is active. Of course , this cause a waste of 
-		stack memory, but it made the management of temporaries
-		simple.
-	 */
 	p = fsym->locals;
 	while (p)
 	{
 		if (p->ref == 0)
 			goto next;
-		
-	
+		// a temporary living in register
+		if (p->reg != NULL && ! p->needwb)
+			goto next;
+
 		// for empty struct object or array of empty struct object
-		if(p->ty->size == 0){
-			offset += ALIGN(EMPTY_OBJECT_SIZE, STACK_ALIGN_SIZE);		
-		}else{
-			offset += ALIGN(p->ty->size, STACK_ALIGN_SIZE);	
-		}
+		size = p->ty->size == 0 ? EMPTY_OBJECT_SIZE : p->ty->size;
+		align = p->ty->align < STACK_ALIGN_SIZE ? STACK_ALIGN_SIZE : p->ty->align;
+		offset = ALIGN(offset + size, align);
 		AsVar(p)->offset = -offset;
-		// PRINT_DEBUG_INFO((" offset = %d, name = %s ",AsVar(p)->offset,AsVar(p)->name));
 next:
 		p = p->next;
 	}
 
-	return offset;
+	return ALIGN(offset, FRAME_ALIGN_SIZE) + VarArgSize;
 }
 
+/**
+	Save(or restore) the callee-saved registers assigned by the
+	register allocator, just below the saved ra and s0.
+	The f registers are saved after the integer ones, 8-byte aligned.
+		sw s1, -12(s0)
+		sw s2, -16(s0)
+		fsd fs0, -24(s0)
+	When emit is 0, only the size of the save area is computed.
+	Return the size of the save area.
+ */
+static int SaveCalleeRegs(int restore, int emit)
+{
+	Symbol opds[2];
+	int i, offset;
+
+	offset = FRAME_HEADER_SIZE;
+	for (i = 0; i < 32; i++)
+	{
+		if (UsedSaveRegs & (1u << i))
+		{
+			offset += STACK_ALIGN_SIZE;
+			opds[0] = RISCVRegs[i];
+			opds[1] = IntConstant(-offset);
+			if (emit)
+				PutASMCode(restore ? RISCV_RESTOREREG : RISCV_SAVEREG, opds);
+		}
+	}
+	for (i = 0; i < 32; i++)
+	{
+		if (UsedSaveFRegs & (1u << i))
+		{
+			offset = ALIGN(offset + 8, 8);
+			opds[0] = RISCVRegs[FREG_BASE + i];
+			opds[1] = IntConstant(-offset);
+			if (emit)
+				PutASMCode(restore ? RISCV_RESTOREFREG : RISCV_SAVEFREG, opds);
+		}
+	}
+	return offset - FRAME_HEADER_SIZE;
+}
+
+/**
+	main:
+		addi sp, sp, -32
+		sw ra, 28(sp)
+		sw s0, 24(sp)
+		addi s0, sp, 32
+ */
 static void EmitPrologue(int stksize)
 {
-	/**
-	 * regardless of the actual register usage, always save the preserve registers.
-	 * on riscv platform, they are ebp, ebx, esi and edi
-	 */
-	PutASMCode(RISCV_PROLOGUE, NULL);
+	Symbol opds[5];
+
+	opds[0] = IntConstant(stksize);
+	opds[1] = IntConstant(stksize - VarArgSize - 4);
+	opds[2] = IntConstant(stksize - VarArgSize - 8);
+	opds[3] = IntConstant(stksize - VarArgSize);
+	opds[4] = IntConstant(VarArgSize);
+	PutASMCode(IsImm12(stksize) ? RISCV_PROLOGUE : RISCV_PROLOGUE_LARGE, opds);
+	SaveCalleeRegs(0, 1);
+}
 
-	//del by johnson
-	/*if (stksize != 0)
+/**
+ * The epilogue before a tail call doesn't return, see EmitCall()
+ */
+static void EmitEpilogue(int stksize, int tail)
+{
+	Symbol opds[5];
+
+	SaveCalleeRegs(1, 1);
+	opds[0] = IntConstant(stksize);
+	opds[1] = IntConstant(stksize - VarArgSize - 4);
+	opds[2] = IntConstant(stksize - VarArgSize - 8);
+	opds[3] = IntConstant(stksize - VarArgSize);
+	opds[4] = IntConstant(VarArgSize);
+	if (tail)
+		PutASMCode(IsImm12(stksize) ? RISCV_TAILEPILOGUE : RISCV_TAILEPILOGUE_LARGE, opds);
+	else
+		PutASMCode(IsImm12(stksize) ? RISCV_EPILOGUE : RISCV_EPILOGUE_LARGE, opds);
+}
+
+/**
+	Decide the word or the fa register of every parameter, see EmitCall().
+	A scalar parameter in register, which is only copied into its temporary
+	at the beginning of the function(see mem2reg.c), is moved into the register
+	of the temporary directly.  The copy instruction is then removed.
+ */
+static void AssignParams(FunctionSymbol fsym)
+{
+	IRInst inst;
+	Symbol p;
+	int i, n, w, f, direct;
+
+	for (n = 0, p = fsym->params; p != NULL; p = p->next)
+		n++;
+	ParamWords = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	ParamFRegs = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	ParamInReg = HeapAllocate(CurrentHeap, (n + 1) * sizeof(IRInst));
+
+	// the copy of big record is done by memcpy(), which destroys a0-a7 and fa0-fa7
+	direct = VarArgSize == 0;
+	w = f = 0;
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
 	{
-		Symbol sym = IntConstant(stksize);
-		// TEMPLATE(X86_EXPANDF,  "subl %0, %%esp")
-		PutASMCode(RISCV_EXPANDF, &sym);
-	}*/
+		ParamInReg[i] = NULL;
+		ParamFRegs[i] = ParamWords[i] = -1;
+		// the named parameters are all in fixed position
+		if (IsRealType(p->ty) && f < NUM_FARG_REGS)
+		{
+			ParamFRegs[i] = f++;
+			continue;
+		}
+		n = NextArgWord(p->ty, 0, &w);
+		ParamWords[i] = w;
+		w = n;
+		if (ByReference(p->ty) && p->ty->size > MAX_INLINE_BLOCK)
+			direct = 0;
+	}
+	if (! direct)
+		return;
+
+	for (inst = fsym->entryBB->insth.next; inst != &fsym->entryBB->insth; inst = inst->next)
+	{
+		if (inst->opcode != MOV || inst->opds[0]->kind != SK_Temp)
+			break;
+		for (i = 0, p = fsym->params; p != NULL && p != inst->opds[1]; i++, p = p->next)
+			;
+		if (p == NULL)
+			break;
+		if (p->ref == 1 && (ParamFRegs[i] >= 0 ||
+		    (ParamWords[i] < NUM_ARG_REGS && (IsIntegType(p->ty) || IsPtrType(p->ty)))))
+		{
+			ParamInReg[i] = inst;
+		}
+	}
 }
 
-static void EmitEpilogue(int stksize)
+/**
+	Store the parameters passed in registers to their stack slots,
+	copy the records passed by reference, then move the parameters
+	only living in temporaries into their registers.
+	A double passed in words is stored word by word as a record.
+		void f(int *a, int n, struct big b){
+			........
+		}
+		---------------------------------
+			sw a0, -12(s0)			-------- &a is taken somewhere
+			addi t0, s0, -124
+			lw t1, 0(a2)			-------- a2 is the address of b
+			sw t1, 0(t0)
+			......
+			mv s1, a1				-------- n is in s1
+ */
+static void EmitParams(FunctionSymbol fsym)
 {
-	PutASMCode(RISCV_EPILOGUE, NULL);
+	Symbol p, t, opds[3], src, dsts[NUM_ARG_REGS], srcs[NUM_ARG_REGS];
+	int i, j, w, n, fp;
+
+	if (VarArgSize != 0)
+	{
+		for (i = 0; i < NUM_ARG_REGS; i++)
+		{
+			opds[0] = FuncRegs[A0 + i];
+			opds[1] = IntConstant(i * STACK_ALIGN_SIZE);
+			PutASMCode(RISCV_SAVEREG, opds);
+		}
+	}
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
+	{
+		w = ParamWords[i];
+		if (ParamInReg[i] != NULL)
+			continue;
+
+		UsedRegs = 0;
+		if (ParamFRegs[i] >= 0)
+		{
+			StoreMemory(FArgRegs[FA0 + ParamFRegs[i]], p, TypeCode(p->ty));
+			continue;
+		}
+		if (VarArgSize != 0 || w >= NUM_ARG_REGS || ByReference(p->ty))
+			continue;
+
+		if (! InWords(p->ty))
+		{
+			StoreMemory(FuncRegs[A0 + w], p, TypeCode(p->ty));
+			continue;
+		}
+		for (j = 0; j < ArgWords(p->ty); j++, w++)
+		{
+			opds[0] = w < NUM_ARG_REGS ? FuncRegs[A0 + w] : GetReg();
+			if (w >= NUM_ARG_REGS)
+			{
+				// the second half of a record is on stack
+				opds[1] = RISCVRegs[S0];
+				opds[2] = IntConstant((w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+				PutASMCode(RISCV_LDOFF4, opds);
+			}
+			opds[1] = IntConstant(AsVar(p)->offset + j * STACK_ALIGN_SIZE);
+			PutASMCode(RISCV_SAVEREG, opds);
+		}
+	}
+
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
+	{
+		if (! ByReference(p->ty))
+			continue;
+
+		UsedRegs = 0;
+		w = ParamWords[i];
+		if (w < NUM_ARG_REGS && VarArgSize == 0)
+		{
+			src = FuncRegs[A0 + w];
+		}
+		else
+		{
+			src = GetReg();
+			opds[0] = src;
+			opds[1] = IntConstant(VarArgSize + (w - NUM_ARG_REGS) * STACK_ALIGN_SIZE);
+			PutASMCode(RISCV_RESTOREREG, opds);
+		}
+		if (p->ty->size > MAX_INLINE_BLOCK)
+		{
+			opds[0] = AddressInReg(p);
+			opds[1] = src;
+			opds[2] = IntConstant(p->ty->size);
+			PutASMCode(RISCV_MEMCPY, opds);
+		}
+		else
+		{
+			CopyBlock(AddressInReg(p), src, p->ty->size, p->ty->align);
+		}
+	}
+
+	// the integer registers, then the f registers
+	for (fp = 0; fp <= 1; fp++)
+	{
+		n = 0;
+		for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
+		{
+			if (ParamInReg[i] == NULL || (ParamFRegs[i] >= 0) != fp)
+				continue;
+
+			t = ParamInReg[i]->opds[0];
+			src = fp ? FArgRegs[FA0 + ParamFRegs[i]] : FuncRegs[A0 + ParamWords[i]];
+			if (t->reg == NULL)
+			{
+				UsedRegs = 0;
+				StoreMemory(src, t, TypeCode(t->ty));
+				continue;
+			}
+			dsts[n] = t->reg;
+			srcs[n++] = src;
+		}
+		UsedRegs = UsedFRegs = 0;
+		ParallelMove(dsts, srcs, n);
+	}
+
+	// the copy instructions are done
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
+	{
+		IRInst inst = ParamInReg[i];
+
+		if (inst != NULL)
+		{
+			inst->prev->next = inst->next;
+			inst->next->prev = inst->prev;
+			fsym->entryBB->ninst--;
+		}
+	}
 }
 
 void EmitFunction(FunctionSymbol fsym)
 {
 	BBlock bb;
 	Type rty;
-	int stksize;
 
 	FSYM = fsym;
 	if (fsym->sclass != TK_STATIC)
@@ -1577,8 +2791,8 @@ void EmitFunction(FunctionSymbol fsym)
 		 typedef struct{
 			 int arr[10];	// or char arr[3];
 		 }Data;
-		 
-		 
+
+
 		 Data GetData(void){	-------------->  void GetData(Date * implicit)
 			 Data dt;
 			 return dt;
@@ -1601,50 +2815,44 @@ void EmitFunction(FunctionSymbol fsym)
 		p->ty = T(POINTER);
 		p->level = 1;
 		p->sclass = TK_AUTO;
-		
+		p->ref = 1;
+
 		p->next = fsym->params;
 		fsym->params = (Symbol)p;
 	}
 
-	stksize = LayoutFrame(fsym, PRESERVE_REGS + 1);
-	/**
-		main:
-		pushl %ebp
-		pushl %ebx
-		pushl %esi
-		pushl %edi
-		movl %esp, %ebp
-		subl $32, %esp
-	 */
-	EmitPrologue(stksize);
+	VarArgSize = ((FunctionType)fsym->ty)->sig->hasEllipsis ? NUM_ARG_REGS * STACK_ALIGN_SIZE : 0;
+	FrameClosed = ! IsRecordType(rty);
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		IRInst inst;
+
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->opcode == ADDR && ! IsGlobalObject(inst->opds[1]))
+				FrameClosed = 0;
+		}
+	}
+	AllocateRegisters(fsym);
+	// the live ranges are numbered in the order of the source, see LayoutBlocks()
+	LayoutBlocks(fsym);
+	AssignParams(fsym);
+	SaveAreaSize = SaveCalleeRegs(0, 0);
+	FrameSize = LayoutFrame(fsym);
+	EmitPrologue(FrameSize);
+	EmitParams(fsym);
 
 	bb = fsym->entryBB;
 	while (bb != NULL)
-	{	
+	{
 		// to show all basic blocks
 		DefineLabel(bb->sym);
 		EmitBBlock(bb);
 		bb = bb->next;
 	}
-	/**
-		movl %ebp, %esp
-		popl %edi
-		popl %esi
-		popl %ebx
-		popl %ebp
-		ret
-	 */
-	EmitEpilogue(stksize);
-	PutString("\n");
-}
-//  store register value to variable
-void StoreVar(Symbol reg, Symbol v)
-{
-	Symbol opds[2];
 
-	opds[0] = v;
-	opds[1] = reg;
-	PutASMCode(RISCV_REG2MEM, opds);
-	
+	// not reached after a tail call
+	if (! TailCall)
+		EmitEpilogue(FrameSize, 0);
+	PutString("\n");
 }
-
@@ -1,9 +1,11 @@
 #include "ucl.h"
 #include "target.h"
+#include "gen.h"
 #include "reg_riscv.h"
 #include "output.h"
 
 static int ORG;
+int ISAExtensions = ISA_M | ISA_A | ISA_F | ISA_D;
 static int FloatNum;
 /**
 	TEMPLATE(X86_JMP,      "jmp %0")
@@ -56,7 +58,7 @@ static void Align(Symbol p)
 
 	if (ORG % align != 0)
 	{
-		Print(".align %d\n", align);
+		Print(".balign %d\n", align);
 		ORG = ALIGN(ORG, align);
 	}
 	ORG += p->ty->size;
@@ -200,36 +202,133 @@ static char* GetAccessName(Symbol p)
 
 void SetupRegisters(void)
 {
-	TempRegs[T0] = CreateReg("t0", "(t0)", T0);
-	TempRegs[T1] = CreateReg("t1", "(t1)", T1);
-	TempRegs[T2] = CreateReg("t2", "(t2)", T2);
-  	TempRegs[T3] = CreateReg("t3", "(t3)", T3);
-	TempRegs[T4] = CreateReg("t4", "(t4)", T4);
-	TempRegs[T5] = CreateReg("t5", "(t5)", T5);
-	TempRegs[T6] = CreateReg("t6", "(t6)", T6);
-
-    FuncRegs[A0] = CreateReg("a0", "(a0)", A0);
-	FuncRegs[A1] = CreateReg("a1", "(a1)", A1);
-	FuncRegs[A2] = CreateReg("a2", "(a2)", A2);
-  	FuncRegs[A3] = CreateReg("a3", "(a3)", A3);
-	FuncRegs[A4] = CreateReg("a4", "(a4)", A4);
-	FuncRegs[A5] = CreateReg("a5", "(a5)", A5);
-	FuncRegs[A6] = CreateReg("a6", "(a6)", A6);
-	FuncRegs[A7] = CreateReg("a7", "(a7)", A7);
-
-
-
-	SaveRegs[S1] = CreateReg("s1", "(s1)", S1);
-	SaveRegs[S2] = CreateReg("s2", "(s2)", S2);
-	SaveRegs[S3] = CreateReg("s3", "(s3)", S3);
-  	SaveRegs[S4] = CreateReg("s4", "(s4)", S4);
-	SaveRegs[S5] = CreateReg("s5", "(s5)", S5);
-	SaveRegs[S6] = CreateReg("s6", "(s6)", S6);
-	SaveRegs[S7] = CreateReg("s7", "(s7)", S7);
-	SaveRegs[S8] = CreateReg("s8", "(s8)", S8);
-	SaveRegs[S9] = CreateReg("s9", "(s9)", S9);
-	SaveRegs[S10] = CreateReg("s10", "(s10)", S10);
-	SaveRegs[S11] = CreateReg("s11", "(s11)", S11);
+	CreateReg("zero", "(zero)", ZERO);
+	CreateReg("ra", "(ra)", RA);
+	CreateReg("sp", "(sp)", SP);
+	CreateReg("s0", "(s0)", S0);
+
+	TempRegs[T0] = CreateReg("t0", "(t0)", 5);
+	TempRegs[T1] = CreateReg("t1", "(t1)", 6);
+	TempRegs[T2] = CreateReg("t2", "(t2)", 7);
+  	TempRegs[T3] = CreateReg("t3", "(t3)", 28);
+	TempRegs[T4] = CreateReg("t4", "(t4)", 29);
+	TempRegs[T5] = CreateReg("t5", "(t5)", 30);
+	TempRegs[T6] = CreateReg("t6", "(t6)", 31);
+
+    FuncRegs[A0] = CreateReg("a0", "(a0)", 10);
+	FuncRegs[A1] = CreateReg("a1", "(a1)", 11);
+	FuncRegs[A2] = CreateReg("a2", "(a2)", 12);
+  	FuncRegs[A3] = CreateReg("a3", "(a3)", 13);
+	FuncRegs[A4] = CreateReg("a4", "(a4)", 14);
+	FuncRegs[A5] = CreateReg("a5", "(a5)", 15);
+	FuncRegs[A6] = CreateReg("a6", "(a6)", 16);
+	FuncRegs[A7] = CreateReg("a7", "(a7)", 17);
+
+
+
+	SaveRegs[S1] = CreateReg("s1", "(s1)", 9);
+	SaveRegs[S2] = CreateReg("s2", "(s2)", 18);
+	SaveRegs[S3] = CreateReg("s3", "(s3)", 19);
+  	SaveRegs[S4] = CreateReg("s4", "(s4)", 20);
+	SaveRegs[S5] = CreateReg("s5", "(s5)", 21);
+	SaveRegs[S6] = CreateReg("s6", "(s6)", 22);
+	SaveRegs[S7] = CreateReg("s7", "(s7)", 23);
+	SaveRegs[S8] = CreateReg("s8", "(s8)", 24);
+	SaveRegs[S9] = CreateReg("s9", "(s9)", 25);
+	SaveRegs[S10] = CreateReg("s10", "(s10)", 26);
+	SaveRegs[S11] = CreateReg("s11", "(s11)", 27);
+
+	FTempRegs[FT0] = CreateReg("ft0", NULL, FREG_BASE + 0);
+	FTempRegs[FT1] = CreateReg("ft1", NULL, FREG_BASE + 1);
+	FTempRegs[FT2] = CreateReg("ft2", NULL, FREG_BASE + 2);
+	FTempRegs[FT3] = CreateReg("ft3", NULL, FREG_BASE + 3);
+	FTempRegs[FT4] = CreateReg("ft4", NULL, FREG_BASE + 4);
+	FTempRegs[FT5] = CreateReg("ft5", NULL, FREG_BASE + 5);
+	FTempRegs[FT6] = CreateReg("ft6", NULL, FREG_BASE + 6);
+	FTempRegs[FT7] = CreateReg("ft7", NULL, FREG_BASE + 7);
+	FTempRegs[FT8] = CreateReg("ft8", NULL, FREG_BASE + 28);
+	FTempRegs[FT9] = CreateReg("ft9", NULL, FREG_BASE + 29);
+	FTempRegs[FT10] = CreateReg("ft10", NULL, FREG_BASE + 30);
+	FTempRegs[FT11] = CreateReg("ft11", NULL, FREG_BASE + 31);
+
+	FArgRegs[FA0] = CreateReg("fa0", NULL, FREG_BASE + 10);
+	FArgRegs[FA1] = CreateReg("fa1", NULL, FREG_BASE + 11);
+	FArgRegs[FA2] = CreateReg("fa2", NULL, FREG_BASE + 12);
+	FArgRegs[FA3] = CreateReg("fa3", NULL, FREG_BASE + 13);
+	FArgRegs[FA4] = CreateReg("fa4", NULL, FREG_BASE + 14);
+	FArgRegs[FA5] = CreateReg("fa5", NULL, FREG_BASE + 15);
+	FArgRegs[FA6] = CreateReg("fa6", NULL, FREG_BASE + 16);
+	FArgRegs[FA7] = CreateReg("fa7", NULL, FREG_BASE + 17);
+
+	FSaveRegs[FS0] = CreateReg("fs0", NULL, FREG_BASE + 8);
+	FSaveRegs[FS1] = CreateReg("fs1", NULL, FREG_BASE + 9);
+	FSaveRegs[FS2] = CreateReg("fs2", NULL, FREG_BASE + 18);
+	FSaveRegs[FS3] = CreateReg("fs3", NULL, FREG_BASE + 19);
+	FSaveRegs[FS4] = CreateReg("fs4", NULL, FREG_BASE + 20);
+	FSaveRegs[FS5] = CreateReg("fs5", NULL, FREG_BASE + 21);
+	FSaveRegs[FS6] = CreateReg("fs6", NULL, FREG_BASE + 22);
+	FSaveRegs[FS7] = CreateReg("fs7", NULL, FREG_BASE + 23);
+	FSaveRegs[FS8] = CreateReg("fs8", NULL, FREG_BASE + 24);
+	FSaveRegs[FS9] = CreateReg("fs9", NULL, FREG_BASE + 25);
+	FSaveRegs[FS10] = CreateReg("fs10", NULL, FREG_BASE + 26);
+	FSaveRegs[FS11] = CreateReg("fs11", NULL, FREG_BASE + 27);
+}
+
+/**
+	Parse the ISA string of -march:
+		rv32imafd_zbb_zicond
+		rv32gc_zicond		-----	g is imafd
+	The single-letter extensions follow rv32, the multi-letter ones
+	are separated by '_'. Unknown extensions are ignored.
+ */
+void SetupISA(char *arch)
+{
+	char *p;
+	int len;
+
+	if (strncmp(arch, "rv32", 4) != 0)
+		Fatal("Unsupported -march=%s, only rv32 is supported.", arch);
+
+	ISAExtensions = 0;
+	for (p = arch + 4; *p != 0 && *p != '_'; p++)
+	{
+		switch (*p)
+		{
+		case 'g':
+			ISAExtensions |= ISA_M | ISA_A | ISA_F | ISA_D;
+			break;
+
+		case 'm':
+			ISAExtensions |= ISA_M;
+			break;
+
+		case 'a':
+			ISAExtensions |= ISA_A;
+			break;
+
+		case 'f':
+			ISAExtensions |= ISA_F;
+			break;
+
+		case 'd':
+			ISAExtensions |= ISA_F | ISA_D;
+			break;
+
+		case 'c':
+			ISAExtensions |= ISA_C;
+			break;
+		}
+	}
+	while (*p == '_')
+	{
+		p++;
+		len = strcspn(p, "_");
+		if (len == 3 && strncmp(p, "zbb", 3) == 0)
+			ISAExtensions |= ISA_ZBB;
+		else if (len == 6 && strncmp(p, "zicond", 6) == 0)
+			ISAExtensions |= ISA_ZICOND;
+		p += len;
+	}
 }
 
 void PutASMCode(int code, Symbol opds[])
@@ -285,39 +384,8 @@ void PutASMCode(int code, Symbol opds[])
 
 void BeginProgram(void)
 {
-	int i;
-
 	ORG = 0;
 	FloatNum = TempNum = 0;
-	for (i = T0; i <= T6; ++i)
-	{
-		// Initialize register symbols to
-		// make sure that no register contains data from variables.
-		if (TempRegs[i] != NULL)
-		{
-			TempRegs[i]->link = NULL;
-		}
-	}
-
-	for (i = A0; i <= A7; ++i)
-	{
-		// Initialize register symbols to
-		// make sure that no register contains data from variables.
-		if (FuncRegs[i] != NULL)
-		{
-			FuncRegs[i]->link = NULL;
-		}
-	}
-
-	for (i = S1; i <= S11; ++i)
-	{
-		// Initialize register symbols to
-		// make sure that no register contains data from variables.
-		if (SaveRegs[i] != NULL)
-		{
-			SaveRegs[i]->link = NULL;
-		}
-	}
 
 	PutString("# Code auto-generated by UCC\n\n");
 }
@@ -466,7 +534,7 @@ void DefineAddress(Symbol p)
 	 .align 2
 	 .globl  s
 	 
-	 s:  .word	 100
+	 s:  .half	 100
 	 
 	 .globl  i 
 	 i:  .long	 300
@@ -493,7 +561,7 @@ void DefineValue(Type ty, union value val)
 		break;
 
 	case I2: case U2:
-		Print(".word\t%d\n", val.i[0] & 0xffff);
+		Print(".half\t%d\n", val.i[0] & 0xffff);
 		break;
 
 	case I4: case U4:
@@ -19,118 +19,168 @@ TEMPLATE(RISCV_BANDU4,    "and %0, %1, %2")
 TEMPLATE(RISCV_BANDF4,    NULL)
 TEMPLATE(RISCV_BANDF8,    NULL)
 
-TEMPLATE(RISCV_LSHI4,    "shl %0, %1, %2")
-TEMPLATE(RISCV_LSHU4,    "shl %0, %1, %2")
+TEMPLATE(RISCV_LSHI4,    "sll %0, %1, %2")
+TEMPLATE(RISCV_LSHU4,    "sll %0, %1, %2")
 TEMPLATE(RISCV_LSHF4,    NULL)
 TEMPLATE(RISCV_LSHF8,    NULL)
 
-TEMPLATE(RISCV_RSHI4,    "srl %0, %1, %2")
+TEMPLATE(RISCV_RSHI4,    "sra %0, %1, %2")
 TEMPLATE(RISCV_RSHU4,    "srl %0, %1, %2")
 TEMPLATE(RISCV_RSHF4,    NULL)
 TEMPLATE(RISCV_RSHF8,    NULL)
 
 TEMPLATE(RISCV_ADDI4,    "add %0, %1, %2")
 TEMPLATE(RISCV_ADDU4,    "add %0, %1, %2")
-TEMPLATE(RISCV_ADDF4,     NULL)
-TEMPLATE(RISCV_ADDF8,     NULL)
+TEMPLATE(RISCV_ADDF4,    "fadd.s %0, %1, %2")
+TEMPLATE(RISCV_ADDF8,    "fadd.d %0, %1, %2")
 
 TEMPLATE(RISCV_SUBI4,    "sub %0, %1, %2")
 TEMPLATE(RISCV_SUBU4,    "sub %0, %1, %2")
-TEMPLATE(RISCV_SUBF4,    NULL)
-TEMPLATE(RISCV_SUBF8,    NULL)
+TEMPLATE(RISCV_SUBF4,    "fsub.s %0, %1, %2")
+TEMPLATE(RISCV_SUBF8,    "fsub.d %0, %1, %2")
 
 TEMPLATE(RISCV_MULI4,    "mul %0, %1, %2")
 TEMPLATE(RISCV_MULU4,    "mul %0, %1, %2")
-TEMPLATE(RISCV_MULF4,    NULL)
-TEMPLATE(RISCV_MULF8,    NULL)
+TEMPLATE(RISCV_MULF4,    "fmul.s %0, %1, %2")
+TEMPLATE(RISCV_MULF8,    "fmul.d %0, %1, %2")
 
 TEMPLATE(RISCV_DIVI4,    "div %0, %1, %2")
-TEMPLATE(RISCV_DIVU4,    "div %0, %1, %2")
-TEMPLATE(RISCV_DIVF4,    NULL)
-TEMPLATE(RISCV_DIVF8,    NULL)
+TEMPLATE(RISCV_DIVU4,    "divu %0, %1, %2")
+TEMPLATE(RISCV_DIVF4,    "fdiv.s %0, %1, %2")
+TEMPLATE(RISCV_DIVF8,    "fdiv.d %0, %1, %2")
 
 TEMPLATE(RISCV_MODI4,    "rem %0, %1, %2")
-TEMPLATE(RISCV_MODU4,    "rem %0, %1, %2")
+TEMPLATE(RISCV_MODU4,    "remu %0, %1, %2")
 TEMPLATE(RISCV_MODF4,    NULL)
 TEMPLATE(RISCV_MODF8,    NULL)
 
 TEMPLATE(RISCV_NEGI4,    "neg %0, %1")
 TEMPLATE(RISCV_NEGU4,    "neg %0, %1")
-TEMPLATE(RISCV_NEGF4,    NULL)
-TEMPLATE(RISCV_NEGF8,    NULL)
+TEMPLATE(RISCV_NEGF4,    "fneg.s %0, %1")
+TEMPLATE(RISCV_NEGF8,    "fneg.d %0, %1")
 
 TEMPLATE(RISCV_COMPI4,   "not %0, %1")
 TEMPLATE(RISCV_COMPU4,   "not %0, %1")
 TEMPLATE(RISCV_COMPF4,   NULL)
 TEMPLATE(RISCV_COMPF8,   NULL)
 
-TEMPLATE(RISCV_JZI4,     "beq %1, 0, %0")
-TEMPLATE(RISCV_JZU4,     "beq %1, 0, %0")
-TEMPLATE(RISCV_JZF4,     NULL)
-TEMPLATE(RISCV_JZF8,     NULL)
-
-TEMPLATE(RISCV_JNZI4,    "bne %1, 0, %0")
-TEMPLATE(RISCV_JNZU4,    "bne %1, 0, %0")
-TEMPLATE(RISCV_JNZF4,    NULL)
-TEMPLATE(RISCV_JNZF8,    NULL)
+TEMPLATE(RISCV_SEQI4,    "xor %0, %1, %2;seqz %0, %0")
+TEMPLATE(RISCV_SEQU4,    "xor %0, %1, %2;seqz %0, %0")
+TEMPLATE(RISCV_SEQF4,    "feq.s %0, %1, %2")
+TEMPLATE(RISCV_SEQF8,    "feq.d %0, %1, %2")
+
+TEMPLATE(RISCV_SNEI4,    "xor %0, %1, %2;snez %0, %0")
+TEMPLATE(RISCV_SNEU4,    "xor %0, %1, %2;snez %0, %0")
+TEMPLATE(RISCV_SNEF4,    "feq.s %0, %1, %2;xori %0, %0, 1")
+TEMPLATE(RISCV_SNEF8,    "feq.d %0, %1, %2;xori %0, %0, 1")
+
+TEMPLATE(RISCV_SGTI4,    "slt %0, %2, %1")
+TEMPLATE(RISCV_SGTU4,    "sltu %0, %2, %1")
+TEMPLATE(RISCV_SGTF4,    "flt.s %0, %2, %1")
+TEMPLATE(RISCV_SGTF8,    "flt.d %0, %2, %1")
+
+TEMPLATE(RISCV_SLTI4,    "slt %0, %1, %2")
+TEMPLATE(RISCV_SLTU4,    "sltu %0, %1, %2")
+TEMPLATE(RISCV_SLTF4,    "flt.s %0, %1, %2")
+TEMPLATE(RISCV_SLTF8,    "flt.d %0, %1, %2")
+
+TEMPLATE(RISCV_SGEI4,    "slt %0, %1, %2;xori %0, %0, 1")
+TEMPLATE(RISCV_SGEU4,    "sltu %0, %1, %2;xori %0, %0, 1")
+TEMPLATE(RISCV_SGEF4,    "fle.s %0, %2, %1")
+TEMPLATE(RISCV_SGEF8,    "fle.d %0, %2, %1")
+
+TEMPLATE(RISCV_SLEI4,    "slt %0, %2, %1;xori %0, %0, 1")
+TEMPLATE(RISCV_SLEU4,    "sltu %0, %2, %1;xori %0, %0, 1")
+TEMPLATE(RISCV_SLEF4,    "fle.s %0, %1, %2")
+TEMPLATE(RISCV_SLEF8,    "fle.d %0, %1, %2")
+
+TEMPLATE(RISCV_MINI4,    "min %0, %1, %2")
+TEMPLATE(RISCV_MINU4,    "minu %0, %1, %2")
+TEMPLATE(RISCV_MINF4,    NULL)
+TEMPLATE(RISCV_MINF8,    NULL)
+
+TEMPLATE(RISCV_MAXI4,    "max %0, %1, %2")
+TEMPLATE(RISCV_MAXU4,    "maxu %0, %1, %2")
+TEMPLATE(RISCV_MAXF4,    NULL)
+TEMPLATE(RISCV_MAXF8,    NULL)
+
+TEMPLATE(RISCV_SELNZI4,  "czero.eqz %0, %1, %2")
+TEMPLATE(RISCV_SELNZU4,  "czero.eqz %0, %1, %2")
+TEMPLATE(RISCV_SELNZF4,  NULL)
+TEMPLATE(RISCV_SELNZF8,  NULL)
+
+TEMPLATE(RISCV_SELZI4,   "czero.nez %0, %1, %2")
+TEMPLATE(RISCV_SELZU4,   "czero.nez %0, %1, %2")
+TEMPLATE(RISCV_SELZF4,   NULL)
+TEMPLATE(RISCV_SELZF8,   NULL)
+
+TEMPLATE(RISCV_JZI4,     "beqz %1, %0")
+TEMPLATE(RISCV_JZU4,     "beqz %1, %0")
+TEMPLATE(RISCV_JZF4,     "fmv.w.x %2, zero;feq.s %3, %1, %2;bnez %3, %0")
+TEMPLATE(RISCV_JZF8,     "fcvt.d.w %2, zero;feq.d %3, %1, %2;bnez %3, %0")
+
+TEMPLATE(RISCV_JNZI4,    "bnez %1, %0")
+TEMPLATE(RISCV_JNZU4,    "bnez %1, %0")
+TEMPLATE(RISCV_JNZF4,    "fmv.w.x %2, zero;feq.s %3, %1, %2;beqz %3, %0")
+TEMPLATE(RISCV_JNZF8,    "fcvt.d.w %2, zero;feq.d %3, %1, %2;beqz %3, %0")
 
 TEMPLATE(RISCV_JEI4,     "beq %1, %2, %0")
 TEMPLATE(RISCV_JEU4,     "beq %1, %2, %0")
-TEMPLATE(RISCV_JEF4,     NULL)
-TEMPLATE(RISCV_JEF8,     NULL)
+TEMPLATE(RISCV_JEF4,     "feq.s %3, %1, %2;bnez %3, %0")
+TEMPLATE(RISCV_JEF8,     "feq.d %3, %1, %2;bnez %3, %0")
 
-TEMPLATE(RISCV_JNEI4,    "bne %1, 0, %0")
-TEMPLATE(RISCV_JNEU4,    "bne %1, 0, %0")
-TEMPLATE(RISCV_JNEF4,    NULL)
-TEMPLATE(RISCV_JNEF8,    NULL)
+TEMPLATE(RISCV_JNEI4,    "bne %1, %2, %0")
+TEMPLATE(RISCV_JNEU4,    "bne %1, %2, %0")
+TEMPLATE(RISCV_JNEF4,    "feq.s %3, %1, %2;beqz %3, %0")
+TEMPLATE(RISCV_JNEF8,    "feq.d %3, %1, %2;beqz %3, %0")
 
 
 TEMPLATE(RISCV_JGI4,     "blt %2, %1, %0")
-TEMPLATE(RISCV_JGU4,     "blt %2, %1, %0")
-TEMPLATE(RISCV_JGF4,     NULL)
-TEMPLATE(RISCV_JGF8,     NULL)
+TEMPLATE(RISCV_JGU4,     "bltu %2, %1, %0")
+TEMPLATE(RISCV_JGF4,     "flt.s %3, %2, %1;bnez %3, %0")
+TEMPLATE(RISCV_JGF8,     "flt.d %3, %2, %1;bnez %3, %0")
 
 TEMPLATE(RISCV_JLI4,     "blt %1, %2, %0")
-TEMPLATE(RISCV_JLU4,     "blt %1, %2, %0")
-TEMPLATE(RISCV_JLF4,     NULL)
-TEMPLATE(RISCV_JLF8,     NULL)
+TEMPLATE(RISCV_JLU4,     "bltu %1, %2, %0")
+TEMPLATE(RISCV_JLF4,     "flt.s %3, %1, %2;bnez %3, %0")
+TEMPLATE(RISCV_JLF8,     "flt.d %3, %1, %2;bnez %3, %0")
 
 TEMPLATE(RISCV_JGEI4,    "bge %1, %2, %0")
-TEMPLATE(RISCV_JGEU4,    "bge %1, %2, %0")
-TEMPLATE(RISCV_JGEF4,    NULL)
-TEMPLATE(RISCV_JGEF8,    NULL)
+TEMPLATE(RISCV_JGEU4,    "bgeu %1, %2, %0")
+TEMPLATE(RISCV_JGEF4,    "fle.s %3, %2, %1;bnez %3, %0")
+TEMPLATE(RISCV_JGEF8,    "fle.d %3, %2, %1;bnez %3, %0")
 
 TEMPLATE(RISCV_JLEI4,    "bge %2, %1, %0")
-TEMPLATE(RISCV_JLEU4,    "bge %2, %1, %0")
-TEMPLATE(RISCV_JLEF4,    NULL)
-TEMPLATE(RISCV_JLEF8,    NULL)
+TEMPLATE(RISCV_JLEU4,    "bgeu %2, %1, %0")
+TEMPLATE(RISCV_JLEF4,    "fle.s %3, %1, %2;bnez %3, %0")
+TEMPLATE(RISCV_JLEF8,    "fle.d %3, %1, %2;bnez %3, %0")
 
 
 
-TEMPLATE(RISCV_EXTI1,    "addi %0, %1, 0")
-TEMPLATE(RISCV_EXTU1,    "addi %0, %1, 0")
-TEMPLATE(RISCV_EXTI2,    "addi %0, %1, 0")
-TEMPLATE(RISCV_EXTU2,    "addi %0, %1, 0")
-TEMPLATE(RISCV_TRUI1,    "addi %0, %1, 0")
-TEMPLATE(RISCV_TRUI2,    "addi %0, %1, 0")
+TEMPLATE(RISCV_EXTI1,    "mv %0, %1")
+TEMPLATE(RISCV_EXTU1,    "mv %0, %1")
+TEMPLATE(RISCV_EXTI2,    "mv %0, %1")
+TEMPLATE(RISCV_EXTU2,    "mv %0, %1")
+TEMPLATE(RISCV_TRUI1,    "slli %0, %1, 24;srai %0, %0, 24")
+TEMPLATE(RISCV_TRUI2,    "slli %0, %1, 16;srai %0, %0, 16")
 
  
-TEMPLATE(RISCV_CVTI4F4,  NULL)
-TEMPLATE(RISCV_CVTI4F8,  NULL)
-TEMPLATE(RISCV_CVTU4F4,  NULL)
-TEMPLATE(RISCV_CVTU4F8,  NULL)
+TEMPLATE(RISCV_CVTI4F4,  "fcvt.s.w %0, %1")
+TEMPLATE(RISCV_CVTI4F8,  "fcvt.d.w %0, %1")
+TEMPLATE(RISCV_CVTU4F4,  "fcvt.s.wu %0, %1")
+TEMPLATE(RISCV_CVTU4F8,  "fcvt.d.wu %0, %1")
 
-TEMPLATE(RISCV_CVTF4,  NULL) 
+TEMPLATE(RISCV_CVTF4,  "fcvt.d.s %0, %1") 
 
  
-TEMPLATE(RISCV_CVTF4I4,  NULL)
+TEMPLATE(RISCV_CVTF4I4,  "fcvt.w.s %0, %1, rtz")
  
-TEMPLATE(RISCV_CVTF4U4,  NULL)
-TEMPLATE(RISCV_CVTF8,   NULL)
+TEMPLATE(RISCV_CVTF4U4,  "fcvt.wu.s %0, %1, rtz")
+TEMPLATE(RISCV_CVTF8,   "fcvt.s.d %0, %1")
 
-TEMPLATE(RISCV_CVTF8I4,  NULL)
+TEMPLATE(RISCV_CVTF8I4,  "fcvt.w.d %0, %1, rtz")
  
-TEMPLATE(RISCV_CVTF8U4,  NULL)
+TEMPLATE(RISCV_CVTF8U4,  "fcvt.wu.d %0, %1, rtz")
 					
 		
 TEMPLATE(RISCV_INCI1,    "addi %0, %0, 1")
@@ -139,10 +189,10 @@ TEMPLATE(RISCV_INCI2,    "addi %0, %0, 1")
 TEMPLATE(RISCV_INCU2,    "addi %0, %0, 1")				
 TEMPLATE(RISCV_INCI4,    "addi %0, %0, 1")
 TEMPLATE(RISCV_INCU4,    "addi %0, %0, 1")
-TEMPLATE(RISCV_INCF4,    NULL)
+TEMPLATE(RISCV_INCF4,    "li %1, 1;fcvt.s.w %2, %1;fadd.s %0, %0, %2")
 
  
-TEMPLATE(RISCV_INCF8,    NULL)
+TEMPLATE(RISCV_INCF8,    "li %1, 1;fcvt.d.w %2, %1;fadd.d %0, %0, %2")
 
 TEMPLATE(RISCV_DECI1,    "addi %0, %0, -1")
 TEMPLATE(RISCV_DECU1,    "addi %0, %0, -1")
@@ -151,38 +201,169 @@ TEMPLATE(RISCV_DECU2,    "addi %0, %0, -1")
 TEMPLATE(RISCV_DECI4,    "addi %0, %0, -1")
 TEMPLATE(RISCV_DECU4,    "addi %0, %0, -1")
 
-TEMPLATE(RISCV_DECF4,    NULL)
-TEMPLATE(RISCV_DECF8,    NULL)
-
-TEMPLATE(RISCV_LOADIMME2REG,    "li %0, %1")
-TEMPLATE(RISCV_JUMP_OFFSET,    "j %0")
-TEMPLATE(RISCV_IMMED2MEM,    "li %2, %1;sw %2, %0")
-TEMPLATE(RISCV_MEM2REG,    "lw %0, %1")
-TEMPLATE(RISCV_REG2MEM,    "sw %1, %0")
-TEMPLATE(RISCV_MV_R2R,    "mv %0, %1")
-TEMPLATE(RISCV_MEM2REG_OFFSET,    "lw %0, %1(%2)")
-TEMPLATE(RISCV_REG2MEM_OFFSET,    "sw %1, %2(%0)")
-TEMPLATE(RISCV_REG2STACK,    "sw %0, %1(sp)")
-
-TEMPLATE(RISCV_PROLOGUE, "addi sp, sp, -8;sw  ra, 4(sp);sw s0, 0(sp);mv  s0, sp")
-TEMPLATE(RISCV_PUSHM2S,     "addi sp, sp, -4;lw %0, %1;sw %0, 0(sp)")
-TEMPLATE(RISCV_PUSHF4,   NULL)
-TEMPLATE(RISCV_PUSHF8,   NULL)
+TEMPLATE(RISCV_DECF4,    "li %1, 1;fcvt.s.w %2, %1;fsub.s %0, %0, %2")
+TEMPLATE(RISCV_DECF8,    "li %1, 1;fcvt.d.w %2, %1;fsub.d %0, %0, %2")
+
+TEMPLATE(RISCV_TRUU1,    "andi %0, %1, 255")
+TEMPLATE(RISCV_TRUU2,    "slli %0, %1, 16;srli %0, %0, 16")
+
+TEMPLATE(RISCV_LI,       "li %0, %1")
+TEMPLATE(RISCV_MOV,      "mv %0, %1")
+TEMPLATE(RISCV_FMOV,     "fmv.d %0, %1")
+TEMPLATE(RISCV_FMVXW,    "fmv.x.w %0, %1")
+TEMPLATE(RISCV_FMVXD,    "addi sp, sp, -16;fsd %2, 0(sp);lw %0, 0(sp);lw %1, 4(sp);addi sp, sp, 16")
+TEMPLATE(RISCV_FMADDF4,  "fmadd.s %0, %1, %2, %3")
+TEMPLATE(RISCV_FMADDF8,  "fmadd.d %0, %1, %2, %3")
+TEMPLATE(RISCV_FMSUBF4,  "fmsub.s %0, %1, %2, %3")
+TEMPLATE(RISCV_FMSUBF8,  "fmsub.d %0, %1, %2, %3")
+TEMPLATE(RISCV_FNMSUBF4, "fnmsub.s %0, %1, %2, %3")
+TEMPLATE(RISCV_FNMSUBF8, "fnmsub.d %0, %1, %2, %3")
+TEMPLATE(RISCV_FSQRTF4,  "fsqrt.s %0, %1")
+TEMPLATE(RISCV_FSQRTF8,  "fsqrt.d %0, %1")
+TEMPLATE(RISCV_ADDIMM,   "addi %0, %1, %2")
+TEMPLATE(RISCV_ADDIMMR,  "addi %0, %2, %1")
+TEMPLATE(RISCV_ANDI,     "andi %0, %1, %2")
+TEMPLATE(RISCV_ANDIR,    "andi %0, %2, %1")
+TEMPLATE(RISCV_ORI,      "ori %0, %1, %2")
+TEMPLATE(RISCV_ORIR,     "ori %0, %2, %1")
+TEMPLATE(RISCV_XORI,     "xori %0, %1, %2")
+TEMPLATE(RISCV_XORIR,    "xori %0, %2, %1")
+TEMPLATE(RISCV_SRAI,     "srai %0, %1, %2")
+TEMPLATE(RISCV_BLTZ,     "bltz %1, %0")
+TEMPLATE(RISCV_BGEZ,     "bgez %1, %0")
+TEMPLATE(RISCV_BGTZ,     "bgtz %1, %0")
+TEMPLATE(RISCV_BLEZ,     "blez %1, %0")
+TEMPLATE(RISCV_SEQZ,     "seqz %0, %1")
+TEMPLATE(RISCV_SEQZR,    "seqz %0, %2")
+TEMPLATE(RISCV_SNEZ,     "snez %0, %1")
+TEMPLATE(RISCV_SNEZR,    "snez %0, %2")
+TEMPLATE(RISCV_SGTZ,     "sgtz %0, %1")
+TEMPLATE(RISCV_SGTZR,    "sgtz %0, %2")
+TEMPLATE(RISCV_SEQIMM,   "xori %0, %1, %2;seqz %0, %0")
+TEMPLATE(RISCV_SNEIMM,   "xori %0, %1, %2;snez %0, %0")
+TEMPLATE(RISCV_SLTIMM,   "slti %0, %1, %2")
+TEMPLATE(RISCV_SLTIMMR,  "slti %0, %2, %1")
+TEMPLATE(RISCV_SLTIMMU,  "sltiu %0, %1, %2")
+TEMPLATE(RISCV_SLTIMMUR, "sltiu %0, %2, %1")
+TEMPLATE(RISCV_SGEIMM,   "slti %0, %1, %2;xori %0, %0, 1")
+TEMPLATE(RISCV_SGEIMMR,  "slti %0, %2, %1;xori %0, %0, 1")
+TEMPLATE(RISCV_SGEIMMU,  "sltiu %0, %1, %2;xori %0, %0, 1")
+TEMPLATE(RISCV_SGEIMMUR, "sltiu %0, %2, %1;xori %0, %0, 1")
+TEMPLATE(RISCV_MASKMINI4, "slt %3, %1, %2;neg %3, %3;xor %4, %1, %2;and %3, %3, %4;xor %0, %2, %3")
+TEMPLATE(RISCV_MASKMINU4, "sltu %3, %1, %2;neg %3, %3;xor %4, %1, %2;and %3, %3, %4;xor %0, %2, %3")
+TEMPLATE(RISCV_MASKMAXI4, "slt %3, %1, %2;neg %3, %3;xor %4, %1, %2;and %3, %3, %4;xor %0, %1, %3")
+TEMPLATE(RISCV_MASKMAXU4, "sltu %3, %1, %2;neg %3, %3;xor %4, %1, %2;and %3, %3, %4;xor %0, %1, %3")
+TEMPLATE(RISCV_MINZERO,  "srai %3, %1, 31;and %0, %1, %3")
+TEMPLATE(RISCV_MAXZERO,  "srai %3, %1, 31;not %3, %3;and %0, %1, %3")
+TEMPLATE(RISCV_MASKNZ,   "snez %3, %2;neg %3, %3;and %0, %1, %3")
+TEMPLATE(RISCV_MASKZ,    "snez %3, %2;addi %3, %3, -1;and %0, %1, %3")
+TEMPLATE(RISCV_MASKNZB,  "neg %3, %2;and %0, %1, %3")
+TEMPLATE(RISCV_MASKZB,   "addi %3, %2, -1;and %0, %1, %3")
+TEMPLATE(RISCV_JMP,      "j %0")
+TEMPLATE(RISCV_IJMP,     "slli %0, %1, 2;lui %2, %%hi(%3);add %0, %0, %2;lw %0, %%lo(%3)(%0);jr %0")
+
+TEMPLATE(RISCV_LDI1,     "lb %0, %1")
+TEMPLATE(RISCV_LDU1,     "lbu %0, %1")
+TEMPLATE(RISCV_LDI2,     "lh %0, %1")
+TEMPLATE(RISCV_LDU2,     "lhu %0, %1")
+TEMPLATE(RISCV_LDI4,     "lw %0, %1")
+TEMPLATE(RISCV_LDU4,     "lw %0, %1")
+TEMPLATE(RISCV_LDF4,     "flw %0, %1")
+TEMPLATE(RISCV_LDF8,     "fld %0, %1")
+
+TEMPLATE(RISCV_STI1,     "sb %0, %1")
+TEMPLATE(RISCV_STU1,     "sb %0, %1")
+TEMPLATE(RISCV_STI2,     "sh %0, %1")
+TEMPLATE(RISCV_STU2,     "sh %0, %1")
+TEMPLATE(RISCV_STI4,     "sw %0, %1")
+TEMPLATE(RISCV_STU4,     "sw %0, %1")
+TEMPLATE(RISCV_STF4,     "fsw %0, %1")
+TEMPLATE(RISCV_STF8,     "fsd %0, %1")
+
+TEMPLATE(RISCV_LDGI1,    "lui %0, %%hi(%1);lb %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGU1,    "lui %0, %%hi(%1);lbu %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGI2,    "lui %0, %%hi(%1);lh %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGU2,    "lui %0, %%hi(%1);lhu %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGI4,    "lui %0, %%hi(%1);lw %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGU4,    "lui %0, %%hi(%1);lw %0, %%lo(%1)(%0)")
+TEMPLATE(RISCV_LDGF4,    "lui %2, %%hi(%1);flw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDGF8,    "lui %2, %%hi(%1);fld %0, %%lo(%1)(%2)")
+
+TEMPLATE(RISCV_STGI1,    "lui %2, %%hi(%1);sb %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGU1,    "lui %2, %%hi(%1);sb %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGI2,    "lui %2, %%hi(%1);sh %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGU2,    "lui %2, %%hi(%1);sh %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGI4,    "lui %2, %%hi(%1);sw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGU4,    "lui %2, %%hi(%1);sw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGF4,    "lui %2, %%hi(%1);fsw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STGF8,    "lui %2, %%hi(%1);fsd %0, %%lo(%1)(%2)")
+
+TEMPLATE(RISCV_LDXI1,    "lui %2, %%hi(%1);add %2, %2, %3;lb %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXU1,    "lui %2, %%hi(%1);add %2, %2, %3;lbu %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXI2,    "lui %2, %%hi(%1);add %2, %2, %3;lh %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXU2,    "lui %2, %%hi(%1);add %2, %2, %3;lhu %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXI4,    "lui %2, %%hi(%1);add %2, %2, %3;lw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXU4,    "lui %2, %%hi(%1);add %2, %2, %3;lw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXF4,    "lui %2, %%hi(%1);add %2, %2, %3;flw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_LDXF8,    "lui %2, %%hi(%1);add %2, %2, %3;fld %0, %%lo(%1)(%2)")
+
+TEMPLATE(RISCV_STXI1,    "lui %2, %%hi(%1);add %2, %2, %3;sb %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXU1,    "lui %2, %%hi(%1);add %2, %2, %3;sb %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXI2,    "lui %2, %%hi(%1);add %2, %2, %3;sh %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXU2,    "lui %2, %%hi(%1);add %2, %2, %3;sh %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXI4,    "lui %2, %%hi(%1);add %2, %2, %3;sw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXU4,    "lui %2, %%hi(%1);add %2, %2, %3;sw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXF4,    "lui %2, %%hi(%1);add %2, %2, %3;fsw %0, %%lo(%1)(%2)")
+TEMPLATE(RISCV_STXF8,    "lui %2, %%hi(%1);add %2, %2, %3;fsd %0, %%lo(%1)(%2)")
+
+TEMPLATE(RISCV_IMOVI1,   "sb %2, %1")
+TEMPLATE(RISCV_IMOVU1,   "sb %2, %1")
+TEMPLATE(RISCV_IMOVI2,   "sh %2, %1")
+TEMPLATE(RISCV_IMOVU2,   "sh %2, %1")
+TEMPLATE(RISCV_IMOVI4,   "sw %2, %1")
+TEMPLATE(RISCV_IMOVU4,   "sw %2, %1")
+TEMPLATE(RISCV_IMOVF4,   "fsw %2, %1")
+TEMPLATE(RISCV_IMOVF8,   "fsd %2, %1")
+
+TEMPLATE(RISCV_LDOFF1,   "lbu %0, %2(%1)")
+TEMPLATE(RISCV_LDOFF2,   "lhu %0, %2(%1)")
+TEMPLATE(RISCV_LDOFF4,   "lw %0, %2(%1)")
+TEMPLATE(RISCV_STOFF1,   "sb %0, %2(%1)")
+TEMPLATE(RISCV_STOFF2,   "sh %0, %2(%1)")
+TEMPLATE(RISCV_STOFF4,   "sw %0, %2(%1)")
+TEMPLATE(RISCV_FSTOFF4,  "fsw %0, %2(%1)")
+TEMPLATE(RISCV_FSTOFF8,  "fsd %0, %2(%1)")
+
+TEMPLATE(RISCV_SLLI,     "slli %0, %1, %2")
+TEMPLATE(RISCV_SRLI,     "srli %0, %1, %2")
+TEMPLATE(RISCV_COPYDOWN4, "addi %1, %1, -%4;addi %2, %2, -%4;lw %3, 0(%1);sw %3, 0(%2);bne %2, sp, %0")
+TEMPLATE(RISCV_COPYDOWN1, "addi %1, %1, -%4;addi %2, %2, -%4;lbu %3, 0(%1);sb %3, 0(%2);bne %2, sp, %0")
+TEMPLATE(RISCV_LA,       "lui %0, %%hi(%1);addi %0, %0, %%lo(%1)")
+TEMPLATE(RISCV_LEAL,     "li %0, %1;add %0, %0, s0")
+TEMPLATE(RISCV_MEMCPY,   "mv a0, %0;mv a1, %1;li a2, %2;call memcpy")
+TEMPLATE(RISCV_MEMSET,   "mv a0, %0;li a1, 0;li a2, %1;call memset")
+TEMPLATE(RISCV_MULH,     "mulh %0, %1, %2")
+TEMPLATE(RISCV_MULHU,    "mulhu %0, %1, %2")
+TEMPLATE(RISCV_MULSI3,   "mv a0, %1;mv a1, %2;call __mulsi3;mv %0, a0")
+TEMPLATE(RISCV_DIVSI3,   "mv a0, %1;mv a1, %2;call __divsi3;mv %0, a0")
+TEMPLATE(RISCV_UDIVSI3,  "mv a0, %1;mv a1, %2;call __udivsi3;mv %0, a0")
+TEMPLATE(RISCV_MODSI3,   "mv a0, %1;mv a1, %2;call __modsi3;mv %0, a0")
+TEMPLATE(RISCV_UMODSI3,  "mv a0, %1;mv a1, %2;call __umodsi3;mv %0, a0")
+
 TEMPLATE(RISCV_EXPANDF,  "addi sp, sp, -%0")
-TEMPLATE(RISCV_LUI_ADDI_LEAL,  "lui %1, %%hi(%2);addi	%0, %1, %%lo(%2)")
-TEMPLATE(RISCV_CALL,     "call %1")
-TEMPLATE(RISCV_ICALL,    "call *%1")
 TEMPLATE(RISCV_REDUCEF,  "addi sp, sp, %0")
-TEMPLATE(RISCV_EPILOGUE, "mv sp, s0;lw ra, 4(sp);lw  s0, 0(sp);addi sp, sp, 8;jr	ra")
-
-
-TEMPLATE(RISCV_LDF4,     NULL)
-TEMPLATE(RISCV_LDF8,     NULL)
-TEMPLATE(RISCV_STF4,     NULL)
-TEMPLATE(RISCV_STF8,     NULL)
-
-
-TEMPLATE(RISCV_STF4_NO_POP,     NULL)
-TEMPLATE(RISCV_STF8_NO_POP,     NULL)
+TEMPLATE(RISCV_CALL,     "call %1")
+TEMPLATE(RISCV_ICALL,    "jalr %1")
+TEMPLATE(RISCV_TAIL,     "tail %1")
+TEMPLATE(RISCV_ITAIL,    "jr %1")
+TEMPLATE(RISCV_PROLOGUE, "addi sp, sp, -%0;sw ra, %1(sp);sw s0, %2(sp);addi s0, sp, %3")
+TEMPLATE(RISCV_EPILOGUE, "lw ra, %1(sp);lw s0, %2(sp);addi sp, sp, %0;ret")
+TEMPLATE(RISCV_PROLOGUE_LARGE, "li t0, %0;sub sp, sp, t0;li t0, %3;add t0, sp, t0;sw ra, -4(t0);sw s0, -8(t0);mv s0, t0")
+TEMPLATE(RISCV_EPILOGUE_LARGE, "lw ra, -4(s0);addi t0, s0, %4;lw s0, -8(s0);mv sp, t0;ret")
+TEMPLATE(RISCV_TAILEPILOGUE, "lw ra, %1(sp);lw s0, %2(sp);addi sp, sp, %0")
+TEMPLATE(RISCV_TAILEPILOGUE_LARGE, "lw ra, -4(s0);addi t0, s0, %4;lw s0, -8(s0);mv sp, t0")
+TEMPLATE(RISCV_SAVEREG,  "sw %0, %1(s0)")
+TEMPLATE(RISCV_RESTOREREG, "lw %0, %1(s0)")
+TEMPLATE(RISCV_SAVEFREG, "fsd %0, %1(s0)")
+TEMPLATE(RISCV_RESTOREFREG, "fld %0, %1(s0)")
 
-TEMPLATE(RISCV_X87_POP,     NULL)
@@ -0,0 +1,657 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Sparse conditional constant propagation on the SSA form.
+	(Mark N. Wegman and F. Kenneth Zadeck, "Constant Propagation with
+	Conditional Branches")
+
+	A temporary is undefined at first, then it holds a constant, or it is
+	varying.   Only the blocks reached along the executable edges are
+	evaluated, and a phi function only meets the arguments coming along
+	the executable edges, so a constant going around a loop isn't lost.
+
+		int f(int a){				t13 = a;
+			int x = 3;				t14 = 3;
+			if (x * 4 > 10)			t0 : t14 << 2;				t13 = a;
+				a += x * 4;			if (t0 <= 10) goto BB3;		t1 : t13 + 12;
+			else					BB2:				------>		return t1;
+				a -= 5;				t1 : t13 + t0;
+			return a;				goto BB4;
+		}						BB3:
+									t2 : t13 + -5;
+								BB4:
+									t3 : phi(t1 BB2, t2 BB3);
+									return t3;
+
+	The temporaries holding constants are replaced by the constants,
+	a branch on constants becomes a jump or falls through, the blocks
+	never reached are removed with their edges, see RebuildCFG().
+	The floating-point values are always varying.
+ */
+
+typedef struct use
+{
+	IRInst inst;
+	BBlock bb;
+	struct use *link;
+} *Use;
+
+// the outcome of the jump at the end of a reached block
+enum { REACH_NONE, REACH_ONE, REACH_ALL };
+
+/**
+	The value of temporary t is Values[AsVar(t)->no]:
+	NULL if undefined, a constant, or t itself if varying.
+ */
+static Symbol *Values;
+// the instructions using temporary t, Uses[AsVar(t)->no]
+static Use *Uses;
+static int *Defined;
+static int NumUses;
+
+// the uses of the temporaries whose values are lowered
+static Use *UseList;
+static int UseTop;
+// the blocks with new executable edges coming in
+static BBlock *BlockList;
+static int BlockTop;
+static int *Queued;
+static int *Reached;
+// Outcome[bb->no] is REACH_ONE when only Taken[bb->no] is reached from bb
+static int *Outcome;
+static BBlock *Taken;
+
+static BBlock CurBB;
+static IRInst CurInst;
+
+#define IsConst(p)    ((p) != NULL && (p)->kind == SK_Constant)
+#define IsJump(op)    ((op) >= JZ && (op) <= IJMP)
+
+static Symbol ValueOf(Symbol p)
+{
+	return IsNumbered(p) ? Values[AsVar(p)->no] : p;
+}
+
+static int IsUnsignedValue(Type ty)
+{
+	return IsPtrType(ty) || (IsIntegType(ty) && IsUnsigned(ty));
+}
+
+/**
+ * The constant n of type ty, a char/short value is extended as in a register.
+ */
+static Symbol MakeConstant(Type ty, int n)
+{
+	union value val;
+
+	if (ty->size == 1)
+		n = IsUnsigned(ty) ? (unsigned char)n : (signed char)n;
+	else if (ty->size == 2)
+		n = IsUnsigned(ty) ? (unsigned short)n : (short)n;
+
+	val.i[0] = n;
+	val.i[1] = 0;
+	return AddConstant(ty, val);
+}
+
+/**
+	rel is 0 .. 5 for ==, !=, >, <, >=, <=,
+	the order of SEQ .. SLE and JE .. JLE.
+ */
+static int Compare(int rel, int unsign, int c1, int c2)
+{
+	unsigned int u1 = c1, u2 = c2;
+
+	switch (rel)
+	{
+	case 0:
+		return c1 == c2;
+
+	case 1:
+		return c1 != c2;
+
+	case 2:
+		return unsign ? u1 > u2 : c1 > c2;
+
+	case 3:
+		return unsign ? u1 < u2 : c1 < c2;
+
+	case 4:
+		return unsign ? u1 >= u2 : c1 >= c2;
+
+	default:
+		return unsign ? u1 <= u2 : c1 <= c2;
+	}
+}
+
+/**
+	Compute dst = src1 op src2 of integer constants as the machine does.
+	Return NULL if it can't be done at compile time, e.g. a division by 0.
+ */
+static Symbol Fold(IRInst inst, Symbol src1, Symbol src2)
+{
+	int unsign = IsUnsignedValue(inst->ty);
+	int c1 = src1->val.i[0], c2 = src2 != NULL ? src2->val.i[0] : 0;
+	unsigned int u1 = c1, u2 = c2;
+	int n;
+
+	switch (inst->opcode)
+	{
+	case BOR:
+		n = c1 | c2;
+		break;
+
+	case BXOR:
+		n = c1 ^ c2;
+		break;
+
+	case BAND:
+		n = c1 & c2;
+		break;
+
+	case LSH:
+		n = (int)(u1 << (c2 & 31));
+		break;
+
+	case RSH:
+		n = unsign ? (int)(u1 >> (c2 & 31)) : c1 >> (c2 & 31);
+		break;
+
+	case ADD:
+		n = (int)(u1 + u2);
+		break;
+
+	case SUB:
+		n = (int)(u1 - u2);
+		break;
+
+	case MUL:
+		n = (int)(u1 * u2);
+		break;
+
+	case DIV:
+	case MOD:
+		if (c2 == 0)
+			return NULL;
+		if (unsign)
+			n = inst->opcode == DIV ? (int)(u1 / u2) : (int)(u1 % u2);
+		else if (c2 == -1)
+			n = inst->opcode == DIV ? (int)(0u - u1) : 0;
+		else
+			n = inst->opcode == DIV ? c1 / c2 : c1 % c2;
+		break;
+
+	case NEG:
+		n = (int)(0u - u1);
+		break;
+
+	case BCOM:
+		n = ~c1;
+		break;
+
+	case SEQ:
+	case SNE:
+	case SGT:
+	case SLT:
+	case SGE:
+	case SLE:
+		n = Compare(inst->opcode - SEQ, unsign, c1, c2);
+		break;
+
+	case MIN:
+		n = Compare(3, unsign, c1, c2) ? c1 : c2;
+		break;
+
+	case MAX:
+		n = Compare(2, unsign, c1, c2) ? c1 : c2;
+		break;
+
+	case SELNZ:
+		n = c2 != 0 ? c1 : 0;
+		break;
+
+	case SELZ:
+		n = c2 == 0 ? c1 : 0;
+		break;
+
+	case EXTI1:
+		n = (signed char)c1;
+		break;
+
+	case EXTU1:
+		n = (unsigned char)c1;
+		break;
+
+	case EXTI2:
+		n = (short)c1;
+		break;
+
+	case EXTU2:
+		n = (unsigned short)c1;
+		break;
+
+	case TRUI1:
+	case TRUI2:
+		// truncated by MakeConstant()
+		n = c1;
+		break;
+
+	default:
+		return NULL;
+	}
+
+	return MakeConstant(inst->opds[0]->ty, n);
+}
+
+/**
+	The block reached by the conditional jump inst on constants,
+	src2 is NULL for JZ and JNZ.
+ */
+static BBlock JumpTarget(BBlock bb, IRInst inst, Symbol src1, Symbol src2)
+{
+	int taken;
+
+	if (inst->opcode == JZ)
+		taken = src1->val.i[0] == 0;
+	else if (inst->opcode == JNZ)
+		taken = src1->val.i[0] != 0;
+	else
+		taken = Compare(inst->opcode - JE, IsUnsignedValue(inst->ty), src1->val.i[0], src2->val.i[0]);
+
+	return taken ? (BBlock)inst->opds[0] : bb->next;
+}
+
+/**
+ * The block reached by goto (BB1, BB2, ...)[i] with constant i, or NULL if i is out of range
+ */
+static BBlock IndirectTarget(IRInst inst, Symbol index)
+{
+	BBlock *dstBBs = (BBlock *)inst->opds[0];
+	int i;
+
+	if (index->val.i[0] < 0)
+		return NULL;
+
+	for (i = 0; dstBBs[i] != NULL; i++)
+	{
+		if (i == index->val.i[0])
+			return dstBBs[i];
+	}
+	return NULL;
+}
+
+static void Reach(BBlock bb)
+{
+	if (! Queued[bb->no])
+	{
+		Queued[bb->no] = 1;
+		BlockList[BlockTop++] = bb;
+	}
+}
+
+/**
+ * taken is the only block reached from bb, or NULL when all the successors are reached.
+ */
+static void SetOutcome(BBlock bb, BBlock taken)
+{
+	CFGEdge succ;
+
+	if (Outcome[bb->no] == REACH_ALL || (Outcome[bb->no] == REACH_ONE && Taken[bb->no] == taken))
+		return;
+
+	if (taken != NULL)
+	{
+		Outcome[bb->no] = REACH_ONE;
+		Taken[bb->no] = taken;
+		Reach(taken);
+		return;
+	}
+
+	Outcome[bb->no] = REACH_ALL;
+	for (succ = bb->succs; succ != NULL; succ = succ->next)
+	{
+		Reach(succ->bb);
+	}
+}
+
+static int IsExecutable(BBlock pred, BBlock bb)
+{
+	return Outcome[pred->no] == REACH_ALL || (Outcome[pred->no] == REACH_ONE && Taken[pred->no] == bb);
+}
+
+static void SetValue(Symbol t, Symbol val)
+{
+	Use use;
+	int no = AsVar(t)->no;
+
+	if (Values[no] == val || Values[no] == t)
+		return;
+
+	Values[no] = val;
+	for (use = Uses[no]; use != NULL; use = use->link)
+	{
+		UseList[UseTop++] = use;
+	}
+}
+
+static void EvaluateJump(BBlock bb, IRInst inst)
+{
+	Symbol v1, v2 = NULL;
+	BBlock taken;
+
+	if (inst->opcode == JMP)
+	{
+		SetOutcome(bb, NULL);
+		return;
+	}
+
+	v1 = ValueOf(inst->opds[1]);
+	if (inst->opcode > JNZ && inst->opcode <= JLE)
+		v2 = ValueOf(inst->opds[2]);
+	if (v1 == NULL || (inst->opcode > JNZ && inst->opcode <= JLE && v2 == NULL))
+		return;
+
+	taken = NULL;
+	if (inst->opcode == IJMP)
+	{
+		if (IsConst(v1))
+			taken = IndirectTarget(inst, v1);
+	}
+	else if (IsConst(v1) && (inst->opcode <= JNZ || IsConst(v2)))
+	{
+		taken = JumpTarget(bb, inst, v1, v2);
+	}
+	SetOutcome(bb, taken);
+}
+
+static void EvaluatePhi(BBlock bb, IRInst inst)
+{
+	Vector args = (Vector)inst->opds[1];
+	Symbol dst = inst->opds[0];
+	Symbol val = NULL, v;
+	PhiArg arg;
+	int i;
+
+	if (! IsNumbered(dst))
+		return;
+
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		if (! IsExecutable(arg->bb, bb) || (v = ValueOf(arg->sym)) == NULL)
+			continue;
+
+		if (! IsConst(v))
+		{
+			val = dst;
+			break;
+		}
+		if (val != NULL && val != v)
+		{
+			val = dst;
+			break;
+		}
+		val = v;
+	}
+	if (val != NULL)
+		SetValue(dst, val);
+}
+
+static void Evaluate(BBlock bb, IRInst inst)
+{
+	int op = inst->opcode;
+	Symbol dst = inst->opds[0];
+	Symbol v1, v2;
+
+	if (op == PHI)
+	{
+		EvaluatePhi(bb, inst);
+		return;
+	}
+	if (IsJump(op))
+	{
+		EvaluateJump(bb, inst);
+		return;
+	}
+	// IMOV and RET don't define opds[0]
+	if (op == IMOV || op == RET || op == CLR || op == NOP || ! IsNumbered(dst))
+		return;
+
+	if (op == MOV)
+	{
+		if ((v1 = ValueOf(inst->opds[1])) != NULL)
+			SetValue(dst, IsConst(v1) ? MakeConstant(dst->ty, v1->val.i[0]) : dst);
+		return;
+	}
+
+	if ((op <= SELZ || (op >= EXTI1 && op <= TRUI2)) && ! IsRealType(inst->ty))
+	{
+		v1 = ValueOf(inst->opds[1]);
+		v2 = inst->opds[2] != NULL ? ValueOf(inst->opds[2]) : NULL;
+		if (v1 == NULL || (inst->opds[2] != NULL && v2 == NULL))
+			return;
+
+		if (IsConst(v1) && (inst->opds[2] == NULL || IsConst(v2)) &&
+		    (v1 = Fold(inst, v1, v2)) != NULL)
+		{
+			SetValue(dst, v1);
+			return;
+		}
+	}
+	SetValue(dst, dst);
+}
+
+static void VisitBlock(BBlock bb)
+{
+	IRInst inst;
+
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+	{
+		Evaluate(bb, inst);
+	}
+	if (! IsJump(bb->insth.prev->opcode))
+		SetOutcome(bb, NULL);
+}
+
+static void RecordUse(Symbol *opd, int def)
+{
+	Use use;
+	int no;
+
+	if (! IsNumbered(*opd))
+		return;
+
+	no = AsVar(*opd)->no;
+	if (def)
+	{
+		if (Defined[no] == 0)
+			Defined[no] = 1;
+		return;
+	}
+	// a function called through a pointer needs the type of the pointer
+	if (CurInst->opcode == CALL && opd == &CurInst->opds[1])
+		Defined[no] = -1;
+
+	ALLOC(use);
+	use->inst = CurInst;
+	use->bb = CurBB;
+	use->link = Uses[no];
+	Uses[no] = use;
+	NumUses++;
+}
+
+static void Substitute(Symbol *opd, int def)
+{
+	if (! def && IsNumbered(*opd) && IsConst(Values[AsVar(*opd)->no]))
+		*opd = Values[AsVar(*opd)->no];
+}
+
+/**
+ * A jump on constants goes to one block.
+ */
+static void FoldJump(BBlock bb)
+{
+	IRInst lasti = bb->insth.prev;
+	int op = lasti->opcode;
+	BBlock taken;
+
+	if (op == IJMP && IsConst(lasti->opds[1]))
+	{
+		if ((taken = IndirectTarget(lasti, lasti->opds[1])) == NULL)
+			return;
+	}
+	else if (op >= JZ && op <= JLE && IsConst(lasti->opds[1]) && (op <= JNZ || IsConst(lasti->opds[2])))
+	{
+		taken = JumpTarget(bb, lasti, lasti->opds[1], lasti->opds[2]);
+		if (taken == bb->next)
+		{
+			RemoveInst(bb, lasti);
+			return;
+		}
+	}
+	else
+	{
+		return;
+	}
+
+	lasti->opcode = JMP;
+	lasti->opds[0] = (Symbol)taken;
+	lasti->opds[1] = lasti->opds[2] = NULL;
+}
+
+/**
+ * Remove the arguments of the phi functions in bb not coming from the predecessors.
+ */
+static void RemovePhiArgs(BBlock bb)
+{
+	IRInst inst;
+	CFGEdge pred;
+	Vector args;
+	PhiArg arg;
+	int i, n;
+
+	for (inst = bb->insth.next; inst->opcode == PHI; inst = inst->next)
+	{
+		args = (Vector)inst->opds[1];
+		n = 0;
+		for (i = 0; i < LEN(args); i++)
+		{
+			arg = GET_ITEM(args, i);
+			for (pred = bb->preds; pred != NULL; pred = pred->next)
+			{
+				if (pred->bb == arg->bb)
+					break;
+			}
+			if (pred != NULL)
+				args->data[n++] = arg;
+		}
+		args->len = n;
+	}
+}
+
+void PropagateConstants(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst, next;
+	Symbol p;
+	Use use;
+	int n, nblock;
+
+	n = nblock = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) && ! IsRealType(p->ty) ? ++n : 0;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = nblock++;
+	}
+
+	Values = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	Uses = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Use));
+	Defined = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	memset(Values, 0, (n + 1) * sizeof(Symbol));
+	memset(Uses, 0, (n + 1) * sizeof(Use));
+	memset(Defined, 0, (n + 1) * sizeof(int));
+	NumUses = 0;
+	for (CurBB = fsym->entryBB; CurBB != NULL; CurBB = CurBB->next)
+	{
+		for (CurInst = CurBB->insth.next; CurInst != &CurBB->insth; CurInst = CurInst->next)
+		{
+			VisitOperands(CurInst, RecordUse);
+		}
+	}
+	// the undefined values are varying, they may be anything
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (IsNumbered(p) && Defined[AsVar(p)->no] <= 0)
+			Values[AsVar(p)->no] = p;
+	}
+
+	// the value of a temporary is lowered twice at most
+	UseList = HeapAllocate(CurrentHeap, (2 * NumUses + 1) * sizeof(Use));
+	BlockList = HeapAllocate(CurrentHeap, (nblock + 1) * sizeof(BBlock));
+	Queued = HeapAllocate(CurrentHeap, (nblock + 1) * sizeof(int));
+	Reached = HeapAllocate(CurrentHeap, (nblock + 1) * sizeof(int));
+	Outcome = HeapAllocate(CurrentHeap, (nblock + 1) * sizeof(int));
+	Taken = HeapAllocate(CurrentHeap, (nblock + 1) * sizeof(BBlock));
+	memset(Queued, 0, (nblock + 1) * sizeof(int));
+	memset(Reached, 0, (nblock + 1) * sizeof(int));
+	memset(Outcome, 0, (nblock + 1) * sizeof(int));
+	UseTop = BlockTop = 0;
+
+	Reach(fsym->entryBB);
+	while (BlockTop != 0 || UseTop != 0)
+	{
+		if (BlockTop != 0)
+		{
+			bb = BlockList[--BlockTop];
+			Queued[bb->no] = 0;
+			if (! Reached[bb->no])
+			{
+				Reached[bb->no] = 1;
+				VisitBlock(bb);
+				continue;
+			}
+			// a new edge comes in
+			for (inst = bb->insth.next; inst->opcode == PHI; inst = inst->next)
+			{
+				EvaluatePhi(bb, inst);
+			}
+			continue;
+		}
+
+		use = UseList[--UseTop];
+		if (Reached[use->bb->no])
+			Evaluate(use->bb, use->inst);
+	}
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+		{
+			next = inst->next;
+			VisitOperands(inst, Substitute);
+			if (inst->opcode != IMOV && inst->opcode != RET && ! IsJump(inst->opcode) &&
+			    IsNumbered(inst->opds[0]) && IsConst(Values[AsVar(inst->opds[0])->no]))
+				RemoveInst(bb, inst);
+		}
+		if (Reached[bb->no])
+			FoldJump(bb);
+	}
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+
+	// the blocks not reached are removed
+	ComputeDominators(fsym);
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		RemovePhiArgs(bb);
+	}
+}
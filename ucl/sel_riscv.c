@@ -0,0 +1,469 @@
+#include "ucl.h"
+#include "gen.h"
+#include "reg_riscv.h"
+#include "sel_riscv.h"
+
+/**
+	Instruction selection by tree pattern matching.
+
+	The patterns are the rules in riscvlinux.brg, each of them rewrites
+	one UIL instruction whose operands match some nonterminals, see the
+	comments there.  Like the labeler of BURG, LabelBBlock() finds for every
+	instruction of a basic block the rule of the minimal cost, the cost of
+	an operand is the number of instructions needed to put it in the form
+	required by the nonterminal.
+
+	The UIL of an expression is a tree flattened into a sequence of
+	instructions linked by temporaries, so the subtree of an operand is the
+	instruction defining it.  An address computed shortly before its only use
+	is folded into the memory operand of the load or store:
+		t1 = p + 8;			----- rewritten to NT_ADDR, not emitted
+		t2 = *t1;			----- lw a5, 8(a4)
+	The code of the selected rules is emitted by EmitMatch() in riscv.c.
+ */
+
+enum ASMCode
+{
+#define TEMPLATE(code, str) code,
+#include "riscvlinux.tpl"
+#undef TEMPLATE
+};
+
+#define TY_I1       (1 << I1)
+#define TY_U1       (1 << U1)
+#define TY_I2       (1 << I2)
+#define TY_U2       (1 << U2)
+#define TY_I4       (1 << I4)
+#define TY_U4       (1 << U4)
+#define TY_F4       (1 << F4)
+#define TY_F8       (1 << F8)
+#define TY_INT      (TY_I4 | TY_U4)
+#define TY_SIGNED   (TY_I1 | TY_I2 | TY_I4)
+#define TY_UNSIGNED (TY_U1 | TY_U2 | TY_U4)
+#define TY_INTEGER  (TY_SIGNED | TY_UNSIGNED)
+
+#define IsImm12(n) ((n) >= -2048 && (n) < 2048)
+#define IsIntConst(p) ((p)->kind == SK_Constant && ! IsRealType((p)->ty))
+// the cost of an operand not matching the nonterminal
+#define NO_MATCH 10000
+// the maximal distance between an address and the load or store using it
+#define FOLD_WINDOW 8
+
+struct rule Rules[] =
+{
+#define RULE(lhs, op, types, kid1, kid2, cost, code) {lhs, op, types, {kid1, kid2}, cost, code},
+#include "riscvlinux.brg"
+#undef RULE
+};
+
+#define NUM_RULES (sizeof(Rules) / sizeof(Rules[0]))
+
+/**
+	The rules of every opcode, chained in the order of riscvlinux.brg:
+		FirstRule[opcode], NextRule[FirstRule[opcode]], ...
+ */
+static int FirstRule[NOP + 1];
+static int NextRule[NUM_RULES];
+
+static void SetupRules(void)
+{
+	static int done;
+	int last[NOP + 1];
+	int i;
+
+	if (done)
+		return;
+
+	for (i = 0; i <= NOP; i++)
+	{
+		FirstRule[i] = last[i] = -1;
+	}
+	for (i = 0; i < NUM_RULES; i++)
+	{
+		NextRule[i] = -1;
+		if (last[Rules[i].opcode] < 0)
+			FirstRule[Rules[i].opcode] = i;
+		else
+			NextRule[last[Rules[i].opcode]] = i;
+		last[Rules[i].opcode] = i;
+	}
+	done = 1;
+}
+
+/**
+ * Return the operands of inst matched by the kids of its rules
+ */
+static void GetKids(IRInst inst, Symbol kids[])
+{
+	if (inst->opcode == IMOV)
+	{
+		kids[0] = inst->opds[0];
+		kids[1] = inst->opds[1];
+	}
+	else if (inst->opcode == DEREF)
+	{
+		kids[0] = inst->opds[1];
+		kids[1] = NULL;
+	}
+	else
+	{
+		kids[0] = inst->opds[1];
+		kids[1] = inst->opds[2];
+	}
+}
+
+/**
+ * The number of instructions to put p into a register
+ */
+static int RegCost(Symbol p)
+{
+	if (p->reg != NULL)
+		return 0;
+
+	if (IsIntConst(p))
+		return p->val.i[0] == 0 ? 0 : (IsImm12(p->val.i[0]) ? 1 : 2);
+
+	// the constants of floating-point and global objects need lui first
+	if (p->kind == SK_Constant || p->kind == SK_String || p->kind == SK_Function ||
+	    p->level == 0 || p->sclass == TK_STATIC || p->sclass == TK_EXTERN)
+		return 2;
+
+	return 1;
+}
+
+/**
+ * Return the memory object whose address is held by temporary p, or NULL
+ */
+static Symbol AddressedObject(Symbol p)
+{
+	Symbol obj;
+
+	if (p->kind != SK_Temp || AsVar(p)->def == NULL || AsVar(p)->def->op != ADDR)
+		return NULL;
+
+	obj = AsVar(p)->def->src1;
+	return obj->kind == SK_Variable || obj->kind == SK_Offset ? obj : NULL;
+}
+
+/**
+	The number of instructions to form the address of obj again in the
+	memory operand, which is held by temporary p.
+	A global object needs lui, an object on frame is addressed by s0.
+	When p is used only once, "p = &obj" isn't emitted at all.
+ */
+static int ObjCost(Symbol p, Symbol obj)
+{
+	if (obj->kind == SK_Offset)
+		obj = obj->link;
+
+	if (p->ref == 2 || ! (obj->level == 0 || obj->sclass == TK_STATIC || obj->sclass == TK_EXTERN))
+		return 0;
+
+	return 1;
+}
+
+static int RuleCost(BBlock bb, IRInst inst, Match m, int rule, struct kid kids[]);
+
+/**
+ * Return the symbol written by inst, or NULL
+ */
+static Symbol DefinedSymbol(IRInst inst)
+{
+	switch (inst->opcode)
+	{
+	case JZ: case JNZ: case JE: case JNE: case JG: case JL: case JGE: case JLE:
+	case JMP: case IJMP: case IMOV: case RET: case CLR: case NOP:
+		return NULL;
+
+	default:
+		return inst->opds[0];
+	}
+}
+
+/**
+	Return the instruction which computes the address p only for inst,
+	*dist is the number of instructions between them.
+	The instruction is searched in at most FOLD_WINDOW instructions
+	before inst, see SafeFold().
+ */
+static IRInst AddressDef(BBlock bb, IRInst inst, Symbol p, int *dist)
+{
+	IRInst def = inst->prev;
+
+	if (bb == NULL || p->kind != SK_Temp || p->ref != 2)
+		return NULL;
+
+	for (*dist = 0; *dist < FOLD_WINDOW && def != &bb->insth; (*dist)++, def = def->prev)
+	{
+		if (DefinedSymbol(def) != p)
+			continue;
+
+		if (def->opds[1] == p || def->opds[2] == p)
+			return NULL;
+
+		return def;
+	}
+	return NULL;
+}
+
+/**
+	The register part k->sym of a memory operand is read by inst instead of
+	the folded instructions, check it still holds the same value then.
+	Nothing between them may write the symbol or its register, the register
+	allocator may give the register to another temporary after the last use
+	in the folded instructions.  A call clobbers the caller-saved registers,
+	and a variable in memory may be changed by any store.
+ */
+static int SafeFold(IRInst inst, Kid k)
+{
+	Symbol p = k->sym, q;
+	int i;
+
+	for (i = 0; (k->folds >> i) != 0; i++)
+	{
+		inst = inst->prev;
+		if (k->folds & (1u << i))
+			continue;
+
+		if (p == NULL || p->kind == SK_Constant)
+			continue;
+
+		if (IsCallInst(inst) || (p->reg == NULL && p->kind != SK_Temp))
+			return 0;
+
+		q = DefinedSymbol(inst);
+		if (q != NULL && (q == p || (p->reg != NULL && q->reg == p->reg)))
+			return 0;
+	}
+	return 1;
+}
+
+/**
+	Return the cost of rewriting def by NT_ADDR rule, the memory operand is
+	made of the kids of the rule.
+ */
+static int FoldCost(BBlock bb, IRInst def, Match m, int rule, Kid k)
+{
+	Rule r = &Rules[rule];
+	struct kid kids[2];
+	int i, cost;
+
+	cost = RuleCost(bb, def, m, rule, kids);
+	if (cost >= NO_MATCH)
+		return NO_MATCH;
+
+	k->sym = k->obj = k->tmp = NULL;
+	k->off = 0;
+	k->folds = 0;
+	for (i = 0; i < 2; i++)
+	{
+		switch (r->kids[i])
+		{
+		case NT_IMM12:
+			k->off += kids[i].sym->val.i[0];
+			break;
+
+		case NT_REG:
+			k->sym = kids[i].sym;
+			break;
+
+		case NT_OBJ:
+		case NT_ADDR:
+			k->sym = kids[i].sym != NULL ? kids[i].sym : k->sym;
+			k->obj = kids[i].obj;
+			k->tmp = kids[i].tmp;
+			k->off += kids[i].off;
+			k->folds |= kids[i].folds;
+			break;
+		}
+	}
+	// the offset of a memory object on frame is checked by the emitter
+	if (k->obj == NULL && ! IsImm12(k->off))
+		return NO_MATCH;
+
+	return cost;
+}
+
+/**
+	Return the cost of matching operand p of inst with nonterminal nt,
+	k is set to the operand matched.
+	m is the match of inst, the instructions before inst are labeled already.
+	An address is only folded when bb is not NULL.
+ */
+static int KidCost(BBlock bb, IRInst inst, Match m, int nt, Symbol p, Kid k)
+{
+	struct kid fold;
+	IRInst def;
+	Symbol obj;
+	int i, cost, c, dist;
+
+	k->sym = p;
+	k->obj = k->tmp = NULL;
+	k->off = 0;
+	k->folds = 0;
+	if (p == NULL)
+		return nt == NT_NONE ? 0 : NO_MATCH;
+
+	switch (nt)
+	{
+	case NT_REG:
+		return RegCost(p);
+
+	case NT_ZERO:
+		return IsIntConst(p) && p->val.i[0] == 0 ? 0 : NO_MATCH;
+
+	case NT_IMM12:
+		return IsIntConst(p) && IsImm12(p->val.i[0]) ? 0 : NO_MATCH;
+
+	case NT_NIMM12:
+		return IsIntConst(p) && IsImm12(-p->val.i[0]) ? 0 : NO_MATCH;
+
+	case NT_SHAMT:
+		return IsIntConst(p) && p->val.i[0] >= 0 && p->val.i[0] < 32 ? 0 : NO_MATCH;
+
+	case NT_OBJ:
+		if ((obj = AddressedObject(p)) == NULL)
+			return NO_MATCH;
+
+		k->sym = NULL;
+		k->obj = obj;
+		k->tmp = p;
+		return ObjCost(p, obj);
+
+	case NT_ADDR:
+		// the address in register, plus the instruction computing it
+		def = AddressDef(bb, inst, p, &dist);
+		cost = RegCost(p) + (def != NULL ? (m - 1 - dist)->cost : 0);
+		if ((obj = AddressedObject(p)) != NULL && ObjCost(p, obj) <= cost)
+		{
+			cost = KidCost(bb, inst, m, NT_OBJ, p, k);
+		}
+		if (def == NULL)
+			return cost;
+
+		for (i = FirstRule[def->opcode]; i >= 0; i = NextRule[i])
+		{
+			if (Rules[i].lhs != NT_ADDR || (c = FoldCost(bb, def, m - 1 - dist, i, &fold)) > cost)
+				continue;
+
+			if (fold.folds >= (1u << (31 - dist)))
+				continue;
+
+			fold.folds = (fold.folds << (dist + 1)) | (1u << dist);
+			if (SafeFold(inst, &fold))
+			{
+				*k = fold;
+				cost = c;
+			}
+		}
+		return cost;
+
+	default:
+		return NO_MATCH;
+	}
+}
+
+/**
+	Return the cost of rewriting inst by rule, or NO_MATCH.
+	kids[] are set to the operands matched.
+ */
+static int RuleCost(BBlock bb, IRInst inst, Match m, int rule, struct kid kids[])
+{
+	Rule r = &Rules[rule];
+	Symbol opds[2];
+	int i, cost;
+
+	if (! (r->types & (1 << TypeCode(inst->ty))))
+		return NO_MATCH;
+
+	GetKids(inst, opds);
+	cost = r->cost;
+	for (i = 0; i < 2 && cost < NO_MATCH; i++)
+	{
+		cost += KidCost(bb, inst, m, r->kids[i], opds[i], &kids[i]);
+	}
+	return cost < NO_MATCH ? cost : NO_MATCH;
+}
+
+/**
+	Mark the instructions only computing the memory operand k of inst,
+	they are not emitted.
+ */
+static void MarkFolded(BBlock bb, IRInst inst, Match m, Kid k)
+{
+	int i;
+
+	for (i = 0; (k->folds >> i) != 0; i++)
+	{
+		if (k->folds & (1u << i))
+			(m - 1 - i)->folded = 1;
+	}
+	if (k->tmp == NULL || k->tmp->ref != 2)
+		return;
+
+	// "t0 = &obj" used only by the memory operand
+	while (inst->prev != &bb->insth)
+	{
+		inst = inst->prev;
+		m--;
+		if (inst->opcode == ADDR && inst->opds[0] == k->tmp)
+		{
+			m->folded = 1;
+			return;
+		}
+	}
+}
+
+/**
+	Select the rule of minimal cost for every instruction of bb.
+	Return the matches in the order of the instructions.
+ */
+Match LabelBBlock(BBlock bb)
+{
+	IRInst inst;
+	Match matches, m;
+	struct kid kids[2];
+	int i, n, cost;
+
+	SetupRules();
+
+	n = 0;
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		n++;
+	matches = HeapAllocate(CurrentHeap, (n + 1) * sizeof(struct match));
+
+	m = matches;
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next, m++)
+	{
+		m->rule = -1;
+		m->cost = NO_MATCH;
+		m->folded = 0;
+		for (i = FirstRule[inst->opcode]; i >= 0; i = NextRule[i])
+		{
+			if (Rules[i].lhs != NT_STMT)
+				continue;
+
+			cost = RuleCost(bb, inst, m, i, kids);
+			if (cost < m->cost)
+			{
+				m->rule = i;
+				m->cost = cost;
+				m->kids[0] = kids[0];
+				m->kids[1] = kids[1];
+			}
+		}
+		if (m->rule < 0)
+		{
+			// emitted by the Emit* functions in riscv.c
+			m->cost = 1;
+			continue;
+		}
+		for (i = 0; i < 2; i++)
+		{
+			if (Rules[m->rule].kids[i] == NT_ADDR)
+				MarkFolded(bb, inst, m, &m->kids[i]);
+		}
+	}
+
+	return matches;
+}
@@ -0,0 +1,57 @@
+#ifndef __SEL_RISCV_H_
+#define __SEL_RISCV_H_
+
+// nonterminals of the tree patterns, see riscvlinux.brg
+enum {NT_NONE, NT_STMT, NT_REG, NT_ZERO, NT_IMM12, NT_NIMM12, NT_SHAMT, NT_OBJ, NT_ADDR};
+
+typedef struct rule
+{
+	int lhs;
+	int opcode;
+	int types;
+	int kids[2];
+	int cost;
+	int code;
+} *Rule;
+
+/**
+	The operand matched by a kid of a rule.
+	A NT_ADDR operand is the memory operand off(sym), or obj+off(sym) when
+	the address of memory object obj is folded, sym is NULL if there is
+	no register part:
+		t0 = &arr; t1 = i << 2; t2 = t0 + t1; t3 = *t2;
+		-------------------
+		lui t0, %hi(arr)
+		add t0, t0, a5
+		lw a4, %lo(arr)(t0)
+	tmp is the temporary holding the address of obj.
+	Bit i of folds is set if the (i + 1)th instruction before the user
+	only computes the memory operand.
+ */
+typedef struct kid
+{
+	Symbol sym;
+	Symbol obj;
+	Symbol tmp;
+	int off;
+	unsigned int folds;
+} *Kid;
+
+/**
+	The rule selected for one UIL instruction, rule is -1 if no rule matches.
+	folded is set when the instruction is done by the memory operand
+	of another instruction, and it isn't emitted.
+ */
+typedef struct match
+{
+	int rule;
+	int cost;
+	int folded;
+	struct kid kids[2];
+} *Match;
+
+extern struct rule Rules[];
+
+Match LabelBBlock(BBlock bb);
+
+#endif
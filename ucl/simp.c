@@ -20,6 +20,23 @@ static int Power2(unsigned int u)
 	return 0;
 }
 
+/**
+	a + (2 power of n - 1) if a is negative, otherwise a.
+	The arithmetic shift of the biased dividend rounds toward zero:
+		t1 = a >> 31;
+		t2 = t1 >> (32 - n);	---- unsigned shift, 0 or 2 power of n - 1
+		t3 = a + t2;
+ */
+static Symbol RoundTowardZero(Type ty, Symbol a, int n)
+{
+	Symbol t;
+
+	t = n == 1 ? a : TryAddValue(ty, RSH, a, IntConstant(31));
+	t = TryAddValue(T(UINT), RSH, t, IntConstant(32 - n));
+
+	return TryAddValue(ty, ADD, a, t);
+}
+
 /**
  * Perform algebraic simplification and strenth reduction
  */
@@ -140,13 +157,21 @@ Symbol Simplify(Type ty, int opcode, Symbol src1, Symbol src2)
 		if (src2->val.i[0] == 1)
 			return src1;
 
-		// a * 2 power of n = a >> n
+		// a * 2 power of n = a << n; a / 2 power of n = a >> n, only when a is unsigned,
+		// the arithmetic shift of a negative dividend rounds toward negative infinity.
 		c1 = Power2(src2->val.i[0]);
-		if (c1 != 0)
+		if (c1 != 0 && (opcode == MUL || IsUnsigned(ty)))
 		{
 			src2 = IntConstant(c1);
 			opcode = opcode == MUL ? LSH : RSH;
 		}
+		else if (c1 != 0 && src2->val.i[0] > 0)
+		{
+			// a / 2 power of n = (a + bias) >> n, for signed a
+			src1 = RoundTowardZero(ty, src1, c1);
+			src2 = IntConstant(c1);
+			opcode = RSH;
+		}
 		break;
 
 	case MOD:
@@ -154,13 +179,20 @@ Symbol Simplify(Type ty, int opcode, Symbol src1, Symbol src2)
 		if (src2->val.i[0] == 1)
 			return IntConstant(0);
 
-		// a % 2 power of n = a & (2 power of n - 1)
+		// a % 2 power of n = a & (2 power of n - 1), for unsigned a
 		c1 = Power2(src2->val.i[0]);
-		if (c1 != 0)
+		if (c1 != 0 && IsUnsigned(ty))
 		{
 			src2 = IntConstant(src2->val.i[0] - 1);
 			opcode = BAND;
 		}
+		else if (c1 != 0 && src2->val.i[0] > 0)
+		{
+			// a % 2 power of n = a - ((a + bias) & -(2 power of n)), for signed a
+			p1 = TryAddValue(ty, BAND, RoundTowardZero(ty, src1, c1), IntConstant(-src2->val.i[0]));
+			src2 = p1;
+			opcode = SUB;
+		}
 		break;
 
 	case LSH:
@@ -329,17 +361,22 @@ static void PeepHole(BBlock bb)
 	}
 }
 					
+/**
+	Delete the instructions whose results are never used.   The block is
+	walked backward, so the uses of a temporary in it are deleted before its
+	definition is reached, and an expression is deleted in one pass:
+		t0 = a + b;			----- t0->ref is 1 after t1 is deleted
+		t1 = t0 * 2;		----- t1->ref is 1
+ */
 static void EliminateCode(BBlock bb)
 {
-	IRInst inst = bb->insth.next;
-	IRInst ninst;
-	int found = 0;
+	IRInst inst = bb->insth.prev;
+	IRInst pinst;
 	Symbol *opds;
 
-find_unused_temp:
 	while (inst != &bb->insth)
 	{
-		ninst = inst->next;
+		pinst = inst->prev;
 		opds = inst->opds;
 		if (inst->opcode == CALL)
 		{
@@ -349,7 +386,7 @@ find_unused_temp:
 				opds[0] = NULL;
 			}			
 		}
-		else if (inst->opcode <= BCOM || (inst->opcode >= ADDR && inst->opcode <= MOV))
+		else if (inst->opcode <= SELZ || (inst->opcode >= ADDR && inst->opcode <= MOV))
 		{
 			/**
 				OPCODE(BOR,     "|",                    Assign)
@@ -359,11 +396,21 @@ find_unused_temp:
 				OPCODE(RSH,     ">>",                   Assign)
 				OPCODE(ADD,     "+",                    Assign)
 				OPCODE(SUB,     "-",                    Assign)
-				OPCODE(MUL,     "*",                    Assign)
-				OPCODE(DIV,     "/",                    Assign)
-				OPCODE(MOD,     "%",                    Assign)
+				OPCODE(MUL,     "*",                    MulDiv)
+				OPCODE(DIV,     "/",                    MulDiv)
+				OPCODE(MOD,     "%",                    MulDiv)
 				OPCODE(NEG,     "-",                    Assign)
 				OPCODE(BCOM,    "~",                    Assign)
+				OPCODE(SEQ,     "==",                   Assign)
+				OPCODE(SNE,     "!=",                   Assign)
+				OPCODE(SGT,     ">",                    Assign)
+				OPCODE(SLT,     "<",                    Assign)
+				OPCODE(SGE,     ">=",                   Assign)
+				OPCODE(SLE,     "<=",                   Assign)
+				OPCODE(MIN,     "min",                  Select)
+				OPCODE(MAX,     "max",                  Select)
+				OPCODE(SELNZ,   "?",                    Select)
+				OPCODE(SELZ,    "!?",                   Select)
 
 				OPCODE(ADDR,    "&",                    Address)
 				OPCODE(DEREF,   "*",                    Deref)
@@ -392,21 +439,11 @@ find_unused_temp:
 				if (opds[2]) opds[2]->ref--;
 				inst->prev->next = inst->next;
 				inst->next->prev = inst->prev;
-				found = 1;
 				bb->ninst--;
 			}
 		}
-		inst = inst->next;
-	}
-
-	if (found)
-	{
-		found = 0;
-		inst = bb->insth.next;
-		goto find_unused_temp;
+		inst = pinst;
 	}
-
-	return;
 }
 
 void Optimize(FunctionSymbol fsym)
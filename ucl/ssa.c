@@ -0,0 +1,1100 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Static single assignment form of UIL.
+	(Ron Cytron et al., "Efficiently Computing Static Single Assignment Form
+	and the Control Dependence Graph";
+	Keith D. Cooper, Timothy J. Harvey and Ken Kennedy, "A Simple, Fast
+	Dominance Algorithm";
+	Vugranam C. Sreedhar et al., "Translating Out of Static Single
+	Assignment Form")
+
+	BuildSSA() gives every definition of a register candidate its own
+	temporary, the values of a temporary reaching a join point are merged
+	by a phi function at the start of the join block.
+
+		int sum(int *a, int n){			function sum
+			int i, s = 0;					t5 = a;
+			for(i = 0; i < n; i++)			t6 = n;
+				s += a[i];					t7 = 0;
+			return s;						t8 = 0;
+		}									goto BB2;
+										BB1:
+											t0 = t10 * 4;
+											t1 = t5 + t0;
+											t2 = *t1;
+											t3 = t9 + t2;
+											t11 = t3;
+											t12 = t10 + 1;		----- t8++
+										BB2:
+											t9 : phi(t7 BB0, t11 BB1);
+											t10 : phi(t8 BB0, t12 BB1);
+											if (t10 < t6) goto BB1;
+
+	The first definition of a temporary keeps its name, a temporary defined
+	once whose definition dominates all its uses is not renamed at all.
+	The phi functions whose values are never used are deleted.
+
+	DestroySSA() replaces a phi function x : phi(a1 B1, ..., an Bn) by
+		x0 = ai;		----- at the end of every predecessor Bi
+		x = x0;			----- in place of the phi function
+	x0 is a new temporary, no critical edge has to be split.   Most of the
+	copies are removed by coalescing the temporaries which don't interfere,
+	the register allocator only sees the normal instructions.
+ */
+
+// the blocks of current function, Blocks[bb->no]
+static BBlock *Blocks;
+static int NumBlocks;
+// the reachable blocks in reverse postorder, RPONum[bb->no] is the index in it
+static BBlock *RPO;
+static int *RPONum;
+static int NumReachable;
+// the dominance frontier of Blocks[i] is Frontiers[i]
+static Vector *Frontiers;
+
+// the temporaries renamed, Vars[no]
+static Symbol *Vars;
+static int NumVars;
+// the variable of the temporary whose AsVar(t)->no is i is Vars[VarOf[i]]
+static int *VarOf;
+// the phi function defining the temporary, or NULL
+static IRInst *PhiOf;
+static int NumNames;
+
+static int *DefCount;
+static IRInst *DefInst;
+static BBlock *DefBB;
+
+typedef struct defsite
+{
+	BBlock bb;
+	struct defsite *link;
+} *DefSite;
+
+static DefSite *DefSites;
+
+typedef struct version
+{
+	Symbol sym;
+	struct version *link;
+} *Version;
+
+// the current version of every variable during renaming
+static Version *Stacks;
+// the temporary standing for the undefined value of a variable
+static Symbol *Undefs;
+// set when the first definition of a variable has kept its name
+static int *Named;
+
+static BBlock CurBB;
+static IRInst CurInst;
+
+// the register candidates, see IsRegCandidate() in regalloc.c
+int IsSSATemp(Symbol p)
+{
+	if (p == NULL || p->kind != SK_Temp || p->addressed)
+		return 0;
+
+	return IsRealType(p->ty) || ((IsIntegType(p->ty) || IsPtrType(p->ty)) && p->ty->size <= 4);
+}
+
+static void NumberBlocks(FunctionSymbol fsym)
+{
+	BBlock bb;
+
+	NumBlocks = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->no = NumBlocks++;
+	}
+	Blocks = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		Blocks[bb->no] = bb;
+	}
+}
+
+static void PostOrder(BBlock bb)
+{
+	CFGEdge succ;
+
+	RPONum[bb->no] = 0;
+	for (succ = bb->succs; succ != NULL; succ = succ->next)
+	{
+		if (RPONum[succ->bb->no] < 0)
+			PostOrder(succ->bb);
+	}
+	RPO[NumReachable++] = bb;
+}
+
+static BBlock Intersect(BBlock bb1, BBlock bb2)
+{
+	while (bb1 != bb2)
+	{
+		while (RPONum[bb1->no] > RPONum[bb2->no])
+			bb1 = bb1->idom;
+		while (RPONum[bb2->no] > RPONum[bb1->no])
+			bb2 = bb2->idom;
+	}
+	return bb1;
+}
+
+static int NumberDominatorTree(BBlock bb, int n)
+{
+	BBlock kid;
+
+	bb->pre = n++;
+	for (kid = bb->kids; kid != NULL; kid = kid->sibling)
+	{
+		n = NumberDominatorTree(kid, n);
+	}
+	bb->last = n - 1;
+
+	return n;
+}
+
+/**
+	Compute the immediate dominator of every reachable block by iterating
+	over the blocks in reverse postorder:
+		idom(b) = the common dominator of all the processed predecessors of b
+	The dominator tree is numbered in preorder, so the dominance check
+	is done in constant time, see Dominates().
+	The CFG is drawn again first, see RebuildCFG().
+ */
+void ComputeDominators(FunctionSymbol fsym)
+{
+	BBlock bb, idom;
+	CFGEdge pred;
+	int i, changed;
+
+	RebuildCFG(fsym);
+	NumberBlocks(fsym);
+
+	RPO = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+	RPONum = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+	for (i = 0; i < NumBlocks; i++)
+	{
+		RPONum[i] = -1;
+		Blocks[i]->idom = Blocks[i]->kids = Blocks[i]->sibling = NULL;
+		Blocks[i]->pre = -1;
+		Blocks[i]->last = -2;
+	}
+	NumReachable = 0;
+	PostOrder(fsym->entryBB);
+	for (i = 0; i < NumReachable / 2; i++)
+	{
+		bb = RPO[i];
+		RPO[i] = RPO[NumReachable - 1 - i];
+		RPO[NumReachable - 1 - i] = bb;
+	}
+	for (i = 0; i < NumReachable; i++)
+	{
+		RPONum[RPO[i]->no] = i;
+	}
+
+	fsym->entryBB->idom = fsym->entryBB;
+	do
+	{
+		changed = 0;
+		for (i = 1; i < NumReachable; i++)
+		{
+			bb = RPO[i];
+			idom = NULL;
+			for (pred = bb->preds; pred != NULL; pred = pred->next)
+			{
+				if (pred->bb->idom == NULL)
+					continue;
+				idom = idom == NULL ? pred->bb : Intersect(pred->bb, idom);
+			}
+			if (bb->idom != idom)
+			{
+				bb->idom = idom;
+				changed = 1;
+			}
+		}
+	} while (changed);
+	fsym->entryBB->idom = NULL;
+
+	for (i = NumReachable - 1; i > 0; i--)
+	{
+		bb = RPO[i];
+		bb->sibling = bb->idom->kids;
+		bb->idom->kids = bb;
+	}
+	NumberDominatorTree(fsym->entryBB, 0);
+}
+
+/**
+ * Return 1 if every path from the entry to bb2 goes through bb1.
+ */
+int Dominates(BBlock bb1, BBlock bb2)
+{
+	return bb1->pre <= bb2->pre && bb2->pre <= bb1->last;
+}
+
+/**
+	The dominance frontier of block x is the set of blocks y, x dominates
+	a predecessor of y, but doesn't strictly dominate y.   A join block is
+	in the frontier of every block from its predecessor up to its idom.
+ */
+static void ComputeFrontiers(void)
+{
+	BBlock bb, runner;
+	CFGEdge pred;
+	Vector df;
+	int i;
+
+	Frontiers = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(Vector));
+	for (i = 0; i < NumBlocks; i++)
+	{
+		Frontiers[i] = CreateVector(2);
+	}
+	for (i = 0; i < NumReachable; i++)
+	{
+		bb = RPO[i];
+		if (bb->npred < 2 && bb != RPO[0])
+			continue;
+		for (pred = bb->preds; pred != NULL; pred = pred->next)
+		{
+			runner = pred->bb;
+			while (runner != NULL && runner != bb->idom)
+			{
+				df = Frontiers[runner->no];
+				if (TOP_ITEM(df) == bb)
+					break;
+				INSERT_ITEM(df, bb);
+				runner = runner->idom;
+			}
+		}
+	}
+}
+
+/**
+ * Insert inst after pos in bb, &bb->insth for the start of bb.
+ */
+void InsertAfter(BBlock bb, IRInst pos, IRInst inst)
+{
+	inst->next = pos->next;
+	inst->prev = pos;
+	pos->next->prev = inst;
+	pos->next = inst;
+	bb->ninst++;
+}
+
+void RemoveInst(BBlock bb, IRInst inst)
+{
+	inst->prev->next = inst->next;
+	inst->next->prev = inst->prev;
+	bb->ninst--;
+}
+
+/**
+	t++ and t-- use and define t in one instruction, they are expanded to
+		t = t + 1;
+	then the use and the definition can have different names.
+	See RestoreIncrement().
+ */
+static void ExpandIncrement(IRInst inst)
+{
+	union value val;
+
+	if ((inst->opcode != INC && inst->opcode != DEC) || ! IsSSATemp(inst->opds[0]))
+		return;
+
+	inst->opcode = inst->opcode == INC ? ADD : SUB;
+	inst->opds[1] = inst->opds[0];
+	if (IsRealType(inst->ty))
+	{
+		if (TypeCode(inst->ty) == F4)
+			val.f = 1.0f;
+		else
+			val.d = 1.0;
+		inst->opds[2] = AddConstant(inst->ty, val);
+	}
+	else
+	{
+		inst->opds[2] = IntConstant(1);
+	}
+}
+
+static void RestoreIncrement(IRInst inst)
+{
+	Symbol *opds = inst->opds;
+	int tcode = TypeCode(inst->ty);
+
+	if ((inst->opcode != ADD && inst->opcode != SUB) || opds[0] != opds[1] ||
+	    ! IsSSATemp(opds[0]) || opds[2]->kind != SK_Constant)
+		return;
+
+	if ((tcode == F4 && opds[2]->val.f == 1.0f) || (tcode == F8 && opds[2]->val.d == 1.0) ||
+	    (tcode != F4 && tcode != F8 && opds[2]->val.i[0] == 1))
+	{
+		inst->opcode = inst->opcode == ADD ? INC : DEC;
+		opds[1] = opds[2] = NULL;
+	}
+}
+
+static void CountOperand(Symbol *opd, int def)
+{
+	if (IsSSATemp(*opd) && ! (def && (CurInst->opcode == INC || CurInst->opcode == DEC)))
+		(*opd)->ref++;
+}
+
+/**
+ * p->ref is the number of the operands p of the instructions.
+ */
+static void CountReferences(FunctionSymbol fsym)
+{
+	BBlock bb;
+	Symbol p;
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (IsSSATemp(p))
+			p->ref = 0;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (CurInst = bb->insth.next; CurInst != &bb->insth; CurInst = CurInst->next)
+		{
+			VisitOperands(CurInst, CountOperand);
+		}
+	}
+}
+
+static void VisitDefinition(Symbol *opd, int def)
+{
+	DefSite site;
+	int i;
+
+	if (! def || ! IsNumbered(*opd))
+		return;
+
+	i = AsVar(*opd)->no;
+	DefCount[i]++;
+	DefInst[i] = CurInst;
+	DefBB[i] = CurBB;
+
+	ALLOC(site);
+	site->bb = CurBB;
+	site->link = DefSites[i];
+	DefSites[i] = site;
+}
+
+static void VisitUse(Symbol *opd, int def)
+{
+	int i;
+
+	if (def || ! IsNumbered(*opd))
+		return;
+
+	i = AsVar(*opd)->no;
+	if (DefCount[i] != 1)
+		return;
+	if (CurBB == DefBB[i] ? CurInst->no <= DefInst[i]->no : ! Dominates(DefBB[i], CurBB))
+		DefCount[i]++;
+}
+
+/**
+	Find the temporaries to be renamed, they are defined more than once,
+	or used at some place not dominated by their only definition.
+	Vars[1 .. NumVars] are the temporaries, AsVar(Vars[i])->no is i.
+ */
+static void FindVariables(FunctionSymbol fsym)
+{
+	Symbol p;
+	int i, n, no;
+
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = IsSSATemp(p) ? ++n : 0;
+	}
+	DefCount = HeapAllocate(CurrentHeap, (n + 1) * sizeof(int));
+	DefInst = HeapAllocate(CurrentHeap, (n + 1) * sizeof(IRInst));
+	DefBB = HeapAllocate(CurrentHeap, (n + 1) * sizeof(BBlock));
+	DefSites = HeapAllocate(CurrentHeap, (n + 1) * sizeof(DefSite));
+	memset(DefCount, 0, (n + 1) * sizeof(int));
+	memset(DefSites, 0, (n + 1) * sizeof(DefSite));
+
+	no = 0;
+	for (i = 0; i < NumReachable; i++)
+	{
+		CurBB = RPO[i];
+		for (CurInst = CurBB->insth.next; CurInst != &CurBB->insth; CurInst = CurInst->next)
+		{
+			ExpandIncrement(CurInst);
+			CurInst->no = no++;
+			VisitOperands(CurInst, VisitDefinition);
+		}
+	}
+	for (i = 0; i < NumReachable; i++)
+	{
+		CurBB = RPO[i];
+		for (CurInst = CurBB->insth.next; CurInst != &CurBB->insth; CurInst = CurInst->next)
+		{
+			VisitOperands(CurInst, VisitUse);
+		}
+	}
+
+	NumVars = 0;
+	Vars = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind != SK_Temp || AsVar(p)->no == 0)
+			continue;
+
+		i = AsVar(p)->no;
+		if (DefCount[i] < 2)
+		{
+			AsVar(p)->no = 0;
+			continue;
+		}
+		Vars[++NumVars] = p;
+		DefCount[NumVars] = DefCount[i];
+		DefSites[NumVars] = DefSites[i];
+		AsVar(p)->no = NumVars;
+		// the temporary won't have a single definition any more, see DefineTemp()
+		AsVar(p)->def = NULL;
+	}
+}
+
+/**
+	Insert the phi functions of Vars[v] at the iterated dominance frontier
+	of its definitions.   HasPhi[b] and Queued[b] are v if the block Blocks[b]
+	is done for Vars[v].
+ */
+static int InsertPhis(int v, int *hasPhi, int *queued, BBlock *work)
+{
+	Symbol p = Vars[v];
+	BBlock bb, y;
+	CFGEdge pred;
+	DefSite site;
+	Vector args;
+	PhiArg arg;
+	IRInst inst;
+	int i, top, n;
+
+	top = n = 0;
+	for (site = DefSites[v]; site != NULL; site = site->link)
+	{
+		if (queued[site->bb->no] != v)
+		{
+			queued[site->bb->no] = v;
+			work[top++] = site->bb;
+		}
+	}
+	while (top > 0)
+	{
+		bb = work[--top];
+		for (i = 0; i < LEN(Frontiers[bb->no]); i++)
+		{
+			y = GET_ITEM(Frontiers[bb->no], i);
+			if (hasPhi[y->no] == v)
+				continue;
+
+			hasPhi[y->no] = v;
+			args = CreateVector(y->npred);
+			for (pred = y->preds; pred != NULL; pred = pred->next)
+			{
+				ALLOC(arg);
+				arg->sym = p;
+				arg->bb = pred->bb;
+				INSERT_ITEM(args, arg);
+			}
+			ALLOC(inst);
+			inst->ty = p->ty;
+			inst->opcode = PHI;
+			inst->opds[0] = p;
+			inst->opds[1] = (Symbol)args;
+			inst->opds[2] = NULL;
+			InsertAfter(y, &y->insth, inst);
+			n++;
+
+			if (queued[y->no] != v)
+			{
+				queued[y->no] = v;
+				work[top++] = y;
+			}
+		}
+	}
+	return n;
+}
+
+static Symbol NewName(int v)
+{
+	Symbol t;
+
+	t = CreateTemp(Vars[v]->ty);
+	AsVar(t)->no = ++NumNames;
+	VarOf[NumNames] = v;
+	PhiOf[NumNames] = NULL;
+
+	return t;
+}
+
+static Symbol CurrentName(int v)
+{
+	if (Stacks[v] != NULL)
+		return Stacks[v]->sym;
+
+	if (Undefs[v] == NULL)
+		Undefs[v] = NewName(v);
+	return Undefs[v];
+}
+
+static void PushName(Symbol *opd)
+{
+	int v = VarOf[AsVar(*opd)->no];
+	Version ver;
+
+	ALLOC(ver);
+	if (! Named[v])
+	{
+		Named[v] = 1;
+		ver->sym = Vars[v];
+	}
+	else
+	{
+		ver->sym = NewName(v);
+	}
+	if (CurInst->opcode == PHI)
+		PhiOf[AsVar(ver->sym)->no] = CurInst;
+	ver->link = Stacks[v];
+	Stacks[v] = ver;
+	*opd = ver->sym;
+}
+
+static void RenameOperand(Symbol *opd, int def)
+{
+	if (! IsNumbered(*opd))
+		return;
+
+	if (def)
+		PushName(opd);
+	else
+		*opd = CurrentName(VarOf[AsVar(*opd)->no]);
+}
+
+static void PopName(Symbol *opd, int def)
+{
+	if (def && IsNumbered(*opd))
+	{
+		Stacks[VarOf[AsVar(*opd)->no]] = Stacks[VarOf[AsVar(*opd)->no]]->link;
+	}
+}
+
+/**
+	Walk the dominator tree in preorder, the current name of every
+	variable is on the top of its stack.
+ */
+static void RenameBlock(BBlock bb)
+{
+	CFGEdge succ;
+	IRInst inst;
+	PhiArg arg;
+	Vector args;
+	BBlock kid;
+	int i;
+
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+	{
+		CurInst = inst;
+		if (inst->opcode == PHI)
+			PushName(&inst->opds[0]);
+		else
+			VisitOperands(inst, RenameOperand);
+	}
+
+	for (succ = bb->succs; succ != NULL; succ = succ->next)
+	{
+		for (inst = succ->bb->insth.next; inst->opcode == PHI; inst = inst->next)
+		{
+			args = (Vector)inst->opds[1];
+			for (i = 0; i < LEN(args); i++)
+			{
+				arg = GET_ITEM(args, i);
+				if (arg->bb == bb)
+					arg->sym = CurrentName(VarOf[AsVar(inst->opds[0])->no]);
+			}
+		}
+	}
+
+	for (kid = bb->kids; kid != NULL; kid = kid->sibling)
+	{
+		RenameBlock(kid);
+	}
+
+	for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+	{
+		CurInst = inst;
+		VisitOperands(inst, PopName);
+	}
+}
+
+static IRInst *PhiWork;
+static int PhiTop;
+static int *PhiUsed;
+
+static void MarkPhiUse(Symbol *opd, int def)
+{
+	int i;
+
+	if (def || ! IsNumbered(*opd))
+		return;
+
+	i = AsVar(*opd)->no;
+	if (PhiOf[i] != NULL && ! PhiUsed[i])
+	{
+		PhiUsed[i] = 1;
+		PhiWork[PhiTop++] = PhiOf[i];
+	}
+}
+
+/**
+	A phi function is useful if its value is used by a normal instruction,
+	or by a useful phi function.   The others are deleted.
+ */
+static void RemoveDeadPhis(void)
+{
+	IRInst inst, next;
+	BBlock bb;
+	int i;
+
+	PhiWork = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(IRInst));
+	PhiUsed = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(int));
+	memset(PhiUsed, 0, (NumNames + 1) * sizeof(int));
+	PhiTop = 0;
+
+	for (i = 0; i < NumReachable; i++)
+	{
+		bb = RPO[i];
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (inst->opcode != PHI)
+				VisitOperands(inst, MarkPhiUse);
+		}
+	}
+	while (PhiTop > 0)
+	{
+		VisitOperands(PhiWork[--PhiTop], MarkPhiUse);
+	}
+
+	for (i = 0; i < NumReachable; i++)
+	{
+		bb = RPO[i];
+		for (inst = bb->insth.next; inst->opcode == PHI; inst = next)
+		{
+			next = inst->next;
+			if (! PhiUsed[AsVar(inst->opds[0])->no])
+				RemoveInst(bb, inst);
+		}
+	}
+}
+
+/**
+	Convert the instructions of fsym to SSA form.
+	The temporaries created by BuildSSA() have no ValueDef, see DefineTemp().
+ */
+void BuildSSA(FunctionSymbol fsym)
+{
+	int *hasPhi, *queued;
+	BBlock *work;
+	Symbol p;
+	int i, n;
+
+	ComputeDominators(fsym);
+	ComputeFrontiers();
+	FindVariables(fsym);
+
+	if (NumVars != 0)
+	{
+		hasPhi = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+		queued = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(int));
+		work = HeapAllocate(CurrentHeap, (NumBlocks + 1) * sizeof(BBlock));
+		memset(hasPhi, 0, (NumBlocks + 1) * sizeof(int));
+		memset(queued, 0, (NumBlocks + 1) * sizeof(int));
+		n = 0;
+		for (i = 1; i <= NumVars; i++)
+		{
+			n += InsertPhis(i, hasPhi, queued, work);
+			n += DefCount[i];
+		}
+
+		// every definition and every phi function has a name, so has every undefined value
+		n += 2 * NumVars + 1;
+		VarOf = HeapAllocate(CurrentHeap, n * sizeof(int));
+		PhiOf = HeapAllocate(CurrentHeap, n * sizeof(IRInst));
+		Stacks = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(Version));
+		Undefs = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(Symbol));
+		Named = HeapAllocate(CurrentHeap, (NumVars + 1) * sizeof(int));
+		memset(Stacks, 0, (NumVars + 1) * sizeof(Version));
+		memset(Undefs, 0, (NumVars + 1) * sizeof(Symbol));
+		memset(Named, 0, (NumVars + 1) * sizeof(int));
+		for (i = 1; i <= NumVars; i++)
+		{
+			VarOf[i] = i;
+			PhiOf[i] = NULL;
+		}
+		NumNames = NumVars;
+
+		RenameBlock(fsym->entryBB);
+		RemoveDeadPhis();
+	}
+
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+	CountReferences(fsym);
+}
+
+/**
+ * Insert inst at the end of bb, but before the jump.
+ */
+void InsertBeforeJump(BBlock bb, IRInst inst)
+{
+	IRInst lasti = bb->insth.prev;
+
+	if ((lasti->opcode >= JZ && lasti->opcode <= JMP) || lasti->opcode == IJMP)
+		InsertAfter(bb, lasti->prev, inst);
+	else
+		InsertAfter(bb, lasti, inst);
+}
+
+static void ReplacePhis(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst, copy;
+	Vector args;
+	PhiArg arg;
+	Symbol x0;
+	int i;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst->opcode == PHI; inst = inst->next)
+		{
+			x0 = CreateTemp(inst->opds[0]->ty);
+			args = (Vector)inst->opds[1];
+			for (i = 0; i < LEN(args); i++)
+			{
+				arg = GET_ITEM(args, i);
+				ALLOC(copy);
+				copy->ty = inst->ty;
+				copy->opcode = MOV;
+				copy->opds[0] = x0;
+				copy->opds[1] = arg->sym;
+				copy->opds[2] = NULL;
+				InsertBeforeJump(arg->bb, copy);
+			}
+			inst->opcode = MOV;
+			inst->opds[1] = x0;
+		}
+	}
+}
+
+/**
+	The temporaries coalesced, Names[no] for no in 1 .. NumNames.
+	Parent[no] is used to find the class of a temporary, the representative
+	of a class is the member with the least no, it is the oldest one.
+	Row[c] is the set of the temporaries interfering with the members of
+	class c, Members[c] is the set of its members, Size[c] is the number of
+	its members.   The sets are sparse, see dataflow.c, a temporary
+	interferes only with the few ones live at its definition, but a function
+	may have tens of thousands of them.
+ */
+static Symbol *Names;
+static int *Parent;
+static BitSet *Row, *Members;
+static int *Size;
+static Dataflow Liveness;
+static BitSet CurLive, Others;
+static int *OwnDef;
+
+/**
+	Return 1 if temporary p1 can be replaced by p2.   The type of a
+	temporary is still used by the emitter, e.g. the function type of
+	a function pointer is needed by a call.
+ */
+int SameValueType(Symbol p1, Symbol p2)
+{
+	return p1->ty == p2->ty || (p1->ty->categ == p2->ty->categ && ! IsPtrType(p1->ty));
+}
+
+static int IsCoalescable(IRInst inst)
+{
+	Symbol *opds = inst->opds;
+
+	return inst->opcode == MOV && IsSSATemp(opds[0]) && IsSSATemp(opds[1]) &&
+	       TypeCode(opds[0]->ty) == TypeCode(inst->ty) && SameValueType(opds[0], opds[1]);
+}
+
+static void NameOperand(Symbol *opd, int def)
+{
+	if ((*opd)->kind == SK_Temp && AsVar(*opd)->no == 0)
+	{
+		AsVar(*opd)->no = ++NumNames;
+		Names[NumNames] = *opd;
+	}
+}
+
+static int Find(int i)
+{
+	while (Parent[i] != i)
+	{
+		Parent[i] = Parent[Parent[i]];
+		i = Parent[i];
+	}
+	return i;
+}
+
+/**
+	x0 = s; y0 = s;   x0 and y0 hold the same value, they don't interfere at
+	the definition of y0.   It is common after a loop is rotated, the phi
+	functions in the loop header and at the loop exit both take s from the
+	bottom of the loop.   The copies of the phi functions are put together
+	at the end of a predecessor, only the copies just before inst are searched.
+ */
+static int IsSameCopy(IRInst inst, Symbol t)
+{
+	IRInst p;
+
+	for (p = inst->prev; p != &CurBB->insth && IsCoalescable(p); p = p->prev)
+	{
+		if (p->opds[0] == inst->opds[1])
+			return 0;
+		if (p->opds[0] == t)
+			return p->opds[1] == inst->opds[1];
+	}
+	return 0;
+}
+
+static void AddInterference(Symbol *opd, int def)
+{
+	IRInst p;
+	int i;
+
+	if (! def || ! IsNumbered(*opd))
+		return;
+
+	i = AsVar(*opd)->no;
+	CopyBits(Others, CurLive);
+	ClearBit(Others, i);
+	// the source of a copy doesn't interfere with the destination
+	if (IsCoalescable(CurInst))
+	{
+		ClearBit(Others, AsVar(CurInst->opds[1])->no);
+		for (p = CurInst->prev; p != &CurBB->insth && IsCoalescable(p); p = p->prev)
+		{
+			if (IsSameCopy(CurInst, p->opds[0]))
+				ClearBit(Others, AsVar(p->opds[0])->no);
+		}
+	}
+	UnionBits(Row[i], Others);
+}
+
+static void UpdateLive(Symbol *opd, int def)
+{
+	int i;
+
+	if (! IsNumbered(*opd))
+		return;
+
+	i = AsVar(*opd)->no;
+	if (def)
+		ClearBit(CurLive, i);
+	else
+		SetBit(CurLive, i);
+}
+
+/**
+	Walk every block backward, a temporary defined at some point interferes
+	with all the temporaries live there.
+ */
+static void BuildInterference(void)
+{
+	IRInst inst;
+	int i, j;
+
+	Row = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(BitSet));
+	Members = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(BitSet));
+	for (i = 1; i <= NumNames; i++)
+	{
+		Row[i] = NewBitSet();
+		Members[i] = NewBitSet();
+		SetBit(Members[i], i);
+	}
+	CurLive = NewBitSet();
+	Others = NewBitSet();
+	for (i = 0; i < NumBlocks; i++)
+	{
+		CurBB = Blocks[i];
+		ClearBits(CurLive);
+		for (j = NextBit(Liveness->out[i], 0); j >= 0; j = NextBit(Liveness->out[i], j + 1))
+		{
+			SetBit(CurLive, j + 1);
+		}
+		for (inst = Blocks[i]->insth.prev; inst != &Blocks[i]->insth; inst = inst->prev)
+		{
+			CurInst = inst;
+			VisitOperands(inst, AddInterference);
+			VisitOperands(inst, UpdateLive);
+		}
+	}
+}
+
+static void Coalesce(IRInst inst)
+{
+	int c1, c2, i;
+
+	if (! IsCoalescable(inst))
+		return;
+
+	c1 = Find(AsVar(inst->opds[0])->no);
+	c2 = Find(AsVar(inst->opds[1])->no);
+	if (c1 == c2)
+		return;
+
+	// the sets of the smaller class are walked, the ones of the larger class are searched
+	if (Size[c2] < Size[c1])
+	{
+		i = c1; c1 = c2; c2 = i;
+	}
+	if (! DisjointBits(Members[c1], Row[c2]) || ! DisjointBits(Row[c1], Members[c2]))
+		return;
+
+	if (c2 < c1)
+	{
+		i = c1; c1 = c2; c2 = i;
+	}
+	Parent[c2] = c1;
+	Size[c1] += Size[c2];
+	UnionBits(Row[c1], Row[c2]);
+	UnionBits(Members[c1], Members[c2]);
+}
+
+static void CountDefinition(Symbol *opd, int def)
+{
+	int c;
+
+	if (! def || ! IsNumbered(*opd))
+		return;
+
+	c = Find(AsVar(*opd)->no);
+	if (IsCoalescable(CurInst) && Find(AsVar(CurInst->opds[1])->no) == c)
+		return;
+	// OwnDef[c] is 1 if the only definition of class c is one of its representative
+	OwnDef[c] = OwnDef[c] == 0 && Names[c] == *opd ? 1 : -1;
+}
+
+static void ReplaceOperand(Symbol *opd, int def)
+{
+	if (IsNumbered(*opd))
+		*opd = Names[Find(AsVar(*opd)->no)];
+}
+
+/**
+	Replace the phi functions with copies, then coalesce the operands of
+	the copies if they are never live at the same time.   The copies
+	between the members of one class are deleted.
+ */
+void DestroySSA(FunctionSymbol fsym)
+{
+	BBlock bb;
+	IRInst inst, next;
+	Symbol p;
+	int i;
+
+	ReplacePhis(fsym);
+	NumberBlocks(fsym);
+
+	// only the temporaries of the copies are numbered, see ComputeLiveness()
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		AsVar(p)->no = 0;
+	}
+	i = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp || p->kind == SK_Variable)
+			AsVar(p)->no = 0;
+		i++;
+	}
+	Names = HeapAllocate(CurrentHeap, (i + 1) * sizeof(Symbol));
+	NumNames = 0;
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (IsCoalescable(inst))
+				VisitOperands(inst, NameOperand);
+		}
+	}
+
+	if (NumNames != 0)
+	{
+		Parent = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(int));
+		OwnDef = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(int));
+		Size = HeapAllocate(CurrentHeap, (NumNames + 1) * sizeof(int));
+		for (i = 0; i <= NumNames; i++)
+		{
+			Parent[i] = i;
+			OwnDef[i] = 0;
+			Size[i] = 1;
+		}
+		Liveness = ComputeLiveness(fsym, NumNames);
+		BuildInterference();
+
+		for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+		{
+			for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+			{
+				Coalesce(inst);
+			}
+		}
+
+		for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+		{
+			for (CurInst = bb->insth.next; CurInst != &bb->insth; CurInst = CurInst->next)
+			{
+				VisitOperands(CurInst, CountDefinition);
+			}
+		}
+		// a class keeps the ValueDef of its representative only if it is still the only definition
+		for (i = 1; i <= NumNames; i++)
+		{
+			if (Find(i) != i && OwnDef[Find(i)] != 1)
+				AsVar(Names[Find(i)])->def = NULL;
+		}
+
+		for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+		{
+			for (inst = bb->insth.next; inst != &bb->insth; inst = next)
+			{
+				next = inst->next;
+				VisitOperands(inst, ReplaceOperand);
+				if (inst->opcode == MOV && inst->opds[0] == inst->opds[1])
+					RemoveInst(bb, inst);
+			}
+		}
+	}
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			RestoreIncrement(inst);
+		}
+	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
+	CountReferences(fsym);
+}
@@ -15,6 +15,7 @@ enum
 	sclass:	storage class,  TK_STATIC	TK_EXTERN		...
 	link:	link symbols in the same hash bucket[*] item.
 	needwb:	the content needs to be written back to memory
+	inlined:	a function declared inline, see inline.c
 	reg:		int abc;     variable may be in register EAX/ECX,...
 				reg represents the register in which var abc is ?
 	aname:		access name,see GetAccessName()				
@@ -30,7 +31,8 @@ enum
     int defined   : 1;    \
     int addressed : 1;    \
     int needwb    : 1;    \
-    int unused    : 29;   \
+    int inlined   : 1;    \
+    int unused    : 28;   \
     union value val;      \
     struct symbol *reg;   \
     struct symbol *link;  \
@@ -45,8 +47,7 @@ typedef struct symbol
 	SYMBOL_COMMON
 } *Symbol;
 /**
-	struct valueDef and struct valueUse
-		are used for DU list .
+	struct valueDef records the definition of a temporary.
 	Here definition is assignment to a variable just like
 		t1 = b + c;	//   defition of t1,  use of b and c.
 					t1 is a temporary variable.
@@ -60,23 +61,17 @@ typedef struct valueDef
 	int op;
 	Symbol src1;
 	Symbol src2;
-	BBlock ownBB;
 	struct valueDef *link;
 } *ValueDef;
-// the use of a definition
-typedef struct valueUse
-{
-	ValueDef def;
-	struct valueUse *next;
-} *ValueUse;
 
 typedef struct variableSymbol
 {
 	SYMBOL_COMMON
 	InitData idata;
 	ValueDef def;
-	ValueUse uses;
 	int offset;
+	// number of a register candidate, 0 for others.  see regalloc.c
+	int no;
 } *VariableSymbol;
 
 typedef struct functionSymbol
@@ -88,7 +83,8 @@ typedef struct functionSymbol
 	int nbblock;
 	BBlock entryBB;
 	BBlock exitBB;
-	ValueDef valNumTable[16];
+	// the copy of the body kept for inlining, see inline.c
+	struct inlineBody *body;
 } *FunctionSymbol;
 
 typedef struct table
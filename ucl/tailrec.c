@@ -0,0 +1,210 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Tail recursion elimination.
+
+	A call of the function itself, whose value is returned at once, is
+	replaced by the assignments of the arguments to the parameters and
+	a jump back to the beginning of the function body:
+
+		int gcd(int a, int b){				function gcd
+			if (b == 0)						BB1:
+				return a;					 	if (b != 0) goto BB3;
+			return gcd(b, a % b);			BB2:
+		}										return a;
+												goto BB4;
+											BB3:
+												t0 : a % b;
+												t1 = b;		----- b is read before it is assigned
+												a = t1;
+												b = t0;
+												goto BB1;
+											BB4:
+												ret
+
+	The body is moved out of the entry block into a new block, the loop
+	header, so the entry block has no predecessor, and the parameters are
+	copied into their temporaries there, see PromoteVariables().   The
+	function can't take the address of a parameter or a local, otherwise
+	the callee may see the objects of the caller it would have overwritten.
+	The parameters are scalars and the function has a prototype, the
+	arguments are converted to the types of the parameters then, except
+	that a char or short argument is passed as an int.   The other tail
+	calls are done by the back end, see EmitCall() in riscv.c.
+ */
+
+// eliminate tail recursion and do tail calls, see -fno-optimize-sibling-calls
+int TailCalls = 1;
+
+static void DecreaseReference(Symbol *opd, int def)
+{
+	(*opd)->ref--;
+}
+
+/**
+	Return 1 if inst calls fsym and the function returns the value of the
+	call right after it:
+		t2 : fact(t0, t1);
+		return t2;
+		goto BB8;				----- BB8 is the empty exit block
+ */
+static int IsTailRecursion(FunctionSymbol fsym, BBlock bb, IRInst inst)
+{
+	IRInst next = inst->next;
+
+	if (inst->opcode != CALL || inst->opds[1] != (Symbol)fsym)
+		return 0;
+
+	if (inst->opds[0] != NULL)
+	{
+		if (next == &bb->insth || next->opcode != RET || next->opds[0] != inst->opds[0])
+			return 0;
+		next = next->next;
+	}
+	else if (fsym->ty->bty->categ != VOID)
+	{
+		return 0;
+	}
+	if (next != &bb->insth && next->opcode == JMP)
+		return next->next == &bb->insth && IsReturnBlock((BBlock)next->opds[0]);
+
+	return next == &bb->insth && IsReturnBlock(bb->next);
+}
+
+static int CanEliminateTailRecursion(FunctionSymbol fsym)
+{
+	FunctionType fty = (FunctionType)fsym->ty;
+	BBlock bb;
+	IRInst inst;
+	Symbol p;
+	int found = 0;
+
+	if (! fty->sig->hasProto || fty->sig->hasEllipsis)
+		return 0;
+
+	for (p = fsym->params; p != NULL; p = p->next)
+	{
+		if (! IsScalarType(p->ty) || p->addressed)
+			return 0;
+	}
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			// an object on the frame of the caller
+			if (inst->opcode == ADDR && inst->opds[1]->kind != SK_String && inst->opds[1]->kind != SK_Function)
+			{
+				p = inst->opds[1]->kind == SK_Offset ? inst->opds[1]->link : inst->opds[1];
+				if (p->level != 0 && p->sclass != TK_STATIC && p->sclass != TK_EXTERN)
+					return 0;
+			}
+			if (IsTailRecursion(fsym, bb, inst))
+				found = 1;
+		}
+	}
+	return found;
+}
+
+/**
+	Replace the tail call inst in bb by a jump to header.   The arguments
+	which are parameters themselves are copied into temporaries first.
+ */
+static void ReplaceTailRecursion(FunctionSymbol fsym, BBlock bb, IRInst inst, BBlock header)
+{
+	Vector args = (Vector)inst->opds[2];
+	Symbol *vals, p, q, t;
+	IRInst next;
+	ILArg arg;
+	int i;
+
+	vals = HeapAllocate(CurrentHeap, (LEN(args) + 1) * sizeof(Symbol));
+	for (i = 0; i < LEN(args); i++)
+	{
+		arg = GET_ITEM(args, i);
+		vals[i] = arg->sym;
+	}
+
+	// the call, the return and the jump to the exit block
+	fsym->ref--;
+	while (inst != &bb->insth)
+	{
+		next = inst->next;
+		VisitOperands(inst, DecreaseReference);
+		RemoveInst(bb, inst);
+		inst = next;
+	}
+
+	CurrentBB = bb;
+	for (i = 0; i < LEN(args); i++)
+	{
+		for (q = fsym->params; q != NULL && q != vals[i]; q = q->next)
+			;
+		if (q != NULL)
+		{
+			t = CreateTemp(q->ty);
+			GenerateMove(q->ty, t, q);
+			vals[i] = t;
+		}
+	}
+	for (i = 0, p = fsym->params; p != NULL; i++, p = p->next)
+	{
+		if (p->ref == 0)
+			continue;
+		if (p->ty->categ < INT)
+		{
+			t = CreateTemp(p->ty);
+			GenerateAssign(p->ty, t, p->ty->size == 1 ? TRUI1 : TRUI2, vals[i], NULL);
+			GenerateMove(p->ty, p, t);
+		}
+		else
+		{
+			GenerateMove(p->ty, p, vals[i]);
+		}
+	}
+	GenerateJump(header);
+}
+
+/**
+	Turn the tail calls of fsym to itself into a loop, the CFG is drawn again
+	if one is found.
+ */
+void EliminateTailRecursion(FunctionSymbol fsym)
+{
+	BBlock bb, header;
+	IRInst inst;
+
+	if (! CanEliminateTailRecursion(fsym))
+		return;
+
+	// the instructions of the entry block are moved to the loop header
+	bb = fsym->entryBB;
+	header = CreateBBlock();
+	if (bb->insth.next != &bb->insth)
+	{
+		header->insth.next = bb->insth.next;
+		header->insth.prev = bb->insth.prev;
+		header->insth.next->prev = header->insth.prev->next = &header->insth;
+		header->ninst = bb->ninst;
+		bb->insth.next = bb->insth.prev = &bb->insth;
+		bb->ninst = 0;
+	}
+	header->next = bb->next;
+	header->prev = bb;
+	if (bb->next != NULL)
+		bb->next->prev = header;
+	bb->next = header;
+
+	for (bb = header; bb != NULL; bb = bb->next)
+	{
+		for (inst = bb->insth.next; inst != &bb->insth; inst = inst->next)
+		{
+			if (IsTailRecursion(fsym, bb, inst))
+			{
+				ReplaceTailRecursion(fsym, bb, inst, header);
+				break;
+			}
+		}
+	}
+	RebuildCFG(fsym);
+}
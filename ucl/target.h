@@ -2,10 +2,17 @@
 #define __TARGET_H_
 
 enum { CODE, DATA };
+/**
+	The ISA extensions enabled by -march, see SetupISA().
+	The default is rv32imafd (rv32g).
+ */
+enum { ISA_M = 0x1, ISA_A = 0x2, ISA_F = 0x4, ISA_D = 0x8, ISA_C = 0x10, ISA_ZBB = 0x20, ISA_ZICOND = 0x40 };
+extern int ISAExtensions;
 
 
 void PutASMCode(int code, Symbol opds[]);
 void SetupRegisters(void);
+void SetupISA(char *arch);
 void BeginProgram(void);
 void Segment(int seg);
 void Import(Symbol p);
@@ -8,8 +8,10 @@ TOKEN(TK_EXTERN,    "extern")
 TOKEN(TK_REGISTER,  "register")
 TOKEN(TK_STATIC,    "static")
 TOKEN(TK_TYPEDEF,   "typedef")
+TOKEN(TK_INLINE,    "inline")
 TOKEN(TK_CONST,     "const")
 TOKEN(TK_VOLATILE,  "volatile")
+TOKEN(TK_RESTRICT,  "restrict")
 TOKEN(TK_SIGNED,    "signed")
 TOKEN(TK_UNSIGNED,  "unsigned")
 TOKEN(TK_SHORT,     "short")
@@ -5,6 +5,18 @@
 
 #define	GetBitFieldType(fld)	((fld->ty->categ %2) ? T(UINT):T(INT) )
 
+/**
+	The type of the object expr accesses.   Adjust() removes the qualifiers
+	of an rvalue, a volatile one is put back on the load, which the optimizer
+	must not remove or reuse, see IsVolatileAccess().
+		volatile int *p;
+		int a = *p;		----------	t0 = *p;	its type is volatile int
+ */
+static Type AccessType(AstExpression expr)
+{
+	return expr->isvolatile ? Qualify(VOLATILE, expr->ty) : expr->ty;
+}
+
 /**
  * Translates a primary expression.
  */
@@ -146,7 +158,7 @@ static Symbol WriteBitField(Field fld, Symbol dst, Symbol src)
 		Symbol addr = AsVar(dst)->def->src1;
 
 		GenerateIndirectMove(fld->ty, addr, p);
-		dst = Deref(fld->ty, addr);
+		dst = Deref(Unqual(fld->ty), addr);
 	}
 	else
 	{
@@ -371,7 +383,7 @@ static Symbol TranslateArrayIndex(AstExpression expr)
 
 	
 	addr = TranslateExpression(p);
-	dst = Offset(expr->ty, addr, voff, coff);
+	dst = Offset(AccessType(expr), addr, voff, coff);
 	return expr->isarray ? AddressOf(dst) : dst;
 }
 /**
@@ -483,7 +495,7 @@ static Symbol TranslateMemberAccess(AstExpression expr)
 	}
 	//	No variable offset when accessing member of a struct.	
 	//PRINT_DEBUG_INFO(("%s",addr->name));
-	dst = Offset(expr->ty, addr, NULL, coff);	
+	dst = Offset(AccessType(expr), addr, NULL, coff);
 	/**
 		store struct field object in symbol object for struct filed,
 		to be used later  in 
@@ -750,13 +762,46 @@ static Symbol TranslateCast(Type ty, Type sty, Symbol src)
 		   unary-operator: one of
 				   &  *  +	-  ~  !
  */
+/**
+	A relational or equality operator used as a value is a set-on-compare
+	instruction, ty is the type of the operands, the result is int 0/1.
+		int f(int a, int b){
+			return a < b;
+		}
+		-------------------
+		function f
+			t0 = a < b;		-----------	slt a0, a0, a1
+			return t0;
+ */
+static Symbol TranslateCompare(Type ty, int op, Symbol src1, Symbol src2)
+{
+	Symbol t;
+
+	t = CreateTemp(T(INT));
+	GenerateAssign(ty, t, op, src1, src2);
+
+	return t;
+}
+
 static Symbol TranslateUnaryExpression(AstExpression expr)
 {
 	Symbol src;
+	Type ty;
 
 	if (expr->op == OP_NOT)
 	{
-		return TranslateBranchExpression(expr);
+		// !a is (a == 0), a floating-point value still uses branches
+		ty = expr->kids[0]->ty;
+		if (IsRealType(ty))
+			return TranslateBranchExpression(expr);
+
+		src = TranslateExpression(expr->kids[0]);
+		if (ty->categ < INT)
+		{
+			src = TranslateCast(T(INT), ty, src);
+			ty = T(INT);
+		}
+		return TranslateCompare(ty, SEQ, src, IntConstant(0));
 	}
 
 	if (expr->op == OP_PREINC || expr->op == OP_PREDEC)
@@ -775,7 +820,7 @@ static Symbol TranslateUnaryExpression(AstExpression expr)
 		return AddressOf(src);
 
 	case OP_DEREF:		// *a
-		return Deref(expr->ty, src);
+		return Deref(AccessType(expr), src);
 
 	case OP_NEG:
 	case OP_COMP:		//	+/-
@@ -791,15 +836,156 @@ static Symbol TranslateBinaryExpression(AstExpression expr)
 {
 	Symbol src1, src2;
 
-	if (expr->op == OP_OR || expr->op == OP_AND || (expr->op >= OP_EQUAL && expr->op <= OP_LESS_EQ))
+	if (expr->op == OP_OR || expr->op == OP_AND)
 	{
 		return TranslateBranchExpression(expr);
 	}
 	src1 = TranslateExpression(expr->kids[0]);
 	src2 = TranslateExpression(expr->kids[1]);
 
+	if (expr->op >= OP_EQUAL && expr->op <= OP_LESS_EQ)
+	{
+		// JE..JLE and SEQ..SLE are in the same order
+		return TranslateCompare(expr->kids[0]->ty, OPMap[expr->op] - JE + SEQ, src1, src2);
+	}
+
 	return Simplify(expr->ty, OPMap[expr->op], src1, src2);
 }
+/**
+	The 32-bit integer or pointer values a select instruction works on
+ */
+#define IsSelectType(ty)	((IsIntegType(ty) || IsPtrType(ty)) && ty->size == 4)
+
+/**
+	An operand of ?: which has no side effect and needs only a few
+	instructions, so it can be evaluated even if it isn't selected.
+	depth is the number of the operators still allowed.   A volatile
+	object is read only if selected, and  g > 5 ? g : 5  reads it twice,
+	so it isn't a min/max.
+ */
+static int IsCheapExpression(AstExpression expr, int depth)
+{
+	if (! (IsIntegType(expr->ty) || IsPtrType(expr->ty)))
+		return 0;
+
+	switch (expr->op)
+	{
+	case OP_CONST:
+		return 1;
+
+	case OP_ID:
+		// the type of an rvalue has no qualifier, see Adjust()
+		return ! (((Symbol)expr->val.p)->ty->qual & VOLATILE);
+
+	case OP_CAST:
+	case OP_NEG:
+	case OP_COMP:
+		return depth > 0 && IsCheapExpression(expr->kids[0], depth - 1);
+
+	case OP_BITOR:
+	case OP_BITXOR:
+	case OP_BITAND:
+	case OP_LSHIFT:
+	case OP_RSHIFT:
+	case OP_ADD:
+	case OP_SUB:
+	case OP_EQUAL:
+	case OP_UNEQUAL:
+	case OP_GREAT:
+	case OP_LESS:
+	case OP_GREAT_EQ:
+	case OP_LESS_EQ:
+		return depth > 0 && IsCheapExpression(expr->kids[0], depth - 1) &&
+		       IsCheapExpression(expr->kids[1], depth - 1);
+
+	case OP_QUESTION:
+		// x < 0 ? 0 : (x > 255 ? 255 : x)
+		return depth > 0 && IsSelectType(expr->ty) && IsCheapExpression(expr->kids[0], depth - 1) &&
+		       IsCheapExpression(expr->kids[1]->kids[0], depth - 1) &&
+		       IsCheapExpression(expr->kids[1]->kids[1], depth - 1);
+
+	default:
+		return 0;
+	}
+}
+
+static int IsZeroConstant(Symbol p)
+{
+	return p->kind == SK_Constant && p->val.i[0] == 0;
+}
+
+static Symbol GenerateSelect(Type ty, int op, Symbol src1, Symbol src2)
+{
+	Symbol t;
+
+	t = CreateTemp(ty);
+	GenerateAssign(ty, t, op, src1, src2);
+
+	return t;
+}
+
+/**
+	c ? a : b without branches, a and b are cheap expressions.
+		int clamp(int x){
+			return x > 255 ? 255 : x;
+		}
+		-------------------
+		function clamp
+			t0 : min(x, 255);
+			return t0;
+
+		int f(int c, int a, int b){
+			return c ? a : b;
+		}
+		-------------------
+		function f
+			t0 : c ? a : 0;
+			t1 : c ? 0 : b;
+			t2 : t0 | t1;
+			return t2;
+	A relational condition whose operands are a and b is min/max.
+	The selects are lowered to Zicond czero.eqz/czero.nez or to masks,
+	see EmitSelect() in riscv.c.
+ */
+static Symbol TranslateSelect(AstExpression expr)
+{
+	AstExpression cond = expr->kids[0];
+	Symbol c, x, y, a, b;
+	int op;
+
+	if (cond->op >= OP_GREAT && cond->op <= OP_LESS_EQ && cond->kids[0]->ty->categ == expr->ty->categ)
+	{
+		x = TranslateExpression(cond->kids[0]);
+		y = TranslateExpression(cond->kids[1]);
+		a = TranslateExpression(expr->kids[1]->kids[0]);
+		b = TranslateExpression(expr->kids[1]->kids[1]);
+		// x > y ? x : y is max(x, y), x < y ? x : y is min(x, y)
+		op = (cond->op == OP_GREAT || cond->op == OP_GREAT_EQ) ? MAX : MIN;
+		if (a == x && b == y)
+			return GenerateSelect(expr->ty, op, x, y);
+		if (a == y && b == x)
+			return GenerateSelect(expr->ty, op == MAX ? MIN : MAX, x, y);
+
+		c = TranslateCompare(cond->kids[0]->ty, OPMap[cond->op] - JE + SEQ, x, y);
+	}
+	else
+	{
+		c = TranslateExpression(cond);
+		a = TranslateExpression(expr->kids[1]->kids[0]);
+		b = TranslateExpression(expr->kids[1]->kids[1]);
+	}
+
+	if (IsZeroConstant(b))
+		return GenerateSelect(expr->ty, SELNZ, a, c);
+	if (IsZeroConstant(a))
+		return GenerateSelect(expr->ty, SELZ, b, c);
+
+	a = GenerateSelect(expr->ty, SELNZ, a, c);
+	b = GenerateSelect(expr->ty, SELZ, b, c);
+
+	return GenerateSelect(expr->ty, BOR, a, b);
+}
+
 /**
  Syntax
  
@@ -828,6 +1014,11 @@ static Symbol TranslateConditionalExpression(AstExpression expr)
 			 return 0;
 		 }
 	 */
+	if (IsSelectType(expr->ty) && IsSelectType(expr->kids[0]->ty) &&
+	    IsCheapExpression(expr->kids[1]->kids[0], 2) && IsCheapExpression(expr->kids[1]->kids[1], 2))
+	{
+		return TranslateSelect(expr);
+	}
 	if (expr->ty->categ != VOID)
 	{
 		t = CreateTemp(expr->ty);
@@ -861,6 +1052,11 @@ static Symbol TranslateAssignmentExpression(AstExpression expr)
 
 	dst = TranslateExpression(expr->kids[0]);
 	fld = dst->val.p;
+	// *p = 3 doesn't read *p, *p += 3 does
+	if (expr->op == OP_ASSIGN && ! expr->kids[0]->bitfld)
+	{
+		DiscardLoad(dst);
+	}
 	/**
 		 OPINFO(OP_COMMA,		  1,	",",	  Comma,		  NOP)
 		 OPINFO(OP_ASSIGN,		  2,	"=",	  Assignment,	  NOP)
@@ -920,7 +1116,8 @@ static Symbol TranslateAssignmentExpression(AstExpression expr)
 		Symbol addr = AsVar(dst)->def->src1;
 		//PRINT_DEBUG_INFO(("name = %s",dst->name));
 		GenerateIndirectMove(expr->ty, addr, src);
-		dst = Deref(expr->ty, addr);
+		// the value of the assignment isn't a volatile read, it may be removed
+		dst = Deref(Unqual(expr->ty), addr);
 	}
 	else
 	{
@@ -984,12 +1181,15 @@ AstExpression Not(AstExpression expr)
 		expr->kids[1] = Not(expr->kids[1]);
 		return expr;
 
-	case OP_EQUAL:
-	case OP_UNEQUAL:
 	case OP_GREAT:
 	case OP_LESS:
 	case OP_GREAT_EQ:
 	case OP_LESS_EQ:
+		// !(a < b) isn't a >= b when a or b is a NaN
+		if (IsRealType(expr->kids[0]->ty))
+			break;
+	case OP_EQUAL:
+	case OP_UNEQUAL:
 		expr->op = rops[expr->op - OP_EQUAL];
 		return expr;
 
@@ -997,14 +1197,17 @@ AstExpression Not(AstExpression expr)
 		return expr->kids[0];
 
 	default:
-		CREATE_AST_NODE(t, Expression);
-		t->coord = expr->coord;
-		t->ty = T(INT);
-		t->op = OP_NOT;
-		t->kids[0] = expr;
-		return FoldConstant(t);
+		break;
 	}
+
+	CREATE_AST_NODE(t, Expression);
+	t->coord = expr->coord;
+	t->ty = T(INT);
+	t->op = OP_NOT;
+	t->kids[0] = expr;
+	return FoldConstant(t);
 }
+
 /**
 	if(expr)	goto trueBB.
 	@expr	the expression for test
@@ -791,10 +791,8 @@ static void TranslateFunction(AstFunction func)
 	TranslateStatement(func->stmt);
 	// 
 	StartBBlock(FSYM->exitBB);
-	// do some optimizations for every basic block, only at the IR level, not ASM level.
-	#if 1
-	Optimize(FSYM);
-	#endif
+	// the optimizations at the IR level, not ASM level, chosen by -O and -f<pass>, see pass.c
+	RunPasses(FSYM);
 	bb = FSYM->entryBB;
 	// function f
 	//BB0:
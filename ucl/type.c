@@ -1114,14 +1114,10 @@ char* TypeToString(Type ty)
 		qual = ty->qual;
 		ty = Unqual(ty);
 
-		if (qual == CONST)
-			str = "const";
-		else if (qual == VOLATILE)
-			str = "volatile";
-		else 
-			str = "const volatile";
+		str = FormatName("%s%s%s", qual & CONST ? "const " : "", qual & VOLATILE ? "volatile " : "",
+		                 qual & RESTRICT ? "restrict " : "");
 		// for example: const volatile int
-		return FormatName("%s %s", str, TypeToString(ty));
+		return FormatName("%s%s", str, TypeToString(ty));
 	}
 	// primary type
 	if (ty->categ >= CHAR && ty->categ <= LONGDOUBLE && ty->categ != ENUM)
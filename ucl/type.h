@@ -15,14 +15,14 @@ enum
 	FLOAT, DOUBLE, LONGDOUBLE, POINTER, VOID, UNION, STRUCT, ARRAY, FUNCTION
 };
 // type qualifier
-enum { CONST = 0x1, VOLATILE = 0x2 };
+enum { CONST = 0x1, VOLATILE = 0x2, RESTRICT = 0x4 };
 // I1 : signed int8	1byte=8bit;  U1: unsigned int8
 // V: no type              B: memory block, 
 // see TypeCode()
 enum {I1, U1, I2, U2, I4, U4, F4, F8, V, B};
 /**
 	categ:	category	CHAR,UCHAR,SHORT, ...
-	qual:	type qualifier, CONST, VOLATILE
+	qual:	type qualifier, CONST, VOLATILE, RESTRICT
 	align:	type alignment
 	size:	type size
 	bty:		for primary type		bty  is NULL
@@ -112,12 +112,14 @@ typedef struct enumType
 	function declaration or definition.
 	id:	parameter name ,can be NULL.
 	ty:	parameter type
+	qual:	the qualifiers of the parameter, they aren't part of the function type
 	reg:	qualified by register or not
  */
 typedef struct parameter
 {
 	char *id; 
 	Type ty; 
+	int  qual;
 	int  reg; 
 } *Parameter;
 /**
@@ -1,11 +1,15 @@
 #include "ucl.h"
 #include "ast.h"
 #include "target.h"
+#include "gen.h"
+#include "output.h"
 
 // flag to control if dump abstract syntax tree
 static int DumpAST;
 // flag to control if dump intermediate code
 static int DumpIR;
+// flag to control if report the time of the analyses, see -ftime-report
+static int TimeReport;
 // file to hold abstract synatx tree
 FILE *ASTFile;
 // file to hold intermediate code
@@ -72,9 +76,21 @@ static void Compile(char *file)
 		DumpTranslationUnit(transUnit);
 	}
 
+	if (DumpIRAfter != NULL)
+	{
+		// Dump intermediate code after a pass, see DAssemPass()
+		IRFile = CreateOutput(Input.filename, FormatName(".%s.uil", DumpIRAfter));
+	}
+
 	// translate the abstract synatx tree into intermediate code
 	Translate(transUnit);
 
+	if (IRFile != NULL)
+	{
+		fclose(IRFile);
+		IRFile = NULL;
+	}
+
 	if (DumpIR)
 	{
 		// Dump intermediate code which is put into a file named xxx.uil
@@ -173,6 +189,41 @@ static int ParseCommandLine(int argc, char *argv[])
 		{
 			DumpIR = 1;
 		} 
+		// "  -march=rv32imafd_zbb_zicond   the ISA extensions the generated code may use\n"
+		else if (strncmp(argv[i], "-march=", 7) == 0)
+		{
+			SetupISA(argv[i] + 7);
+		}
+		// "  --dump-IR-after=pass   Dump intermediate code after the pass into a file named xxx.pass.uil\n"
+		else if (strncmp(argv[i], "--dump-IR-after=", 16) == 0)
+		{
+			SetDumpIRAfter(argv[i] + 16);
+		}
+		// "  -O0 -O1 -O2 -Os   the optimization passes run, -O2 is the default, see pass.c\n"
+		else if (strncmp(argv[i], "-O", 2) == 0)
+		{
+			SetOptimizeLevel(argv[i] + 2);
+		}
+		// "  -funroll-loops=N   copy the body of a small loop N times, N is from 1 to 64\n"
+		else if (strncmp(argv[i], "-funroll-loops=", 15) == 0)
+		{
+			SetUnrollFactor(argv[i] + 15);
+		}
+		// "  -ftime-report   report the time spent in the passes and the dataflow analyses\n"
+		else if (strcmp(argv[i], "-ftime-report") == 0)
+		{
+			TimeReport = 1;
+		}
+		// "  -fno-<pass>   skip the pass, e.g. -fno-inline, -fno-reorder-blocks\n"
+		else if (strncmp(argv[i], "-fno-", 5) == 0 && ChoosePass(argv[i] + 5, 0))
+		{
+			continue;
+		}
+		// "  -f<pass>   run the pass whatever the -O level is, e.g. -fgvn\n"
+		else if (strncmp(argv[i], "-f", 2) == 0 && ChoosePass(argv[i] + 2, 1))
+		{
+			continue;
+		}
 		else
 			return i;
 	}
@@ -191,6 +242,7 @@ int main(int argc, char *argv[])
 	CurrentHeap = &ProgramHeap;
 	argc--; argv++;
 	i = ParseCommandLine(argc, argv);
+	SetupPasses();
 
 	SetupRegisters();
 	SetupLexer();
@@ -211,6 +263,13 @@ int main(int argc, char *argv[])
 	{
 		Compile(argv[i]);
 	}
+	if (TimeReport)
+	{
+		ReportPasses();
+		fprintf(stderr, "dataflow: %d problems, %d block visits, %d set chunks, %.3f s\n",
+		        DataflowProblems, DataflowVisits, DataflowChunks, DataflowSeconds);
+		fprintf(stderr, "liveness: %.3f s\n", LivenessSeconds);
+	}
 
 	return (ErrorCount != 0);
 }
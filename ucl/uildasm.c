@@ -41,9 +41,29 @@ static void DAssemUIL(IRInst inst)
 	case MUL: 
 	case DIV: 
 	case MOD:
+	case SEQ:
+	case SNE:
+	case SGT:
+	case SLT:
+	case SGE:
+	case SLE:
 		fprintf(IRFile, "%s : %s %s %s", DST->name, SRC1->name, OPCodeNames[op], SRC2->name);
 		break;
 
+	case MIN:
+	case MAX:
+		fprintf(IRFile, "%s : %s(%s, %s)", DST->name, OPCodeNames[op], SRC1->name, SRC2->name);
+		break;
+
+	case SELNZ:
+		// t1 : a ? 3 : 0
+		fprintf(IRFile, "%s : %s ? %s : 0", DST->name, SRC2->name, SRC1->name);
+		break;
+
+	case SELZ:
+		fprintf(IRFile, "%s : %s ? 0 : %s", DST->name, SRC2->name, SRC1->name);
+		break;
+
 	case INC:
 	case DEC:
 		fprintf(IRFile, "%s%s", OPCodeNames[op], DST->name);
@@ -129,6 +149,24 @@ static void DAssemUIL(IRInst inst)
 		}
 		break;
 
+	case PHI:
+		// t5 : phi(t3 BB1, t4 BB2);
+		{
+			PhiArg arg;
+			Vector args = (Vector)SRC1;
+			int i;
+
+			fprintf(IRFile, "%s : %s(", DST->name, OPCodeNames[op]);
+			for (i = 0; i < LEN(args); i++)
+			{
+				arg = GET_ITEM(args, i);
+				fprintf(IRFile, "%s%s %s", i == 0 ? "" : ", ", arg->sym->name,
+				        arg->bb->sym != NULL ? arg->bb->sym->name : "?");
+			}
+			fprintf(IRFile, ")");
+		}
+		break;
+
 	case RET:
 		// return t4;
 		fprintf(IRFile, "return %s", DST->name);
@@ -144,14 +182,50 @@ static void DAssemUIL(IRInst inst)
 
 }
 
-void DAssemFunction(AstFunction func)
+/**
+ * Dump the temporaries in set, e.g. "// live in: t1, t5"
+ */
+static void DAssemLiveSet(char *title, BitSet set, Symbol *temps)
+{
+	int i;
+
+	if ((i = NextBit(set, 0)) < 0)
+		return;
+
+	fprintf(IRFile, "\t// %s: %s", title, temps[i]->name);
+	for (i = NextBit(set, i + 1); i >= 0; i = NextBit(set, i + 1))
+	{
+		fprintf(IRFile, ", %s", temps[i]->name);
+	}
+	fprintf(IRFile, "\n");
+}
+
+static void DAssemBlocks(FunctionSymbol fsym)
 {
-	FunctionSymbol fsym = func->fsym;
 	BBlock bb = fsym->entryBB;
 	IRInst inst;
+	Dataflow live;
+	Symbol p, *temps;
+	int n;
 
-	if (! fsym->defined)
-		return;
+	// the temporaries live at the entry and the exit of every block, see ComputeLiveness()
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			n++;
+	}
+	temps = HeapAllocate(CurrentHeap, (n + 1) * sizeof(Symbol));
+	n = 0;
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+		{
+			temps[n++] = p;
+			AsVar(p)->no = n;
+		}
+	}
+	live = ComputeLiveness(fsym, n);
 	/**
 		function f
 			if (n > 2) goto BB0;
@@ -182,14 +256,21 @@ void DAssemFunction(AstFunction func)
 			fprintf(IRFile, "%s:\n ",bb->sym->name);
 		#endif
 		}
+		DAssemLiveSet("live in", live->in[bb->no], temps);
 		inst = bb->insth.next;
 		while (inst != &bb->insth)
 		{
 			DAssemUIL(inst);
 			inst = inst->next;
 		}
+		DAssemLiveSet("live out", live->out[bb->no], temps);
 		bb = bb->next;
 	}
+	for (p = fsym->locals; p != NULL; p = p->next)
+	{
+		if (p->kind == SK_Temp)
+			AsVar(p)->no = 0;
+	}
 	// if the exit block has predecessors, gen a  "ret" intermediate instruction
 	if (fsym->exitBB->npred != 0)
 		fprintf(IRFile, "\tret\n");
@@ -197,6 +278,38 @@ void DAssemFunction(AstFunction func)
 	fprintf(IRFile, "\n\n");
 }
 
+void DAssemFunction(AstFunction func)
+{
+	if (! func->fsym->defined)
+		return;
+
+	DAssemBlocks(func->fsym);
+}
+
+/**
+	Dump fsym in the middle of the passes, see --dump-IR-after=pass.   The
+	blocks are named after the passes, see TranslateFunction(), they get
+	temporary names B0, B1, ... here, which don't take the numbers of the
+	labels, so the code is the same whether the IR is dumped or not.
+ */
+void DAssemPass(FunctionSymbol fsym)
+{
+	BBlock bb;
+	int n = 0;
+
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		CALLOC(bb->sym);
+		bb->sym->kind = SK_Label;
+		bb->sym->name = FormatName("B%d", n++);
+	}
+	DAssemBlocks(fsym);
+	for (bb = fsym->entryBB; bb != NULL; bb = bb->next)
+	{
+		bb->sym = NULL;
+	}
+}
+
 void DAssemTranslationUnit(AstTranslationUnit transUnit)
 {
 	AstNode p = transUnit->extDecls;
@@ -0,0 +1,299 @@
+#include "ucl.h"
+#include "gen.h"
+
+/**
+	Loop unrolling.
+
+	An innermost loop of one block, counted by a temporary i which is
+	bumped by a constant and compared with a loop-invariant n at the
+	bottom, see RotateLoops().   Its body is copied UnrollFactor times
+	into a new loop, which tests once for all the copies; the original
+	loop runs the remaining iterations:
+
+		int sum(int *a, int n){			t16 = t7 - t13;
+			int i, s = 0;				if (t16 <= 1) goto BB4;		----- unsigned, 2 copies
+			for(i = 0; i < n; i++)		t17 = t7 - 1;
+				s += a[i];			BB2:
+			return s;					t0 = t13 << 2;
+		}								...
+										t18 = t13 + 1;
+										t4 = t18 << 2;
+										...
+										t13 = t13 + 2;
+										if (t13 < t17) goto BB2;
+									BB3:
+										if (t13 >= t7) goto BB5;
+									BB4:						----- the remainder
+										t0 = t13 << 2;
+										...
+										++t13;
+										if (t13 < t7) goto BB4;
+									BB5:
+
+	When the new loop is entered or repeated, i + (UnrollFactor - 1) * c < n
+	holds, so the next UnrollFactor iterations are all run.   n - i is taken
+	as unsigned after i < n is known, either by the guard in front of the
+	loop or by a new test, so neither it nor n - (UnrollFactor - 1) * c
+	wraps around.   A loop counting down with i > n or i >= n is done the
+	same way.   The k-th copy uses i + k * c, and i is bumped only once,
+	so the new loop has a basic induction variable for
+	ReduceInductionVariables().   The body of the new loop has
+	MAX_UNROLLED_INSTS instructions at most, the factor is decreased for
+	a bigger loop.   A loop with calls isn't unrolled, the calls take much
+	more time than the loop test.   The global optimizations see the copies
+	of a temporary as different definitions, see BuildSSA().
+ */
+
+#define MAX_UNROLLED_INSTS  64
+
+// the number of the copies of the loop body, a loop isn't unrolled if it is 1, see -funroll-loops=N
+int UnrollFactor = 4;
+
+static Symbol Counter, Current;
+static IRInst CounterDef, CurInst;
+static int NumDefs;
+
+#define IsWordTemp(p) (IsSSATemp(p) && ! IsRealType((p)->ty) && (p)->ty->size == 4)
+
+static void CountReference(Symbol *opd, int def)
+{
+	(*opd)->ref++;
+}
+
+static void FindDefinition(Symbol *opd, int def)
+{
+	if (def && *opd == Counter)
+	{
+		NumDefs++;
+		CounterDef = CurInst;
+	}
+}
+
+/**
+ * The number of the definitions of p in bb, CounterDef is the last one.
+ */
+static int CountDefinitions(BBlock bb, Symbol p)
+{
+	Counter = p;
+	CounterDef = NULL;
+	NumDefs = 0;
+	for (CurInst = bb->insth.next; CurInst != &bb->insth; CurInst = CurInst->next)
+	{
+		VisitOperands(CurInst, FindDefinition);
+	}
+	return NumDefs;
+}
+
+/**
+	The step of counter i defined by inst, i++, i--, i = i + c or i = i - c;
+	0 if inst isn't one of them.
+ */
+static int StepOf(IRInst inst, Symbol i)
+{
+	Symbol c = inst->opds[2];
+
+	if (inst->opcode == INC || inst->opcode == DEC)
+		return IsIntegType(inst->ty) ? (inst->opcode == INC ? 1 : -1) : 0;
+	if (inst->opcode != ADD && inst->opcode != SUB)
+		return 0;
+	if (inst->opds[1] != i || c->kind != SK_Constant || IsRealType(c->ty) || c->val.i[0] <= -0x8000 || c->val.i[0] >= 0x8000)
+		return 0;
+
+	return inst->opcode == ADD ? c->val.i[0] : -c->val.i[0];
+}
+
+/**
+	Find the counter i and the invariant n compared at the bottom of bb,
+	the comparison is turned into i op n.   Return the step of i, or 0;
+	CounterDef is the instruction bumping i.
+ */
+static int FindCounter(BBlock bb, Symbol *pi, Symbol *pn, int *op)
+{
+	static int swaps[] = { JL, JG, JLE, JGE };
+	IRInst lasti = bb->insth.prev, inc, prev;
+	Symbol i = lasti->opds[1], n = lasti->opds[2], t;
+	int step;
+
+	*op = lasti->opcode;
+	if (*op < JG || *op > JLE || IsRealType(lasti->ty) || n == NULL)
+		return 0;
+
+	// n > i is i < n
+	if (CountDefinitions(bb, i) == 0)
+	{
+		t = i; i = n; n = t;
+		*op = swaps[*op - JG];
+	}
+	if (! IsWordTemp(i) || CountDefinitions(bb, i) != 1)
+		return 0;
+	inc = CounterDef;
+	step = StepOf(inc, i);
+	// t = i + c; i = t;
+	if (inc->opcode == MOV && IsSSATemp(inc->opds[1]) && CountDefinitions(bb, inc->opds[1]) == 1)
+	{
+		for (prev = inc->prev; prev != &bb->insth; prev = prev->prev)
+		{
+			if (prev == CounterDef)
+				step = StepOf(prev, i);
+		}
+	}
+	if (step == 0 || (step > 0) != (*op == JL || *op == JLE))
+		return 0;
+	if (n->kind == SK_Constant ? IsRealType(n->ty) : ! IsWordTemp(n) || CountDefinitions(bb, n) != 0)
+		return 0;
+
+	CounterDef = inc;
+
+	*pi = i;
+	*pn = n;
+	return step;
+}
+
+static void ReplaceCounter(Symbol *opd, int def)
+{
+	if (! def && *opd == Counter)
+		*opd = Current;
+}
+
+/**
+	i op n is known to be true when bb is entered from outside the loop,
+	the block before bb is the guard created by RotateLoops().
+ */
+static int IsGuarded(BBlock bb, Symbol i, Symbol n, int op)
+{
+	static int negs[] = { JLE, JGE, JL, JG };
+	static int swaps[] = { JL, JG, JLE, JGE };
+	BBlock guard = bb->prev;
+	IRInst lasti;
+	CFGEdge pred;
+
+	for (pred = bb->preds; pred != NULL; pred = pred->next)
+	{
+		if (pred->bb != bb && pred->bb != guard)
+			return 0;
+	}
+	lasti = guard->insth.prev;
+	if (lasti->opcode < JG || lasti->opcode > JLE || (BBlock)lasti->opds[0] == bb)
+		return 0;
+
+	return (lasti->opcode == negs[op - JG] && lasti->opds[1] == i && lasti->opds[2] == n) ||
+	       (lasti->opcode == swaps[negs[op - JG] - JG] && lasti->opds[1] == n && lasti->opds[2] == i);
+}
+
+static void UnrollLoop(Loop loop)
+{
+	static int negs[] = { JLE, JGE, JL, JG };
+	BBlock bb = loop->header, exitBB = bb->next, restBB;
+	IRInst lasti = bb->insth.prev, inc, inst, copy;
+	Symbol i, n, t, limit;
+	Type ty = lasti->ty;
+	int k, factor, step, op, up, dist;
+
+	if (LEN(loop->blocks) != 1 || exitBB == NULL || lasti->opcode < JZ || lasti->opcode > JLE ||
+	    (BBlock)lasti->opds[0] != bb)
+		return;
+
+	for (factor = UnrollFactor; factor > 1 && (bb->ninst - 1) * factor > MAX_UNROLLED_INSTS; factor--)
+		;
+	if (factor < 2 || (step = FindCounter(bb, &i, &n, &op)) == 0)
+		return;
+	inc = CounterDef;
+	for (inst = bb->insth.next; inst != lasti; inst = inst->next)
+	{
+		if (inst->opcode == CALL)
+			return;
+	}
+	up = op == JL || op == JLE;
+	dist = (factor - 1) * (up ? step : -step);
+
+	// the instructions of bb are moved to the remainder loop
+	restBB = CreateBBlock();
+	restBB->insth.next = bb->insth.next;
+	restBB->insth.prev = bb->insth.prev;
+	restBB->insth.next->prev = restBB->insth.prev->next = &restBB->insth;
+	restBB->ninst = bb->ninst;
+	bb->insth.next = bb->insth.prev = &bb->insth;
+	bb->ninst = 0;
+	lasti->opds[0] = (Symbol)restBB;
+
+	CurrentBB = bb;
+	if (! IsGuarded(bb, i, n, op))
+	{
+		GenerateBranch(ty, restBB, negs[op - JG], i, n);
+		StartBBlock(CreateBBlock());
+	}
+	t = CreateTemp(T(UINT));
+	if (up)
+		GenerateAssign(T(UINT), t, SUB, n, i);
+	else
+		GenerateAssign(T(UINT), t, SUB, i, n);
+	// n - i > dist for i < n, n - i >= dist for i <= n
+	GenerateBranch(T(UINT), restBB, op == JL || op == JG ? JLE : JL, t, IntConstant(dist));
+	StartBBlock(CreateBBlock());
+	limit = CreateTemp(ty);
+	GenerateAssign(ty, limit, up ? SUB : ADD, n, IntConstant(dist));
+
+	/**
+		The k-th copy uses i + k * step, i is bumped once at the end:
+			t0 = i << 2;				t0 = i << 2;
+			...							...
+			++i;			----->		t1 = i + 1;
+										t2 = t1 << 2;
+										...
+										i = i + 2;
+	 */
+	StartBBlock(CreateBBlock());
+	Counter = i;
+	Current = i;
+	for (k = 0; k < factor; k++)
+	{
+		for (inst = restBB->insth.next; inst != lasti; inst = inst->next)
+		{
+			if (inst == inc)
+			{
+				Current = k == factor - 1 ? i : CreateTemp(i->ty);
+				GenerateAssign(inc->ty, Current, ADD, i, IntConstant((k + 1) * step));
+				continue;
+			}
+			ALLOC(copy);
+			*copy = *inst;
+			VisitOperands(copy, ReplaceCounter);
+			VisitOperands(copy, CountReference);
+			AppendInst(copy);
+		}
+	}
+	GenerateBranch(ty, CurrentBB, op, i, limit);
+
+	StartBBlock(CreateBBlock());
+	GenerateBranch(ty, exitBB, negs[op - JG], i, n);
+
+	StartBBlock(restBB);
+	restBB->next = exitBB;
+	exitBB->prev = restBB;
+}
+
+/**
+	Unroll the innermost loops of fsym by UnrollFactor, the CFG is drawn
+	again if a loop is unrolled.
+ */
+void UnrollLoops(FunctionSymbol fsym)
+{
+	Vector loops;
+	Loop loop;
+	BBlock bb;
+	int i;
+
+	if (UnrollFactor < 2)
+		return;
+
+	ComputeDominators(fsym);
+	loops = FindLoops(fsym);
+	for (i = 0; i < LEN(loops); i++)
+	{
+		loop = GET_ITEM(loops, i);
+		bb = loop->header;
+		if (bb->loop == loop && LEN(loop->blocks) == 1)
+			UnrollLoop(loop);
+	}
+	RebuildCFG(fsym);
+}